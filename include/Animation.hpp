@@ -47,6 +47,10 @@ protected:
 
     GLdouble deg2rad;
 
+    /* Changes whenever the transform does, unique across animations */
+    unsigned long version;
+    static unsigned long lastVersion;
+
 public:
     Animation(const std::string& iId, float iSpan, unsigned int iType);
     virtual ~Animation();
@@ -57,9 +61,15 @@ public:
     unsigned long getDeltaTime();
     std::string getID();
 
+    /* Same span, type and control points */
+    bool hasSameDefinition(const Animation& other);
+
     /* Receives the (approximated) time passed since last update */
     void updateAnimation(unsigned long timePassed);
     void applyAnimation();
+    /* The transform applyAnimation multiplies in, column major */
+    void getAnimationMatrix(GLdouble* out);
+    unsigned long getVersion();
 };
 
 } //namespace ge
@@ -56,6 +56,8 @@ public:
 
     /* For already loaded textures */
     void setTexture(Texture* input);
+    Texture* getTexture();
+    void clearTexture();
     void setTextureWrap(GLfloat iS, GLfloat iT);
 
     std::string getTextureReference();
@@ -63,6 +65,9 @@ public:
 
     GLdouble getTextureSWrap();
     GLdouble getTextureTWrap();
+
+    /* Same values and texture reference (the texture itself is not compared) */
+    bool hasSameValues(const Appearance& other);
 };
 
 } // namespace ge
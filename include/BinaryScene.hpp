@@ -0,0 +1,317 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Compiled binary scene format (yafb).
+ *
+ * A yafb file is a flat image of an already parsed yaf file. It is made of a
+ * header followed by a set of sections (string table, node table, transform,
+ * primitive, appearance arrays, child index lists, ...). Every record is a
+ * fixed size POD, strings are offsets into the string table and children are
+ * indexes into the node table, so the image can be memory mapped and used
+ * in place.
+ *
+ * The yaf file is always the source of truth, the yafb is only a cache.
+ */
+
+#ifndef GEBINARYSCENE_HPP_
+#define GEBINARYSCENE_HPP_
+
+#include <ContentHash.hpp>
+#include <MappedFile.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ge {
+namespace Binary {
+
+/* Bump the version every time a record layout changes */
+const uint32_t Magic = 0x42464159; /* "YAFB" */
+const uint32_t Version = 3;
+const uint32_t ByteOrderMark = 0x01020304;
+
+/* Reference to a non existing string */
+const uint32_t NoString = 0xFFFFFFFF;
+
+const std::string FileExtension = ".yafb";
+
+enum Section {
+    SectionStrings = 0,
+    SectionGlobals,
+    SectionCameras,
+    SectionLights,
+    SectionTextures,
+    SectionAppearances,
+    SectionAnimations,
+    SectionNodes,
+    SectionTransforms,
+    SectionPrimitives,
+    SectionPoints,
+    SectionChildren,
+    SectionCount
+};
+
+struct SectionEntry {
+    uint64_t offset;
+    uint32_t count;
+    uint32_t elementSize;
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t headerSize;
+
+    /* Status of the yaf file this image was compiled from */
+    int64_t sourceModificationTime;
+    uint64_t sourceSize;
+
+    SectionEntry sections[SectionCount];
+};
+
+enum CameraType {
+    CameraPerspective = 0, CameraOrtho
+};
+
+enum LightType {
+    LightOmni = 0, LightSpot
+};
+
+enum TransformType {
+    TransformTypeTranslate = 0, TransformTypeRotate, TransformTypeScale
+};
+
+enum PrimitiveType {
+    PrimitiveRectangle = 0,
+    PrimitiveTriangle,
+    PrimitiveCylinder,
+    PrimitiveSphere,
+    PrimitiveTorus,
+    PrimitivePlane,
+    PrimitivePatch,
+    PrimitiveVehicle,
+    PrimitiveWaterLine
+};
+
+/* Node flags */
+const uint32_t NodeDisplayList = 1;
+const uint32_t NodeStaticBatch = 2;
+/* No displaylist attribute, the engine decides */
+const uint32_t NodeDisplayListAuto = 4;
+
+struct GlobalsRecord {
+    float background[4];
+    float ambient[4];
+    uint32_t drawMode;
+    uint32_t shadingMode;
+    uint32_t cullFace;
+    uint32_t cullOrder;
+    uint32_t initialCamera;
+    uint32_t rootId;
+    uint32_t lightingDoubleSided;
+    uint32_t lightingLocal;
+    uint32_t lightingEnabled;
+    uint32_t padding;
+};
+
+struct CameraRecord {
+    double position[3];
+    double target[3];
+    uint32_t id;
+    uint32_t type;
+    float nearPlane, farPlane, angle;
+    float left, right, top, bottom;
+    uint32_t padding;
+};
+
+struct LightRecord {
+    uint32_t id;
+    uint32_t type;
+    uint32_t enabled;
+    float location[3];
+    float ambient[4];
+    float diffuse[4];
+    float specular[4];
+    float angle, exponent;
+    float direction[3];
+};
+
+struct TextureRecord {
+    uint32_t id;
+    uint32_t file;
+};
+
+struct AppearanceRecord {
+    uint32_t id;
+    uint32_t textureRef;
+    float emissive[4];
+    float ambient[4];
+    float diffuse[4];
+    float specular[4];
+    float shininess;
+    float texlengthS, texlengthT;
+    uint32_t padding;
+};
+
+struct AnimationRecord {
+    uint32_t id;
+    uint32_t type;
+    float span;
+    uint32_t firstPoint;
+    uint32_t pointCount;
+    uint32_t padding;
+};
+
+struct PointRecord {
+    double x, y, z;
+};
+
+struct NodeRecord {
+    uint32_t id;
+    uint32_t flags;
+    uint32_t appearanceRef;
+    uint32_t animationRef;
+    uint32_t firstTransform, transformCount;
+    uint32_t firstPrimitive, primitiveCount;
+    uint32_t firstChild, childCount;
+};
+
+/* Translate and scale use the 3 values, rotate uses axis and values[0] */
+struct TransformRecord {
+    double values[3];
+    uint32_t type;
+    int32_t axis;
+};
+
+/*
+ * Generic primitive record, the meaning of each field depends on the type:
+ * rectangle: values = x1 y1 x2 y2
+ * triangle: values = xyz1 xyz2 xyz3
+ * cylinder: values = base top height, integers = slices stacks
+ * sphere: values = radius, integers = slices stacks
+ * torus: values = inner outer, integers = slices loops
+ * plane: integers = parts
+ * patch: integers = order partsU partsV compute, points = control points
+ * waterline: strings = heightmap texturemap fragmentshader vertexshader
+ */
+struct PrimitiveRecord {
+    double values[9];
+    uint32_t type;
+    uint32_t integers[4];
+    uint32_t strings[4];
+    uint32_t firstPoint;
+    uint32_t pointCount;
+    uint32_t padding;
+};
+
+/* Accumulates records while a yaf file is parsed and writes the image */
+class SceneImageWriter {
+private:
+    std::vector<char> stringTable;
+    std::unordered_map<std::string, uint32_t> internedStrings;
+
+    GlobalsRecord globals;
+    std::vector<CameraRecord> cameras;
+    std::vector<LightRecord> lights;
+    std::vector<TextureRecord> textures;
+    std::vector<AppearanceRecord> appearances;
+    std::vector<AnimationRecord> animations;
+    std::vector<NodeRecord> nodes;
+    std::vector<TransformRecord> transforms;
+    std::vector<PrimitiveRecord> primitives;
+    std::vector<PointRecord> points;
+
+    /* Children are kept by id until the image is written */
+    std::vector<std::vector<uint32_t> > nodeChildrenIds;
+
+    bool nodeOpen;
+
+public:
+    SceneImageWriter();
+    virtual ~SceneImageWriter();
+
+    uint32_t addString(const std::string& in);
+
+    GlobalsRecord& getGlobals();
+    void addCamera(const CameraRecord& in);
+    void addLight(const LightRecord& in);
+    void addTexture(const std::string& id, const std::string& file);
+    void addAppearance(const AppearanceRecord& in);
+    void setLastAppearanceTexture(const std::string& textureId,
+            float texlengthS, float texlengthT);
+
+    void beginAnimation(const std::string& id, float span, uint32_t type);
+    void addAnimationPoint(double x, double y, double z);
+
+    void beginNode(const std::string& id, bool displayList,
+            bool displayListAuto, bool staticBatch);
+    void setNodeAppearance(const std::string& appearanceId);
+    void setNodeAnimation(const std::string& animationId);
+    void addNodeTransform(const TransformRecord& in);
+    void addNodePrimitive(const PrimitiveRecord& in);
+    void addPrimitivePoint(double x, double y, double z);
+    void addNodeChild(const std::string& nodeId);
+    void endNode();
+
+    /* hashPrimitives of the node being written */
+    uint64_t getNodePrimitivesHash();
+
+    /* Writes the image, returns false on IO errors or unknown children ids */
+    bool write(const std::string& fileName, int64_t sourceModificationTime,
+            uint64_t sourceSize);
+};
+
+/* Read only view over a memory mapped image */
+class SceneImage {
+private:
+    MappedFile file;
+    const Header* header;
+
+    const void* getSection(Section section, uint32_t elementSize,
+            uint32_t& count);
+
+public:
+    SceneImage();
+    virtual ~SceneImage();
+
+    /*
+     * Maps and validates an image, returns false if the file is missing,
+     * corrupted, from another version or older than the yaf source.
+     */
+    bool open(const std::string& fileName, int64_t sourceModificationTime,
+            uint64_t sourceSize, bool checkSource);
+
+    const char* getString(uint32_t offset);
+    /* Start of the string table, strings are referenced by offset */
+    const char* getStrings();
+    const GlobalsRecord* getGlobals();
+    const CameraRecord* getCameras(uint32_t& count);
+    const LightRecord* getLights(uint32_t& count);
+    const TextureRecord* getTextures(uint32_t& count);
+    const AppearanceRecord* getAppearances(uint32_t& count);
+    const AnimationRecord* getAnimations(uint32_t& count);
+    const NodeRecord* getNodes(uint32_t& count);
+    const TransformRecord* getTransforms(uint32_t& count);
+    const PrimitiveRecord* getPrimitives(uint32_t& count);
+    const PointRecord* getPoints(uint32_t& count);
+    const uint32_t* getChildren(uint32_t& count);
+};
+
+/*
+ * Hash of the primitives of one node (records, control points and strings),
+ * the same whether the records come from the writer or from an image.
+ */
+uint64_t hashPrimitives(const PrimitiveRecord* primitives, uint32_t count,
+        const PointRecord* points, const char* strings);
+
+/* scene.yaf -> scene.yafb */
+std::string getCacheFileName(const std::string& yafFileName);
+bool isCompiledSceneFileName(const std::string& fileName);
+
+} // namespace Binary
+}
+
+#endif /* GEBINARYSCENE_HPP_ */
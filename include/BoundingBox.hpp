@@ -0,0 +1,37 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Axis aligned bounding box, used to cull what the camera can not see.
+ */
+
+#ifndef GEBOUNDINGBOX_HPP_
+#define GEBOUNDINGBOX_HPP_
+
+#include "includes.hpp"
+
+namespace ge {
+
+class BoundingBox {
+public:
+    GLdouble min[3], max[3];
+
+    /* Something that can be anywhere (a vehicle driven around), never culled */
+    bool unbounded;
+
+    /* Starts empty */
+    BoundingBox();
+
+    void setEmpty();
+    void setUnbounded();
+    bool isEmpty() const;
+
+    void merge(GLdouble x, GLdouble y, GLdouble z);
+    void merge(const BoundingBox& other);
+
+    /* Box holding this box once transformed by matrix (column major) */
+    void transform(const GLdouble* matrix, BoundingBox& out) const;
+};
+
+}
+
+#endif /* GEBOUNDINGBOX_HPP_ */
@@ -27,6 +27,8 @@ public:
     GLdouble getFar();
 
     virtual void applyView(double aspectRatio) = 0;
+    /* The matrix applyView multiplies onto the projection, computed without GL */
+    virtual void getViewProjection(double aspectRatio, GLdouble* out) = 0;
     virtual void updateProjectionMatrix(int width, int height);
 
     void setPosition(xyzPointDouble in);
@@ -52,6 +54,7 @@ public:
             GLdouble iRight, GLdouble iTop, GLdouble iBottom);
 
     virtual void applyView(double aspectRatio);
+    virtual void getViewProjection(double aspectRatio, GLdouble* out);
     virtual ~OrthoCamera();
 
     virtual void rotateTo(int, double);
@@ -78,6 +81,7 @@ public:
             GLdouble iAngle, xyzPointDouble iFrom, xyzPointDouble iTo);
 
     virtual void applyView(double aspectRatio);
+    virtual void getViewProjection(double aspectRatio, GLdouble* out);
 
     virtual void rotateTo(int axis, double angle); ///< Rotates the camera around _axis_ by _increment_ degrees, unless it has reached _angle_ degrees. Useful for stepping a rotation in an animation.
     virtual void rotate(int axis, double angle); ///< Rotates the camera around _axis_ by _angle_ degrees.
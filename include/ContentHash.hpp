@@ -0,0 +1,52 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Content hash (64 bit FNV-1a), used to tell which parts of a reloaded scene
+ * changed. Not meant to be stored, the values only have to match within one
+ * run of the program.
+ */
+
+#ifndef GECONTENTHASH_HPP_
+#define GECONTENTHASH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ge {
+
+class ContentHash {
+private:
+    std::uint64_t value;
+
+public:
+    ContentHash() {
+        value = 14695981039346656037ull;
+    }
+
+    void add(const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; i++) {
+            value = (value ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    /* The length goes in first, so "ab" + "c" and "a" + "bc" differ */
+    void add(const std::string& in) {
+        addValue(in.size());
+        add(in.data(), in.size());
+    }
+
+    template<typename T>
+    void addValue(const T& in) {
+        add(&in, sizeof(T));
+    }
+
+    std::uint64_t get() const {
+        return value;
+    }
+};
+
+}
+
+#endif /* GECONTENTHASH_HPP_ */
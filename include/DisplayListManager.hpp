@@ -0,0 +1,94 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Display list manager, names every node's list and keeps them in a budget.
+ *
+ * Lists are compiled when the scene is loaded or reloaded, not by the frame
+ * that first draws them, and only hold what never moves. Their size is
+ * estimated from the triangles they record. A list that does not fit the
+ * budget (bytes or number of lists) is not compiled and its node is drawn
+ * directly. The frame after that, lists that were not called for a number
+ * of frames are deleted, least recently called first, until the refused ones
+ * fit.
+ */
+
+#ifndef GEDISPLAYLISTMANAGER_HPP_
+#define GEDISPLAYLISTMANAGER_HPP_
+
+#include <Texture.hpp>
+#include "includes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace ge {
+
+class DisplayListManager {
+public:
+    struct List {
+        /* 0 while not compiled */
+        GLuint id;
+        std::size_t bytes;
+        /* Counted when it is compiled, a call draws them all */
+        std::size_t triangles;
+        unsigned long lastUsedFrame;
+        /* Textures the list binds, touched whenever it is called */
+        std::vector<Texture*> textures;
+
+        List();
+    };
+
+private:
+    /* Compiled lists, owned by their nodes */
+    static std::vector<List*> lists;
+
+    static unsigned long frame;
+    static std::size_t budget;
+    static unsigned int maxLists;
+    static unsigned int evictAfterFrames;
+
+    static std::size_t usedBytes, peakUsedBytes;
+    /* Bytes of the lists refused since the last frame started */
+    static std::size_t refusedBytes;
+    static unsigned int refusedLists;
+
+    static uint64_t compiles, evictions, refusals;
+    /* This frame */
+    static unsigned int calls, directDraws;
+
+    static bool fits(std::size_t bytes, unsigned int count);
+    static void evict();
+
+public:
+    /*
+     * Names the list for a compile of about bytes drawing the given
+     * triangles, false if it does not fit. The caller compiles it right away.
+     */
+    static bool reserve(List& list, std::size_t bytes, std::size_t triangles);
+    /* Deletes the list, it can be reserved again */
+    static void release(List& list);
+
+    /* Replays a compiled list, GLState forgets what it knew. Returns its triangles */
+    static std::size_t call(List& list);
+    /* A list that did not fit was drawn without it */
+    static void countDirectDraw();
+
+    /* Evicts for the lists refused last frame, must be outside any display list */
+    static void beginFrame();
+
+    /* geEngine --list-budget MB */
+    static void setBudget(std::size_t bytes);
+    static void setMaxLists(unsigned int count);
+    static void setEvictAfterFrames(unsigned int frames);
+
+    static unsigned int getNumberOfLists();
+    static std::size_t getUsedBytes();
+
+    static void printStatistics(std::ostream& out);
+};
+
+}
+
+#endif /* GEDISPLAYLISTMANAGER_HPP_ */
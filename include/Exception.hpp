@@ -16,12 +16,30 @@ class Exception {
 private:
     std::string errorMessage;
 
+    /* Number of live Recoverable guards */
+    static inline int recoverable = 0;
+
     void PressEnterToContinue() {
         std::cerr << "Press enter to continue..." << std::flush;
         std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
     }
 
 public:
+    /*
+     * While a guard is alive fatal exceptions are thrown like the others
+     * instead of ending the program (used to keep the scene when a reload
+     * fails).
+     */
+    class Recoverable {
+    public:
+        Recoverable() {
+            Exception::recoverable++;
+        }
+        ~Recoverable() {
+            Exception::recoverable--;
+        }
+    };
+
     Exception() {
         errorMessage = "Unknown error.";
     }
@@ -33,7 +51,7 @@ public:
     Exception(std::string str, bool fatal) {
         errorMessage = str;
 
-        if (fatal) {
+        if (fatal && recoverable == 0) {
             std::cerr << "Fatal exception caught: " << errorMessage.c_str()
                     << std::endl << std::flush;
             PressEnterToContinue();
@@ -45,7 +63,10 @@ public:
     Exception(std::string str, bool fatal, int line) {
         errorMessage = str;
 
-        if (fatal) {
+        if (fatal && recoverable > 0) {
+            errorMessage = "At or near line " + std::to_string(line) + ": "
+                    + str;
+        } else if (fatal) {
             std::cerr << "Fatal exception while parsing xml at or near line: "
                     << line << std::endl;
             std::cerr << "Error: " << errorMessage.c_str() << std::endl;
@@ -0,0 +1,56 @@
+/*
+ * Eduardo Fernandes
+ *
+ * View frustum, the six clip planes of a camera in world coordinates, and
+ * how large things at a given point end up on screen.
+ */
+
+#ifndef GEFRUSTUM_HPP_
+#define GEFRUSTUM_HPP_
+
+#include <BoundingBox.hpp>
+#include "includes.hpp"
+
+namespace ge {
+
+class Frustum {
+public:
+    enum Result {
+        Outside, Intersecting, Inside
+    };
+
+private:
+    /* a * x + b * y + c * z + d >= 0 inside, not normalized */
+    GLdouble planes[6][4];
+
+    /* Clip w of a point, and how much a unit length changes clip y */
+    GLdouble wRow[4];
+    GLdouble wScale, yScale;
+    GLdouble halfHeight;
+
+public:
+    Frustum();
+
+    /* Planes of a projection * view matrix (column major), works for perspective and ortho */
+    void setMatrix(const GLdouble* viewProjection);
+
+    /* Conservative, a box near a corner may be Intersecting while outside */
+    Result classify(const BoundingBox& box) const;
+
+    /* Grows away from the camera (distance to the near plane, not normalized) */
+    GLdouble getDepth(const GLdouble* point) const;
+
+    /* Needed by getPixelsPerUnit, in pixels */
+    void setViewportHeight(int height);
+
+    /*
+     * Pixels a world unit spans at the point nearest to the camera within
+     * radius of point. Infinite once that reaches the camera, or when no
+     * viewport was set.
+     */
+    GLdouble getPixelsPerUnit(const GLdouble* point, GLdouble radius) const;
+};
+
+}
+
+#endif /* GEFRUSTUM_HPP_ */
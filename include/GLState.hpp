@@ -0,0 +1,115 @@
+/*
+ * Eduardo Fernandes
+ *
+ * GL state cache, every engine state change goes through here.
+ *
+ * Shadows capabilities, bound textures, buffers and vertex arrays, the
+ * program, the blend function, materials and light parameters, and drops
+ * calls that would set what is already set. Anything unknown (start of a
+ * frame, after a display list was called) is issued. Light positions and
+ * directions are always issued, GL keeps them in eye space so they depend on
+ * the modelview at call time.
+ */
+
+#ifndef GEGLSTATE_HPP_
+#define GEGLSTATE_HPP_
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "includes.hpp"
+
+namespace ge {
+
+class GLState {
+public:
+    /* Texture units with shadowed bindings, the rest are issued */
+    static const unsigned int MaxTextureUnits = 8;
+
+private:
+    enum Known {
+        Unknown, Off, On
+    };
+
+    /* Ambient, diffuse, specular, emission, shininess */
+    static const unsigned int MaterialParameters = 5;
+    /* Ambient, diffuse, specular, spot exponent, spot cutoff, attenuations */
+    static const unsigned int LightParameters = 8;
+
+    /* Keyed by capability, GL_TEXTURE_2D also by texture unit */
+    static std::unordered_map<std::uint64_t, Known> capabilities;
+
+    static GLenum activeUnit;
+    static bool activeUnitKnown;
+    static GLuint boundTextures[MaxTextureUnits];
+    static bool boundTexturesKnown[MaxTextureUnits];
+
+    static GLuint arrayBuffer, elementBuffer, vertexArray;
+    static bool arrayBufferKnown, elementBufferKnown, vertexArrayKnown;
+
+    static GLuint program;
+    static bool programKnown;
+
+    static GLenum blendSource, blendDestination;
+    static bool blendKnown;
+
+    static GLfloat materials[2][MaterialParameters][4];
+    static bool materialsKnown[2][MaterialParameters];
+
+    static GLfloat lights[MAX_LIGHTS][LightParameters][4];
+    static bool lightsKnown[MAX_LIGHTS][LightParameters];
+
+    /* Inside glNewList nothing may be dropped, the list must be complete */
+    static unsigned int recording;
+
+    static std::uint64_t issuedCalls;
+    static std::uint64_t elidedCalls;
+
+    static void setCapability(GLenum capability, bool enabled);
+    static bool setParameter(GLfloat* shadow, bool& known,
+            const GLfloat* params, unsigned int size);
+
+public:
+    /* Forgets everything and zeroes the counters (GLUI draws in between) */
+    static void beginFrame();
+    /* Forgets everything, after state changes the cache did not see */
+    static void invalidate();
+
+    /* Around glNewList / glEndList */
+    static void startRecording();
+    static void stopRecording();
+
+    static void enable(GLenum capability);
+    static void disable(GLenum capability);
+    /* The shadow when known, glIsEnabled otherwise (not for GL_TEXTURE_2D) */
+    static bool isEnabled(GLenum capability);
+
+    static void activeTexture(GLenum unit);
+    /* GL_TEXTURE_2D on the active unit */
+    static void bindTexture(GLuint texture);
+    /* Before glDeleteTextures, the name may come back from glGenTextures */
+    static void forgetTexture(GLuint texture);
+
+    /* GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER */
+    static void bindBuffer(GLenum target, GLuint buffer);
+    /* The element buffer binding belongs to the vertex array */
+    static void bindVertexArray(GLuint vertexArray);
+    /* Before glDeleteBuffers / glDeleteVertexArrays */
+    static void forgetBuffer(GLuint buffer);
+    static void forgetVertexArray(GLuint vertexArray);
+
+    static void useProgram(GLuint program);
+    static void blendFunc(GLenum source, GLenum destination);
+
+    static void material(GLenum face, GLenum name, const GLfloat* params);
+    static void material(GLenum face, GLenum name, GLfloat param);
+    static void light(GLenum light, GLenum name, const GLfloat* params);
+
+    /* Since beginFrame */
+    static std::uint64_t getIssuedCalls();
+    static std::uint64_t getElidedCalls();
+};
+
+}
+
+#endif /* GEGLSTATE_HPP_ */
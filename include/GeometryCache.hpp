@@ -0,0 +1,72 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Geometry cache, primitives with the same type and parameters share a mesh.
+ *
+ * Meshes are kept while a primitive uses them (a reload finds the meshes of
+ * the scene it replaces), circle tables for as long as the program runs.
+ */
+
+#ifndef GEGEOMETRYCACHE_HPP_
+#define GEGEOMETRYCACHE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include <Mesh.hpp>
+
+namespace ge {
+
+class GeometryCache {
+public:
+    enum Type {
+        TypeRectangle, TypeTriangle, TypeCylinder, TypeSphere, TypeTorus
+    };
+
+    /* sin and cos of n steps around the circle, n + 1 entries (the last one
+     * repeats the first), a negative n goes the other way */
+    struct CircleTable {
+        std::vector<double> sin;
+        std::vector<double> cos;
+    };
+
+private:
+    typedef std::pair<Type, std::vector<double> > Key;
+
+    struct Entry {
+        std::weak_ptr<Mesh> mesh;
+        /* Handed to the primitives drawing the mesh at full detail, its use count is theirs */
+        std::weak_ptr<Mesh> primitives;
+    };
+
+    static std::map<Key, Entry> meshes;
+    static std::map<int, std::unique_ptr<CircleTable> > circleTables;
+    /* Building a mesh asks for circle tables */
+    static std::recursive_mutex mutex;
+
+    static std::uint64_t hits;
+    static std::uint64_t misses;
+
+public:
+    /*
+     * The shared mesh for the parameters, build fills it on a miss. A coarse
+     * mesh is a primitive's lower level of detail, not counted as its mesh.
+     */
+    static std::shared_ptr<Mesh> getMesh(Type type,
+            std::vector<double> parameters,
+            const std::function<void(Mesh&)>& build, bool coarse = false);
+
+    static const CircleTable& getCircleTable(int n);
+
+    /* Meshes in use, what sharing full meshes saved and the hit rate since start */
+    static void printStatistics(std::ostream& out);
+};
+
+}
+
+#endif /* GEGEOMETRYCACHE_HPP_ */
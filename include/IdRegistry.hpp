@@ -0,0 +1,65 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Hashed id lookup, used to resolve the references between scene objects.
+ */
+
+#ifndef GEIDREGISTRY_HPP_
+#define GEIDREGISTRY_HPP_
+
+#include <string>
+#include <unordered_map>
+
+namespace ge {
+
+/* Does not own the registered objects */
+template<typename T>
+class IdRegistry {
+private:
+    std::unordered_map<std::string, T*> items;
+
+public:
+    /* Returns false (and keeps the first object) if the id is already taken */
+    bool add(const std::string& id, T* item) {
+        return items.emplace(id, item).second;
+    }
+
+    /* Returns false if the id is unknown */
+    bool remove(const std::string& id) {
+        return items.erase(id) > 0;
+    }
+
+    /* Returns nullptr if the id is unknown */
+    T* find(const std::string& id) const {
+        auto it = items.find(id);
+        if (it == items.end()) {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    void reserve(std::size_t count) {
+        items.reserve(count);
+    }
+
+    void clear() {
+        items.clear();
+    }
+
+    std::size_t size() const {
+        return items.size();
+    }
+
+    /* (id, object) pairs, in no particular order */
+    typename std::unordered_map<std::string, T*>::const_iterator begin() const {
+        return items.begin();
+    }
+
+    typename std::unordered_map<std::string, T*>::const_iterator end() const {
+        return items.end();
+    }
+};
+
+}
+
+#endif /* GEIDREGISTRY_HPP_ */
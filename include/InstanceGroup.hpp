@@ -0,0 +1,131 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Instance group, every draw of one mesh with one appearance as instanced
+ * draw calls.
+ *
+ * Each member keeps its world matrix and normal matrix (25 floats) in a
+ * buffer read as per instance attributes. Only members whose matrices
+ * changed are written again, in runs of neighbouring members. A frame draws
+ * the visible members, one call per run of consecutive ones: the attribute
+ * pointers are moved to the start of the run, so no base instance is
+ * needed. Members drawn at a coarser level of detail read the same buffer
+ * with the level's mesh.
+ *
+ * Fixed function lighting does not take per instance matrices, built in
+ * shaders do its work instead (GL lights, front and back materials and the
+ * texture matrix, normals left as the matrices make them, like the rest of
+ * the engine draws them). A variant that fails to build falls back to one
+ * draw per member.
+ */
+
+#ifndef GEINSTANCEGROUP_HPP_
+#define GEINSTANCEGROUP_HPP_
+
+#include <map>
+#include <vector>
+
+#include "includes.hpp"
+#include "Mesh.hpp"
+
+namespace ge {
+
+class Shader;
+
+class InstanceGroup {
+public:
+    /* World matrix, then the normal matrix, both column major */
+    static const unsigned int FloatsPerInstance = 16 + 9;
+
+private:
+    /* Level of detail meshes, the full one first */
+    std::vector<Mesh*> levels;
+
+    std::vector<GLfloat> instances;
+    /* Members changed since the last upload, each once */
+    std::vector<unsigned int> dirty;
+    std::vector<bool> dirtyFlags;
+    /* Visible this frame per level, in member order */
+    std::vector<std::vector<unsigned int> > visible;
+    std::size_t numberOfVisible;
+
+    GLuint buffer;
+    /* Members the buffer holds, it is reallocated when the group grows */
+    std::size_t bufferMembers;
+
+    /* Program variants: enabled lights (one bit each), then these */
+    enum Variant {
+        VariantLighting = 1 << 8, VariantTwoSided = 1 << 9, VariantTextured = 1
+                << 10
+    };
+
+    struct Program {
+        /* nullptr if the variant did not build */
+        Shader* shader;
+        GLint matrixLocation, normalMatrixLocation;
+    };
+
+    /* Shared by every group, built when first needed */
+    static std::map<unsigned int, Program> programs;
+    static bool checked;
+    static bool supported;
+    /* The light state is read once per frame */
+    static unsigned int frameVariant;
+    static bool frameStarted;
+
+    void setPointers(const Program& program, std::size_t first);
+    /* Returns the number of draw calls */
+    unsigned int drawLevel(const Program& program, unsigned int level);
+    void drawEach(GLdouble s, GLdouble t);
+    void clearVisible();
+    static void startFrame();
+    static Program* getProgram(unsigned int variant);
+
+public:
+    InstanceGroup(Mesh* mesh);
+    virtual ~InstanceGroup();
+    InstanceGroup(InstanceGroup const&) = delete;
+    InstanceGroup& operator=(InstanceGroup const&) = delete;
+
+    Mesh* getMesh();
+    /* The next coarser mesh, drawn with the same matrices */
+    void addLevel(Mesh* mesh);
+    unsigned int getNumberOfMembers();
+
+    /* Returns the new member, its matrix must be set before the first draw */
+    unsigned int addMember();
+    void setMatrix(unsigned int member, const GLdouble* world);
+    /*
+     * setMatrix in two steps: different members can be written from
+     * different threads, marking them for the next upload can not
+     */
+    void writeMatrix(unsigned int member, const GLdouble* world);
+    void markChanged(unsigned int member);
+
+    /*
+     * In increasing member order, returns true for the frame's first one.
+     * Level 0 is the full mesh.
+     */
+    bool addVisible(unsigned int member, unsigned int level);
+    std::size_t getNumberOfVisible();
+    std::size_t getVisibleTriangles();
+
+    /* Writes the changed matrices, returns how many members were written */
+    unsigned int upload();
+    /*
+     * Draws the visible members with the appearance already applied and
+     * forgets them, returns the number of draw calls. The modelview must be
+     * the identity. Texture lengths go through the texture matrix, like
+     * Mesh::draw.
+     */
+    unsigned int draw(GLdouble s, GLdouble t, bool textured);
+
+    /* Before the groups of a frame are drawn (the lights may have changed) */
+    static void beginFrame();
+    /* Vertex arrays, instanced arrays and a linked shader (needs the context) */
+    static bool isSupported();
+};
+
+}
+
+#endif /* GEINSTANCEGROUP_HPP_ */
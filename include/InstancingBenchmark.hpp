@@ -0,0 +1,50 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Instanced drawing benchmark (geEngine --bench-instancing [instances]).
+ *
+ * Generates a scene of cylinders, spheres and tori in a few shapes and
+ * appearances (so nearly every draw belongs to an instance group, with a
+ * tenth of the subtrees animated so matrices keep being rewritten), then
+ * times the same frames with instancing off and on. Opens a window, under
+ * Mesa it runs on llvmpipe with LIBGL_ALWAYS_SOFTWARE=1.
+ */
+
+#ifndef GEINSTANCINGBENCHMARK_HPP_
+#define GEINSTANCINGBENCHMARK_HPP_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace ge {
+
+class Scene;
+
+class InstancingBenchmark {
+private:
+    uint64_t instances;
+    unsigned int frames;
+
+    /* Same animation times on every pass, the first frame is not timed */
+    void timeFrames(Scene& scene, double& best, double& average);
+
+    /* A yaf file name in the temporary directory that is not taken */
+    static std::string getSceneFileName();
+
+public:
+    InstancingBenchmark(uint64_t instances, unsigned int frames);
+
+    /* The benchmark scene, about one leaf (one draw) per instance */
+    bool writeScene(const std::string& fileName);
+
+    /* Loads the scene for each pass, needs a current GL context */
+    void measure(const std::string& fileName, std::ostream& out);
+
+    /* Writes the scene, opens the window and measures, false if something failed */
+    bool run(int argc, char** argv);
+};
+
+}
+
+#endif /* GEINSTANCINGBENCHMARK_HPP_ */
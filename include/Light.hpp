@@ -44,6 +44,9 @@ public:
     bool getLightEnableStatus();
     std::string getID();
 
+    /* Creates the GL side objects (light sphere quadric) */
+    void init();
+
     virtual void draw() = 0;
     virtual void update() = 0;
     void enable();
@@ -0,0 +1,111 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Scene load instrumentation (geEngine --load-report [--json] scene).
+ *
+ * Times every load phase and counts what the load did. Nothing is measured
+ * unless the profiler was enabled, so the hooks can stay in the load path.
+ */
+
+#ifndef GELOADPROFILER_HPP_
+#define GELOADPROFILER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace ge {
+
+class LoadProfiler {
+public:
+    enum Phase {
+        PhaseParse,
+        PhaseGlobals,
+        PhaseCameras,
+        PhaseLighting,
+        PhaseTextures,
+        PhaseAppearances,
+        PhaseAnimations,
+        PhaseGraph,
+        PhaseGraphImport,
+        PhaseNodeMatrices,
+        PhaseBinaryLoad,
+        PhaseTextureDecode,
+        PhaseTextureUpload,
+        PhaseShaders,
+        PhaseFirstDraw,
+        PhaseStaticBatches,
+        PhaseDisplayLists,
+        NumberOfPhases
+    };
+
+    enum Counter {
+        CounterBytesRead,
+        CounterElementsParsed,
+        CounterAllocations,
+        CounterTexturesDecoded,
+        CounterGLObjects,
+        CounterNodeInstances,
+        CounterSharedNodes,
+        CounterGeometryHits,
+        CounterGeometryMisses,
+        /* Bytes of mesh the hits did not build */
+        CounterGeometrySaved,
+        CounterStaticBatches,
+        /* Primitives drawn through a static batch instead of on their own */
+        CounterBatchedPrimitives,
+        NumberOfCounters
+    };
+
+    /* Times a phase from construction to destruction */
+    class Scope {
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        Scope(Phase phase);
+        ~Scope();
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+    };
+
+    /* Starts counting, the total time is measured from here */
+    static void enable(bool json);
+    static bool isEnabled() {
+        return enabled;
+    }
+
+    /* For phases that start and end in different callbacks */
+    static void begin(Phase phase);
+    static void end(Phase phase);
+
+    static void count(Counter counter, std::uint64_t amount = 1) {
+        if (enabled.load(std::memory_order_relaxed)) {
+            counters[counter].fetch_add(amount, std::memory_order_relaxed);
+        }
+    }
+
+    /* Prints the breakdown (or json) to the stream */
+    static void report(std::ostream& out);
+
+private:
+    /* Read by every allocation, on any thread */
+    static std::atomic<bool> enabled;
+    static bool json;
+    static std::chrono::steady_clock::time_point enableTime;
+
+    static std::atomic<std::uint64_t> counters[NumberOfCounters];
+
+    static double phaseTime[NumberOfPhases];
+    static unsigned phaseCalls[NumberOfPhases];
+    static std::chrono::steady_clock::time_point phaseStart[NumberOfPhases];
+
+    static void addTime(Phase phase,
+            std::chrono::steady_clock::time_point start);
+};
+
+}
+
+#endif /* GELOADPROFILER_HPP_ */
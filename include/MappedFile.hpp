@@ -0,0 +1,46 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Read only memory mapped file.
+ */
+
+#ifndef GEMAPPEDFILE_HPP_
+#define GEMAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ge {
+
+class MappedFile {
+private:
+    const unsigned char* mappedData;
+    std::size_t mappedSize;
+
+    /* Used when mmap is not available (the whole file is read instead) */
+    std::vector<unsigned char> fallbackBuffer;
+
+public:
+    MappedFile();
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    virtual ~MappedFile();
+
+    /* Returns false if the file could not be opened or is empty */
+    bool open(const std::string& fileName);
+    void close();
+
+    bool isOpen();
+    const unsigned char* getData();
+    std::size_t getSize();
+};
+
+/* File status helpers, return false if the file does not exist */
+bool getFileModificationTime(const std::string& fileName, int64_t& mtime,
+        uint64_t& size);
+
+}
+
+#endif /* GEMAPPEDFILE_HPP_ */
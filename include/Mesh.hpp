@@ -0,0 +1,101 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Triangle mesh of a primitive, drawn from GL buffers.
+ *
+ * Interleaved float vertices (position, normal, texture coordinate) and a
+ * single indexed triangle strip: strips and fans are joined with degenerate
+ * triangles, so the whole mesh is one draw. Built on the CPU when the
+ * primitive is created (no GL context needed), uploaded on the first draw.
+ * Without vertex buffer objects it is drawn in immediate mode.
+ */
+
+#ifndef GEMESH_HPP_
+#define GEMESH_HPP_
+
+#include <vector>
+
+#include "includes.hpp"
+
+namespace ge {
+
+class Mesh {
+public:
+    struct Vertex {
+        GLfloat position[3];
+        GLfloat normal[3];
+        GLfloat texcoord[2];
+    };
+
+    enum Support {
+        SupportUnknown, SupportImmediate, SupportBuffers, SupportVertexArrays
+    };
+
+private:
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+
+    /* The next index starts a new strip */
+    bool stripStart;
+    /* Not counting the degenerate ones joining strips */
+    std::size_t triangles;
+
+    GLuint vertexBuffer, indexBuffer, vertexArray;
+    bool uploaded;
+
+    /* What the context can do, known after glewInit */
+    static Support support;
+
+    void pushIndex(GLuint index);
+    void upload();
+    void setPointers();
+    void drawImmediate();
+
+public:
+    Mesh();
+    virtual ~Mesh();
+    Mesh(Mesh const&) = delete;
+    Mesh& operator=(Mesh const&) = delete;
+
+    GLuint addVertex(GLfloat x, GLfloat y, GLfloat z, GLfloat nx, GLfloat ny,
+            GLfloat nz, GLfloat s, GLfloat t);
+
+    /* Indices after this form a new strip */
+    void beginStrip();
+    void addIndex(GLuint index);
+    /* A fan around center, as a strip that keeps going back to the center */
+    void addFan(GLuint center, const std::vector<GLuint>& rim);
+
+    /*
+     * Adds other as a new strip, transformed by matrix (column major) with
+     * its texture coordinates divided by s and t
+     */
+    void append(const Mesh& other, const GLdouble* matrix, GLdouble s,
+            GLdouble t);
+
+    /* Texture coordinates are divided by s and t (texture lengths) */
+    void draw(GLdouble s = 1.0, GLdouble t = 1.0);
+
+    /*
+     * Instanced draws need vertex arrays: bindInstanced binds the mesh's,
+     * the caller sets up its instance attributes (and disables them before
+     * anything else uses the array), then draws any number of times.
+     */
+    void bindInstanced();
+    void drawInstances(GLsizei count);
+
+    std::size_t getNumberOfVertices();
+    std::size_t getNumberOfIndices();
+    std::size_t getNumberOfTriangles();
+    /* Vertices and indices, the same on the CPU and in the buffers */
+    std::size_t getMemorySize();
+
+    static Support getSupport();
+
+    /* Inverse transpose of the upper 3x3 of matrix, what normals go through */
+    static void getNormalMatrix(const GLdouble* matrix, GLdouble* out);
+};
+
+}
+
+#endif /* GEMESH_HPP_ */
@@ -0,0 +1,124 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Occlusion culling, hardware queries on the bounds of node subtrees with
+ * the visibility of earlier frames reused (coherent hierarchical culling).
+ *
+ * A unit is a subtree whose world bounds are tested. Once the visible units
+ * are drawn, the bounds of the units found occluded before are queried and
+ * their results waited for, the ones that turn out visible are drawn in the
+ * same frame (nothing pops in late). Visible units are queried again every
+ * few frames, staggered, and their results are read in a later frame when
+ * they are available, so they never stall. A unit is skipped only while its
+ * last query passed no sample at all. Units whose bounds reach the camera
+ * are always visible, their boxes would be clipped by the near plane.
+ */
+
+#ifndef GEOCCLUSIONCULLING_HPP_
+#define GEOCCLUSIONCULLING_HPP_
+
+#include <BoundingBox.hpp>
+#include <Frustum.hpp>
+#include "includes.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace ge {
+
+class OcclusionCulling {
+public:
+    struct Request {
+        unsigned int unit;
+        BoundingBox bounds;
+    };
+
+    /* Queries a walk asked for, of occluded units (waited for) and visible ones */
+    struct Requests {
+        std::vector<Request> occluded;
+        std::vector<Request> visible;
+    };
+
+private:
+    struct Unit {
+        /* Node instance of the subtree */
+        unsigned int instance;
+        /* 0 until first queried */
+        GLuint query;
+        bool visible;
+        /* A query of the visible unit whose result was not read yet */
+        bool pending;
+        unsigned long issuedFrame;
+        unsigned long nextQueryFrame;
+    };
+
+    std::vector<Unit> units;
+    unsigned long frame;
+
+    /* Queries to issue this frame */
+    Requests requests;
+    /* Units whose queries are read in a later frame */
+    std::vector<unsigned int> pendingUnits;
+
+    /* This frame */
+    unsigned int issuedQueries, waitedQueries, skippedSubtrees;
+    unsigned int revealedSubtrees, readResults;
+    unsigned long latencyFrames;
+    double waitSeconds;
+
+    static bool checked;
+    static bool supported;
+
+    void issue(Request& request);
+    static void drawBox(const BoundingBox& bounds);
+
+public:
+    OcclusionCulling();
+    virtual ~OcclusionCulling();
+    OcclusionCulling(OcclusionCulling const&) = delete;
+    OcclusionCulling& operator=(OcclusionCulling const&) = delete;
+
+    /* Deletes the units and their queries, the draw list is rebuilt */
+    void clear();
+    /* Returns the new unit (from 1, 0 stands for none), visible at first */
+    unsigned int addUnit(unsigned int instance);
+    unsigned int getNumberOfUnits();
+
+    /* Reads the results of earlier frames that are available */
+    void beginFrame();
+
+    /*
+     * The unit's bounds are in the frustum, returns false if its subtree
+     * is skipped. The query it needs, if any, goes to out. Walks on other
+     * threads may visit other units at the same time.
+     */
+    bool visit(unsigned int unit, const BoundingBox& bounds,
+            const Frustum& frustum, Requests& out);
+    /* Queued for issueQueries in walk order, in is left empty */
+    void addRequests(Requests& in);
+
+    /*
+     * After the visible units are drawn, the modelview must be the
+     * identity. Leaves the program unbound, everything else as it was.
+     */
+    void issueQueries();
+
+    /*
+     * Waits for the queries of occluded units, returns the instances of
+     * the ones that turned visible
+     */
+    void collectResults(std::vector<unsigned int>& instances);
+
+    /* Drawn along with a unit that turned visible, queried on the next frame */
+    void reveal(unsigned int unit);
+
+    /* Occlusion queries (OpenGL 1.5, needs the context) */
+    static bool isSupported();
+
+    void printStatistics(std::ostream& out);
+};
+
+}
+
+#endif /* GEOCCLUSIONCULLING_HPP_ */
@@ -0,0 +1,65 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Yaf parser microbenchmark (geEngine --bench-parse scene.yaf).
+ *
+ * Reads a scene once to collect its elements and numeric attributes, then
+ * times the name dispatch and number decoding the old TinyXML loader used
+ * (string compares and sscanf on std::string copies) against the token and
+ * from_chars path used now.
+ */
+
+#ifndef GEPARSEBENCHMARK_HPP_
+#define GEPARSEBENCHMARK_HPP_
+
+#include <YafReader.hpp>
+
+#include <string>
+#include <vector>
+
+namespace ge {
+
+class ParseBenchmark: public YafHandler {
+private:
+    struct Attribute {
+        /* Before: looked up by name, value copied into a string */
+        std::string name;
+        std::string value;
+
+        /* After: looked up by token, value decoded in place */
+        Xml::Names::Name token;
+
+        /* Number of values in the attribute (1 to 4) */
+        unsigned count;
+    };
+
+    struct Element {
+        std::string name;
+        std::vector<Attribute> attributes;
+    };
+
+    std::string fileName;
+    unsigned iterations;
+
+    std::vector<Element> elements;
+    std::size_t numberOfAttributes;
+
+    void startElement(const YafElement& element);
+    void endElement(const YafElement& element);
+
+    double timeReader();
+    double timeDispatchBefore(unsigned& found);
+    double timeDispatchAfter(unsigned& found);
+    double timeDecodeBefore(double& checksum);
+    double timeDecodeAfter(double& checksum);
+
+public:
+    ParseBenchmark(const std::string& fileName, unsigned iterations);
+
+    /* Prints the results, returns false if the scene can not be read */
+    bool run();
+};
+
+}
+
+#endif /* GEPARSEBENCHMARK_HPP_ */
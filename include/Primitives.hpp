@@ -7,6 +7,9 @@
 #ifndef GEPRIMITIVE_HPP_
 #define GEPRIMITIVE_HPP_
 
+#include <BoundingBox.hpp>
+#include <GeometryCache.hpp>
+#include <Mesh.hpp>
 #include <Shader.hpp>
 #include <Texture.hpp>
 #include "includes.hpp"
@@ -17,12 +20,32 @@ namespace Primitives {
 class PrimitiveInterface {
 protected:
     GLdouble normal[3];
-    void fghCircleTable(double **sint, double **cost, const int n);
     void calculateNormal(GLdouble v[3][3], GLdouble out[3]);
     void NormalizeVector(GLdouble vector[3]);
 
 public:
     virtual void draw(GLdouble s, GLdouble t) = 0;
+    /* Local bounds of what draw renders */
+    virtual void getBounds(BoundingBox& out) = 0;
+    /* Binds its own shader and textures, the appearance state is lost after draw */
+    virtual bool hasShader();
+    /* Draws the same every frame (vehicles are driven, water lines flow) */
+    virtual bool isStatic();
+    /*
+     * The mesh draw renders, nullptr if it has none. s and t come in as the
+     * texture lengths draw would get and leave as the ones the mesh uses.
+     */
+    virtual Mesh* getMesh(GLdouble& s, GLdouble& t);
+    /* Triangles draw submits, 0 if it does not know */
+    virtual std::size_t getNumberOfTriangles();
+    /*
+     * Coarser meshes of the same surface for draws far from the camera,
+     * level 0 is what getMesh returns. The error of a level is how far (in
+     * local units) its surface strays from the exact one.
+     */
+    virtual unsigned int getNumberOfLevels();
+    virtual Mesh* getLevelMesh(unsigned int level);
+    virtual GLdouble getLevelError(unsigned int level);
     virtual ~PrimitiveInterface();
 };
 
@@ -32,12 +55,18 @@ private:
     GLdouble normal[3];
     //unsigned int _numDivisions, dx, dy;
 
+    std::shared_ptr<Mesh> mesh;
+    void shareMesh();
+    void buildMesh(Mesh& out);
+
 public:
     Rectangle(xyPointDouble pt1, xyPointDouble pt2);
     Rectangle(GLdouble inX0, GLdouble inY0, GLdouble inX1, GLdouble inY1);
     virtual ~Rectangle();
 
     void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
+    Mesh* getMesh(GLdouble& s, GLdouble& t);
 };
 
 /* Triangle class. Assumes that you don't repeat points. Incomplete */
@@ -45,6 +74,10 @@ class Triangle: public PrimitiveInterface {
 private:
     GLdouble point1[3], point2[3], point3[3];
 
+    std::shared_ptr<Mesh> mesh;
+    void shareMesh();
+    void buildMesh(Mesh& out);
+
 public:
     Triangle(GLdouble inX1, GLdouble inY1, GLdouble inZ1, GLdouble inX2,
             GLdouble inY2, GLdouble inZ2, GLdouble inX3, GLdouble inY3,
@@ -53,65 +86,84 @@ public:
     virtual ~Triangle();
 
     void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
+    Mesh* getMesh(GLdouble& s, GLdouble& t);
+};
+
+/*
+ * Curved primitives, tessellated at the yaf's slices and also at a half,
+ * a quarter and an eighth of them (while enough are left). Every level is
+ * shared through the geometry cache like the full mesh. Texture lengths do
+ * not apply to them.
+ */
+class TessellatedPrimitive: public PrimitiveInterface {
+public:
+    static const unsigned int MaxLevels = 4;
+
+protected:
+    std::shared_ptr<Mesh> levels[MaxLevels];
+    GLdouble errors[MaxLevels];
+    unsigned int numberOfLevels;
+
+    void addLevel(std::shared_ptr<Mesh> mesh, GLdouble error);
+
+public:
+    TessellatedPrimitive();
+    virtual ~TessellatedPrimitive();
+
+    virtual void draw(GLdouble s, GLdouble t);
+    virtual Mesh* getMesh(GLdouble& s, GLdouble& t);
+    virtual unsigned int getNumberOfLevels();
+    virtual Mesh* getLevelMesh(unsigned int level);
+    virtual GLdouble getLevelError(unsigned int level);
 };
 
 /* Cylinder */
-class Cylinder: public PrimitiveInterface {
+class Cylinder: public TessellatedPrimitive {
 private:
     GLint slices, stacks;
     GLdouble baseRadius, topRadius, height;
 
-    /* Internal precalc tables */
-    GLdouble *sinCache;
-    GLdouble *cosCache;
-    GLdouble *sinCache2;
-    GLdouble *cosCache2;
-    GLdouble *sinCache3;
-    GLdouble *cosCache3;
-
-    /* Internal precalc vars */
-    GLdouble angleStep;
-    GLdouble zNormal;
-
-    GLdouble deltaRadius, deltaAngle;
+    void buildMesh(Mesh& out, int levelSlices, int levelStacks);
+    /* Cap facing normalZ (-1 base, 1 top) */
+    void addCap(Mesh& out, const GeometryCache::CircleTable& circle,
+            int levelSlices, GLdouble radius, GLdouble z, GLdouble normalZ);
 
 public:
     Cylinder(GLdouble iBase, GLdouble iTop, GLdouble iHeight,
             unsigned int iSlices, unsigned int iStacks);
     virtual ~Cylinder();
 
-    virtual void draw(GLdouble s, GLdouble t);
-    virtual void drawCircle(GLdouble radius);
+    virtual void getBounds(BoundingBox& out);
 };
 
-class Sphere: public PrimitiveInterface {
+class Sphere: public TessellatedPrimitive {
 private:
     int slices, stacks;
     GLdouble radius;
 
-    double *sint1, *cost1;
-    double *sint2, *cost2;
+    void buildMesh(Mesh& out, int levelSlices, int levelStacks);
 
 public:
     Sphere(GLdouble iRadius, int iSlices, int iStacks);
     virtual ~Sphere();
 
-    void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
 };
 
-class Torus: public PrimitiveInterface {
+class Torus: public TessellatedPrimitive {
 private:
+    /* One more than asked for, the last point repeats the first */
     int slices, loops;
     GLdouble inner, outer;
 
-    /* Precalcs */
-    double *vertex, *normal;
+    void buildMesh(Mesh& out, int levelSlices, int levelLoops);
 
 public:
     Torus(GLdouble iInner, GLdouble iOuter, int iSlices, int iLoops);
     virtual ~Torus();
 
-    void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
 };
 
 /* Plane 1x1 */
@@ -120,6 +172,7 @@ class Plane: public PrimitiveInterface {
 protected:
     unsigned int partsPerAxis;
     static GLdouble planeGrid[4][4][3];
+    static GLdouble texturePoints[4][2];
     GLdouble *grid;
 
     int evaluatorOrder;
@@ -129,6 +182,8 @@ public:
     virtual ~Plane();
 
     void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
+    std::size_t getNumberOfTriangles();
 };
 
 /* Patch */
@@ -157,6 +212,8 @@ public:
     void insertPoint(xyzPointDouble i);
 
     void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
+    std::size_t getNumberOfTriangles();
 
     virtual ~Patch();
 };
@@ -187,6 +244,8 @@ public:
     Vehicle();
     virtual ~Vehicle();
     void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
+    bool isStatic();
 
     /* Vehicle control */
     void moveUp();
@@ -221,7 +280,15 @@ public:
             std::string& vshader);
     virtual ~WaterLine();
 
+    /* Reads the height and texture maps, safe to call from a worker thread */
+    void decodeTextures();
+    /* Creates the shader and uploads the maps, must be called from the GL thread */
+    void init();
+
     void draw(GLdouble s, GLdouble t);
+    void getBounds(BoundingBox& out);
+    bool isStatic();
+    bool hasShader();
     void update(unsigned long timePassed);
 };
 
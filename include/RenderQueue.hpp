@@ -0,0 +1,63 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Render queue, what gets drawn in a frame ordered by a packed sort key.
+ *
+ * Key layout, most significant first:
+ *   pass (2 bits) | shader (8) | texture (16) | appearance (16) | depth (22)
+ * so items that share a shader, texture and appearance end up next to each
+ * other (state is set once for the run) and each run is drawn front to back.
+ * Ids wider than their field only make the ordering worse, never wrong.
+ */
+
+#ifndef GERENDERQUEUE_HPP_
+#define GERENDERQUEUE_HPP_
+
+#include <cstdint>
+#include <vector>
+
+namespace ge {
+
+class RenderQueue {
+public:
+    enum Pass {
+        /* Fixed function primitives, state tracked between items */
+        PassFixedFunction,
+        /* Display lists apply their own appearances */
+        PassDisplayList,
+        /* Primitives with their own shader and texture units */
+        PassShader
+    };
+
+    struct Item {
+        uint64_t key;
+        unsigned int entry;
+    };
+
+private:
+    std::vector<Item> items;
+    /* Radix sort ping-pong buffer */
+    std::vector<Item> sorted;
+
+public:
+    RenderQueue();
+    virtual ~RenderQueue();
+
+    /* Everything but the depth, which changes every frame */
+    static uint64_t makeStateKey(Pass pass, unsigned int shader,
+            unsigned int texture, unsigned int appearance);
+    /* Any depth measure that grows away from the camera */
+    static uint64_t makeDepthKey(double depth);
+
+    void clear();
+    void push(uint64_t key, unsigned int entry);
+
+    /* Stable LSD radix sort, bytes every key shares are skipped */
+    void sort();
+
+    const std::vector<Item>& getItems();
+};
+
+}
+
+#endif /* GERENDERQUEUE_HPP_ */
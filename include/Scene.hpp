@@ -9,20 +9,26 @@
 
 #include <Animation.hpp>
 #include <Appearance.hpp>
+#include <BinaryScene.hpp>
 #include <Camera.hpp>
+#include <IdRegistry.hpp>
+#include <LoadProfiler.hpp>
 #include <Light.hpp>
 #include <Primitives.hpp>
 #include <SceneGraph.hpp>
+#include <TextureResidency.hpp>
+#include <WorkerPool.hpp>
+#include <YafReader.hpp>
 #include <xmlDefinitions.hpp>
 #include "includes.hpp"
 
-#define TIXML_USE_STL
-#include <tinyxml.h>
+#include <chrono>
+#include <unordered_set>
 
 
 namespace ge {
 
-class Scene {
+class Scene: public YafHandler {
 private:
     /* Glut window size */
     int windowSizeX, windowSizeY;
@@ -67,35 +73,103 @@ private:
 
     /* Textures */
     std::vector<Texture*> textureVector;
+    IdRegistry<Texture> textureRegistry;
+    TextureResidency textureResidency;
+    void addTexture(Texture* in);
+    void decodeTextures();
     void initTextures();
 
     /* Appearances */
     std::vector<Appearance*> appearanceVector;
+    IdRegistry<Appearance> appearanceRegistry;
+    void addAppearance(Appearance* in);
     Appearance* getAppearanceByString(std::string& in);
     void initAppearanceTextures();
 
     /* Graph */
     SceneGraph* graph;
     std::vector<Node*> unprocessedNodes;
+    /* Once everything the lists draw is set up, so the first frame does not compile them */
+    void initDisplayLists();
 
     /* Animations */
     std::vector<Animation*> animationsVector;
+    IdRegistry<Animation> animationRegistry;
+    void addAnimation(Animation* in);
     Animation* getAnimationByString(std::string& in);
 
     /* Shader */
     std::vector<Primitives::WaterLine*> waterLineVector;
+    void initShaders();
+
+    /* Loads the compiled image if it is up to date, otherwise parses the xml (and refreshes the image) */
+    void loadScene(std::string& fileName, const std::string& binaryFileName,
+            bool forceCompile);
+    bool binaryFileWritten;
+
+    /* Compiled scene (yafb) loading, the writer is only set while parsing xml */
+    Binary::SceneImageWriter* imageWriter;
+    void binaryLoad(Binary::SceneImage& image);
+
+    /* What the private constructor does after the file is loaded */
+    enum LoadMode {
+        LoadCompile, /* nothing, the scene is only used to write the yafb file */
+        LoadReload /* no textures are decoded, reload only decodes the changed ones */
+    };
+
+    /* Used to compile a yaf file without using the default cache location, and by reload */
+    Scene(std::string& fileName, const std::string& binaryFileName,
+            LoadMode mode);
+
+    /* Hot reload, the live scene is patched to match a fresh load of the same file */
+    std::string sourceFileName;
+    int64_t sourceModificationTime;
+    uint64_t sourceSize;
+    std::chrono::steady_clock::time_point lastReloadCheck;
+    void readSourceModificationTime();
+
+    /* Frees everything the scene owns, also what a load that threw left behind */
+    void release();
+
+    bool reloadTextures(Scene& fresh, std::vector<Texture*>& changedTextures,
+            std::unordered_set<std::string>& changedTextureIds);
+    void reloadGlobals(Scene& fresh);
+    void reloadAppearances(Scene& fresh,
+            const std::unordered_set<std::string>& changedTextureIds,
+            std::unordered_set<Appearance*>& changedAppearances);
+    void reloadAnimations(Scene& fresh,
+            std::unordered_set<Animation*>& changedAnimations);
+    unsigned int reloadGraph(Scene& fresh,
+            const std::unordered_set<Appearance*>& changedAppearances,
+            const std::unordered_set<Animation*>& changedAnimations);
 
     /* Internal variables and methods for xml parsing */
     void parseAndLoadXml(std::string& fileName);
 
-    char* xmlFileName;
-    TiXmlDocument* doc;
+    /* The reader reports every element to the scene, the state stack tells where it is */
+    enum XmlState {
+        XmlDocument,
+        XmlYaf,
+        XmlCameras,
+        XmlLighting,
+        XmlTextures,
+        XmlAppearances,
+        XmlAnimations,
+        XmlAnimation,
+        XmlGraph,
+        XmlNode,
+        XmlTransforms,
+        XmlChildren,
+        XmlPatch,
+        XmlIgnored
+    };
+
+    std::vector<XmlState> xmlStateStack;
+    bool xmlRootFound;
+
+    void startElement(const YafElement& element);
+    void endElement(const YafElement& element);
 
-    void xmlLoadFile(const std::string& filename);
-
-    void xmlCheckDocumentType();
-
-    void xmlLoadMainElements();
     void xmlCheckMainElements();
 
     bool xmlGlobalsLoaded;
@@ -106,46 +180,56 @@ private:
     bool xmlGraphLoaded;
     bool xmlAnimationsLoaded;
 
-    void xmlLoadGlobals();
-    void xmlLoadCameras();
-    void xmlLoadLighting();
-    void xmlLoadTextures();
-    void xmlLoadAppearances();
-    void xmlLoadGraph();
-    void xmlLoadAnimations();
-
-    static TiXmlElement *findChildByAttribute(TiXmlElement *parent,
-            const char * attr, const char *val);
-
-    /* XML Elements */
-    TiXmlElement* xmlRootElement;
-
-    TiXmlElement* xmlGlobalsElement;
-    TiXmlElement* xmlCamerasElement;
-    TiXmlElement* xmlLightingElement;
-    TiXmlElement* xmlTexturesElement;
-    TiXmlElement* xmlAppearancesElement;
-    TiXmlElement* xmlGraphElement;
-    TiXmlElement* xmlAnimationsElement;
+    void xmlLoadGlobals(const YafElement& element);
+    void xmlLoadCameras(const YafElement& element);
+    void xmlLoadCamera(const YafElement& element);
+    void xmlLoadLighting(const YafElement& element);
+    void xmlLoadLight(const YafElement& element);
+    void xmlLoadTexture(const YafElement& element);
+    void xmlLoadAppearance(const YafElement& element);
+    void xmlLoadAnimation(const YafElement& element);
+    void xmlLoadAnimationPoint(const YafElement& element);
+    void xmlLoadGraph(const YafElement& element);
+    void xmlLoadNode(const YafElement& element);
+    XmlState xmlLoadNodeBlock(const YafElement& element);
+    void xmlLoadTransform(const YafElement& element);
+    XmlState xmlLoadNodeChild(const YafElement& element);
+    void xmlLoadPatchPoint(const YafElement& element);
+    void xmlEndPatch();
+    void xmlEndNode(const YafElement& element);
+    void xmlLinkGraph();
+
+    /* Element currently being loaded */
+    Node* xmlCurrentNode;
+    bool xmlNodeTransformsFound;
+    bool xmlNodeAppearanceFound;
+    bool xmlNodeAnimationFound;
+    bool xmlNodeChildrenFound;
+    unsigned xmlNodeTransformCount;
+
+    Primitives::Patch* xmlCurrentPatch;
+    unsigned xmlPatchReadPoints;
+
+    Animation* xmlCurrentAnimation;
 
     /* XML Parse methods */
-    std::string getStringFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
-    xyzPointDouble getDoublePointFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
-    xyzPointFloat getFloatPointFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
-    color getColorFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
-    double getDoubleFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
-    float getFloatFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
-    unsigned int getUnsignedIntFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
-    bool getAttributeExistence(TiXmlElement* iElement, const std::string& iAttribute);
-    xyPointDouble get2DdPointFromElementAttribute(TiXmlElement* iElement,
-            const std::string& iAttribute, const std::string& Error);
+    std::string getStringFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
+    xyzPointDouble getDoublePointFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
+    xyzPointFloat getFloatPointFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
+    color getColorFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
+    double getDoubleFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
+    float getFloatFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
+    unsigned int getUnsignedIntFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
+    bool getAttributeExistence(const YafElement& iElement, Xml::Names::Name iAttribute);
+    xyPointDouble get2DdPointFromElementAttribute(const YafElement& iElement,
+            Xml::Names::Name iAttribute, const std::string& Error);
 
     /* End XML related methods */
 
@@ -162,6 +246,7 @@ private:
     /* Internal display functions */
     void displayLights();
     void applyCameraView();
+    bool firstFrameDrawn;
 
     /* Update stuff */
     void checkUpdate(); ///< Called by the main application class, that handles timing, to check if an update is needed due to timeout. If so, it calls update(), and updates the timer.
@@ -174,14 +259,55 @@ private:
 public:
     PerspectiveCamera* externalGuiCamera;
 
-    /* Constructor who receives an string with the file name to load the scene from. */
-    Scene(std::string& fileName);
+    /*
+     * Loads the scene from the file without touching OpenGL (parse, link,
+     * node matrices, tessellation and image decoding). Without the cache the
+     * yaf file is always parsed and no yafb file is written.
+     */
+    Scene(std::string& fileName, bool useCache = true);
     virtual ~Scene();
 
+    /* Compiles a yaf file into a yafb file, returns false if it could not be written */
+    static bool compileBinary(std::string& fileName,
+            const std::string& binaryFileName);
+
+    /*
+     * Loads the file again and patches the live scene, keeping every node,
+     * texture, appearance and animation that did not change (and their
+     * display lists and GL objects). Needs the GL context. If the file can
+     * not be loaded the error is printed and the scene is left as it was.
+     */
+    bool reload();
+    /* Reloads if the file changed, checks at most twice per second */
+    bool reloadIfModified();
+
     /* Gets */
     GLboolean getLightingEnableStatus();
 
-    /*  */
+    /* One line with the number of loaded objects */
+    void printSummary(std::ostream& out);
+    /* Resident texture memory, uploads, evictions and stalls */
+    void printTextureStatistics(std::ostream& out);
+    /* Last frame: instances visited and culled, entries drawn and state changes */
+    void printDrawStatistics(std::ostream& out);
+    /* Flips frustum culling on and off, returns the new state */
+    bool toggleCulling();
+    /* Flips occlusion culling on and off, returns the new state */
+    bool toggleOcclusionCulling();
+    /* Flips render queue sorting on and off, returns the new state */
+    bool toggleSorting();
+    /* Flips instanced drawing on and off, returns the new state */
+    bool toggleInstancing();
+    /* Flips level of detail on and off, returns the new state */
+    bool toggleLevelOfDetail();
+    /* Adds to the level of detail bias, returns the new bias */
+    double changeLodBias(double delta);
+
+    /* World matrix of every instance of a node (none if the id is unknown) */
+    void getNodeWorldMatrices(const std::string& nodeId,
+            std::vector<const GLdouble*>& out);
+
+    /* Creates the OpenGL side of the scene, needs the GL context */
     virtual void init();
     virtual void display();
     virtual void update(unsigned long millis);
@@ -0,0 +1,109 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Synthetic stress scene generator (geEngine --generate scene.yaf ...).
+ *
+ * Writes a valid yaf scene of any size, meant as the input of the load and
+ * frame time benchmarks. The graph is a tree: inner nodes only reference
+ * their children, every leaf holds one primitive picked from the mix. The
+ * tree is as balanced as the node count allows and reaches the given depth
+ * without any node having more children than the fan-out.
+ *
+ * The output only depends on the settings (seed included), the same settings
+ * write the same bytes on every platform.
+ */
+
+#ifndef GESCENEGENERATOR_HPP_
+#define GESCENEGENERATOR_HPP_
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ge {
+
+class SceneGenerator {
+public:
+    enum PrimitiveType {
+        Cylinder, Sphere, Torus, Patch, Rectangle, Triangle, Plane, NumberOfPrimitiveTypes
+    };
+
+    struct Settings {
+        uint64_t nodes;
+        /* 0 picks the smallest depth that holds every node */
+        unsigned int depth;
+        unsigned int fanOut;
+        uint32_t seed;
+
+        /* Relative weight of each primitive type */
+        unsigned int primitiveWeights[NumberOfPrimitiveTypes];
+        /* Also used as torus loops and patch and plane parts, at least 2 and 1 */
+        unsigned int slices, stacks;
+        /*
+         * Parameter sets per primitive type, leaves pick one so meshes repeat
+         * (instancing benchmarks). 0 gives every leaf parameters of its own.
+         */
+        unsigned int shapes;
+
+        unsigned int appearances, textures, animations;
+        /* Percentage of the inner nodes that get an animation */
+        unsigned int animatedNodes;
+
+        /* Image files cycled through by the textures (in the textures folder) */
+        std::vector<std::string> textureFiles;
+
+        Settings();
+
+        /* "sphere:2,cylinder,torus", false if a name or weight is invalid */
+        bool setPrimitiveMix(const std::string& mix);
+        /* "a.jpg,b.jpg", false if empty */
+        bool setTextureFiles(const std::string& files);
+    };
+
+private:
+    Settings settings;
+    std::mt19937 engine;
+    FILE* out;
+
+    unsigned int depth;
+    unsigned int weightTotal;
+
+    /* Written statistics */
+    uint64_t leaves, animated;
+    unsigned int reachedDepth;
+    uint64_t primitives[NumberOfPrimitiveTypes];
+
+    /*
+     * Own mappings of the engine output, the std distributions differ between
+     * libraries. Never call them twice in one expression, the order is
+     * unspecified.
+     */
+    uint32_t nextInteger(uint32_t range);
+    double nextReal(double minimum, double maximum);
+
+    /* Number of nodes a subtree of the given height can hold */
+    uint64_t getCapacity(unsigned int height);
+    /* Children of a subtree with this many nodes, so it reaches the given height */
+    unsigned int getNumberOfChildren(uint64_t nodes, unsigned int height);
+
+    void writeHeader();
+    void writeNode(uint64_t id, uint64_t nodes, unsigned int level,
+            double extent);
+    void writePrimitive();
+    void writeTransforms(unsigned int level, double extent, bool leaf);
+
+public:
+    SceneGenerator(const Settings& settings);
+    SceneGenerator(SceneGenerator const&) = delete;
+    SceneGenerator& operator=(SceneGenerator const&) = delete;
+    virtual ~SceneGenerator();
+
+    /* Returns false (and says why) if the settings can not work or the file can not be written */
+    bool write(const std::string& fileName);
+};
+
+}
+
+#endif /* GESCENEGENERATOR_HPP_ */
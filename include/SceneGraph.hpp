@@ -9,25 +9,87 @@
 
 #include <Animation.hpp>
 #include <Appearance.hpp>
+#include <BoundingBox.hpp>
+#include <ContentHash.hpp>
+#include <DisplayListManager.hpp>
+#include <Frustum.hpp>
+#include <IdRegistry.hpp>
+#include <InstanceGroup.hpp>
+#include <OcclusionCulling.hpp>
 #include <Primitives.hpp>
+#include <RenderQueue.hpp>
 #include <Texture.hpp>
+#include <TextureResidency.hpp>
 #include <Transform.hpp>
+#include <WorkerPool.hpp>
 #include "includes.hpp"
 
+#include <deque>
 #include <list>
+#include <map>
+#include <memory>
+#include <set>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace ge {
 
 class Node {
+public:
+    /* Parts of a node that a reload can replace independently */
+    enum Part {
+        PartLinks, /* display list and batch flags, appearance, animation and children */
+        PartTransforms,
+        PartPrimitives,
+        NumberOfParts
+    };
+
+    /* The displaylist attribute, automatic when the yaf does not say */
+    enum ListMode {
+        ListOff, ListOn, ListAuto
+    };
+
 protected:
     /* Node related */
     std::string ID;
     bool precalcDone;
 
-    bool useDisplayList;
-    bool displayListCreated;
-    GLint displayListID;
+    ListMode displayListMode;
+    /* What the draw cost measured for an automatic list */
+    bool autoDisplayList;
+    bool autoDisplayListMeasured;
+    /* Meshes of the subtree are merged when it never moves */
+    bool useStaticBatch;
+    /* Nothing below the node moves, set with the graph's draw list */
+    bool staticSubtree;
+
+    /*
+     * A node can be referenced by many parents. Without its own appearance
+     * it is drawn with the parent's, so there is one list per inherited
+     * appearance (a single one when the node has its own). The manager keeps
+     * pointers to the lists, a deque does not move them.
+     */
+    struct DisplayList {
+        Appearance* inheritedAppearance;
+        DisplayListManager::List list;
+    };
+    std::deque<DisplayList> displayLists;
+    DisplayList& getDisplayList(Appearance* inheritedAppearance);
+
+    /*
+     * A list holds what is drawn below the node's animation and transforms
+     * that never moves: its static primitives and its static children. The
+     * rest is drawn around the list every time.
+     */
+    enum Contents {
+        ContentsAll, ContentsStatic, ContentsMoving
+    };
+    void drawContents(Contents contents);
+    /* What a list of the contents would take, from their triangles (added to triangles) */
+    std::size_t estimateBytes(Contents contents, std::size_t& triangles);
+    bool compileDisplayList(DisplayList& list,
+            Appearance* inheritedAppearance);
 
     std::vector<std::string> childrenIdVector;
     std::vector<Node*> childrenVector;
@@ -42,8 +104,24 @@ protected:
     Appearance* nodeAppearance;
     Animation* nodeAnimation;
 
+    /* First of the node's instances in the graph's draw list, 0 if none */
+    unsigned int firstInstance;
+
+    /* Ids read from the xml, resolved once the whole file is loaded */
+    std::string appearanceReference;
+    std::string animationReference;
+
     std::vector<Primitives::PrimitiveInterface*> primitiveVector;
 
+    /* Local bounds of the node's own primitives, worked out on first use */
+    BoundingBox primitiveBounds;
+    bool primitiveBoundsDone;
+
+    /* Content hashes, links and transforms are hashed the first time they are asked for */
+    std::uint64_t contentHash[NumberOfParts];
+    bool contentHashed;
+    void hashContent();
+
     void setTransformationMatrix(GLdouble* in);
 
     /* Result must be deleted */
@@ -56,14 +134,12 @@ protected:
     /* Creating display List (Avoid creating display lists inside of display lists) */
     static bool creatingDisplayList;
 
-    static GLint displayListCount;
-
     /* Debug */
     void printMatrix16x1(GLdouble* in);
 
 public:
     /* Constructor */
-    Node(std::string& in, bool displayList);
+    Node(std::string& in, ListMode displayList, bool staticBatch);
     virtual ~Node();
 
     /* Input */
@@ -72,8 +148,21 @@ public:
     void addPrimitive(Primitives::PrimitiveInterface* in);
     void addChildrenID(std::string& in);
     void setAnimation(Animation* in);
+    void setAppearanceReference(const std::string& in);
+    void setAnimationReference(const std::string& in);
     std::vector<std::string>& getChildrenIDVector();
     std::vector<Node*>& getChildrenVector();
+    std::vector<Primitives::PrimitiveInterface*>& getPrimitiveVector();
+
+    /* Primitives are hashed by the loader, from their compiled scene records */
+    void setPrimitivesHash(std::uint64_t in);
+    std::uint64_t getHash(Part part);
+
+    /* Swaps a part with the same part of other, the children vector has to be linked again after PartLinks */
+    void replacePart(Part part, Node& other);
+
+    /* The display lists are deleted, compiled again with the graph's or on the next draw */
+    void invalidateDisplayList();
 
     /* Precalc */
     void calculateNodeMatrix();
@@ -81,7 +170,38 @@ public:
     /* Output */
     std::string getNodeID();
     Appearance* getAppearance();
+    Animation* getAnimation();
+    const std::string& getAppearanceReference();
+    const std::string& getAnimationReference();
     unsigned int getNodeDepth();
+    /* An automatic list counts once the measured cost chose it */
+    bool hasDisplayList();
+    ListMode getDisplayListMode();
+    bool isAutoDisplayListMeasured();
+    void setAutoDisplayList(bool in);
+    bool hasStaticBatch();
+    bool isStaticSubtree();
+    void setStaticSubtree(bool in);
+    /* Transforms of the node only, column major */
+    GLdouble* getNodeMatrix();
+    void setFirstInstance(unsigned int in);
+    unsigned int getFirstInstance();
+    /* Own primitives only, in node coordinates (before the node transforms) */
+    const BoundingBox& getPrimitiveBounds();
+
+    /*
+     * The node's list for a parent drawn with inheritedAppearance, false if
+     * it does not fit the budget. Compiled, not executed.
+     */
+    bool compileDisplayList(Appearance* inheritedAppearance);
+    /*
+     * Calls the list, compiling it first if it was not, or draws what it
+     * would hold if it does not fit. The node's animation and transforms
+     * must already be applied. Returns the triangles drawn.
+     */
+    std::size_t callDisplayList(Appearance* inheritedAppearance);
+    /* What the list would hold, drawn without it */
+    void drawDisplayListContents(Appearance* inheritedAppearance);
 
     /* Runtime (Draw method) */
     void draw();
@@ -95,6 +215,11 @@ private:
 
     /* Internal */
     void setRootNode(Node* root);
+    void setRootDefaultAppearance();
+
+    /* Id lookup for every node in the graph, filled before linking */
+    IdRegistry<Node> nodeRegistry;
+    void registerNodes(std::vector<Node*>& inputNodes);
 
     GLdouble identityMatrix[16];
 
@@ -103,18 +228,401 @@ private:
     color emissive, ambient, diffuse, specular;
     Appearance* defaultRootAppearance;
 
-    bool firstRun;
+    /* Nodes drawn from the root (a shared node counts once per reference) */
+    uint64_t numberOfInstances;
+    /* Nodes referenced by more than one parent */
+    unsigned int numberOfSharedNodes;
+
+    /* Throws if a node is its own descendant, then counts the instances */
+    void checkGraph();
+
+    /* What changed in a reload, the memo is per inherited flag */
+    struct ReloadChanges {
+        const std::unordered_set<Node*>* nodes;
+        const std::unordered_set<Appearance*>* appearances;
+        const std::unordered_set<Animation*>* animations;
+        std::unordered_map<Node*, bool> visited[2];
+    };
+    bool invalidateHelper(Node* node, bool inherited, ReloadChanges& changes);
+
+    /*
+     * Meshes of a static subtree (nothing below the node is animated, driven
+     * or flowing) drawn with the same appearance, merged into one in the
+     * node's coordinates so every instance of the node draws it with its own
+     * world matrix. Large ones are split in cells that cull on their own.
+     */
+    struct StaticBatch {
+        Appearance* appearance;
+        Mesh mesh;
+        /* Node coordinates */
+        BoundingBox bounds;
+        GLdouble center[3];
+    };
+
+    /* A mesh going into a batch, matrix takes it to the batch node's coordinates */
+    struct BatchPiece {
+        Appearance* appearance;
+        Mesh* mesh;
+        GLdouble matrix[16];
+        GLdouble s, t;
+        BoundingBox bounds;
+    };
+
+    /* Rebuilt with the draw list, a deque keeps the entries' pointers valid */
+    std::deque<StaticBatch> staticBatches;
+    /* Batches of a node per inherited appearance, [first, end) of staticBatches */
+    std::map<std::pair<Node*, Appearance*>,
+            std::pair<unsigned int, unsigned int> > batchRanges;
+    /* While the draw list is built */
+    std::unordered_map<Node*, bool> staticSubtrees;
+    /* Nodes merged into an ancestor's batch, moving one rebuilds the batches */
+    std::unordered_set<Node*> batchedNodes;
+    unsigned int batchedPrimitives;
+
+    bool isStaticSubtree(Node* node);
+    void collectBatchPieces(Node* node, const GLdouble* matrix,
+            Appearance* appearance, std::vector<BatchPiece>& out);
+    /* Halves the pieces along the widest axis of their centers until they fit */
+    void splitStaticBatch(std::vector<BatchPiece>::iterator first,
+            std::vector<BatchPiece>::iterator last);
+    void addStaticBatchEntries(Node* node, unsigned int instance,
+            Appearance* inheritedAppearance);
+
+    /*
+     * Flat draw list, the graph unrolled in draw order with one entry per
+     * drawn primitive, rebuilt only when the graph changes. A node with a
+     * display list has one entry for the list, which draws the static part
+     * of its subtree, and entries for whatever moves. A static batch node
+     * has one entry per batch, its subtree only keeps entries for what has
+     * no mesh.
+     */
+    struct DrawEntry {
+        /* World matrix to load */
+        unsigned int instance;
+        /* The inherited one for a display list call */
+        Appearance* appearance;
+        /* nullptr for a display list call or a batch */
+        Primitives::PrimitiveInterface* primitive;
+        Node* displayListNode;
+        StaticBatch* batch;
+        /* nullptr if the entry is drawn on its own */
+        InstanceGroup* group;
+        unsigned int member;
+        /*
+         * Levels of detail of the primitive (1 without them), the one drawn
+         * last frame, and how far the primitive reaches from its node's
+         * origin
+         */
+        unsigned int levels, level;
+        GLdouble reach;
+        /* First primitive of its node, the appearance is applied once per node */
+        bool applyAppearance;
+        /* Render queue key without the depth */
+        uint64_t stateKey;
+    };
+
+    /*
+     * Every node instance (a shared node has one per path from the root) in
+     * preorder with its world matrix, instance 0 is the scene itself. The
+     * subtree of an instance is the range [index, end), so a moved node only
+     * recomputes its own subtree and static subtrees cost nothing per frame.
+     */
+    struct NodeInstance {
+        Node* node;
+        unsigned int parent;
+        unsigned int end;
+        /* Next instance of the same node, 0 for the last one */
+        unsigned int nextInstance;
+        /*
+         * Draw entries of the node itself are [firstEntry, ownEntriesEnd),
+         * its whole subtree's are [firstEntry, entriesEnd)
+         */
+        unsigned int firstEntry, ownEntriesEnd, entriesEnd;
+        GLdouble world[16];
+        /* Largest scale the world matrix applies */
+        GLdouble scale;
+        /* World bounds of the whole subtree */
+        BoundingBox bounds;
+        /* 0 if the subtree is not tested for occlusion */
+        unsigned int occlusionUnit;
+    };
+
+    struct AnimatedInstance {
+        unsigned int instance;
+        Animation* animation;
+        /* Animation version the world matrices were computed with */
+        unsigned long version;
+    };
+
+    std::vector<DrawEntry> drawEntries;
+    std::vector<NodeInstance> nodeInstances;
+    std::vector<AnimatedInstance> animatedInstances;
+    /* Instances whose subtrees are recomputed on the next update */
+    std::vector<unsigned int> changedInstances;
+    bool drawListValid;
+    /* Graphs that unroll into too many instances are drawn recursively */
+    bool useDrawList;
+
+    void buildDrawList();
+    void buildDrawListHelper(Node* node, unsigned int parent,
+            Appearance* inheritedAppearance, bool drawn, bool batched);
+    void updateWorldMatrix(unsigned int instance);
+    void updateSubtree(unsigned int first);
+    /* The moved subtrees split in jobs on the pool */
+    void updateSubtrees(const std::vector<unsigned int>& moved,
+            unsigned int movedInstances, WorkerPool& pool);
+    /* Own primitives and direct children, which must be up to date */
+    void updateBounds(unsigned int instance);
+
+    bool culling;
+    unsigned int visitedInstances, culledInstances, drawnEntries;
+    unsigned int culledBatches;
+
+    /*
+     * With frustum culling, subtrees of enough entries are also tested
+     * for occlusion. Subtrees that turn out visible once the rest of the
+     * frame is drawn are queued and drawn in a second pass.
+     */
+    OcclusionCulling occlusionCulling;
+    bool occlusion;
+    /* Occlusion is on and the context can do it, decided each frame */
+    bool occlusionFrame;
+
+    void addOcclusionUnits();
+    void drawRevealedSubtrees(const Frustum& frustum);
+
+    /*
+     * Visible entries are queued and sorted by state, an appearance is
+     * applied only when it differs from the last one applied. Unsorted, the
+     * list order is kept and every node applies its own.
+     */
+    RenderQueue renderQueue;
+    bool sorting;
+    /* Last frame, and what the same entries cost in list order */
+    unsigned int appearanceChanges, textureChanges;
+    unsigned int listOrderAppearanceChanges, listOrderTextureChanges;
+
+    /*
+     * Entries drawing the same mesh (a primitive's or a batch's) with the
+     * same appearance, when there are enough of them, are drawn together
+     * with instanced calls. Culling still goes entry by entry, the first
+     * visible member queues its group. Rebuilt with the draw list.
+     */
+    std::deque<InstanceGroup> instanceGroups;
+    bool instancing;
+    /* Instancing is on and the context can do it, decided each frame */
+    bool instancedFrame;
+    unsigned int groupedEntries;
+    unsigned int instancedCalls, instancedEntries, uploadedInstances;
+
+    /*
+     * Primitives with levels of detail are drawn at the coarsest level whose
+     * error covers at most the tolerance in pixels (doubled by each step of
+     * bias), a level is only left for a coarser one well under it.
+     */
+    static double lodBias;
+    bool levelOfDetail;
+    /* This frame's, from the bias */
+    GLdouble lodTolerance;
+    uint64_t submittedTriangles;
+    unsigned int coarseEntries;
+
+    void selectLevel(DrawEntry& entry, const Frustum& frustum);
+
+    /*
+     * Nodes the yaf leaves to the engine get a list when a call measured
+     * clearly faster than drawing the subtree directly. Only static
+     * subtrees with a few entries are measured, none instanced or with
+     * levels of detail (a list would undo both).
+     */
+    unsigned int measuredLists, chosenLists;
+
+    /* Appearance the instance's node inherits */
+    Appearance* getInheritedAppearance(unsigned int instance);
+    void chooseDisplayLists();
+    bool isListCandidate(unsigned int instance);
+    /* Returns false if the list did not fit */
+    bool measureDisplayList(unsigned int instance);
+    /* Graphs drawn recursively, once per node and inherited appearance */
+    void compileDisplayListsHelper(Node* node, Appearance* inheritedAppearance,
+            std::set<std::pair<Node*, Appearance*> >& visited);
+
+    void buildInstanceGroups();
+    /* Entries in [first, end) moved, their members are written again */
+    void updateGroupMatrices(unsigned int first, unsigned int end);
+    /* Same, without marking the members changed (can run in a job) */
+    void writeGroupMatrices(unsigned int first, unsigned int end);
+
+    /* Packs the shader, texture and appearance of every entry */
+    void setStateKeys();
+    /*
+     * Culling, level selection and depth keys run in jobs. The top of the
+     * graph is walked here down to subtrees small enough for a job, each of
+     * those is a job, and so are the entries of every node above them.
+     * Jobs write their own items and counters, merged in job order (draw
+     * list order) before the queue is sorted. Small graphs are walked in a
+     * single job on this thread.
+     */
+    struct TraversalJob {
+        /* Entries [first, end) queued as they are, or instances [first, end) walked */
+        bool entries;
+        unsigned int first, end;
+
+        std::vector<RenderQueue::Item> items;
+        OcclusionCulling::Requests occlusionRequests;
+        unsigned int visitedInstances, culledInstances, drawnEntries;
+        unsigned int culledBatches, coarseEntries;
+        unsigned int listOrderAppearanceChanges, listOrderTextureChanges;
+    };
+
+    /* Kept between frames with their item vectors, the first ones are used */
+    std::vector<TraversalJob> traversalJobs;
+    unsigned int numberOfTraversalJobs;
+    /* Started by the first frame of a graph large enough */
+    std::unique_ptr<WorkerPool> traversalPool;
+    /* 0 is one per hardware thread */
+    static unsigned int traversalThreads;
+    /* Last frame's walk, the reveal pass runs jobs of its own and is not counted */
+    unsigned int traversalJobsRun, traversalJobThreads;
+    double traversalSeconds;
+
+    WorkerPool* getTraversalPool();
+    TraversalJob& addTraversalJob(bool entries, unsigned int first,
+            unsigned int end);
+    /* The first job takes what the walk itself finds, it has no range */
+    void splitTraversal(unsigned int jobInstances, const Frustum& frustum,
+            bool occlusionTests);
+    /* On the pool when there are several jobs and the graph is large, returns the threads used */
+    unsigned int runTraversalJobs(const Frustum& frustum, bool occlusionTests);
+    /* Adds the counters and queues the items, grouped entries through their group */
+    void mergeTraversalJobs();
+    void queueVisibleEntries(const Frustum& frustum);
+
+    /* Frustum culled walk of the instances [first, end), occlusion tests if asked */
+    void queueVisibleEntries(unsigned int first, unsigned int end,
+            const Frustum& frustum, bool occlusionTests, TraversalJob& job);
+    void queueEntryRange(unsigned int first, unsigned int end,
+            const Frustum& frustum, TraversalJob& job);
+    void submitQueue();
 
 public:
     SceneGraph(std::string& root);
     virtual ~SceneGraph();
 
     void importNodesPointerVector(std::vector<Node*>& inputNodes);
-    void importNodesPointerVectorHelper(std::vector<Node*>& unprocessedNodes,
-            Node* parent);
 
-    /* Recursive draw function */
-    void draw();
+    /* Nodes that already have their children vectors filled (compiled scenes) */
+    void importLinkedNodes(std::vector<Node*>& linkedNodes);
+
+    /* Returns nullptr if there is no node with that id */
+    Node* getNodeByID(const std::string& id);
+
+    unsigned int getNumberOfNodes();
+    uint64_t getNumberOfInstances();
+    unsigned int getNumberOfSharedNodes();
+
+    /*
+     * Patches this graph to match fresh (loaded from the same file) by node
+     * id, only the parts whose hashes differ are swapped. Patched and added
+     * nodes go to patched, primitives that are no longer drawn to discarded.
+     * Everything that is not used anymore ends up owned by fresh.
+     * Returns true if the root node changed.
+     */
+    bool applyReload(SceneGraph& fresh, std::vector<Node*>& patched,
+            std::unordered_set<Primitives::PrimitiveInterface*>& discarded);
+
+    /*
+     * Invalidates the display lists that include a changed node, or a node
+     * drawn with a changed appearance or animation (lists also include
+     * everything drawn below them).
+     */
+    void invalidateDisplayLists(const std::unordered_set<Node*>& nodes,
+            const std::unordered_set<Appearance*>& appearances,
+            const std::unordered_set<Animation*>& animations);
+
+    /*
+     * Measures the automatic candidates, then compiles every list the draw
+     * will call (within the budget). After the scene is set up or reloaded,
+     * needs the GL context.
+     */
+    void compileDisplayLists();
+    /* Subtrees measured for an automatic list, and how many got one */
+    unsigned int getMeasuredLists();
+    unsigned int getChosenLists();
+
+    /* Recomputes the world matrices of whatever moved since the last call (draw calls it first) */
+    void updateWorldMatrices();
+
+    /* The node's transforms changed, its subtrees are recomputed on the next update */
+    void invalidateWorldMatrices(Node* node);
+
+    /*
+     * World matrix (column major, camera not included) of every instance of
+     * the node. Empty for graphs too large to unroll.
+     */
+    void getWorldMatrices(Node* node, std::vector<const GLdouble*>& out);
+
+    /*
+     * Walks the flat draw list, the modelview must be the identity (the
+     * camera is in the projection). Subtrees whose bounds are outside the
+     * frustum, or were found occluded, are skipped as a whole.
+     */
+    void draw(const Frustum& frustum);
+
+    void setCulling(bool enabled);
+    bool getCulling();
+
+    /* Last frame: instances tested against the frustum, subtrees skipped and entries drawn */
+    unsigned int getVisitedInstances();
+    unsigned int getCulledInstances();
+    unsigned int getDrawnEntries();
+    unsigned int getCulledBatches();
+
+    /* Batches in the draw list and the primitives merged into them */
+    unsigned int getNumberOfStaticBatches();
+    unsigned int getNumberOfBatchedPrimitives();
+
+    void setOcclusionCulling(bool enabled);
+    bool getOcclusionCulling();
+    /* Last frame: queries issued, subtrees skipped and how late the results came */
+    void printOcclusionStatistics(std::ostream& out);
+
+    /* Shared by every graph, set before the first frame */
+    static void setTraversalThreads(unsigned int threads);
+    /* Last frame: jobs the walk was split in, threads that ran them and the time it took */
+    unsigned int getTraversalJobs();
+    unsigned int getTraversalJobThreads();
+    double getTraversalSeconds();
+
+    void setSorting(bool enabled);
+    bool getSorting();
+
+    void setInstancing(bool enabled);
+    bool getInstancing();
+    unsigned int getNumberOfInstanceGroups();
+    unsigned int getNumberOfGroupedEntries();
+    /* Last frame: instanced calls, entries they drew and member matrices written */
+    unsigned int getInstancedCalls();
+    unsigned int getInstancedEntries();
+    unsigned int getUploadedInstances();
+
+    void setLevelOfDetail(bool enabled);
+    bool getLevelOfDetail();
+    /* Shared by every graph */
+    static void setLodBias(double bias);
+    static double getLodBias();
+    /*
+     * Last frame: triangles submitted (display lists count what they
+     * recorded) and entries drawn coarser than their full mesh
+     */
+    uint64_t getSubmittedTriangles();
+    unsigned int getCoarseEntries();
+
+    /* Last frame: appearances applied and textures bound, then the same in draw list order */
+    unsigned int getAppearanceChanges();
+    unsigned int getTextureChanges();
+    unsigned int getListOrderAppearanceChanges();
+    unsigned int getListOrderTextureChanges();
 };
 
 } //namespace ge
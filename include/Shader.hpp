@@ -21,8 +21,14 @@ private:
 
     unsigned int totalTimePassed;
 
+    Shader();
+    void build(const char* vsText, const char* fsText, const char* vsName,
+            const char* fsName);
+
 public:
     Shader(const char *vsFile, const char *fsFile);
+    /* The engine's own shaders, source text instead of file names */
+    static Shader* fromSource(const char* vsText, const char* fsText);
     virtual ~Shader();
 
     virtual void update(float time);
@@ -33,6 +39,8 @@ public:
     virtual void unbind();
 
     unsigned int getId();
+    /* False if a shader failed to compile or the program to link */
+    bool isLinked();
 };
 
 }
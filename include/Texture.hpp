@@ -9,13 +9,18 @@
 
 #include "includes.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <string>
 
 #include <imagetools.hpp>
+#include <TextureCache.hpp>
 
 namespace ge {
 
+class TextureResidency;
+
 class Texture {
 private:
     // Attributes
@@ -26,6 +31,29 @@ private:
 
     bool loaded;
 
+    /* Decoded mip chain waiting to be uploaded (mapped from the texb cache or just built) */
+    TextureCache::Image* decodedImage;
+
+    /* Bytes and levels of the uploaded image */
+    std::size_t imageSize;
+    GLint uploadedLevels;
+
+    /* Load timings in milliseconds */
+    double decodeTime, uploadTime;
+
+    /* Managed by the scene's TextureResidency (null for eager textures) */
+    friend class TextureResidency;
+    enum Residency {
+        NotResident, Decoding, Decoded, Resident, DecodeFailed
+    };
+    std::atomic<int> residencyState;
+    unsigned long lastUsedFrame;
+    TextureResidency* residency;
+
+    /* 1x1 grey image, also frees the real one */
+    void uploadPlaceholder();
+    std::size_t getImageSize();
+
 public:
     Texture(std::string& xmlIdIn, std::string& input);
     virtual ~Texture();
@@ -34,10 +62,27 @@ public:
     int getWidth();
     int getHeight();
 
+    /* Decode and upload in one go */
     void loadTexture();
+
+    /* Maps the texb cache (or decodes the image and builds it), safe to call from a worker thread */
+    void decodeTexture();
+    /* Sends the decoded image to OpenGL, must be called from the GL thread */
+    void uploadTexture();
+    /* False if the image could not be read (or was already uploaded) */
+    bool isDecoded();
+    /* Only checks that the image file is there, nothing is read */
+    bool fileExists();
+
     void apply();
+    /* Marks the texture as drawn without binding it */
+    void touch();
+
+    double getDecodeTime();
+    double getUploadTime();
 
     std::string getXmlId();
+    std::string getFileName();
 };
 
 }
@@ -0,0 +1,103 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Preprocessed texture cache (texb).
+ *
+ * A texb file holds an image ready for glTexImage2D: decoded, flipped so the
+ * bottom row comes first, RGBA (so every row is 4 byte aligned) and followed
+ * by its whole box filtered mip chain. It is written next to the image the
+ * first time the image is loaded (or by geEngine --compile) and later loads
+ * map it and upload straight from the mapping.
+ *
+ * The image file is always the source of truth, the texb is only a cache.
+ */
+
+#ifndef GETEXTURECACHE_HPP_
+#define GETEXTURECACHE_HPP_
+
+#include <MappedFile.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ge {
+namespace TextureCache {
+
+/* Bump the version every time the layout changes */
+const uint32_t Magic = 0x42584554; /* "TEXB" */
+const uint32_t Version = 1;
+const uint32_t ByteOrderMark = 0x01020304;
+
+/* Enough for a 32768 pixel wide image */
+const uint32_t MaxLevels = 16;
+
+const std::string FileExtension = ".texb";
+
+struct LevelEntry {
+    uint64_t offset;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t headerSize;
+
+    /* Status of the image file this cache was built from */
+    int64_t sourceModificationTime;
+    uint64_t sourceSize;
+
+    uint32_t levelCount;
+    uint32_t reserved;
+    LevelEntry levels[MaxLevels];
+};
+
+class Image {
+private:
+    MappedFile file;
+
+    /* Used instead of the mapping when the image was just built */
+    std::vector<unsigned char> buffer;
+
+    const unsigned char* data;
+
+    bool validate(const unsigned char* candidate, std::size_t candidateSize);
+
+public:
+    Image();
+    Image(Image const&) = delete;
+    Image& operator=(Image const&) = delete;
+    virtual ~Image();
+
+    /* Maps a cache file, false if it is missing, invalid or older than the image */
+    bool open(const std::string& fileName, int64_t sourceModificationTime,
+            uint64_t sourceSize);
+
+    /*
+     * Decodes the image and builds the mip chain, then tries to write the
+     * cache file. The image can be used even if the file could not be written.
+     */
+    bool build(const std::string& imageFileName,
+            const std::string& cacheFileName, int64_t sourceModificationTime,
+            uint64_t sourceSize);
+
+    uint32_t getNumberOfLevels();
+    /* RGBA pixels of a level, bottom row first */
+    const unsigned char* getLevel(uint32_t level, uint32_t& width,
+            uint32_t& height);
+
+    /* Pixel bytes of every level together */
+    std::size_t getPixelSize();
+};
+
+/* Image file name + texb */
+std::string getCacheFileName(const std::string& imageFileName);
+
+}
+}
+
+#endif /* GETEXTURECACHE_HPP_ */
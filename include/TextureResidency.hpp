@@ -0,0 +1,83 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Texture residency, textures are decoded and uploaded when first drawn.
+ *
+ * Every texture gets its GL name and a 1x1 placeholder image up front, so
+ * display lists can bind it before the real image exists. Drawing a texture
+ * that is not resident queues its decode on a worker thread, the finished
+ * images are uploaded at the start of the next frame (never while a display
+ * list is being compiled). Over the budget, textures that were not drawn for
+ * a number of frames go back to the placeholder, least recently used first.
+ */
+
+#ifndef GETEXTURERESIDENCY_HPP_
+#define GETEXTURERESIDENCY_HPP_
+
+#include <Texture.hpp>
+#include <WorkerPool.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace ge {
+
+class TextureResidency {
+private:
+    std::vector<Texture*> textures;
+
+    /* Decode jobs only, created on the first decode */
+    std::unique_ptr<WorkerPool> pool;
+    std::vector<Texture*> decoding;
+
+    unsigned long frame;
+    std::size_t budget;
+    unsigned int evictAfterFrames;
+
+    std::size_t residentBytes, peakResidentBytes;
+    uint64_t uploads, evictions, stalls, failures;
+
+    /* Textures drawn while a display list is compiled, replayed with the list */
+    static std::vector<Texture*>* recording;
+
+    static std::size_t defaultBudget;
+
+    void evict();
+
+public:
+    TextureResidency();
+    TextureResidency(TextureResidency const&) = delete;
+    TextureResidency& operator=(TextureResidency const&) = delete;
+    virtual ~TextureResidency();
+
+    /* GL thread, creates the name and the placeholder */
+    void add(Texture* texture);
+    /* Waits for a running decode, the texture can be deleted afterwards */
+    void remove(Texture* texture);
+    void clear();
+
+    /* Called whenever the texture is drawn (directly or by a display list) */
+    void touch(Texture* texture);
+
+    /* Uploads finished decodes and evicts, must be outside any display list */
+    void beginFrame();
+
+    void setBudget(std::size_t bytes);
+    void setEvictAfterFrames(unsigned int frames);
+
+    /* Returns the recording it replaces, pass it back to stopRecording */
+    static std::vector<Texture*>* startRecording(std::vector<Texture*>* in);
+    static void stopRecording(std::vector<Texture*>* previous);
+
+    /* Budget for scenes created afterwards (geEngine --texture-budget MB) */
+    static void setDefaultBudget(std::size_t bytes);
+
+    void printStatistics(std::ostream& out);
+};
+
+}
+
+#endif /* GETEXTURERESIDENCY_HPP_ */
@@ -0,0 +1,52 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Fixed size thread pool for CPU only jobs (no OpenGL calls inside jobs).
+ */
+
+#ifndef GEWORKERPOOL_HPP_
+#define GEWORKERPOOL_HPP_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace ge {
+
+class WorkerPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()> > jobs;
+
+    std::mutex jobsMutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsFinished;
+
+    /* Queued plus running jobs */
+    unsigned int pendingJobs;
+    bool stopping;
+
+    void workerLoop();
+
+public:
+    /* Zero threads means one per hardware thread */
+    WorkerPool(unsigned int numberOfThreads = 0);
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+    virtual ~WorkerPool();
+
+    /* Jobs must not throw, report errors through the job's own state */
+    void submit(std::function<void()> job);
+
+    /* Blocks until every submitted job has finished */
+    void wait();
+
+    unsigned int getNumberOfThreads();
+};
+
+}
+
+#endif /* GEWORKERPOOL_HPP_ */
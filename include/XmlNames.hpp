@@ -0,0 +1,193 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Element and attribute names known by the yaf parser.
+ *
+ * Every name gets a small token, the reader converts names to tokens with a
+ * perfect hash table built at compile time (one hash and one compare per
+ * name), so the loaders dispatch with a switch instead of string compares.
+ */
+
+#ifndef GEXMLNAMES_HPP_
+#define GEXMLNAMES_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ge {
+namespace Xml {
+namespace Names {
+
+/* Token, string */
+#define GE_XML_NAMES(NAME) \
+    NAME(Yaf, "yaf") \
+    NAME(Globals, "globals") \
+    NAME(Cameras, "cameras") \
+    NAME(Perspective, "perspective") \
+    NAME(Ortho, "ortho") \
+    NAME(Lighting, "lighting") \
+    NAME(Omni, "omni") \
+    NAME(Spot, "spot") \
+    NAME(Textures, "textures") \
+    NAME(Appearances, "appearances") \
+    NAME(Appearance, "appearance") \
+    NAME(Animations, "animations") \
+    NAME(Animation, "animation") \
+    NAME(ControlPoint, "controlpoint") \
+    NAME(Graph, "graph") \
+    NAME(Node, "node") \
+    NAME(Transforms, "transforms") \
+    NAME(Translate, "translate") \
+    NAME(Rotate, "rotate") \
+    NAME(Scale, "scale") \
+    NAME(AppearanceRef, "appearanceref") \
+    NAME(AnimationRef, "animationref") \
+    NAME(Children, "children") \
+    NAME(NodeRef, "noderef") \
+    NAME(Rectangle, "rectangle") \
+    NAME(Triangle, "triangle") \
+    NAME(Cylinder, "cylinder") \
+    NAME(Sphere, "sphere") \
+    NAME(Torus, "torus") \
+    NAME(Plane, "plane") \
+    NAME(Patch, "patch") \
+    NAME(Vehicle, "vehicle") \
+    NAME(WaterLine, "waterline") \
+    NAME(Id, "id") \
+    NAME(File, "file") \
+    NAME(Enabled, "enabled") \
+    NAME(Background, "background") \
+    NAME(DrawMode, "drawmode") \
+    NAME(Shading, "shading") \
+    NAME(CullFace, "cullface") \
+    NAME(CullOrder, "cullorder") \
+    NAME(Initial, "initial") \
+    NAME(Near, "near") \
+    NAME(Far, "far") \
+    NAME(Angle, "angle") \
+    NAME(Pos, "pos") \
+    NAME(Target, "target") \
+    NAME(Left, "left") \
+    NAME(Right, "right") \
+    NAME(Top, "top") \
+    NAME(Bottom, "bottom") \
+    NAME(DoubleSided, "doublesided") \
+    NAME(Local, "local") \
+    NAME(Location, "location") \
+    NAME(Ambient, "ambient") \
+    NAME(Diffuse, "diffuse") \
+    NAME(Specular, "specular") \
+    NAME(Exponent, "exponent") \
+    NAME(Direction, "direction") \
+    NAME(Emissive, "emissive") \
+    NAME(Shininess, "shininess") \
+    NAME(TextureRef, "textureref") \
+    NAME(TexLengthS, "texlength_s") \
+    NAME(TexLengthT, "texlength_t") \
+    NAME(Span, "span") \
+    NAME(Type, "type") \
+    NAME(XX, "xx") \
+    NAME(YY, "yy") \
+    NAME(ZZ, "zz") \
+    NAME(RootId, "rootid") \
+    NAME(DisplayList, "displaylist") \
+    NAME(StaticBatch, "staticbatch") \
+    NAME(To, "to") \
+    NAME(Axis, "axis") \
+    NAME(Factor, "factor") \
+    NAME(XY1, "xy1") \
+    NAME(XY2, "xy2") \
+    NAME(XYZ1, "xyz1") \
+    NAME(XYZ2, "xyz2") \
+    NAME(XYZ3, "xyz3") \
+    NAME(Base, "base") \
+    NAME(Height, "height") \
+    NAME(Slices, "slices") \
+    NAME(Stacks, "stacks") \
+    NAME(Radius, "radius") \
+    NAME(Inner, "inner") \
+    NAME(Outer, "outer") \
+    NAME(Loops, "loops") \
+    NAME(Parts, "parts") \
+    NAME(Order, "order") \
+    NAME(PartsU, "partsU") \
+    NAME(PartsV, "partsV") \
+    NAME(Compute, "compute") \
+    NAME(X, "x") \
+    NAME(Y, "y") \
+    NAME(Z, "z") \
+    NAME(HeightMap, "heightmap") \
+    NAME(TextureMap, "texturemap") \
+    NAME(FragmentShader, "fragmentshader") \
+    NAME(VertexShader, "vertexshader")
+
+#define GE_XML_NAME_TOKEN(token, text) token,
+#define GE_XML_NAME_TEXT(token, text) text,
+
+/* Unknown is used for every name that is not in the list */
+enum Name : std::uint8_t {
+    Unknown = 0,
+    GE_XML_NAMES(GE_XML_NAME_TOKEN)
+    Count
+};
+
+constexpr std::string_view Text[Count] = { "", GE_XML_NAMES(GE_XML_NAME_TEXT) };
+
+#undef GE_XML_NAME_TOKEN
+#undef GE_XML_NAME_TEXT
+
+/* Power of two, large enough for a collision free seed to show up quickly */
+constexpr std::size_t TableSize = 1024;
+
+constexpr std::uint32_t hash(std::string_view in, std::uint32_t seed) {
+    std::uint32_t h = 2166136261u ^ seed;
+    for (char c : in) {
+        h = (h ^ static_cast<std::uint8_t>(c)) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+struct Table {
+    std::uint32_t seed;
+    std::array<Name, TableSize> slots;
+};
+
+/* Tries seeds until every name lands in its own slot */
+constexpr Table buildTable() {
+    for (std::uint32_t seed = 1;; seed++) {
+        Table table = { seed, { } };
+        bool collision = false;
+
+        for (std::size_t i = 1; i < Count && !collision; i++) {
+            std::size_t slot = hash(Text[i], seed) & (TableSize - 1);
+            if (table.slots[slot] != Unknown) {
+                collision = true;
+            }
+            table.slots[slot] = static_cast<Name>(i);
+        }
+
+        if (!collision) {
+            return table;
+        }
+    }
+}
+
+constexpr Table table = buildTable();
+
+constexpr Name find(std::string_view in) {
+    Name name = table.slots[hash(in, table.seed) & (TableSize - 1)];
+    return Text[name] == in ? name : Unknown;
+}
+
+static_assert(find("rectangle") == Rectangle && find("partsV") == PartsV,
+        "Xml name table is broken.");
+static_assert(find("") == Unknown && find("rectangles") == Unknown,
+        "Xml name table is broken.");
+
+}
+}
+}
+
+#endif /* GEXMLNAMES_HPP_ */
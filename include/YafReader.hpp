@@ -0,0 +1,139 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Streaming yaf (xml) reader.
+ *
+ * The file is read in fixed size chunks and every element is reported to a
+ * handler as soon as its tag is complete, no document tree is ever built.
+ * Memory use only depends on the chunk size and on the largest single tag.
+ */
+
+#ifndef GEYAFREADER_HPP_
+#define GEYAFREADER_HPP_
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <XmlNames.hpp>
+
+namespace ge {
+
+/* Element as seen by the handler, only valid during the callback */
+class YafElement {
+private:
+    friend class YafReader;
+
+    struct Attribute {
+        Xml::Names::Name name;
+        std::string_view value;
+        bool decoded;
+    };
+
+    /* Names and values point into the reader buffer */
+    std::string_view name;
+    Xml::Names::Name token;
+
+    /* Slots are reused between elements, only the first attributeCount are valid */
+    std::vector<Attribute> attributes;
+    std::size_t attributeCount;
+
+    /* Values that had entities, one slot per attribute */
+    std::vector<std::string> decodedValues;
+
+    int row;
+
+public:
+    YafElement();
+
+    std::string_view getName() const;
+    Xml::Names::Name getToken() const;
+    int getRow() const;
+
+    /* Returns nullptr if the attribute is not present */
+    const std::string_view* getAttribute(Xml::Names::Name attribute) const;
+
+    /* Attributes in file order, unknown names have the Unknown token */
+    std::size_t getNumberOfAttributes() const;
+    Xml::Names::Name getAttributeToken(std::size_t i) const;
+    std::string_view getAttributeValue(std::size_t i) const;
+
+    /*
+     * Reads count white space separated numbers (locale independent, no
+     * allocations), returns false if the attribute is missing or malformed.
+     */
+    bool getNumbers(Xml::Names::Name attribute, double* out,
+            unsigned count) const;
+    bool getNumbers(Xml::Names::Name attribute, float* out,
+            unsigned count) const;
+    bool getNumbers(Xml::Names::Name attribute, unsigned* out,
+            unsigned count) const;
+};
+
+class YafHandler {
+public:
+    virtual ~YafHandler() {
+    }
+
+    virtual void startElement(const YafElement& element) = 0;
+
+    /* Empty elements (<a/>) get both calls, the end element has no attributes */
+    virtual void endElement(const YafElement& element) = 0;
+};
+
+class YafReader {
+private:
+    FILE* file;
+
+    /* Unparsed bytes are buffer[begin, end) */
+    std::vector<char> buffer;
+    std::size_t begin, end;
+    bool endOfFile;
+
+    /* Line of buffer[begin] */
+    int row;
+
+    YafElement element;
+
+    /* Slots are reused, only the first depth are open */
+    std::vector<std::string> openElements;
+    std::size_t depth;
+
+    bool fillBuffer();
+    void consume(std::size_t length);
+    std::size_t findMarkupEnd(std::size_t start, bool& complete);
+
+    void parseTag(const char* tag, std::size_t length, int tagRow,
+            YafHandler& handler);
+    bool decodeValue(const char* in, std::size_t length, std::string& out,
+            int tagRow);
+
+public:
+    static const std::size_t ChunkSize = 64 * 1024;
+
+    /* Largest single tag (or comment) accepted */
+    static const std::size_t MaxMarkupSize = 4 * 1024 * 1024;
+
+    YafReader();
+    YafReader(YafReader const&) = delete;
+    YafReader& operator=(YafReader const&) = delete;
+    virtual ~YafReader();
+
+    /*
+     * Reads the whole file, returns false if it can not be opened.
+     * Malformed xml is a fatal exception with the row number.
+     */
+    bool parse(const std::string& fileName, YafHandler& handler);
+
+    /* Reads count white space separated numbers, used by YafElement::getNumbers */
+    static bool parseNumbers(std::string_view in, double* out, unsigned count);
+    static bool parseNumbers(std::string_view in, float* out, unsigned count);
+    static bool parseNumbers(std::string_view in, unsigned* out,
+            unsigned count);
+};
+
+}
+
+#endif /* GEYAFREADER_HPP_ */
@@ -8,19 +8,24 @@
 #ifndef XMLDEFS_HPP_
 #define XMLDEFS_HPP_
 
+#include <XmlNames.hpp>
+
 namespace ge {
 namespace Xml {
 
 typedef const std::string cString;
 
+/* Names are tokens from XmlNames.hpp, so they can be used in a switch */
+typedef Names::Name cName;
+
 // DOCUMENT TYPE
-cString DocumentType = "yaf";
+constexpr cName DocumentType = Names::Yaf;
 
 namespace Blocks {
-    cString Graph = "graph";
-    cString Node = "node";
-    cString NodeReference = "noderef";
-    cString Children = "children";
+    constexpr cName Graph = Names::Graph;
+    constexpr cName Node = Names::Node;
+    constexpr cName NodeReference = Names::NodeRef;
+    constexpr cName Children = Names::Children;
 
     namespace Errors {
         cString InvalidNodeRefID = "Children: Could not read node reference id.";
@@ -29,17 +34,17 @@ namespace Blocks {
 
 namespace Nodes
 {
-    cString RootNodeID = "rootid";
+    constexpr cName RootNodeID = Names::RootId;
 
     namespace Globals {
-        cString RootNode = "globals";
+        constexpr cName RootNode = Names::Globals;
 
         namespace Attributes {
-            cString Background = "background";
-            cString DrawMode = "drawmode";
-            cString Shading = "shading";
-            cString CullFace = "cullface";
-            cString CullOrder = "cullorder";
+            constexpr cName Background = Names::Background;
+            constexpr cName DrawMode = Names::DrawMode;
+            constexpr cName Shading = Names::Shading;
+            constexpr cName CullFace = Names::CullFace;
+            constexpr cName CullOrder = Names::CullOrder;
         }
 
         namespace Values {
@@ -67,16 +72,16 @@ namespace Nodes
     }
 
     namespace Animations {
-        cString RootNode = "animations";
-        cString NodeReference = "animationref";
-        cString Animation = "animation";
+        constexpr cName RootNode = Names::Animations;
+        constexpr cName NodeReference = Names::AnimationRef;
+        constexpr cName Animation = Names::Animation;
 
         namespace Attributes {
-            cString Span = "span";
-            cString Type = "type";
-            cString x = "xx";
-            cString y = "yy";
-            cString z = "zz";
+            constexpr cName Span = Names::Span;
+            constexpr cName Type = Names::Type;
+            constexpr cName x = Names::XX;
+            constexpr cName y = Names::YY;
+            constexpr cName z = Names::ZZ;
         }
 
         namespace Errors {
@@ -94,54 +99,54 @@ namespace Nodes
     }
 
     namespace Appearances {
-        cString RootNode = "appearances";
-        cString NodeReference = "appearanceref";
-
-        cString Appearance = "appearance";
-        cString Rectangle = "rectangle";
-        cString Triangle = "triangle";
-        cString Cylinder = "cylinder";
-        cString Sphere = "sphere";
-        cString Torus = "torus";
-        cString Plane = "plane";
-        cString Patch = "patch";
-        cString Vehicle = "vehicle";
-        cString WaterLine = "waterline";
-        cString ControlPoint = "controlpoint";
+        constexpr cName RootNode = Names::Appearances;
+        constexpr cName NodeReference = Names::AppearanceRef;
+
+        constexpr cName Appearance = Names::Appearance;
+        constexpr cName Rectangle = Names::Rectangle;
+        constexpr cName Triangle = Names::Triangle;
+        constexpr cName Cylinder = Names::Cylinder;
+        constexpr cName Sphere = Names::Sphere;
+        constexpr cName Torus = Names::Torus;
+        constexpr cName Plane = Names::Plane;
+        constexpr cName Patch = Names::Patch;
+        constexpr cName Vehicle = Names::Vehicle;
+        constexpr cName WaterLine = Names::WaterLine;
+        constexpr cName ControlPoint = Names::ControlPoint;
 
         namespace Attributes {
-            cString Angle = "angle";
-            cString xy1 = "xy1";
-            cString xy2 = "xy2";
-            cString xyz1 = "xyz1";
-            cString xyz2 = "xyz2";
-            cString xyz3 = "xyz3";
-            cString Base = "base";
-            cString Top = "top";
-            cString Height = "height";
-            cString Slices = "slices";
-            cString Stacks = "stacks";
-            cString Radius = "radius";
-            cString Inner = "inner";
-            cString Outer = "outer";
-            cString Loops = "loops";
-            cString Parts = "parts";
-            cString Order = "order";
-            cString PartsU = "partsU";
-            cString PartsV = "partsV";
-            cString Compute = "compute";
-            cString x = "x";
-            cString y = "y";
-            cString z = "z";
-            cString HeightMap = "heightmap";
-            cString TextureMap = "texturemap";
-            cString FragmentShader = "fragmentshader";
-            cString VertexShader = "vertexshader";
-            cString Emissive = "emissive";
-            cString Ambient = "ambient";
-            cString Diffuse = "diffuse";
-            cString Specular = "specular";
-            cString Shininess = "shininess";
+            constexpr cName Angle = Names::Angle;
+            constexpr cName xy1 = Names::XY1;
+            constexpr cName xy2 = Names::XY2;
+            constexpr cName xyz1 = Names::XYZ1;
+            constexpr cName xyz2 = Names::XYZ2;
+            constexpr cName xyz3 = Names::XYZ3;
+            constexpr cName Base = Names::Base;
+            constexpr cName Top = Names::Top;
+            constexpr cName Height = Names::Height;
+            constexpr cName Slices = Names::Slices;
+            constexpr cName Stacks = Names::Stacks;
+            constexpr cName Radius = Names::Radius;
+            constexpr cName Inner = Names::Inner;
+            constexpr cName Outer = Names::Outer;
+            constexpr cName Loops = Names::Loops;
+            constexpr cName Parts = Names::Parts;
+            constexpr cName Order = Names::Order;
+            constexpr cName PartsU = Names::PartsU;
+            constexpr cName PartsV = Names::PartsV;
+            constexpr cName Compute = Names::Compute;
+            constexpr cName x = Names::X;
+            constexpr cName y = Names::Y;
+            constexpr cName z = Names::Z;
+            constexpr cName HeightMap = Names::HeightMap;
+            constexpr cName TextureMap = Names::TextureMap;
+            constexpr cName FragmentShader = Names::FragmentShader;
+            constexpr cName VertexShader = Names::VertexShader;
+            constexpr cName Emissive = Names::Emissive;
+            constexpr cName Ambient = Names::Ambient;
+            constexpr cName Diffuse = Names::Diffuse;
+            constexpr cName Specular = Names::Specular;
+            constexpr cName Shininess = Names::Shininess;
         }
 
         namespace Errors {
@@ -158,21 +163,21 @@ namespace Nodes
     }
 
     namespace Cameras {
-        cString RootNode = "cameras";
-        cString Perspective = "perspective";
-        cString Ortho = "ortho";
+        constexpr cName RootNode = Names::Cameras;
+        constexpr cName Perspective = Names::Perspective;
+        constexpr cName Ortho = Names::Ortho;
 
         namespace Attributes {
-            cString InitialCamera = "initial";
-            cString Near = "near";
-            cString Far = "far";
-            cString Position = "pos";
-            cString Target = "target";
-            cString Angle = "angle";
-            cString Left = "left";
-            cString Right = "right";
-            cString Top = "top";
-            cString Bottom = "bottom";
+            constexpr cName InitialCamera = Names::Initial;
+            constexpr cName Near = Names::Near;
+            constexpr cName Far = Names::Far;
+            constexpr cName Position = Names::Pos;
+            constexpr cName Target = Names::Target;
+            constexpr cName Angle = Names::Angle;
+            constexpr cName Left = Names::Left;
+            constexpr cName Right = Names::Right;
+            constexpr cName Top = Names::Top;
+            constexpr cName Bottom = Names::Bottom;
         }
 
         namespace Errors {
@@ -191,34 +196,38 @@ namespace Nodes
     }
 
     namespace DisplayLists {
-        cString RootNode  = "displaylist";
+        constexpr cName RootNode = Names::DisplayList;
+    }
+
+    namespace StaticBatches {
+        constexpr cName RootNode = Names::StaticBatch;
     }
 
     namespace Lights {
-        cString RootNode = "lighting";
-        cString Omni = "omni";
-        cString Spot = "spot";
+        constexpr cName RootNode = Names::Lighting;
+        constexpr cName Omni = Names::Omni;
+        constexpr cName Spot = Names::Spot;
 
         namespace Attributes {
-            cString Angle = "angle";
-            cString DoubleSided = "doublesided";
-            cString Local = "local";
-            cString Location = "location";
-            cString Ambient = "ambient";
-            cString Diffuse = "diffuse";
-            cString Specular = "specular";
-            cString Exponent = "exponent";
-            cString Direction = "direction";
+            constexpr cName Angle = Names::Angle;
+            constexpr cName DoubleSided = Names::DoubleSided;
+            constexpr cName Local = Names::Local;
+            constexpr cName Location = Names::Location;
+            constexpr cName Ambient = Names::Ambient;
+            constexpr cName Diffuse = Names::Diffuse;
+            constexpr cName Specular = Names::Specular;
+            constexpr cName Exponent = Names::Exponent;
+            constexpr cName Direction = Names::Direction;
         }
     }
 
     namespace Textures {
-        cString RootNode = "textures";
+        constexpr cName RootNode = Names::Textures;
 
         namespace Attributes {
-            cString ID = "textureref";
-            cString LenghtS = "texlength_s";
-            cString LenghtT = "texlength_t";
+            constexpr cName ID = Names::TextureRef;
+            constexpr cName LenghtS = Names::TexLengthS;
+            constexpr cName LenghtT = Names::TexLengthT;
         }
 
         namespace Errors {
@@ -228,24 +237,24 @@ namespace Nodes
     }
 
     namespace Transforms {
-        cString RootNode = "transforms";
-        cString Translate = "translate";
-        cString Rotate = "rotate";
-        cString Scale = "scale";
+        constexpr cName RootNode = Names::Transforms;
+        constexpr cName Translate = Names::Translate;
+        constexpr cName Rotate = Names::Rotate;
+        constexpr cName Scale = Names::Scale;
 
         namespace Attributes {
-            cString To = "to";
-            cString Axis = "axis";
-            cString Factor = "factor";
+            constexpr cName To = Names::To;
+            constexpr cName Axis = Names::Axis;
+            constexpr cName Factor = Names::Factor;
         }
     }
 }
 
 namespace GenericAttributes
 {
-cString ID = "id";
-cString File = "file";
-cString Enabled = "enabled";
+constexpr cName ID = Names::Id;
+constexpr cName File = Names::File;
+constexpr cName Enabled = Names::Enabled;
 cString ValueTrue = "true";
 cString ValueFalse = "false";
 }
@@ -285,6 +294,8 @@ cString SECTION_GRAPH_ID =
         "Graph: Error while reading the node id.";
 cString ATTRIBUTE_NODE_DISPLAYLIST =
         "Graph: Error while reading the display list.";
+cString ATTRIBUTE_NODE_STATICBATCH =
+        "Graph: Error while reading the static batch.";
 cString ATTRIBUTE_TRANSFORM_FACTOR =
         "Transform: Error while reading the scale factors.";
 cString ATTRIBUTE_TRANSFORM_AXIS =
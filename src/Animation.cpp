@@ -11,6 +11,8 @@
 
 namespace ge {
 
+unsigned long Animation::lastVersion = 0;
+
 void Animation::updateDeltas() {
     if (deltaTimeSingleMove > 0) {
         double divisor = static_cast<double>(deltaTimeSingleMove);
@@ -64,6 +66,8 @@ Animation::Animation(const std::string& iId, float iSpan,
     this->hasEnded = true;
 
     this->deltaTimeSingleMove = 0;
+
+    this->version = ++lastVersion;
 }
 
 void Animation::insertPoint(xyzPointDouble in) {
@@ -118,6 +122,23 @@ unsigned long Animation::getDeltaTime() {
     return this->deltaTimeMillis;
 }
 
+bool Animation::hasSameDefinition(const Animation& other) {
+    if (span != other.span || type != other.type
+            || controlPoints.size() != other.controlPoints.size()) {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < controlPoints.size(); i++) {
+        if (controlPoints[i].x != other.controlPoints[i].x
+                || controlPoints[i].y != other.controlPoints[i].y
+                || controlPoints[i].z != other.controlPoints[i].z) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 std::string Animation::getID() {
     return this->id;
 }
@@ -148,6 +169,7 @@ void Animation::updateAnimation(unsigned long timePassed) {
                 /* Calculate new deltas */
                 updateDeltas();
                 updateAngles();
+                this->version = ++lastVersion;
 
                 /* Increment number of processed control points */
                 numberOfProcessedControlPoints++;
@@ -162,6 +184,7 @@ void Animation::updateAnimation(unsigned long timePassed) {
             x = x + dX;
             y = y + dY;
             z = z + dZ;
+            this->version = ++lastVersion;
         }
 
     }
@@ -172,6 +195,7 @@ void Animation::updateAnimation(unsigned long timePassed) {
 
         angleX = 0;
         angleZ = 0;
+        this->version = ++lastVersion;
     }
 }
 
@@ -184,6 +208,38 @@ void Animation::applyAnimation() {
     glTranslated(x, y, z);
 }
 
+/* Rotation about x, then about z, then the translation (the same order as applyAnimation) */
+void Animation::getAnimationMatrix(GLdouble* out) {
+    GLdouble radiansX = angleX * M_PI / 180.0;
+    GLdouble radiansZ = angleZ * M_PI / 180.0;
+    GLdouble cx = cos(radiansX), sx = sin(radiansX);
+    GLdouble cz = cos(radiansZ), sz = sin(radiansZ);
+
+    out[0] = cz;
+    out[1] = cx * sz;
+    out[2] = sx * sz;
+    out[3] = 0;
+
+    out[4] = -sz;
+    out[5] = cx * cz;
+    out[6] = sx * cz;
+    out[7] = 0;
+
+    out[8] = 0;
+    out[9] = -sx;
+    out[10] = cx;
+    out[11] = 0;
+
+    out[12] = out[0] * x + out[4] * y + out[8] * z;
+    out[13] = out[1] * x + out[5] * y + out[9] * z;
+    out[14] = out[2] * x + out[6] * y + out[10] * z;
+    out[15] = 1;
+}
+
+unsigned long Animation::getVersion() {
+    return this->version;
+}
+
 Animation::~Animation() {
 
 }
@@ -3,10 +3,12 @@
  *
  * Appearance class methods.
  */
+#include <algorithm>
 #include <iostream>
 
 #include <imagetools.hpp>
 #include <Appearance.hpp>
+#include <GLState.hpp>
 
 namespace ge {
 Appearance::Appearance(const std::string& iID, color iEmissive, color iAmbient,
@@ -18,6 +20,7 @@ Appearance::Appearance(const std::string& iID, color iEmissive, color iAmbient,
     setDiffuse(iDiffuse);
     setSpecular(iSpecular);
     setShininess(iShininess);
+    setColour(0, 0, 0, 0);
 
     this->isTextured = false;
 
@@ -40,6 +43,7 @@ Appearance::Appearance(const std::string& iID, color iEmissive, color iAmbient,
     setDiffuse(iDiffuse);
     setSpecular(iSpecular);
     setShininess(iShininess);
+    setColour(0, 0, 0, 0);
 
     this->isTextured = true;
 
@@ -53,21 +57,21 @@ Appearance::Appearance(const std::string& iID, color iEmissive, color iAmbient,
 
 void Appearance::apply() {
 
-    glDisable(GL_COLOR_MATERIAL);
-    glMaterialf(GL_FRONT, GL_SHININESS, this->shininess);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, this->specular);
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, this->diffuse);
-    glMaterialfv(GL_FRONT, GL_AMBIENT, this->ambient);
+    GLState::disable(GL_COLOR_MATERIAL);
+    GLState::material(GL_FRONT, GL_SHININESS, this->shininess);
+    GLState::material(GL_FRONT, GL_SPECULAR, this->specular);
+    GLState::material(GL_FRONT, GL_DIFFUSE, this->diffuse);
+    GLState::material(GL_FRONT, GL_AMBIENT, this->ambient);
 
     if (texture != nullptr) {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        glEnable(GL_TEXTURE_2D);
+        GLState::blendFunc(GL_SRC_ALPHA, GL_ONE);
+        GLState::enable(GL_TEXTURE_2D);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->sWrap);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->tWrap);
         this->texture->apply();
 
     } else {
-        glDisable(GL_TEXTURE_2D);
+        GLState::disable(GL_TEXTURE_2D);
 
     }
 }
@@ -145,6 +149,14 @@ void Appearance::setTexture(Texture* input) {
     }
 } // FOR PRELOADED TEXTURES
 
+Texture* Appearance::getTexture() {
+    return this->texture;
+}
+
+void Appearance::clearTexture() {
+    this->texture = nullptr;
+}
+
 void Appearance::setTextureWrap(GLfloat iS, GLfloat iT) {
     this->sWrap = iS;
     this->tWrap = iT;
@@ -166,6 +178,17 @@ GLdouble Appearance::getTextureTWrap() {
     return this->tWrap;
 }
 
+bool Appearance::hasSameValues(const Appearance& other) {
+    return std::equal(emissive, emissive + 4, other.emissive)
+            && std::equal(ambient, ambient + 4, other.ambient)
+            && std::equal(diffuse, diffuse + 4, other.diffuse)
+            && std::equal(specular, specular + 4, other.specular)
+            && std::equal(colour, colour + 4, other.colour)
+            && shininess == other.shininess && isTextured == other.isTextured
+            && textureRef == other.textureRef && sWrap == other.sWrap
+            && tWrap == other.tWrap;
+}
+
 Appearance::~Appearance() {
 
 }
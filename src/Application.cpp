@@ -178,6 +178,12 @@ void Application::callBack(int control) {
 /* Calls scene display function. */
 void Application::display(void) {
     scene->display();
+
+    /* --load-report only needs the first frame */
+    if (LoadProfiler::isEnabled()) {
+        LoadProfiler::report(std::cout);
+        exit(0);
+    }
 }
 
 void Application::processMouse(int button, int state, int x, int y) {
@@ -270,6 +276,60 @@ void Application::keyboard(unsigned char key, int x, int y) {
             snapshot();
             break;
 
+        case 'r':
+            scene->reload();
+            glutPostRedisplay();
+            break;
+
+        case 't':
+            scene->printTextureStatistics(std::cout);
+            break;
+
+        case 'c':
+            scene->printDrawStatistics(std::cout);
+            break;
+
+        case 'f':
+            std::cout << "Frustum culling "
+                    << (scene->toggleCulling() ? "on." : "off.") << std::endl;
+            glutPostRedisplay();
+            break;
+
+        case 'h':
+            std::cout << "Occlusion culling "
+                    << (scene->toggleOcclusionCulling() ? "on." : "off.")
+                    << std::endl;
+            glutPostRedisplay();
+            break;
+
+        case 'o':
+            std::cout << "Render queue sorting "
+                    << (scene->toggleSorting() ? "on." : "off.") << std::endl;
+            glutPostRedisplay();
+            break;
+
+        case 'i':
+            std::cout << "Instanced drawing "
+                    << (scene->toggleInstancing() ? "on." : "off.")
+                    << std::endl;
+            glutPostRedisplay();
+            break;
+
+        case 'l':
+            std::cout << "Level of detail "
+                    << (scene->toggleLevelOfDetail() ? "on." : "off.")
+                    << std::endl;
+            glutPostRedisplay();
+            break;
+
+        case '+':
+        case '-':
+            std::cout << "Level of detail bias "
+                    << scene->changeLodBias(key == '+' ? 0.5 : -0.5) << "."
+                    << std::endl;
+            glutPostRedisplay();
+            break;
+
             /* Vehicle control */
         case 'w':
             scene->moveVehicleFront();
@@ -348,6 +408,9 @@ void Application::glutIdle(void) {
 }
 
 void Application::geUpdate(int value) {
+    /* Pick up edits to the scene file */
+    scene->reloadIfModified();
+
     /* Call the scene update method */
     scene->update(value);
 
@@ -0,0 +1,556 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Compiled binary scene format (yafb) methods.
+ */
+
+#include <BinaryScene.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+namespace ge {
+namespace Binary {
+
+/* Sections start aligned to 8 bytes so that doubles can be read in place */
+const uint64_t SectionAlignment = 8;
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+}
+
+/* Offsets are left out, they depend on everything else in the file */
+uint64_t hashPrimitives(const PrimitiveRecord* primitives, uint32_t count,
+        const PointRecord* points, const char* strings) {
+    ContentHash hash;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const PrimitiveRecord& primitive = primitives[i];
+        hash.addValue(primitive.type);
+        hash.addValue(primitive.values);
+        hash.addValue(primitive.integers);
+
+        for (unsigned int s = 0; s < 4; s++) {
+            if (primitive.strings[s] != NoString) {
+                hash.add(std::string(strings + primitive.strings[s]));
+            }
+        }
+
+        hash.addValue(primitive.pointCount);
+        hash.add(points + primitive.firstPoint,
+                primitive.pointCount * sizeof(PointRecord));
+    }
+
+    return hash.get();
+}
+
+/******************** WRITER ********************/
+SceneImageWriter::SceneImageWriter() {
+    std::memset(&globals, 0, sizeof(globals));
+    globals.drawMode = NoString;
+    globals.shadingMode = NoString;
+    globals.cullFace = NoString;
+    globals.cullOrder = NoString;
+    globals.initialCamera = NoString;
+    globals.rootId = NoString;
+
+    this->nodeOpen = false;
+}
+
+SceneImageWriter::~SceneImageWriter() {
+
+}
+
+uint32_t SceneImageWriter::addString(const std::string& in) {
+    auto interned = internedStrings.find(in);
+    if (interned != internedStrings.end()) {
+        return interned->second;
+    }
+
+    uint32_t offset = static_cast<uint32_t>(stringTable.size());
+    stringTable.insert(stringTable.end(), in.begin(), in.end());
+    stringTable.push_back('\0');
+
+    internedStrings.emplace(in, offset);
+    return offset;
+}
+
+GlobalsRecord& SceneImageWriter::getGlobals() {
+    return this->globals;
+}
+
+void SceneImageWriter::addCamera(const CameraRecord& in) {
+    cameras.push_back(in);
+}
+
+void SceneImageWriter::addLight(const LightRecord& in) {
+    lights.push_back(in);
+}
+
+void SceneImageWriter::addTexture(const std::string& id,
+        const std::string& file) {
+    TextureRecord record;
+    record.id = addString(id);
+    record.file = addString(file);
+    textures.push_back(record);
+}
+
+void SceneImageWriter::addAppearance(const AppearanceRecord& in) {
+    appearances.push_back(in);
+}
+
+void SceneImageWriter::setLastAppearanceTexture(const std::string& textureId,
+        float texlengthS, float texlengthT) {
+    appearances.back().textureRef = addString(textureId);
+    appearances.back().texlengthS = texlengthS;
+    appearances.back().texlengthT = texlengthT;
+}
+
+void SceneImageWriter::beginAnimation(const std::string& id, float span,
+        uint32_t type) {
+    AnimationRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.id = addString(id);
+    record.type = type;
+    record.span = span;
+    record.firstPoint = static_cast<uint32_t>(points.size());
+    record.pointCount = 0;
+    animations.push_back(record);
+}
+
+void SceneImageWriter::addAnimationPoint(double x, double y, double z) {
+    PointRecord point = { x, y, z };
+    points.push_back(point);
+    animations.back().pointCount++;
+}
+
+void SceneImageWriter::beginNode(const std::string& id, bool displayList,
+        bool displayListAuto, bool staticBatch) {
+    NodeRecord record;
+    record.id = addString(id);
+    record.flags = (displayList ? NodeDisplayList : 0)
+            | (displayListAuto ? NodeDisplayListAuto : 0)
+            | (staticBatch ? NodeStaticBatch : 0);
+    record.appearanceRef = NoString;
+    record.animationRef = NoString;
+    record.firstTransform = static_cast<uint32_t>(transforms.size());
+    record.transformCount = 0;
+    record.firstPrimitive = static_cast<uint32_t>(primitives.size());
+    record.primitiveCount = 0;
+    record.firstChild = 0;
+    record.childCount = 0;
+
+    nodes.push_back(record);
+    nodeChildrenIds.push_back(std::vector<uint32_t>());
+    this->nodeOpen = true;
+}
+
+void SceneImageWriter::setNodeAppearance(const std::string& appearanceId) {
+    nodes.back().appearanceRef = addString(appearanceId);
+}
+
+void SceneImageWriter::setNodeAnimation(const std::string& animationId) {
+    nodes.back().animationRef = addString(animationId);
+}
+
+void SceneImageWriter::addNodeTransform(const TransformRecord& in) {
+    transforms.push_back(in);
+    nodes.back().transformCount++;
+}
+
+void SceneImageWriter::addNodePrimitive(const PrimitiveRecord& in) {
+    primitives.push_back(in);
+    primitives.back().firstPoint = static_cast<uint32_t>(points.size());
+    primitives.back().pointCount = 0;
+    nodes.back().primitiveCount++;
+}
+
+void SceneImageWriter::addPrimitivePoint(double x, double y, double z) {
+    PointRecord point = { x, y, z };
+    points.push_back(point);
+    primitives.back().pointCount++;
+}
+
+void SceneImageWriter::addNodeChild(const std::string& nodeId) {
+    nodeChildrenIds.back().push_back(addString(nodeId));
+}
+
+void SceneImageWriter::endNode() {
+    this->nodeOpen = false;
+}
+
+uint64_t SceneImageWriter::getNodePrimitivesHash() {
+    const NodeRecord& node = nodes.back();
+    return hashPrimitives(primitives.data() + node.firstPrimitive,
+            node.primitiveCount, points.data(), stringTable.data());
+}
+
+bool SceneImageWriter::write(const std::string& fileName,
+        int64_t sourceModificationTime, uint64_t sourceSize) {
+    if (this->nodeOpen) {
+        return false;
+    }
+
+    /* Resolve children ids to node indexes, unknown ids are refused like the xml loader does */
+    std::unordered_map<uint32_t, uint32_t> nodeIndexById;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        nodeIndexById.emplace(nodes[i].id, i);
+    }
+
+    std::vector<uint32_t> children;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        nodes[i].firstChild = static_cast<uint32_t>(children.size());
+        for (auto childId : nodeChildrenIds[i]) {
+            auto childIndex = nodeIndexById.find(childId);
+            if (childIndex == nodeIndexById.end()) {
+                return false;
+            }
+            children.push_back(childIndex->second);
+        }
+        nodes[i].childCount = static_cast<uint32_t>(children.size())
+                - nodes[i].firstChild;
+    }
+
+    /* Lay out the sections */
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = Magic;
+    header.version = Version;
+    header.byteOrder = ByteOrderMark;
+    header.headerSize = sizeof(Header);
+    header.sourceModificationTime = sourceModificationTime;
+    header.sourceSize = sourceSize;
+
+    const void* sectionData[SectionCount];
+    uint64_t offset = alignOffset(sizeof(Header));
+
+    auto layout = [&](Section section, const void* data, std::size_t count,
+            std::size_t elementSize) {
+        header.sections[section].offset = offset;
+        header.sections[section].count = static_cast<uint32_t>(count);
+        header.sections[section].elementSize = static_cast<uint32_t>(elementSize);
+        sectionData[section] = data;
+        offset = alignOffset(offset + count * elementSize);
+    };
+
+    layout(SectionStrings, stringTable.data(), stringTable.size(), 1);
+    layout(SectionGlobals, &globals, 1, sizeof(GlobalsRecord));
+    layout(SectionCameras, cameras.data(), cameras.size(), sizeof(CameraRecord));
+    layout(SectionLights, lights.data(), lights.size(), sizeof(LightRecord));
+    layout(SectionTextures, textures.data(), textures.size(),
+            sizeof(TextureRecord));
+    layout(SectionAppearances, appearances.data(), appearances.size(),
+            sizeof(AppearanceRecord));
+    layout(SectionAnimations, animations.data(), animations.size(),
+            sizeof(AnimationRecord));
+    layout(SectionNodes, nodes.data(), nodes.size(), sizeof(NodeRecord));
+    layout(SectionTransforms, transforms.data(), transforms.size(),
+            sizeof(TransformRecord));
+    layout(SectionPrimitives, primitives.data(), primitives.size(),
+            sizeof(PrimitiveRecord));
+    layout(SectionPoints, points.data(), points.size(), sizeof(PointRecord));
+    layout(SectionChildren, children.data(), children.size(),
+            sizeof(uint32_t));
+
+    /* Write to a temporary file first so that a running instance never maps a half written image */
+    std::string temporaryFileName = fileName + ".tmp";
+    FILE* file = fopen(temporaryFileName.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool writeOk = fwrite(&header, sizeof(Header), 1, file) == 1;
+    uint64_t written = sizeof(Header);
+    const char padding[SectionAlignment] = { 0 };
+
+    for (unsigned int i = 0; i < SectionCount && writeOk; i++) {
+        const SectionEntry& entry = header.sections[i];
+        uint64_t length = static_cast<uint64_t>(entry.count) * entry.elementSize;
+
+        if (entry.offset > written) {
+            std::size_t padLength = static_cast<std::size_t>(entry.offset - written);
+            writeOk = fwrite(padding, 1, padLength, file) == padLength;
+            written = entry.offset;
+        }
+
+        if (writeOk && length > 0) {
+            writeOk = fwrite(sectionData[i], 1, static_cast<std::size_t>(length),
+                    file) == length;
+            written = written + length;
+        }
+    }
+
+    writeOk = (fclose(file) == 0) && writeOk;
+
+    if (!writeOk || std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+        std::remove(temporaryFileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/******************** READER ********************/
+SceneImage::SceneImage() {
+    this->header = nullptr;
+}
+
+SceneImage::~SceneImage() {
+
+}
+
+const void* SceneImage::getSection(Section section, uint32_t elementSize,
+        uint32_t& count) {
+    const SectionEntry& entry = header->sections[section];
+
+    if (entry.elementSize != elementSize) {
+        count = 0;
+        return nullptr;
+    }
+
+    count = entry.count;
+    return file.getData() + entry.offset;
+}
+
+bool SceneImage::open(const std::string& fileName,
+        int64_t sourceModificationTime, uint64_t sourceSize, bool checkSource) {
+    this->header = nullptr;
+
+    if (!file.open(fileName) || file.getSize() < sizeof(Header)) {
+        return false;
+    }
+
+    const Header* candidate = reinterpret_cast<const Header*>(file.getData());
+
+    if (candidate->magic != Magic || candidate->version != Version
+            || candidate->byteOrder != ByteOrderMark
+            || candidate->headerSize != sizeof(Header)) {
+        file.close();
+        return false;
+    }
+
+    /* Invalidate the cache if the yaf file changed since it was compiled */
+    if (checkSource
+            && (candidate->sourceModificationTime != sourceModificationTime
+                    || candidate->sourceSize != sourceSize)) {
+        file.close();
+        return false;
+    }
+
+    const uint32_t elementSizes[SectionCount] = { 1, sizeof(GlobalsRecord),
+            sizeof(CameraRecord), sizeof(LightRecord), sizeof(TextureRecord),
+            sizeof(AppearanceRecord), sizeof(AnimationRecord),
+            sizeof(NodeRecord), sizeof(TransformRecord),
+            sizeof(PrimitiveRecord), sizeof(PointRecord), sizeof(uint32_t) };
+
+    for (unsigned int i = 0; i < SectionCount; i++) {
+        const SectionEntry& entry = candidate->sections[i];
+        uint64_t end = entry.offset
+                + static_cast<uint64_t>(entry.count) * entry.elementSize;
+
+        if (entry.elementSize != elementSizes[i]
+                || entry.offset % SectionAlignment != 0 || end > file.getSize()
+                || end < entry.offset) {
+            file.close();
+            return false;
+        }
+    }
+
+    this->header = candidate;
+
+    /* Validate every cross reference once, so that the loader can trust the image */
+    uint32_t stringCount, globalsCount, cameraCount, lightCount, textureCount,
+            appearanceCount, animationCount, nodeCount, transformCount,
+            primitiveCount, pointCount, childCount;
+
+    const char* strings = static_cast<const char*>(getSection(SectionStrings, 1,
+            stringCount));
+    getSection(SectionGlobals, sizeof(GlobalsRecord), globalsCount);
+    const CameraRecord* cameraRecords = getCameras(cameraCount);
+    const LightRecord* lightRecords = getLights(lightCount);
+    const TextureRecord* textureRecords = getTextures(textureCount);
+    const AppearanceRecord* appearanceRecords = getAppearances(appearanceCount);
+    const AnimationRecord* animationRecords = getAnimations(animationCount);
+    const NodeRecord* nodeRecords = getNodes(nodeCount);
+    const TransformRecord* transformRecords = getTransforms(transformCount);
+    const PrimitiveRecord* primitiveRecords = getPrimitives(primitiveCount);
+    getPoints(pointCount);
+    const uint32_t* childRecords = getChildren(childCount);
+
+    auto validString = [&](uint32_t offset, bool optional) {
+        return (optional && offset == NoString) || offset < stringCount;
+    };
+
+    auto validRange = [](uint32_t first, uint32_t count, uint32_t total) {
+        return first <= total && count <= total - first;
+    };
+
+    bool valid = globalsCount == 1 && stringCount > 0
+            && strings[stringCount - 1] == '\0';
+
+    if (valid) {
+        const GlobalsRecord* globals = getGlobals();
+        valid = validString(globals->drawMode, false)
+                && validString(globals->shadingMode, false)
+                && validString(globals->cullFace, false)
+                && validString(globals->cullOrder, false)
+                && validString(globals->initialCamera, false)
+                && validString(globals->rootId, false);
+    }
+
+    for (uint32_t i = 0; valid && i < cameraCount; i++) {
+        valid = validString(cameraRecords[i].id, false)
+                && cameraRecords[i].type <= CameraOrtho;
+    }
+
+    for (uint32_t i = 0; valid && i < lightCount; i++) {
+        valid = validString(lightRecords[i].id, false)
+                && lightRecords[i].type <= LightSpot;
+    }
+
+    for (uint32_t i = 0; valid && i < textureCount; i++) {
+        valid = validString(textureRecords[i].id, false)
+                && validString(textureRecords[i].file, false);
+    }
+
+    for (uint32_t i = 0; valid && i < appearanceCount; i++) {
+        valid = validString(appearanceRecords[i].id, false)
+                && validString(appearanceRecords[i].textureRef, true);
+    }
+
+    for (uint32_t i = 0; valid && i < animationCount; i++) {
+        valid = validString(animationRecords[i].id, false)
+                && validRange(animationRecords[i].firstPoint,
+                        animationRecords[i].pointCount, pointCount);
+    }
+
+    for (uint32_t i = 0; valid && i < nodeCount; i++) {
+        const NodeRecord& node = nodeRecords[i];
+        valid = validString(node.id, false)
+                && validString(node.appearanceRef, true)
+                && validString(node.animationRef, true)
+                && validRange(node.firstTransform, node.transformCount,
+                        transformCount)
+                && validRange(node.firstPrimitive, node.primitiveCount,
+                        primitiveCount)
+                && validRange(node.firstChild, node.childCount, childCount);
+    }
+
+    for (uint32_t i = 0; valid && i < transformCount; i++) {
+        valid = transformRecords[i].type <= TransformTypeScale
+                && transformRecords[i].axis >= 0
+                && transformRecords[i].axis <= 2;
+    }
+
+    for (uint32_t i = 0; valid && i < primitiveCount; i++) {
+        const PrimitiveRecord& primitive = primitiveRecords[i];
+        valid = primitive.type <= PrimitiveWaterLine
+                && validRange(primitive.firstPoint, primitive.pointCount,
+                        pointCount);
+
+        if (valid && primitive.type == PrimitiveWaterLine) {
+            for (unsigned int j = 0; j < 4 && valid; j++) {
+                valid = validString(primitive.strings[j], false);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; valid && i < childCount; i++) {
+        valid = childRecords[i] < nodeCount;
+    }
+
+    if (!valid) {
+        this->header = nullptr;
+        file.close();
+        return false;
+    }
+
+    return true;
+}
+
+const char* SceneImage::getString(uint32_t offset) {
+    return getStrings() + offset;
+}
+
+const char* SceneImage::getStrings() {
+    uint32_t count;
+    return static_cast<const char*>(getSection(SectionStrings, 1, count));
+}
+
+const GlobalsRecord* SceneImage::getGlobals() {
+    uint32_t count;
+    return static_cast<const GlobalsRecord*>(getSection(SectionGlobals,
+            sizeof(GlobalsRecord), count));
+}
+
+const CameraRecord* SceneImage::getCameras(uint32_t& count) {
+    return static_cast<const CameraRecord*>(getSection(SectionCameras,
+            sizeof(CameraRecord), count));
+}
+
+const LightRecord* SceneImage::getLights(uint32_t& count) {
+    return static_cast<const LightRecord*>(getSection(SectionLights,
+            sizeof(LightRecord), count));
+}
+
+const TextureRecord* SceneImage::getTextures(uint32_t& count) {
+    return static_cast<const TextureRecord*>(getSection(SectionTextures,
+            sizeof(TextureRecord), count));
+}
+
+const AppearanceRecord* SceneImage::getAppearances(uint32_t& count) {
+    return static_cast<const AppearanceRecord*>(getSection(SectionAppearances,
+            sizeof(AppearanceRecord), count));
+}
+
+const AnimationRecord* SceneImage::getAnimations(uint32_t& count) {
+    return static_cast<const AnimationRecord*>(getSection(SectionAnimations,
+            sizeof(AnimationRecord), count));
+}
+
+const NodeRecord* SceneImage::getNodes(uint32_t& count) {
+    return static_cast<const NodeRecord*>(getSection(SectionNodes,
+            sizeof(NodeRecord), count));
+}
+
+const TransformRecord* SceneImage::getTransforms(uint32_t& count) {
+    return static_cast<const TransformRecord*>(getSection(SectionTransforms,
+            sizeof(TransformRecord), count));
+}
+
+const PrimitiveRecord* SceneImage::getPrimitives(uint32_t& count) {
+    return static_cast<const PrimitiveRecord*>(getSection(SectionPrimitives,
+            sizeof(PrimitiveRecord), count));
+}
+
+const PointRecord* SceneImage::getPoints(uint32_t& count) {
+    return static_cast<const PointRecord*>(getSection(SectionPoints,
+            sizeof(PointRecord), count));
+}
+
+const uint32_t* SceneImage::getChildren(uint32_t& count) {
+    return static_cast<const uint32_t*>(getSection(SectionChildren,
+            sizeof(uint32_t), count));
+}
+
+std::string getCacheFileName(const std::string& yafFileName) {
+    const std::string yafExtension = ".yaf";
+
+    if (yafFileName.size() > yafExtension.size()
+            && yafFileName.compare(yafFileName.size() - yafExtension.size(),
+                    yafExtension.size(), yafExtension) == 0) {
+        return yafFileName.substr(0, yafFileName.size() - yafExtension.size())
+                + FileExtension;
+    }
+
+    return yafFileName + FileExtension;
+}
+
+bool isCompiledSceneFileName(const std::string& fileName) {
+    return fileName.size() > FileExtension.size()
+            && fileName.compare(fileName.size() - FileExtension.size(),
+                    FileExtension.size(), FileExtension) == 0;
+}
+
+}
+}
@@ -0,0 +1,93 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Bounding box methods.
+ */
+
+#include <BoundingBox.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ge {
+
+BoundingBox::BoundingBox() {
+    setEmpty();
+}
+
+void BoundingBox::setEmpty() {
+    for (int i = 0; i < 3; i++) {
+        this->min[i] = HUGE_VAL;
+        this->max[i] = -HUGE_VAL;
+    }
+    this->unbounded = false;
+}
+
+void BoundingBox::setUnbounded() {
+    for (int i = 0; i < 3; i++) {
+        this->min[i] = -HUGE_VAL;
+        this->max[i] = HUGE_VAL;
+    }
+    this->unbounded = true;
+}
+
+bool BoundingBox::isEmpty() const {
+    return !unbounded && min[0] > max[0];
+}
+
+void BoundingBox::merge(GLdouble x, GLdouble y, GLdouble z) {
+    if (unbounded) {
+        return;
+    }
+
+    min[0] = std::min(min[0], x);
+    min[1] = std::min(min[1], y);
+    min[2] = std::min(min[2], z);
+    max[0] = std::max(max[0], x);
+    max[1] = std::max(max[1], y);
+    max[2] = std::max(max[2], z);
+}
+
+void BoundingBox::merge(const BoundingBox& other) {
+    if (other.unbounded) {
+        setUnbounded();
+        return;
+    }
+
+    if (other.isEmpty()) {
+        return;
+    }
+
+    merge(other.min[0], other.min[1], other.min[2]);
+    merge(other.max[0], other.max[1], other.max[2]);
+}
+
+/* Center and half size, the new half size adds up the absolute matrix columns */
+void BoundingBox::transform(const GLdouble* matrix, BoundingBox& out) const {
+    if (unbounded || isEmpty()) {
+        out = *this;
+        return;
+    }
+
+    GLdouble center[3], extent[3];
+    for (int i = 0; i < 3; i++) {
+        center[i] = (min[i] + max[i]) * 0.5;
+        extent[i] = (max[i] - min[i]) * 0.5;
+    }
+
+    for (int row = 0; row < 3; row++) {
+        GLdouble newCenter = matrix[12 + row];
+        GLdouble newExtent = 0;
+
+        for (int column = 0; column < 3; column++) {
+            newCenter += matrix[column * 4 + row] * center[column];
+            newExtent += std::fabs(matrix[column * 4 + row]) * extent[column];
+        }
+
+        out.min[row] = newCenter - newExtent;
+        out.max[row] = newCenter + newExtent;
+    }
+    out.unbounded = false;
+}
+
+}
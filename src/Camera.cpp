@@ -6,7 +6,122 @@
 
 #include <Camera.hpp>
 
+#include <cmath>
+
 namespace ge {
+
+/* Column major helpers, each one matches the GL call it is named after */
+static void setIdentity(GLdouble* out) {
+    for (int i = 0; i < 16; i++) {
+        out[i] = (i % 5 == 0) ? 1 : 0;
+    }
+}
+
+/* matrix = matrix * right */
+static void multiplyBy(GLdouble* matrix, const GLdouble* right) {
+    GLdouble left[16];
+    for (int i = 0; i < 16; i++) {
+        left[i] = matrix[i];
+    }
+
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            matrix[column * 4 + row] = left[row] * right[column * 4]
+                    + left[4 + row] * right[column * 4 + 1]
+                    + left[8 + row] * right[column * 4 + 2]
+                    + left[12 + row] * right[column * 4 + 3];
+        }
+    }
+}
+
+static void frustum(GLdouble* out, GLdouble left, GLdouble right,
+        GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar) {
+    for (int i = 0; i < 16; i++) {
+        out[i] = 0;
+    }
+    out[0] = 2 * zNear / (right - left);
+    out[5] = 2 * zNear / (top - bottom);
+    out[8] = (right + left) / (right - left);
+    out[9] = (top + bottom) / (top - bottom);
+    out[10] = -(zFar + zNear) / (zFar - zNear);
+    out[11] = -1;
+    out[14] = -2 * zFar * zNear / (zFar - zNear);
+}
+
+static void ortho(GLdouble* out, GLdouble left, GLdouble right,
+        GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar) {
+    setIdentity(out);
+    out[0] = 2 / (right - left);
+    out[5] = 2 / (top - bottom);
+    out[10] = -2 / (zFar - zNear);
+    out[12] = -(right + left) / (right - left);
+    out[13] = -(top + bottom) / (top - bottom);
+    out[14] = -(zFar + zNear) / (zFar - zNear);
+}
+
+static void translateMatrix(GLdouble* matrix, GLdouble x, GLdouble y,
+        GLdouble z) {
+    GLdouble translation[16];
+    setIdentity(translation);
+    translation[12] = x;
+    translation[13] = y;
+    translation[14] = z;
+    multiplyBy(matrix, translation);
+}
+
+/* Around one of the x, y, z axes */
+static void rotateMatrix(GLdouble* matrix, GLdouble degrees, int axis) {
+    GLdouble radians = degrees * M_PI / 180.0;
+    GLdouble c = cos(radians), s = sin(radians);
+    int a = (axis + 1) % 3, b = (axis + 2) % 3;
+
+    GLdouble rotation[16];
+    setIdentity(rotation);
+    rotation[a * 4 + a] = c;
+    rotation[a * 4 + b] = s;
+    rotation[b * 4 + a] = -s;
+    rotation[b * 4 + b] = c;
+    multiplyBy(matrix, rotation);
+}
+
+static void normalize(GLdouble* vector) {
+    GLdouble length = sqrt(
+            vector[0] * vector[0] + vector[1] * vector[1]
+                    + vector[2] * vector[2]);
+    if (length > 0) {
+        vector[0] /= length;
+        vector[1] /= length;
+        vector[2] /= length;
+    }
+}
+
+static void cross(const GLdouble* a, const GLdouble* b, GLdouble* out) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void lookAt(GLdouble* matrix, const GLdouble* eye,
+        const GLdouble* center, const GLdouble* up) {
+    GLdouble forward[3] = { center[0] - eye[0], center[1] - eye[1], center[2]
+            - eye[2] };
+    normalize(forward);
+
+    GLdouble side[3], newUp[3];
+    cross(forward, up, side);
+    normalize(side);
+    cross(side, forward, newUp);
+
+    GLdouble view[16];
+    setIdentity(view);
+    for (int i = 0; i < 3; i++) {
+        view[i * 4] = side[i];
+        view[i * 4 + 1] = newUp[i];
+        view[i * 4 + 2] = -forward[i];
+    }
+    multiplyBy(matrix, view);
+    translateMatrix(matrix, -eye[0], -eye[1], -eye[2]);
+}
 CameraInterface::CameraInterface() {
 
 }
@@ -74,6 +189,11 @@ void OrthoCamera::applyView(double) {
             this->geFar);
 }
 
+void OrthoCamera::getViewProjection(double, GLdouble* out) {
+    ortho(out, this->left, this->right, this->bottom, this->top, this->geNear,
+            this->geFar);
+}
+
 OrthoCamera::~OrthoCamera() {
 
 }
@@ -151,6 +271,30 @@ void PerspectiveCamera::applyView(double aspectRatio) {
     }
 }
 
+void PerspectiveCamera::getViewProjection(double aspectRatio, GLdouble* out) {
+    if (this->examineMode) {
+        frustum(out, -aspectRatio * .04, aspectRatio * .04, -.04, .04, .1,
+                500.0);
+
+        translateMatrix(out, position[0], position[1], position[2]);
+
+        rotateMatrix(out, rotation[0], 0);
+        rotateMatrix(out, rotation[1], 1);
+        rotateMatrix(out, rotation[2], 2);
+
+    } else {
+
+        /* gluPerspective is a symmetric frustum */
+        GLdouble top = this->geNear * tan(this->angle * M_PI / 360.0);
+        frustum(out, -top * aspectRatio, top * aspectRatio, -top, top,
+                this->geNear, this->geFar);
+
+        const GLdouble up[3] = { 0, 1, 0 };
+        lookAt(out, this->from, this->to, up);
+
+    }
+}
+
 void PerspectiveCamera::rotateTo(int axis, double angle) {
     if (axis >= 0 && axis <= 2) {
         if (rotation[axis] < angle) {
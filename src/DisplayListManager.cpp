@@ -0,0 +1,175 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Display list manager methods.
+ */
+
+#include <DisplayListManager.hpp>
+#include <GLState.hpp>
+#include <LoadProfiler.hpp>
+
+#include <algorithm>
+
+namespace ge {
+
+std::vector<DisplayListManager::List*> DisplayListManager::lists;
+
+unsigned long DisplayListManager::frame = 1;
+std::size_t DisplayListManager::budget = 64 * 1024 * 1024;
+unsigned int DisplayListManager::maxLists = 4096;
+unsigned int DisplayListManager::evictAfterFrames = 120;
+
+std::size_t DisplayListManager::usedBytes = 0;
+std::size_t DisplayListManager::peakUsedBytes = 0;
+std::size_t DisplayListManager::refusedBytes = 0;
+unsigned int DisplayListManager::refusedLists = 0;
+
+uint64_t DisplayListManager::compiles = 0;
+uint64_t DisplayListManager::evictions = 0;
+uint64_t DisplayListManager::refusals = 0;
+unsigned int DisplayListManager::calls = 0;
+unsigned int DisplayListManager::directDraws = 0;
+
+DisplayListManager::List::List() {
+    this->id = 0;
+    this->bytes = 0;
+    this->triangles = 0;
+    this->lastUsedFrame = 0;
+}
+
+bool DisplayListManager::fits(std::size_t bytes, unsigned int count) {
+    return usedBytes + bytes <= budget && lists.size() + count <= maxLists;
+}
+
+bool DisplayListManager::reserve(List& list, std::size_t bytes,
+        std::size_t triangles) {
+    release(list);
+
+    if (!fits(bytes, 1)) {
+        refusedBytes += bytes;
+        refusedLists++;
+        refusals++;
+        return false;
+    }
+
+    list.id = glGenLists(1);
+    if (list.id == 0) {
+        return false;
+    }
+
+    list.bytes = bytes;
+    list.triangles = triangles;
+    list.lastUsedFrame = frame;
+    list.textures.clear();
+    lists.push_back(&list);
+
+    usedBytes += bytes;
+    peakUsedBytes = std::max(peakUsedBytes, usedBytes);
+    compiles++;
+    LoadProfiler::count(LoadProfiler::CounterGLObjects);
+    return true;
+}
+
+void DisplayListManager::release(List& list) {
+    if (list.id == 0) {
+        return;
+    }
+
+    glDeleteLists(list.id, 1);
+    list.id = 0;
+    list.textures.clear();
+
+    auto found = std::find(lists.begin(), lists.end(), &list);
+    if (found != lists.end()) {
+        *found = lists.back();
+        lists.pop_back();
+    }
+    usedBytes -= list.bytes;
+    list.bytes = 0;
+    list.triangles = 0;
+}
+
+std::size_t DisplayListManager::call(List& list) {
+    for (auto texture : list.textures) {
+        texture->touch();
+    }
+    list.lastUsedFrame = frame;
+
+    glCallList(list.id);
+    calls++;
+
+    /* Whatever the list set, the cache did not see it */
+    GLState::invalidate();
+    return list.triangles;
+}
+
+void DisplayListManager::countDirectDraw() {
+    directDraws++;
+}
+
+void DisplayListManager::beginFrame() {
+    frame++;
+    calls = 0;
+    directDraws = 0;
+
+    if (refusedLists > 0) {
+        evict();
+    }
+    refusedBytes = 0;
+    refusedLists = 0;
+}
+
+/* Least recently called first, lists called recently are kept even if others are refused */
+void DisplayListManager::evict() {
+    std::vector<List*> candidates;
+    for (auto list : lists) {
+        if (frame - list->lastUsedFrame > evictAfterFrames) {
+            candidates.push_back(list);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](List* a, List* b) {
+        return a->lastUsedFrame < b->lastUsedFrame;
+    });
+
+    for (auto list : candidates) {
+        if (fits(refusedBytes, refusedLists)) {
+            break;
+        }
+
+        release(*list);
+        evictions++;
+    }
+}
+
+void DisplayListManager::setBudget(std::size_t bytes) {
+    budget = bytes;
+}
+
+void DisplayListManager::setMaxLists(unsigned int count) {
+    maxLists = count;
+}
+
+void DisplayListManager::setEvictAfterFrames(unsigned int frames) {
+    evictAfterFrames = frames;
+}
+
+unsigned int DisplayListManager::getNumberOfLists() {
+    return static_cast<unsigned int>(lists.size());
+}
+
+std::size_t DisplayListManager::getUsedBytes() {
+    return usedBytes;
+}
+
+void DisplayListManager::printStatistics(std::ostream& out) {
+    const double megabyte = 1024.0 * 1024.0;
+    out << "Display lists: " << lists.size() << " of " << maxLists << ", "
+            << usedBytes / megabyte << " MB (peak " << peakUsedBytes / megabyte
+            << " MB, budget " << budget / megabyte << " MB), " << compiles
+            << " compiles, " << evictions << " evictions, " << refusals
+            << " refused, last frame " << calls << " called and "
+            << directDraws << " drawn without their list." << std::endl;
+}
+
+}
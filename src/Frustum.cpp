@@ -0,0 +1,115 @@
+/*
+ * Eduardo Fernandes
+ *
+ * View frustum methods.
+ */
+
+#include <Frustum.hpp>
+
+#include <cmath>
+#include <limits>
+
+namespace ge {
+
+/* Nothing is culled until a matrix is set */
+Frustum::Frustum() {
+    for (int i = 0; i < 6; i++) {
+        planes[i][0] = 0;
+        planes[i][1] = 0;
+        planes[i][2] = 0;
+        planes[i][3] = 1;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        wRow[i] = i == 3 ? 1 : 0;
+    }
+    wScale = 0;
+    yScale = 0;
+    halfHeight = 0;
+}
+
+/* Gribb and Hartmann: each plane is the last row plus or minus another row */
+void Frustum::setMatrix(const GLdouble* viewProjection) {
+    for (int i = 0; i < 3; i++) {
+        for (int column = 0; column < 4; column++) {
+            GLdouble w = viewProjection[column * 4 + 3];
+            GLdouble value = viewProjection[column * 4 + i];
+
+            planes[i * 2][column] = w + value;
+            planes[i * 2 + 1][column] = w - value;
+        }
+    }
+
+    for (int column = 0; column < 4; column++) {
+        wRow[column] = viewProjection[column * 4 + 3];
+    }
+
+    /* Rows without the translation, the view itself does not scale */
+    const GLdouble* m = viewProjection;
+    wScale = sqrt(m[3] * m[3] + m[7] * m[7] + m[11] * m[11]);
+    yScale = sqrt(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]);
+}
+
+Frustum::Result Frustum::classify(const BoundingBox& box) const {
+    if (box.unbounded) {
+        return Intersecting;
+    }
+
+    if (box.isEmpty()) {
+        return Outside;
+    }
+
+    Result result = Inside;
+
+    for (int i = 0; i < 6; i++) {
+        const GLdouble* plane = planes[i];
+
+        /* Corners furthest along and against the plane normal */
+        GLdouble farthest = plane[3], nearest = plane[3];
+        for (int axis = 0; axis < 3; axis++) {
+            if (plane[axis] >= 0) {
+                farthest += plane[axis] * box.max[axis];
+                nearest += plane[axis] * box.min[axis];
+            } else {
+                farthest += plane[axis] * box.min[axis];
+                nearest += plane[axis] * box.max[axis];
+            }
+        }
+
+        if (farthest < 0) {
+            return Outside;
+        }
+
+        /* Written so a NaN (broken animation) ends up drawn */
+        if (!(nearest >= 0)) {
+            result = Intersecting;
+        }
+    }
+
+    return result;
+}
+
+GLdouble Frustum::getDepth(const GLdouble* point) const {
+    const GLdouble* nearPlane = planes[4];
+    return nearPlane[0] * point[0] + nearPlane[1] * point[1]
+            + nearPlane[2] * point[2] + nearPlane[3];
+}
+
+void Frustum::setViewportHeight(int height) {
+    halfHeight = height * 0.5;
+}
+
+/* Perspective divides by w, ortho keeps w at 1 */
+GLdouble Frustum::getPixelsPerUnit(const GLdouble* point,
+        GLdouble radius) const {
+    GLdouble w = wRow[0] * point[0] + wRow[1] * point[1] + wRow[2] * point[2]
+            + wRow[3] - radius * wScale;
+
+    if (!(w > 0) || halfHeight == 0) {
+        return std::numeric_limits<GLdouble>::infinity();
+    }
+
+    return yScale * halfHeight / w;
+}
+
+}
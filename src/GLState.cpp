@@ -0,0 +1,369 @@
+/*
+ * Eduardo Fernandes
+ *
+ * GL state cache methods.
+ */
+
+#include <GLState.hpp>
+
+#include <cstring>
+
+namespace ge {
+
+std::unordered_map<std::uint64_t, GLState::Known> GLState::capabilities;
+
+GLenum GLState::activeUnit = GL_TEXTURE0;
+bool GLState::activeUnitKnown = false;
+GLuint GLState::boundTextures[MaxTextureUnits];
+bool GLState::boundTexturesKnown[MaxTextureUnits];
+
+GLuint GLState::arrayBuffer = 0;
+GLuint GLState::elementBuffer = 0;
+GLuint GLState::vertexArray = 0;
+bool GLState::arrayBufferKnown = false;
+bool GLState::elementBufferKnown = false;
+bool GLState::vertexArrayKnown = false;
+
+GLuint GLState::program = 0;
+bool GLState::programKnown = false;
+
+GLenum GLState::blendSource = GL_ONE;
+GLenum GLState::blendDestination = GL_ZERO;
+bool GLState::blendKnown = false;
+
+GLfloat GLState::materials[2][MaterialParameters][4];
+bool GLState::materialsKnown[2][MaterialParameters];
+
+GLfloat GLState::lights[MAX_LIGHTS][LightParameters][4];
+bool GLState::lightsKnown[MAX_LIGHTS][LightParameters];
+
+unsigned int GLState::recording = 0;
+
+std::uint64_t GLState::issuedCalls = 0;
+std::uint64_t GLState::elidedCalls = 0;
+
+/* Index into the material shadow, -1 for names that are not shadowed */
+static int getMaterialIndex(GLenum name, unsigned int& size) {
+    size = 4;
+    switch (name) {
+        case GL_AMBIENT:
+            return 0;
+        case GL_DIFFUSE:
+            return 1;
+        case GL_SPECULAR:
+            return 2;
+        case GL_EMISSION:
+            return 3;
+        case GL_SHININESS:
+            size = 1;
+            return 4;
+        default:
+            return -1;
+    }
+}
+
+/* Index into the light shadow, -1 for names that are not shadowed */
+static int getLightIndex(GLenum name, unsigned int& size) {
+    size = 1;
+    switch (name) {
+        case GL_AMBIENT:
+            size = 4;
+            return 0;
+        case GL_DIFFUSE:
+            size = 4;
+            return 1;
+        case GL_SPECULAR:
+            size = 4;
+            return 2;
+        case GL_SPOT_EXPONENT:
+            return 3;
+        case GL_SPOT_CUTOFF:
+            return 4;
+        case GL_CONSTANT_ATTENUATION:
+            return 5;
+        case GL_LINEAR_ATTENUATION:
+            return 6;
+        case GL_QUADRATIC_ATTENUATION:
+            return 7;
+        default:
+            return -1;
+    }
+}
+
+void GLState::beginFrame() {
+    invalidate();
+    issuedCalls = 0;
+    elidedCalls = 0;
+
+    /* Every later bind and texture enable knows its unit */
+    activeTexture(GL_TEXTURE0);
+}
+
+void GLState::invalidate() {
+    capabilities.clear();
+
+    activeUnitKnown = false;
+    for (unsigned int unit = 0; unit < MaxTextureUnits; unit++) {
+        boundTexturesKnown[unit] = false;
+    }
+
+    arrayBufferKnown = false;
+    elementBufferKnown = false;
+    vertexArrayKnown = false;
+
+    programKnown = false;
+    blendKnown = false;
+
+    std::memset(materialsKnown, 0, sizeof(materialsKnown));
+    std::memset(lightsKnown, 0, sizeof(lightsKnown));
+}
+
+void GLState::startRecording() {
+    recording++;
+}
+
+/*
+ * A list compiled and executed leaves what it recorded as the current state,
+ * one only compiled must be followed by invalidate
+ */
+void GLState::stopRecording() {
+    recording--;
+}
+
+void GLState::setCapability(GLenum capability, bool enabled) {
+    std::uint64_t key = capability;
+
+    /* Texturing is enabled per unit */
+    if (capability == GL_TEXTURE_2D) {
+        if (!activeUnitKnown) {
+            issuedCalls++;
+            enabled ? glEnable(capability) : glDisable(capability);
+            return;
+        }
+        key |= static_cast<std::uint64_t>(activeUnit - GL_TEXTURE0) << 32;
+    }
+
+    Known state = enabled ? On : Off;
+    Known& shadow = capabilities[key];
+
+    if (shadow == state && recording == 0) {
+        elidedCalls++;
+        return;
+    }
+
+    shadow = state;
+    issuedCalls++;
+    enabled ? glEnable(capability) : glDisable(capability);
+}
+
+void GLState::enable(GLenum capability) {
+    setCapability(capability, true);
+}
+
+void GLState::disable(GLenum capability) {
+    setCapability(capability, false);
+}
+
+bool GLState::isEnabled(GLenum capability) {
+    auto found = capabilities.find(capability);
+    if (found != capabilities.end() && found->second != Unknown) {
+        return found->second == On;
+    }
+
+    bool enabled = glIsEnabled(capability) == GL_TRUE;
+    capabilities[capability] = enabled ? On : Off;
+    return enabled;
+}
+
+void GLState::activeTexture(GLenum unit) {
+    if (activeUnitKnown && activeUnit == unit && recording == 0) {
+        elidedCalls++;
+        return;
+    }
+
+    activeUnit = unit;
+    activeUnitKnown = true;
+    issuedCalls++;
+    glActiveTexture(unit);
+}
+
+void GLState::bindTexture(GLuint texture) {
+    unsigned int unit = activeUnit - GL_TEXTURE0;
+
+    if (!activeUnitKnown || unit >= MaxTextureUnits) {
+        issuedCalls++;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        return;
+    }
+
+    if (boundTexturesKnown[unit] && boundTextures[unit] == texture
+            && recording == 0) {
+        elidedCalls++;
+        return;
+    }
+
+    boundTextures[unit] = texture;
+    boundTexturesKnown[unit] = true;
+    issuedCalls++;
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+/* GL unbinds a deleted texture, a reused name would look bound */
+void GLState::forgetTexture(GLuint texture) {
+    for (unsigned int unit = 0; unit < MaxTextureUnits; unit++) {
+        if (boundTextures[unit] == texture) {
+            boundTexturesKnown[unit] = false;
+        }
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    bool elements = target == GL_ELEMENT_ARRAY_BUFFER;
+    GLuint& shadow = elements ? elementBuffer : arrayBuffer;
+    bool& known = elements ? elementBufferKnown : arrayBufferKnown;
+
+    if (known && shadow == buffer && recording == 0) {
+        elidedCalls++;
+        return;
+    }
+
+    shadow = buffer;
+    known = true;
+    issuedCalls++;
+    glBindBuffer(target, buffer);
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+    if (vertexArrayKnown && GLState::vertexArray == vertexArray
+            && recording == 0) {
+        elidedCalls++;
+        return;
+    }
+
+    GLState::vertexArray = vertexArray;
+    vertexArrayKnown = true;
+    elementBufferKnown = false;
+    issuedCalls++;
+    glBindVertexArray(vertexArray);
+}
+
+void GLState::forgetBuffer(GLuint buffer) {
+    if (arrayBuffer == buffer) {
+        arrayBufferKnown = false;
+    }
+    if (elementBuffer == buffer) {
+        elementBufferKnown = false;
+    }
+}
+
+void GLState::forgetVertexArray(GLuint vertexArray) {
+    if (GLState::vertexArray == vertexArray) {
+        vertexArrayKnown = false;
+    }
+}
+
+void GLState::useProgram(GLuint program) {
+    if (programKnown && GLState::program == program && recording == 0) {
+        elidedCalls++;
+        return;
+    }
+
+    GLState::program = program;
+    programKnown = true;
+    issuedCalls++;
+    glUseProgram(program);
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination) {
+    if (blendKnown && blendSource == source
+            && blendDestination == destination && recording == 0) {
+        elidedCalls++;
+        return;
+    }
+
+    blendSource = source;
+    blendDestination = destination;
+    blendKnown = true;
+    issuedCalls++;
+    glBlendFunc(source, destination);
+}
+
+/* True when the call has to be issued, the shadow is updated either way */
+bool GLState::setParameter(GLfloat* shadow, bool& known, const GLfloat* params,
+        unsigned int size) {
+    if (known && recording == 0
+            && std::memcmp(shadow, params, size * sizeof(GLfloat)) == 0) {
+        return false;
+    }
+
+    std::memcpy(shadow, params, size * sizeof(GLfloat));
+    known = true;
+    return true;
+}
+
+void GLState::material(GLenum face, GLenum name, const GLfloat* params) {
+    unsigned int size;
+    int index = getMaterialIndex(name, size);
+
+    /* Colour material writes the material behind our back */
+    auto colourMaterial = capabilities.find(GL_COLOR_MATERIAL);
+    bool tracked = index >= 0 && colourMaterial != capabilities.end()
+            && colourMaterial->second == Off;
+
+    if (!tracked) {
+        for (unsigned int side = 0; side < 2; side++) {
+            std::memset(materialsKnown[side], 0, sizeof(materialsKnown[side]));
+        }
+        issuedCalls++;
+        glMaterialfv(face, name, params);
+        return;
+    }
+
+    bool issue = false;
+    if (face != GL_BACK) {
+        issue |= setParameter(materials[0][index], materialsKnown[0][index],
+                params, size);
+    }
+    if (face != GL_FRONT) {
+        issue |= setParameter(materials[1][index], materialsKnown[1][index],
+                params, size);
+    }
+
+    if (!issue) {
+        elidedCalls++;
+        return;
+    }
+
+    issuedCalls++;
+    glMaterialfv(face, name, params);
+}
+
+void GLState::material(GLenum face, GLenum name, GLfloat param) {
+    material(face, name, &param);
+}
+
+void GLState::light(GLenum light, GLenum name, const GLfloat* params) {
+    unsigned int size;
+    int index = getLightIndex(name, size);
+    unsigned int number = light - GL_LIGHT0;
+
+    if (index < 0 || number >= MAX_LIGHTS
+            || setParameter(lights[number][index], lightsKnown[number][index],
+                    params, size)) {
+        issuedCalls++;
+        glLightfv(light, name, params);
+        return;
+    }
+
+    elidedCalls++;
+}
+
+std::uint64_t GLState::getIssuedCalls() {
+    return issuedCalls;
+}
+
+std::uint64_t GLState::getElidedCalls() {
+    return elidedCalls;
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Geometry cache methods.
+ */
+
+#include <GeometryCache.hpp>
+#include <LoadProfiler.hpp>
+
+#include <cmath>
+#include <cstdlib>
+
+namespace ge {
+
+std::map<GeometryCache::Key, GeometryCache::Entry> GeometryCache::meshes;
+std::map<int, std::unique_ptr<GeometryCache::CircleTable> > GeometryCache::circleTables;
+std::recursive_mutex GeometryCache::mutex;
+
+std::uint64_t GeometryCache::hits = 0;
+std::uint64_t GeometryCache::misses = 0;
+
+std::shared_ptr<Mesh> GeometryCache::getMesh(Type type,
+        std::vector<double> parameters,
+        const std::function<void(Mesh&)>& build, bool coarse) {
+    /* -0 and 0 build the same mesh */
+    for (auto& parameter : parameters) {
+        if (parameter == 0.0) {
+            parameter = 0.0;
+        }
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    Key key(type, parameters);
+    auto found = meshes.find(key);
+
+    /* Entries of meshes nobody uses any more go before they pile up */
+    if (found == meshes.end() && misses % 1024 == 1023) {
+        for (auto entry = meshes.begin(); entry != meshes.end();) {
+            if (entry->second.mesh.expired()) {
+                entry = meshes.erase(entry);
+            } else {
+                ++entry;
+            }
+        }
+    }
+
+    Entry& entry = meshes[key];
+    std::shared_ptr<Mesh> mesh = entry.mesh.lock();
+    if (mesh) {
+        hits++;
+        LoadProfiler::count(LoadProfiler::CounterGeometryHits);
+    } else {
+        mesh = std::make_shared<Mesh>();
+        build(*mesh);
+        entry.mesh = mesh;
+
+        misses++;
+        LoadProfiler::count(LoadProfiler::CounterGeometryMisses);
+    }
+
+    if (coarse) {
+        return mesh;
+    }
+
+    std::shared_ptr<Mesh> handle = entry.primitives.lock();
+    if (handle) {
+        LoadProfiler::count(LoadProfiler::CounterGeometrySaved,
+                mesh->getMemorySize());
+        return handle;
+    }
+
+    /* Holds the mesh until the last of its primitives goes */
+    handle = std::shared_ptr<Mesh>(mesh.get(), [mesh](Mesh*) mutable {
+        mesh.reset();
+    });
+    entry.primitives = handle;
+    return handle;
+}
+
+/* Same values as the GLUT circle table */
+const GeometryCache::CircleTable& GeometryCache::getCircleTable(int n) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    std::unique_ptr<CircleTable>& table = circleTables[n];
+    if (table) {
+        return *table;
+    }
+
+    table.reset(new CircleTable());
+
+    const int size = std::abs(n);
+    const double angle = 2 * M_PI / (double) ((n == 0) ? 1 : n);
+
+    table->sin.resize(size + 1);
+    table->cos.resize(size + 1);
+
+    table->sin[0] = 0.0;
+    table->cos[0] = 1.0;
+    for (int i = 1; i < size; i++) {
+        table->sin[i] = std::sin(angle * i);
+        table->cos[i] = std::cos(angle * i);
+    }
+
+    table->sin[size] = table->sin[0];
+    table->cos[size] = table->cos[0];
+
+    return *table;
+}
+
+void GeometryCache::printStatistics(std::ostream& out) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    std::size_t unique = 0, primitives = 0, saved = 0;
+    for (auto& entry : meshes) {
+        std::shared_ptr<Mesh> mesh = entry.second.mesh.lock();
+        if (!mesh) {
+            continue;
+        }
+        unique++;
+
+        /* Each primitive once, through its full mesh (not counting the reference just taken) */
+        std::shared_ptr<Mesh> handle = entry.second.primitives.lock();
+        std::size_t users = handle ? handle.use_count() - 1 : 0;
+        primitives += users;
+        if (users > 1) {
+            saved += (users - 1) * mesh->getMemorySize();
+        }
+    }
+
+    std::uint64_t requests = hits + misses;
+    out << "Geometry: " << primitives << " primitives share " << unique
+            << " meshes (" << (saved + 512) / 1024 << " KB saved, "
+            << (requests > 0 ? 100 * hits / requests : 0)
+            << "% cache hits)." << std::endl;
+}
+
+}
@@ -0,0 +1,470 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Instance group methods and the instancing shader.
+ */
+
+#include <InstanceGroup.hpp>
+#include <GLState.hpp>
+#include <LoadProfiler.hpp>
+#include <Shader.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace ge {
+
+/* Dirty members this close together are written with one call */
+const unsigned int MaxUploadGap = 8;
+
+/*
+ * Per vertex lighting as GL does it without a local viewer: scene colour,
+ * then for every enabled light its ambient, diffuse and specular terms with
+ * attenuation and spot, alpha from the diffuse material, back faces with the
+ * back material when lighting is two sided. Each light state gets its own
+ * program (what is enabled comes in as defines), a loop over every light
+ * testing uniforms costs more than the fixed function it replaces. The
+ * modelview is the identity, eye space is world space.
+ */
+static const char* VertexSource =
+        "attribute mat4 instanceMatrix;\n"
+        "attribute mat3 instanceNormalMatrix;\n"
+        "\n"
+        "vec4 lightTerm(int i, vec3 position, vec3 normal,\n"
+        "        gl_LightProducts product, float shininess) {\n"
+        "    vec4 lightPosition = gl_LightSource[i].position;\n"
+        "\n"
+        "    vec3 toLight;\n"
+        "    float attenuation = 1.0;\n"
+        "    if (lightPosition.w != 0.0) {\n"
+        "        toLight = lightPosition.xyz / lightPosition.w - position;\n"
+        "        float distance = length(toLight);\n"
+        "        toLight /= distance;\n"
+        "        attenuation = 1.0 / (gl_LightSource[i].constantAttenuation\n"
+        "                + gl_LightSource[i].linearAttenuation * distance\n"
+        "                + gl_LightSource[i].quadraticAttenuation\n"
+        "                        * distance * distance);\n"
+        "    } else {\n"
+        "        toLight = normalize(lightPosition.xyz);\n"
+        "    }\n"
+        "\n"
+        "    if (gl_LightSource[i].spotCutoff != 180.0) {\n"
+        "        float spot = dot(-toLight,\n"
+        "                normalize(gl_LightSource[i].spotDirection));\n"
+        "        attenuation *= spot < gl_LightSource[i].spotCosCutoff ?\n"
+        "                0.0 : pow(spot, gl_LightSource[i].spotExponent);\n"
+        "    }\n"
+        "\n"
+        "    vec4 term = product.ambient;\n"
+        "    float diffuse = dot(normal, toLight);\n"
+        "    if (diffuse > 0.0) {\n"
+        "        term += diffuse * product.diffuse;\n"
+        "\n"
+        "        float specular = max(dot(normal,\n"
+        "                normalize(toLight + vec3(0.0, 0.0, 1.0))), 0.0);\n"
+        "        term += (shininess == 0.0 ? 1.0 : pow(specular, shininess))\n"
+        "                * product.specular;\n"
+        "    }\n"
+        "\n"
+        "    return attenuation * term;\n"
+        "}\n"
+        "\n"
+        "#define SHADE(name, model, products, material) "
+        "vec4 name(vec3 position, vec3 normal) { "
+        "vec4 color = model.sceneColor; "
+        "LIGHTS(products, material) "
+        "color.a = material.diffuse.a; "
+        "return clamp(color, 0.0, 1.0); }\n"
+        "\n"
+        "SHADE(shadeFront, gl_FrontLightModelProduct, gl_FrontLightProduct,\n"
+        "        gl_FrontMaterial)\n"
+        "SHADE(shadeBack, gl_BackLightModelProduct, gl_BackLightProduct,\n"
+        "        gl_BackMaterial)\n"
+        "\n"
+        "void main() {\n"
+        "    vec4 world = instanceMatrix * gl_Vertex;\n"
+        "    vec3 position = world.xyz;\n"
+        "    vec3 normal = instanceNormalMatrix * gl_Normal;\n"
+        "\n"
+        "    gl_Position = gl_ProjectionMatrix * world;\n"
+        "    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+        "\n"
+        "#ifdef LIGHTING\n"
+        "    gl_FrontColor = shadeFront(position, normal);\n"
+        "#ifdef TWO_SIDED\n"
+        "    gl_BackColor = shadeBack(position, -normal);\n"
+        "#else\n"
+        "    gl_BackColor = gl_FrontColor;\n"
+        "#endif\n"
+        "#else\n"
+        "    gl_FrontColor = gl_Color;\n"
+        "    gl_BackColor = gl_Color;\n"
+        "#endif\n"
+        "}\n";
+
+/* GL_MODULATE */
+static const char* FragmentSource =
+        "uniform sampler2D image;\n"
+        "\n"
+        "void main() {\n"
+        "#ifdef TEXTURED\n"
+        "    gl_FragColor = gl_Color * texture2D(image, gl_TexCoord[0].st);\n"
+        "#else\n"
+        "    gl_FragColor = gl_Color;\n"
+        "#endif\n"
+        "}\n";
+
+std::map<unsigned int, InstanceGroup::Program> InstanceGroup::programs;
+bool InstanceGroup::checked = false;
+bool InstanceGroup::supported = false;
+unsigned int InstanceGroup::frameVariant = 0;
+bool InstanceGroup::frameStarted = false;
+
+InstanceGroup::InstanceGroup(Mesh* mesh) {
+    levels.push_back(mesh);
+    visible.resize(1);
+    this->numberOfVisible = 0;
+    this->buffer = 0;
+    this->bufferMembers = 0;
+}
+
+InstanceGroup::~InstanceGroup() {
+    if (this->buffer != 0) {
+        GLState::forgetBuffer(this->buffer);
+        glDeleteBuffers(1, &this->buffer);
+    }
+}
+
+Mesh* InstanceGroup::getMesh() {
+    return levels.front();
+}
+
+void InstanceGroup::addLevel(Mesh* mesh) {
+    levels.push_back(mesh);
+    visible.resize(levels.size());
+}
+
+unsigned int InstanceGroup::getNumberOfMembers() {
+    return static_cast<unsigned int>(dirtyFlags.size());
+}
+
+unsigned int InstanceGroup::addMember() {
+    unsigned int member = getNumberOfMembers();
+    instances.resize(instances.size() + FloatsPerInstance, 0.0f);
+    dirtyFlags.push_back(false);
+    return member;
+}
+
+void InstanceGroup::setMatrix(unsigned int member, const GLdouble* world) {
+    writeMatrix(member, world);
+    markChanged(member);
+}
+
+void InstanceGroup::writeMatrix(unsigned int member, const GLdouble* world) {
+    GLfloat* out = &instances[member * FloatsPerInstance];
+    std::copy(world, world + 16, out);
+
+    GLdouble normalMatrix[9];
+    Mesh::getNormalMatrix(world, normalMatrix);
+    std::copy(normalMatrix, normalMatrix + 9, out + 16);
+}
+
+void InstanceGroup::markChanged(unsigned int member) {
+    if (!dirtyFlags[member]) {
+        dirtyFlags[member] = true;
+        dirty.push_back(member);
+    }
+}
+
+bool InstanceGroup::addVisible(unsigned int member, unsigned int level) {
+    visible[level].push_back(member);
+    return ++numberOfVisible == 1;
+}
+
+std::size_t InstanceGroup::getNumberOfVisible() {
+    return numberOfVisible;
+}
+
+std::size_t InstanceGroup::getVisibleTriangles() {
+    std::size_t triangles = 0;
+    for (std::size_t level = 0; level < levels.size(); level++) {
+        triangles += visible[level].size()
+                * levels[level]->getNumberOfTriangles();
+    }
+    return triangles;
+}
+
+/* A new or mostly changed buffer is written whole */
+unsigned int InstanceGroup::upload() {
+    if (dirty.empty()) {
+        return 0;
+    }
+
+    const std::size_t stride = FloatsPerInstance * sizeof(GLfloat);
+    std::size_t members = getNumberOfMembers();
+    unsigned int written = 0;
+
+    if (this->buffer == 0) {
+        glGenBuffers(1, &this->buffer);
+        LoadProfiler::count(LoadProfiler::CounterGLObjects);
+    }
+    GLState::bindBuffer(GL_ARRAY_BUFFER, this->buffer);
+
+    if (this->bufferMembers != members || dirty.size() * 2 > members) {
+        glBufferData(GL_ARRAY_BUFFER, members * stride, instances.data(),
+                GL_DYNAMIC_DRAW);
+        this->bufferMembers = members;
+        written = static_cast<unsigned int>(members);
+
+    } else {
+        std::sort(dirty.begin(), dirty.end());
+
+        for (std::size_t i = 0; i < dirty.size();) {
+            unsigned int first = dirty[i];
+            unsigned int last = first;
+            while (++i < dirty.size() && dirty[i] - last <= MaxUploadGap) {
+                last = dirty[i];
+            }
+
+            std::size_t count = last - first + 1;
+            glBufferSubData(GL_ARRAY_BUFFER, first * stride, count * stride,
+                    &instances[first * FloatsPerInstance]);
+            written += static_cast<unsigned int>(count);
+        }
+    }
+
+    for (auto member : dirty) {
+        dirtyFlags[member] = false;
+    }
+    dirty.clear();
+
+    return written;
+}
+
+/* The buffer must be bound, first is the member read by instance 0 */
+void InstanceGroup::setPointers(const Program& program, std::size_t first) {
+    const GLsizei stride = FloatsPerInstance * sizeof(GLfloat);
+    std::size_t base = first * stride;
+
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttribPointer(program.matrixLocation + column, 4, GL_FLOAT,
+                GL_FALSE, stride, reinterpret_cast<const GLvoid*>(base
+                        + column * 4 * sizeof(GLfloat)));
+    }
+    for (GLuint column = 0; column < 3; column++) {
+        glVertexAttribPointer(program.normalMatrixLocation + column, 3,
+                GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(base
+                        + (16 + column * 3) * sizeof(GLfloat)));
+    }
+}
+
+/* Fixed function, with the matrices the members keep for the shader */
+void InstanceGroup::drawEach(GLdouble s, GLdouble t) {
+    for (std::size_t level = 0; level < levels.size(); level++) {
+        for (auto member : visible[level]) {
+            glLoadMatrixf(&instances[member * FloatsPerInstance]);
+            levels[level]->draw(s, t);
+        }
+    }
+    glLoadIdentity();
+}
+
+/* The attributes are left in the mesh's vertex array, disabled */
+unsigned int InstanceGroup::drawLevel(const Program& program,
+        unsigned int level) {
+    const std::vector<unsigned int>& members = visible[level];
+    Mesh* mesh = levels[level];
+
+    mesh->bindInstanced();
+    GLState::bindBuffer(GL_ARRAY_BUFFER, this->buffer);
+
+    GLuint attributes[7];
+    for (GLuint i = 0; i < 4; i++) {
+        attributes[i] = program.matrixLocation + i;
+    }
+    for (GLuint i = 0; i < 3; i++) {
+        attributes[4 + i] = program.normalMatrixLocation + i;
+    }
+
+    for (auto attribute : attributes) {
+        glEnableVertexAttribArray(attribute);
+        if (GLEW_VERSION_3_3) {
+            glVertexAttribDivisor(attribute, 1);
+        } else {
+            glVertexAttribDivisorARB(attribute, 1);
+        }
+    }
+
+    unsigned int calls = 0;
+    for (std::size_t i = 0; i < members.size();) {
+        std::size_t first = i;
+        while (++i < members.size() && members[i] == members[i - 1] + 1) {
+        }
+
+        setPointers(program, members[first]);
+        mesh->drawInstances(static_cast<GLsizei>(i - first));
+        calls++;
+    }
+
+    for (auto attribute : attributes) {
+        glDisableVertexAttribArray(attribute);
+    }
+
+    return calls;
+}
+
+unsigned int InstanceGroup::draw(GLdouble s, GLdouble t, bool textured) {
+    if (numberOfVisible == 0) {
+        return 0;
+    }
+
+    if (!frameStarted) {
+        startFrame();
+    }
+
+    Program* program = getProgram(
+            frameVariant | (textured ? VariantTextured : 0));
+    if (program == nullptr) {
+        drawEach(s, t);
+        clearVisible();
+        return 0;
+    }
+
+    /* Other shaders only write the front colour */
+    program->shader->bind();
+    bool twoSided = (frameVariant & VariantTwoSided) != 0;
+    if (twoSided) {
+        GLState::enable(GL_VERTEX_PROGRAM_TWO_SIDE);
+    }
+
+    bool scaled = s != 1.0 || t != 1.0;
+    if (scaled) {
+        glMatrixMode(GL_TEXTURE);
+        glPushMatrix();
+        glScaled(1.0 / s, 1.0 / t, 1.0);
+        glMatrixMode(GL_MODELVIEW);
+    }
+
+    unsigned int calls = 0;
+    for (unsigned int level = 0; level < levels.size(); level++) {
+        if (!visible[level].empty()) {
+            calls += drawLevel(*program, level);
+        }
+    }
+
+    if (scaled) {
+        glMatrixMode(GL_TEXTURE);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+    }
+
+    if (twoSided) {
+        GLState::disable(GL_VERTEX_PROGRAM_TWO_SIDE);
+    }
+    program->shader->unbind();
+    clearVisible();
+
+    return calls;
+}
+
+void InstanceGroup::clearVisible() {
+    for (auto& members : visible) {
+        members.clear();
+    }
+    numberOfVisible = 0;
+}
+
+void InstanceGroup::beginFrame() {
+    frameStarted = false;
+}
+
+/* What the lights were set to this frame */
+void InstanceGroup::startFrame() {
+    frameVariant = 0;
+
+    if (GLState::isEnabled(GL_LIGHTING)) {
+        frameVariant |= VariantLighting;
+        for (unsigned int i = 0; i < MAX_LIGHTS; i++) {
+            if (GLState::isEnabled(GL_LIGHT0 + i)) {
+                frameVariant |= 1 << i;
+            }
+        }
+
+        GLboolean twoSided = GL_FALSE;
+        glGetBooleanv(GL_LIGHT_MODEL_TWO_SIDE, &twoSided);
+        if (twoSided) {
+            frameVariant |= VariantTwoSided;
+        }
+    }
+
+    frameStarted = true;
+}
+
+InstanceGroup::Program* InstanceGroup::getProgram(unsigned int variant) {
+    auto found = programs.find(variant);
+    if (found != programs.end()) {
+        return found->second.shader != nullptr ? &found->second : nullptr;
+    }
+
+    std::string defines("#version 120\n");
+    if (variant & VariantLighting) {
+        defines.append("#define LIGHTING\n");
+    }
+    if (variant & VariantTwoSided) {
+        defines.append("#define TWO_SIDED\n");
+    }
+    if (variant & VariantTextured) {
+        defines.append("#define TEXTURED\n");
+    }
+
+    /* One term per enabled light, the index is a constant in each */
+    defines.append("#define LIGHTS(products, material)");
+    for (unsigned int i = 0; i < MAX_LIGHTS; i++) {
+        if (variant & (1 << i)) {
+            std::string light = std::to_string(i);
+            defines.append(" color += lightTerm(" + light
+                    + ", position, normal, products[" + light
+                    + "], material.shininess);");
+        }
+    }
+    defines.append("\n");
+
+    Program& program = programs[variant];
+    program.shader = Shader::fromSource((defines + VertexSource).c_str(),
+            (defines + FragmentSource).c_str());
+
+    GLuint id = program.shader->getId();
+    program.matrixLocation = glGetAttribLocation(id, "instanceMatrix");
+    program.normalMatrixLocation = glGetAttribLocation(id,
+            "instanceNormalMatrix");
+
+    if (!program.shader->isLinked() || program.matrixLocation < 0
+            || program.normalMatrixLocation < 0) {
+        delete program.shader;
+        program.shader = nullptr;
+        return nullptr;
+    }
+
+    return &program;
+}
+
+/* The usual variant (lighting and the first light) has to build */
+bool InstanceGroup::isSupported() {
+    if (checked) {
+        return supported;
+    }
+    checked = true;
+
+    bool instancedArrays = GLEW_VERSION_3_3
+            || ((GLEW_VERSION_3_1 || GLEW_ARB_draw_instanced)
+                    && GLEW_ARB_instanced_arrays);
+    if (Mesh::getSupport() != Mesh::SupportVertexArrays || !GLEW_VERSION_2_0
+            || !instancedArrays) {
+        return false;
+    }
+
+    supported = getProgram(VariantLighting | 1) != nullptr;
+    return supported;
+}
+
+}
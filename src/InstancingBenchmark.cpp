@@ -0,0 +1,166 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Instanced drawing benchmark methods.
+ */
+
+#include <InstancingBenchmark.hpp>
+#include <Application.hpp>
+#include <Scene.hpp>
+#include <SceneGenerator.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#define getpid _getpid
+#endif
+
+namespace ge {
+
+/* Animation time between two frames, as the application's timer */
+const unsigned long FrameMilliseconds = GLUT_UPDATE_MS;
+
+InstancingBenchmark::InstancingBenchmark(uint64_t instances,
+        unsigned int frames) {
+    this->instances = instances > 0 ? instances : 1;
+    this->frames = frames > 1 ? frames : 2;
+}
+
+/*
+ * Small meshes, llvmpipe has to get through a hundred thousand of them in
+ * both passes. No textures, the scene can be written anywhere.
+ */
+bool InstancingBenchmark::writeScene(const std::string& fileName) {
+    SceneGenerator::Settings settings;
+
+    /* A full tree with a fan-out of 8 has 8 leaves for every 7 inner nodes */
+    settings.nodes = instances + instances / 7;
+    settings.fanOut = 8;
+    settings.slices = 8;
+    settings.stacks = 4;
+    settings.shapes = 4;
+    settings.appearances = 4;
+    settings.textures = 0;
+    settings.animations = 8;
+    settings.animatedNodes = 10;
+    settings.setPrimitiveMix("cylinder,sphere,torus");
+
+    SceneGenerator generator(settings);
+    return generator.write(fileName);
+}
+
+void InstancingBenchmark::timeFrames(Scene& scene, double& best,
+        double& average) {
+    double total = 0.0;
+    best = 0.0;
+
+    for (unsigned int i = 0; i < frames; i++) {
+        scene.update(FrameMilliseconds);
+        glFinish();
+
+        auto start = std::chrono::steady_clock::now();
+        scene.display();
+        glFinish();
+        double elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+        /* The first frame uploads buffers and builds shaders */
+        if (i == 0) {
+            continue;
+        }
+
+        total += elapsed;
+        best = (i == 1 || elapsed < best) ? elapsed : best;
+    }
+
+    average = total / (frames - 1);
+}
+
+/* A fresh load for each pass, so both start their animations at the same time */
+void InstancingBenchmark::measure(const std::string& fileName,
+        std::ostream& out) {
+    double best[2], average[2];
+
+    for (unsigned int pass = 0; pass < 2; pass++) {
+        bool instancing = pass == 1;
+
+        /* Not worth a compiled copy, the file goes away */
+        std::string sceneFileName(fileName);
+        Scene scene(sceneFileName, false);
+        scene.init();
+        scene.setCurrentWindowSize(Defaults::InitialWindowSizeX,
+                Defaults::InitialWindowSizeY);
+
+        if (pass == 0) {
+            scene.printSummary(out);
+        }
+        if (scene.toggleInstancing() != instancing) {
+            scene.toggleInstancing();
+        }
+
+        timeFrames(scene, best[pass], average[pass]);
+        out << (instancing ? "With" : "Without") << " instancing: best "
+                << best[pass] << " ms, average " << average[pass]
+                << " ms per frame." << std::endl;
+        scene.printDrawStatistics(out);
+    }
+
+    out << "Speedup: " << average[0] / average[1] << "x (average), "
+            << best[0] / best[1] << "x (best)." << std::endl;
+}
+
+/* In the temporary directory, never over a file that is already there */
+std::string InstancingBenchmark::getSceneFileName() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string prefix = "geEngine_instancing_" + std::to_string(getpid());
+
+    for (unsigned int i = 0;; i++) {
+        std::filesystem::path candidate = directory
+                / (prefix + "_" + std::to_string(i) + ".yaf");
+        if (!std::filesystem::exists(candidate)) {
+            return candidate.string();
+        }
+    }
+}
+
+bool InstancingBenchmark::run(int argc, char** argv) {
+    std::string fileName;
+    try {
+        fileName = getSceneFileName();
+    } catch (std::filesystem::filesystem_error& e) {
+        std::cerr << "No temporary directory: " << e.what() << std::endl;
+        return false;
+    }
+
+    if (!writeScene(fileName)) {
+        return false;
+    }
+
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
+    glutInitWindowSize(Defaults::InitialWindowSizeX,
+            Defaults::InitialWindowSizeY);
+    glutCreateWindow("geEngine instancing benchmark");
+    glewInit();
+
+    bool measured = false;
+    try {
+        std::cout << "Renderer: " << glGetString(GL_RENDERER) << ", "
+                << frames << " frames per pass." << std::endl;
+        measure(fileName, std::cout);
+        measured = true;
+    } catch (Exception& e) {
+        e.printerErrorMessage();
+    }
+
+    std::remove(fileName.c_str());
+    return measured;
+}
+
+}
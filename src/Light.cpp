@@ -5,6 +5,7 @@
  */
 
 #include <Light.hpp>
+#include <GLState.hpp>
 #include <Primitives.hpp>
 
 namespace ge {
@@ -22,7 +23,8 @@ OmniLight::OmniLight(const std::string& lightID, int openGLid, bool iEnable,
     setDiffuse(iDiffuse);
     setSpecular(iSpecular);
 
-    gluQuadric = gluNewQuadric();
+    /* Created by init, once there is a GL context */
+    gluQuadric = nullptr;
 }
 
 SpotLight::SpotLight(const std::string& lightID, int openGLid, bool iEnable,
@@ -43,7 +45,14 @@ SpotLight::SpotLight(const std::string& lightID, int openGLid, bool iEnable,
     setExponent(iSpotExponent);
     setDirection(iSpotDirection);
 
-    gluQuadric = gluNewQuadric();
+    gluQuadric = nullptr;
+}
+
+/* GL realization, called by the scene init */
+void Light::init() {
+    if (gluQuadric == nullptr) {
+        gluQuadric = gluNewQuadric();
+    }
 }
 
 /* Sets */
@@ -148,32 +157,32 @@ void SpotLight::draw() {
 
 void OmniLight::update() {
     if (enabled) {
-        glEnable(openGLid);
+        GLState::enable(openGLid);
 
-        glLightfv(openGLid, GL_AMBIENT, ambient);
-        glLightfv(openGLid, GL_DIFFUSE, diffuse);
-        glLightfv(openGLid, GL_SPECULAR, specular);
-        glLightfv(openGLid, GL_POSITION, location);
+        GLState::light(openGLid, GL_AMBIENT, ambient);
+        GLState::light(openGLid, GL_DIFFUSE, diffuse);
+        GLState::light(openGLid, GL_SPECULAR, specular);
+        GLState::light(openGLid, GL_POSITION, location);
 
     } else {
-        glDisable(openGLid);
+        GLState::disable(openGLid);
     }
 
 }
 
 void SpotLight::update() {
     if (enabled) {
-        glEnable(openGLid);
+        GLState::enable(openGLid);
 
-        glLightfv(openGLid, GL_AMBIENT, ambient);
-        glLightfv(openGLid, GL_DIFFUSE, diffuse);
-        glLightfv(openGLid, GL_SPECULAR, specular);
-        glLightfv(openGLid, GL_POSITION, location);
-        glLightfv(openGLid, GL_SPOT_DIRECTION, direction);
-        glLightfv(openGLid, GL_SPOT_EXPONENT, exponent);
+        GLState::light(openGLid, GL_AMBIENT, ambient);
+        GLState::light(openGLid, GL_DIFFUSE, diffuse);
+        GLState::light(openGLid, GL_SPECULAR, specular);
+        GLState::light(openGLid, GL_POSITION, location);
+        GLState::light(openGLid, GL_SPOT_DIRECTION, direction);
+        GLState::light(openGLid, GL_SPOT_EXPONENT, exponent);
 
     } else {
-        glDisable(openGLid);
+        GLState::disable(openGLid);
     }
 
 }
@@ -189,7 +198,9 @@ void Light::disable() {
 }
 
 Light::~Light(){
-
+    if (gluQuadric != nullptr) {
+        gluDeleteQuadric(gluQuadric);
+    }
 }
 
 OmniLight::~OmniLight(){
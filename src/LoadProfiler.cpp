@@ -0,0 +1,146 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Scene load instrumentation methods.
+ */
+
+#include <LoadProfiler.hpp>
+
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+namespace ge {
+
+static const char* phaseNames[LoadProfiler::NumberOfPhases] = { "parse",
+        "globals", "cameras", "lighting", "textures", "appearances",
+        "animations", "graph", "graph_import", "node_matrices", "binary_load",
+        "texture_decode", "texture_upload", "shaders", "first_draw",
+        "static_batching", "display_lists" };
+
+static const char* counterNames[LoadProfiler::NumberOfCounters] = {
+        "bytes_read", "elements_parsed", "allocations", "textures_decoded",
+        "gl_objects", "node_instances", "shared_nodes", "geometry_hits",
+        "geometry_misses", "geometry_saved", "static_batches",
+        "batched_primitives" };
+
+std::atomic<bool> LoadProfiler::enabled(false);
+bool LoadProfiler::json = false;
+std::chrono::steady_clock::time_point LoadProfiler::enableTime;
+
+std::atomic<std::uint64_t> LoadProfiler::counters[NumberOfCounters];
+
+double LoadProfiler::phaseTime[NumberOfPhases];
+unsigned LoadProfiler::phaseCalls[NumberOfPhases];
+std::chrono::steady_clock::time_point LoadProfiler::phaseStart[NumberOfPhases];
+
+LoadProfiler::Scope::Scope(Phase phase) {
+    this->phase = phase;
+    if (LoadProfiler::enabled) {
+        this->start = std::chrono::steady_clock::now();
+    }
+}
+
+LoadProfiler::Scope::~Scope() {
+    if (LoadProfiler::enabled) {
+        LoadProfiler::addTime(phase, start);
+    }
+}
+
+void LoadProfiler::enable(bool json) {
+    LoadProfiler::json = json;
+    LoadProfiler::enableTime = std::chrono::steady_clock::now();
+    LoadProfiler::enabled = true;
+}
+
+void LoadProfiler::begin(Phase phase) {
+    if (enabled) {
+        phaseStart[phase] = std::chrono::steady_clock::now();
+    }
+}
+
+void LoadProfiler::end(Phase phase) {
+    if (enabled) {
+        addTime(phase, phaseStart[phase]);
+    }
+}
+
+/* Phases are only timed on the main thread */
+void LoadProfiler::addTime(Phase phase,
+        std::chrono::steady_clock::time_point start) {
+    phaseTime[phase] += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    phaseCalls[phase]++;
+}
+
+void LoadProfiler::report(std::ostream& out) {
+    double total = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - enableTime).count();
+
+    if (json) {
+        out << "{\"total_ms\": " << total << ", \"phases\": {";
+        for (unsigned i = 0; i < NumberOfPhases; i++) {
+            out << (i > 0 ? ", " : "") << "\"" << phaseNames[i]
+                    << "\": {\"ms\": " << phaseTime[i] << ", \"calls\": "
+                    << phaseCalls[i] << "}";
+        }
+        out << "}, \"counters\": {";
+        for (unsigned i = 0; i < NumberOfCounters; i++) {
+            out << (i > 0 ? ", " : "") << "\"" << counterNames[i] << "\": "
+                    << counters[i].load();
+        }
+        out << "}}" << std::endl;
+        return;
+    }
+
+    /* The caller's formatting is put back once the table is written */
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    /* Since enable, that is until the first frame unless the load was headless */
+    out << "Scene load report (" << total << " ms total)" << std::endl;
+
+    /* Phases nest (sections are part of parse), so they do not add up to the total */
+    for (unsigned i = 0; i < NumberOfPhases; i++) {
+        if (phaseCalls[i] == 0) {
+            continue;
+        }
+        out << "  " << std::left << std::setw(16) << phaseNames[i]
+                << std::right << std::setw(12) << std::fixed
+                << std::setprecision(3) << phaseTime[i] << " ms";
+        if (phaseCalls[i] > 1) {
+            out << " (" << phaseCalls[i] << " calls)";
+        }
+        out << std::endl;
+    }
+
+    for (unsigned i = 0; i < NumberOfCounters; i++) {
+        out << "  " << std::left << std::setw(16) << counterNames[i]
+                << std::right << std::setw(12) << counters[i].load()
+                << std::endl;
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+}
+
+/* Counts heap allocations while the profiler is enabled (array forms end up here too) */
+void* operator new(std::size_t size) {
+    ge::LoadProfiler::count(ge::LoadProfiler::CounterAllocations);
+
+    void* pointer = std::malloc(size > 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
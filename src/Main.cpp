@@ -3,6 +3,11 @@
  *
  */
 #include <Application.hpp>
+#include <InstancingBenchmark.hpp>
+#include <ParseBenchmark.hpp>
+#include <SceneGenerator.hpp>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 
@@ -11,9 +16,291 @@ void PressEnterToExit() {
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 
+/* Compiles a yaf scene into its binary (yafb) form without opening a window */
+int compileScene(int argc, char** argv) {
+    if (argc < 3 || argc > 4) {
+        std::cerr << "Usage: " << argv[0] << " --compile scene.yaf [scene.yafb]"
+                << std::endl;
+        return -1;
+    }
+
+    std::string sceneFileName(argv[2]);
+    std::string binaryFileName;
+
+    if (argc == 4) {
+        binaryFileName.append(argv[3]);
+    } else {
+        binaryFileName = ge::Binary::getCacheFileName(sceneFileName);
+    }
+
+    std::cout << "Compiling [" << sceneFileName << "] into [" << binaryFileName
+            << "]." << std::endl;
+
+    try {
+        ge::Exception::Recoverable recoverable;
+        if (!ge::Scene::compileBinary(sceneFileName, binaryFileName)) {
+            std::cerr << "Could not write [" << binaryFileName << "]."
+                    << std::endl;
+            return -1;
+        }
+    } catch (ge::Exception& e) {
+        e.printerErrorMessage();
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Times attribute decoding of a scene (old sscanf path against the current one) */
+int benchParse(int argc, char** argv) {
+    if (argc < 3 || argc > 4) {
+        std::cerr << "Usage: " << argv[0] << " --bench-parse scene.yaf [iterations]"
+                << std::endl;
+        return -1;
+    }
+
+    unsigned iterations = 10;
+    if (argc == 4) {
+        iterations = static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10));
+    }
+
+    ge::ParseBenchmark benchmark(argv[2], iterations);
+    return benchmark.run() ? 0 : -1;
+}
+
+/* Loads a scene without a GL context, load errors give a non zero exit code */
+int validateScene(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " --validate scene.yaf"
+                << std::endl;
+        return -1;
+    }
+
+    std::string sceneFileName(argv[2]);
+    try {
+        ge::Exception::Recoverable recoverable;
+        ge::Scene scene(sceneFileName, false);
+
+        std::cout << "[" << sceneFileName << "] is valid. ";
+        scene.printSummary(std::cout);
+    } catch (ge::Exception& e) {
+        e.printerErrorMessage();
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Times the CPU side of the scene load (everything before the GL context is needed) */
+int benchLoad(int argc, char** argv) {
+    bool json = argc > 2 && std::string(argv[2]) == "--json";
+    int first = json ? 3 : 2;
+
+    if (argc < first + 1 || argc > first + 2) {
+        std::cerr << "Usage: " << argv[0]
+                << " --load-bench [--json] scene.yaf [iterations]" << std::endl;
+        return -1;
+    }
+
+    std::string sceneFileName(argv[first]);
+    unsigned iterations = 1;
+    if (argc == first + 2) {
+        iterations = static_cast<unsigned>(std::strtoul(argv[first + 1],
+                nullptr, 10));
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    ge::LoadProfiler::enable(json);
+
+    double best = 0.0, total = 0.0;
+    for (unsigned i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            ge::Exception::Recoverable recoverable;
+            ge::Scene scene(sceneFileName, false);
+        } catch (ge::Exception& e) {
+            e.printerErrorMessage();
+            return -1;
+        }
+        double elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+        best = (i == 0 || elapsed < best) ? elapsed : best;
+        total += elapsed;
+    }
+
+    if (!json) {
+        std::cout << "Load benchmark [" << sceneFileName << "]: "
+                << iterations << " loads, best " << best << " ms, average "
+                << total / iterations << " ms." << std::endl;
+    }
+    ge::LoadProfiler::report(std::cout);
+
+    return 0;
+}
+
+/* Writes a synthetic scene of any size for the load and frame time benchmarks */
+int generateScene(int argc, char** argv) {
+    if (argc < 3 || argc % 2 == 0) {
+        std::cerr << "Usage: " << argv[0] << " --generate scene.yaf"
+                << " [--nodes N] [--depth N] [--fanout N] [--seed N]"
+                << " [--primitives cylinder,sphere:2,...] [--slices N]"
+                << " [--stacks N] [--shapes N] [--appearances N]"
+                << " [--textures N] [--texture-files a.jpg,...]"
+                << " [--animations N] [--animated PERCENT]" << std::endl;
+        return -1;
+    }
+
+    ge::SceneGenerator::Settings settings;
+
+    for (int i = 3; i < argc; i += 2) {
+        std::string option(argv[i]);
+        std::string value(argv[i + 1]);
+        unsigned long long number = std::strtoull(argv[i + 1], nullptr, 10);
+
+        if (option == "--nodes") {
+            settings.nodes = number;
+        } else if (option == "--depth") {
+            settings.depth = static_cast<unsigned int>(number);
+        } else if (option == "--fanout") {
+            settings.fanOut = static_cast<unsigned int>(number);
+        } else if (option == "--seed") {
+            settings.seed = static_cast<uint32_t>(number);
+        } else if (option == "--primitives") {
+            if (!settings.setPrimitiveMix(value)) {
+                return -1;
+            }
+        } else if (option == "--slices") {
+            settings.slices = static_cast<unsigned int>(number);
+        } else if (option == "--stacks") {
+            settings.stacks = static_cast<unsigned int>(number);
+        } else if (option == "--shapes") {
+            settings.shapes = static_cast<unsigned int>(number);
+        } else if (option == "--appearances") {
+            settings.appearances = static_cast<unsigned int>(number);
+        } else if (option == "--textures") {
+            settings.textures = static_cast<unsigned int>(number);
+        } else if (option == "--texture-files") {
+            if (!settings.setTextureFiles(value)) {
+                return -1;
+            }
+        } else if (option == "--animations") {
+            settings.animations = static_cast<unsigned int>(number);
+        } else if (option == "--animated") {
+            settings.animatedNodes = static_cast<unsigned int>(number);
+        } else {
+            std::cerr << "Unknown option: [" << option << "]." << std::endl;
+            return -1;
+        }
+    }
+
+    ge::SceneGenerator generator(settings);
+    return generator.write(argv[2]) ? 0 : -1;
+}
+
+/* Frame time with and without instanced drawing on a generated scene */
+int benchInstancing(int argc, char** argv) {
+    if (argc > 4) {
+        std::cerr << "Usage: " << argv[0]
+                << " --bench-instancing [instances] [frames]" << std::endl;
+        return -1;
+    }
+
+    unsigned long long instances = 100000;
+    unsigned int frames = 20;
+    if (argc > 2) {
+        instances = std::strtoull(argv[2], nullptr, 10);
+    }
+    if (argc > 3) {
+        frames = static_cast<unsigned int>(std::strtoul(argv[3], nullptr, 10));
+    }
+
+    ge::InstancingBenchmark benchmark(instances, frames);
+    return benchmark.run(argc, argv) ? 0 : -1;
+}
+
 int main(int argc, char** argv) {
     std::string sceneFileName;
 
+    if (argc > 1 && std::string(argv[1]) == "--compile") {
+        return compileScene(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-parse") {
+        return benchParse(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--validate") {
+        return validateScene(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--load-bench") {
+        return benchLoad(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--generate") {
+        return generateScene(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-instancing") {
+        return benchInstancing(argc, argv);
+    }
+
+    /* Texture memory kept on the GPU before unused textures are evicted */
+    if (argc > 2 && std::string(argv[1]) == "--texture-budget") {
+        unsigned long megabytes = std::strtoul(argv[2], nullptr, 10);
+        ge::TextureResidency::setDefaultBudget(
+                static_cast<std::size_t>(megabytes) * 1024 * 1024);
+
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    /* Display list memory before idle lists are deleted for the ones that did not fit */
+    if (argc > 2 && std::string(argv[1]) == "--list-budget") {
+        unsigned long megabytes = std::strtoul(argv[2], nullptr, 10);
+        ge::DisplayListManager::setBudget(
+                static_cast<std::size_t>(megabytes) * 1024 * 1024);
+
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    /* Steps of coarser level of detail, negative is finer */
+    if (argc > 2 && std::string(argv[1]) == "--lod-bias") {
+        ge::SceneGraph::setLodBias(std::strtod(argv[2], nullptr));
+
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    /* Threads walking large graphs each frame, 1 walks them on the drawing thread */
+    if (argc > 2 && std::string(argv[1]) == "--traversal-threads") {
+        ge::SceneGraph::setTraversalThreads(
+                static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10)));
+
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    /* Loads the scene, draws one frame and prints where the time went */
+    if (argc > 1 && std::string(argv[1]) == "--load-report") {
+        bool json = argc > 2 && std::string(argv[2]) == "--json";
+        int skip = json ? 2 : 1;
+
+        ge::LoadProfiler::enable(json);
+
+        argv[skip] = argv[0];
+        argv += skip;
+        argc -= skip;
+    }
+
     if (argc == 1) {
         sceneFileName.append("default.yaf");
         std::cout << "No scene defined, attempting to use [" << sceneFileName
@@ -32,4 +319,3 @@ int main(int argc, char** argv) {
 
     return 0;
 }
-
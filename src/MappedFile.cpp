@@ -0,0 +1,129 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Read only memory mapped file methods.
+ */
+
+#include <MappedFile.hpp>
+#include <LoadProfiler.hpp>
+
+#include <sys/stat.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace ge {
+
+MappedFile::MappedFile() {
+    this->mappedData = nullptr;
+    this->mappedSize = 0;
+}
+
+bool MappedFile::open(const std::string& fileName) {
+    close();
+
+#ifndef WIN32
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* address = mmap(nullptr, static_cast<std::size_t>(fileStatus.st_size),
+            PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* The mapping keeps its own reference to the file */
+    ::close(fd);
+
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    this->mappedData = static_cast<const unsigned char*>(address);
+    this->mappedSize = static_cast<std::size_t>(fileStatus.st_size);
+#else
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+
+    std::streamsize length = file.tellg();
+    if (length <= 0) {
+        return false;
+    }
+
+    fallbackBuffer.resize(static_cast<std::size_t>(length));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(fallbackBuffer.data()), length)) {
+        fallbackBuffer.clear();
+        return false;
+    }
+
+    this->mappedData = fallbackBuffer.data();
+    this->mappedSize = fallbackBuffer.size();
+#endif
+
+    LoadProfiler::count(LoadProfiler::CounterBytesRead, this->mappedSize);
+    return true;
+}
+
+void MappedFile::close() {
+#ifndef WIN32
+    if (this->mappedData != nullptr) {
+        munmap(const_cast<unsigned char*>(this->mappedData), this->mappedSize);
+    }
+#else
+    fallbackBuffer.clear();
+    fallbackBuffer.shrink_to_fit();
+#endif
+
+    this->mappedData = nullptr;
+    this->mappedSize = 0;
+}
+
+bool MappedFile::isOpen() {
+    return this->mappedData != nullptr;
+}
+
+const unsigned char* MappedFile::getData() {
+    return this->mappedData;
+}
+
+std::size_t MappedFile::getSize() {
+    return this->mappedSize;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool getFileModificationTime(const std::string& fileName, int64_t& mtime,
+        uint64_t& size) {
+    struct stat fileStatus;
+
+    if (stat(fileName.c_str(), &fileStatus) != 0) {
+        return false;
+    }
+
+#ifndef WIN32
+    /* Nanoseconds, edits within the same second must still be seen */
+    mtime = static_cast<int64_t>(fileStatus.st_mtim.tv_sec) * 1000000000
+            + fileStatus.st_mtim.tv_nsec;
+#else
+    mtime = static_cast<int64_t>(fileStatus.st_mtime);
+#endif
+    size = static_cast<uint64_t>(fileStatus.st_size);
+    return true;
+}
+
+}
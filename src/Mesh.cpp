@@ -0,0 +1,291 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Mesh methods.
+ */
+
+#include <Mesh.hpp>
+#include <GLState.hpp>
+#include <LoadProfiler.hpp>
+
+#include <cstddef>
+
+namespace ge {
+
+Mesh::Support Mesh::support = SupportUnknown;
+
+Mesh::Mesh() {
+    this->stripStart = true;
+    this->triangles = 0;
+    this->vertexBuffer = 0;
+    this->indexBuffer = 0;
+    this->vertexArray = 0;
+    this->uploaded = false;
+}
+
+Mesh::~Mesh() {
+    if (this->uploaded) {
+        if (this->vertexArray != 0) {
+            GLState::forgetVertexArray(this->vertexArray);
+            glDeleteVertexArrays(1, &this->vertexArray);
+        }
+
+        GLState::forgetBuffer(this->vertexBuffer);
+        GLState::forgetBuffer(this->indexBuffer);
+        glDeleteBuffers(1, &this->vertexBuffer);
+        glDeleteBuffers(1, &this->indexBuffer);
+    }
+}
+
+GLuint Mesh::addVertex(GLfloat x, GLfloat y, GLfloat z, GLfloat nx, GLfloat ny,
+        GLfloat nz, GLfloat s, GLfloat t) {
+    Vertex vertex = { { x, y, z }, { nx, ny, nz }, { s, t } };
+    vertices.push_back(vertex);
+    return static_cast<GLuint>(vertices.size() - 1);
+}
+
+void Mesh::beginStrip() {
+    this->stripStart = true;
+}
+
+/* Strips are joined by repeating the last and the first index, the new strip
+ * starts at an even position so its triangles keep their winding */
+void Mesh::addIndex(GLuint index) {
+    if (this->stripStart && !indices.empty()) {
+        pushIndex(indices.back());
+        pushIndex(index);
+        if (indices.size() % 2 == 1) {
+            pushIndex(index);
+        }
+    }
+
+    this->stripStart = false;
+    pushIndex(index);
+}
+
+/* Counts the triangle the index completes unless it is degenerate */
+void Mesh::pushIndex(GLuint index) {
+    std::size_t size = indices.size();
+    if (size >= 2 && index != indices[size - 1] && index != indices[size - 2]
+            && indices[size - 1] != indices[size - 2]) {
+        this->triangles++;
+    }
+    indices.push_back(index);
+}
+
+/* c r0 c r1 c r2 ... draws (c, r0, r1), (c, r1, r2), ... and degenerate triangles */
+void Mesh::addFan(GLuint center, const std::vector<GLuint>& rim) {
+    beginStrip();
+    for (auto index : rim) {
+        addIndex(center);
+        addIndex(index);
+    }
+}
+
+/* Normals are not normalized, which is what GL does with them under the same modelview */
+void Mesh::append(const Mesh& other, const GLdouble* matrix, GLdouble s,
+        GLdouble t) {
+    const GLdouble* m = matrix;
+    GLdouble normalMatrix[9];
+    getNormalMatrix(matrix, normalMatrix);
+
+    GLuint base = static_cast<GLuint>(vertices.size());
+    vertices.reserve(vertices.size() + other.vertices.size());
+
+    for (auto& vertex : other.vertices) {
+        const GLfloat* p = vertex.position;
+        const GLfloat* n = vertex.normal;
+        addVertex(m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12],
+                m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13],
+                m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14],
+                normalMatrix[0] * n[0] + normalMatrix[3] * n[1]
+                        + normalMatrix[6] * n[2],
+                normalMatrix[1] * n[0] + normalMatrix[4] * n[1]
+                        + normalMatrix[7] * n[2],
+                normalMatrix[2] * n[0] + normalMatrix[5] * n[1]
+                        + normalMatrix[8] * n[2],
+                vertex.texcoord[0] / s, vertex.texcoord[1] / t);
+    }
+
+    /* Its own joins keep their parity, the strip starts at an even position */
+    beginStrip();
+    for (auto index : other.indices) {
+        addIndex(base + index);
+    }
+}
+
+/* Cofactors over the determinant, column major like the input */
+void Mesh::getNormalMatrix(const GLdouble* matrix, GLdouble* out) {
+    const GLdouble* m = matrix;
+
+    out[0] = m[5] * m[10] - m[9] * m[6];
+    out[3] = m[9] * m[2] - m[1] * m[10];
+    out[6] = m[1] * m[6] - m[5] * m[2];
+    out[1] = m[8] * m[6] - m[4] * m[10];
+    out[4] = m[0] * m[10] - m[8] * m[2];
+    out[7] = m[4] * m[2] - m[0] * m[6];
+    out[2] = m[4] * m[9] - m[8] * m[5];
+    out[5] = m[8] * m[1] - m[0] * m[9];
+    out[8] = m[0] * m[5] - m[4] * m[1];
+
+    GLdouble determinant = m[0] * out[0] + m[4] * out[3] + m[8] * out[6];
+    if (determinant != 0.0) {
+        for (int i = 0; i < 9; i++) {
+            out[i] /= determinant;
+        }
+    }
+}
+
+Mesh::Support Mesh::getSupport() {
+    if (support == SupportUnknown) {
+        if (GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object) {
+            support = SupportVertexArrays;
+        } else if (GLEW_VERSION_1_5 || GLEW_ARB_vertex_buffer_object) {
+            support = SupportBuffers;
+        } else {
+            support = SupportImmediate;
+        }
+    }
+    return support;
+}
+
+void Mesh::upload() {
+    glGenBuffers(1, &this->vertexBuffer);
+    glGenBuffers(1, &this->indexBuffer);
+    LoadProfiler::count(LoadProfiler::CounterGLObjects, 2);
+
+    if (getSupport() == SupportVertexArrays) {
+        glGenVertexArrays(1, &this->vertexArray);
+        LoadProfiler::count(LoadProfiler::CounterGLObjects);
+        GLState::bindVertexArray(this->vertexArray);
+    }
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+            vertices.data(), GL_STATIC_DRAW);
+
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+            indices.data(), GL_STATIC_DRAW);
+
+    /* Recorded by the vertex array, set on every draw without one */
+    if (this->vertexArray != 0) {
+        setPointers();
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+
+    this->uploaded = true;
+}
+
+void Mesh::setPointers() {
+    glVertexPointer(3, GL_FLOAT, sizeof(Vertex),
+            reinterpret_cast<const GLvoid*>(offsetof(Vertex, position)));
+    glNormalPointer(GL_FLOAT, sizeof(Vertex),
+            reinterpret_cast<const GLvoid*>(offsetof(Vertex, normal)));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex),
+            reinterpret_cast<const GLvoid*>(offsetof(Vertex, texcoord)));
+}
+
+void Mesh::drawImmediate() {
+    glBegin(GL_TRIANGLE_STRIP);
+    for (auto index : indices) {
+        const Vertex& vertex = vertices[index];
+        glNormal3fv(vertex.normal);
+        glTexCoord2fv(vertex.texcoord);
+        glVertex3fv(vertex.position);
+    }
+    glEnd();
+}
+
+void Mesh::draw(GLdouble s, GLdouble t) {
+    if (indices.empty()) {
+        return;
+    }
+
+    /* The texture lengths are not baked, one mesh serves every appearance */
+    bool scaled = s != 1.0 || t != 1.0;
+    if (scaled) {
+        glMatrixMode(GL_TEXTURE);
+        glPushMatrix();
+        glScaled(1.0 / s, 1.0 / t, 1.0);
+        glMatrixMode(GL_MODELVIEW);
+    }
+
+    GLsizei count = static_cast<GLsizei>(indices.size());
+
+    switch (getSupport()) {
+        case SupportVertexArrays:
+            if (!this->uploaded) {
+                upload();
+            }
+            GLState::bindVertexArray(this->vertexArray);
+            glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT, nullptr);
+            break;
+
+        case SupportBuffers:
+            if (!this->uploaded) {
+                upload();
+            }
+            GLState::bindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer);
+            GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+            setPointers();
+
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_NORMAL_ARRAY);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT, nullptr);
+            glDisableClientState(GL_VERTEX_ARRAY);
+            glDisableClientState(GL_NORMAL_ARRAY);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            break;
+
+        default:
+            drawImmediate();
+            break;
+    }
+
+    if (scaled) {
+        glMatrixMode(GL_TEXTURE);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+    }
+}
+
+void Mesh::bindInstanced() {
+    if (!this->uploaded) {
+        upload();
+    }
+    GLState::bindVertexArray(this->vertexArray);
+}
+
+void Mesh::drawInstances(GLsizei count) {
+    GLsizei indexCount = static_cast<GLsizei>(indices.size());
+
+    if (GLEW_VERSION_3_1) {
+        glDrawElementsInstanced(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT,
+                nullptr, count);
+    } else {
+        glDrawElementsInstancedARB(GL_TRIANGLE_STRIP, indexCount,
+                GL_UNSIGNED_INT, nullptr, count);
+    }
+}
+
+std::size_t Mesh::getNumberOfVertices() {
+    return vertices.size();
+}
+
+std::size_t Mesh::getNumberOfIndices() {
+    return indices.size();
+}
+
+std::size_t Mesh::getNumberOfTriangles() {
+    return this->triangles;
+}
+
+std::size_t Mesh::getMemorySize() {
+    return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(GLuint);
+}
+
+}
@@ -0,0 +1,278 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Occlusion culling methods.
+ */
+
+#include <OcclusionCulling.hpp>
+#include <GLState.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace ge {
+
+/* Frames a visible unit is assumed to stay visible before its next query */
+const unsigned long VisibleQueryInterval = 8;
+
+bool OcclusionCulling::checked = false;
+bool OcclusionCulling::supported = false;
+
+OcclusionCulling::OcclusionCulling() {
+    this->frame = 0;
+    this->issuedQueries = 0;
+    this->waitedQueries = 0;
+    this->skippedSubtrees = 0;
+    this->revealedSubtrees = 0;
+    this->readResults = 0;
+    this->latencyFrames = 0;
+    this->waitSeconds = 0.0;
+}
+
+OcclusionCulling::~OcclusionCulling() {
+    clear();
+}
+
+void OcclusionCulling::clear() {
+    for (auto& unit : units) {
+        if (unit.query != 0) {
+            glDeleteQueries(1, &unit.query);
+        }
+    }
+
+    units.clear();
+    requests.occluded.clear();
+    requests.visible.clear();
+    pendingUnits.clear();
+}
+
+/* Staggered, so the visible units are not all queried on the same frame */
+unsigned int OcclusionCulling::addUnit(unsigned int instance) {
+    Unit unit;
+    unit.instance = instance;
+    unit.query = 0;
+    unit.visible = true;
+    unit.pending = false;
+    unit.issuedFrame = 0;
+    unit.nextQueryFrame = frame + 1 + units.size() % VisibleQueryInterval;
+    units.push_back(unit);
+
+    return static_cast<unsigned int>(units.size());
+}
+
+unsigned int OcclusionCulling::getNumberOfUnits() {
+    return static_cast<unsigned int>(units.size());
+}
+
+void OcclusionCulling::beginFrame() {
+    frame++;
+    issuedQueries = 0;
+    waitedQueries = 0;
+    skippedSubtrees = 0;
+    revealedSubtrees = 0;
+    readResults = 0;
+    latencyFrames = 0;
+    waitSeconds = 0.0;
+
+    std::size_t kept = 0;
+    for (auto index : pendingUnits) {
+        Unit& unit = units[index - 1];
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(unit.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) {
+            pendingUnits[kept++] = index;
+            continue;
+        }
+
+        GLuint samples = 0;
+        glGetQueryObjectuiv(unit.query, GL_QUERY_RESULT, &samples);
+        unit.pending = false;
+        unit.visible = samples > 0;
+        unit.nextQueryFrame = frame + VisibleQueryInterval;
+
+        readResults++;
+        latencyFrames += frame - unit.issuedFrame;
+    }
+    pendingUnits.resize(kept);
+}
+
+bool OcclusionCulling::visit(unsigned int index, const BoundingBox& bounds,
+        const Frustum& frustum, Requests& out) {
+    Unit& unit = units[index - 1];
+
+    /* The depth grows linearly, the nearest corner is the nearest point */
+    GLdouble nearest = frustum.getDepth(bounds.min);
+    for (unsigned int corner = 1; corner < 8; corner++) {
+        GLdouble point[3];
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            point[axis] = (corner & (1u << axis)) ?
+                    bounds.max[axis] : bounds.min[axis];
+        }
+        nearest = std::min(nearest, frustum.getDepth(point));
+    }
+    if (nearest <= 0.0) {
+        unit.visible = true;
+        return true;
+    }
+
+    Request request;
+    request.unit = index;
+    request.bounds = bounds;
+
+    if (!unit.visible) {
+        out.occluded.push_back(request);
+        return false;
+    }
+
+    if (!unit.pending && frame >= unit.nextQueryFrame) {
+        out.visible.push_back(request);
+    }
+    return true;
+}
+
+void OcclusionCulling::addRequests(Requests& in) {
+    skippedSubtrees += static_cast<unsigned int>(in.occluded.size());
+
+    requests.occluded.insert(requests.occluded.end(), in.occluded.begin(),
+            in.occluded.end());
+    requests.visible.insert(requests.visible.end(), in.visible.begin(),
+            in.visible.end());
+    in.occluded.clear();
+    in.visible.clear();
+}
+
+/*
+ * Only the depth test matters: nothing is written, and the pushed bits
+ * restore what GLState shadows (the program is not part of them).
+ * A visible unit was drawn already, its geometry lies inside the box and
+ * often on its faces. The faces are pulled toward the camera and pass on
+ * equal depth, so only what is in front of the box can hide it.
+ */
+void OcclusionCulling::issueQueries() {
+    if (requests.occluded.empty() && requests.visible.empty()) {
+        return;
+    }
+
+    GLState::useProgram(0);
+    glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT
+            | GL_POLYGON_BIT);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(-1.0f, -1.0f);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    /* Waited for first, their results are needed this frame */
+    for (auto& request : requests.occluded) {
+        issue(request);
+    }
+
+    for (auto& request : requests.visible) {
+        issue(request);
+        units[request.unit - 1].pending = true;
+        pendingUnits.push_back(request.unit);
+    }
+    requests.visible.clear();
+
+    glPopAttrib();
+}
+
+void OcclusionCulling::issue(Request& request) {
+    Unit& unit = units[request.unit - 1];
+    if (unit.query == 0) {
+        glGenQueries(1, &unit.query);
+    }
+
+    glBeginQuery(GL_SAMPLES_PASSED, unit.query);
+    drawBox(request.bounds);
+    glEndQuery(GL_SAMPLES_PASSED);
+
+    unit.issuedFrame = frame;
+    issuedQueries++;
+}
+
+void OcclusionCulling::drawBox(const BoundingBox& bounds) {
+    /* Corner i takes max on the axes whose bit is set */
+    static const unsigned int faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 },
+            { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+
+    glBegin(GL_QUADS);
+    for (auto& face : faces) {
+        for (auto corner : face) {
+            glVertex3d((corner & 1) ? bounds.max[0] : bounds.min[0],
+                    (corner & 2) ? bounds.max[1] : bounds.min[1],
+                    (corner & 4) ? bounds.max[2] : bounds.min[2]);
+        }
+    }
+    glEnd();
+}
+
+void OcclusionCulling::collectResults(std::vector<unsigned int>& instances) {
+    if (requests.occluded.empty()) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& request : requests.occluded) {
+        Unit& unit = units[request.unit - 1];
+
+        GLuint samples = 0;
+        glGetQueryObjectuiv(unit.query, GL_QUERY_RESULT, &samples);
+        waitedQueries++;
+
+        if (samples > 0) {
+            unit.visible = true;
+            unit.nextQueryFrame = frame + VisibleQueryInterval;
+            revealedSubtrees++;
+            instances.push_back(unit.instance);
+        }
+    }
+    requests.occluded.clear();
+
+    waitSeconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionCulling::reveal(unsigned int index) {
+    Unit& unit = units[index - 1];
+    unit.visible = true;
+    unit.nextQueryFrame = std::min(unit.nextQueryFrame, frame + 1);
+}
+
+/* Some implementations have the entry points and a 0 bit counter */
+bool OcclusionCulling::isSupported() {
+    if (checked) {
+        return supported;
+    }
+    checked = true;
+
+    if (!GLEW_VERSION_1_5) {
+        return false;
+    }
+
+    GLint bits = 0;
+    glGetQueryiv(GL_SAMPLES_PASSED, GL_QUERY_COUNTER_BITS, &bits);
+    supported = bits > 0;
+    return supported;
+}
+
+void OcclusionCulling::printStatistics(std::ostream& out) {
+    out << issuedQueries << " queries issued, " << waitedQueries
+            << " waited for (" << waitSeconds * 1000.0 << " ms), "
+            << skippedSubtrees - revealedSubtrees << " subtrees skipped and "
+            << revealedSubtrees << " drawn once their query passed, "
+            << readResults << " results read in later frames";
+    if (readResults > 0) {
+        out << " (" << static_cast<double>(latencyFrames) / readResults
+                << " frames late on average)";
+    }
+    out << "." << std::endl;
+}
+
+}
@@ -0,0 +1,231 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Yaf parser microbenchmark methods.
+ */
+
+#include <ParseBenchmark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace ge {
+
+/* Only used to time the reader itself */
+class NullYafHandler: public YafHandler {
+public:
+    unsigned long elements = 0;
+
+    void startElement(const YafElement&) {
+        elements++;
+    }
+
+    void endElement(const YafElement&) {
+    }
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+ParseBenchmark::ParseBenchmark(const std::string& fileName,
+        unsigned iterations) {
+    this->fileName = fileName;
+    this->iterations = iterations > 0 ? iterations : 1;
+    this->numberOfAttributes = 0;
+}
+
+void ParseBenchmark::startElement(const YafElement& element) {
+    Element collected;
+    collected.name.assign(element.getName().data(), element.getName().size());
+
+    for (std::size_t i = 0; i < element.getNumberOfAttributes(); i++) {
+        Xml::Names::Name token = element.getAttributeToken(i);
+        std::string_view value = element.getAttributeValue(i);
+
+        if (token == Xml::Names::Unknown) {
+            continue;
+        }
+
+        /* Only numeric attributes are timed, ids and file names are copied either way */
+        unsigned count = 0;
+        bool inField = false;
+        for (char c : value) {
+            bool space = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+            if (!space && !inField) {
+                count++;
+            }
+            inField = !space;
+        }
+
+        double values[4];
+        if (count < 1 || count > 4
+                || !YafReader::parseNumbers(value, values, count)) {
+            continue;
+        }
+
+        Attribute attribute;
+        attribute.name.assign(Xml::Names::Text[token].data(),
+                Xml::Names::Text[token].size());
+        attribute.value.assign(value.data(), value.size());
+        attribute.token = token;
+        attribute.count = count;
+        collected.attributes.push_back(attribute);
+        numberOfAttributes++;
+    }
+
+    elements.push_back(collected);
+}
+
+void ParseBenchmark::endElement(const YafElement&) {
+}
+
+double ParseBenchmark::timeReader() {
+    YafReader reader;
+    NullYafHandler handler;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        reader.parse(fileName, handler);
+    }
+    return millisecondsSince(start);
+}
+
+/* The old loaders compared the element name with every candidate in turn */
+double ParseBenchmark::timeDispatchBefore(unsigned& found) {
+    std::vector<std::string> names;
+    for (unsigned i = 1; i < Xml::Names::Count; i++) {
+        names.push_back(std::string(Xml::Names::Text[i]));
+    }
+
+    found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        for (const Element& element : elements) {
+            const char* name = element.name.c_str();
+            for (const std::string& candidate : names) {
+                if (candidate == name) {
+                    found++;
+                    break;
+                }
+            }
+        }
+    }
+    return millisecondsSince(start);
+}
+
+double ParseBenchmark::timeDispatchAfter(unsigned& found) {
+    found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        for (const Element& element : elements) {
+            if (Xml::Names::find(element.name) != Xml::Names::Unknown) {
+                found++;
+            }
+        }
+    }
+    return millisecondsSince(start);
+}
+
+/* Attribute found by name compare, then sscanf on the stored string */
+double ParseBenchmark::timeDecodeBefore(double& checksum) {
+    static const char* formats[] = { "", "%lf", "%lf %lf", "%lf %lf %lf",
+            "%lf %lf %lf %lf" };
+
+    checksum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        for (const Element& element : elements) {
+            for (const Attribute& wanted : element.attributes) {
+                const std::string* value = nullptr;
+                for (const Attribute& attribute : element.attributes) {
+                    if (attribute.name == wanted.name) {
+                        value = &attribute.value;
+                        break;
+                    }
+                }
+
+                double v[4] = { 0.0, 0.0, 0.0, 0.0 };
+                sscanf(value->c_str(), formats[wanted.count], &v[0], &v[1],
+                        &v[2], &v[3]);
+                checksum += v[0] + v[1] + v[2] + v[3];
+            }
+        }
+    }
+    return millisecondsSince(start);
+}
+
+/* Attribute found by token, then from_chars on the value in place */
+double ParseBenchmark::timeDecodeAfter(double& checksum) {
+    checksum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        for (const Element& element : elements) {
+            for (const Attribute& wanted : element.attributes) {
+                const std::string* value = nullptr;
+                for (const Attribute& attribute : element.attributes) {
+                    if (attribute.token == wanted.token) {
+                        value = &attribute.value;
+                        break;
+                    }
+                }
+
+                double v[4] = { 0.0, 0.0, 0.0, 0.0 };
+                YafReader::parseNumbers(*value, v, wanted.count);
+                checksum += v[0] + v[1] + v[2] + v[3];
+            }
+        }
+    }
+    return millisecondsSince(start);
+}
+
+bool ParseBenchmark::run() {
+    elements.clear();
+    numberOfAttributes = 0;
+
+    YafReader reader;
+    if (!reader.parse(fileName, *this)) {
+        std::cerr << "Could not open [" << fileName << "]." << std::endl;
+        return false;
+    }
+
+    std::cout << "Parse benchmark [" << fileName << "]: " << elements.size()
+            << " elements, " << numberOfAttributes << " numeric attributes, "
+            << iterations << " iterations." << std::endl;
+
+    double readerTime = timeReader();
+    std::cout << "Reader: " << readerTime / iterations << " ms per pass."
+            << std::endl;
+
+    unsigned foundBefore, foundAfter;
+    double dispatchBefore = timeDispatchBefore(foundBefore);
+    double dispatchAfter = timeDispatchAfter(foundAfter);
+
+    double elementCount = static_cast<double>(elements.size()) * iterations;
+    std::cout << "Element dispatch: before "
+            << elementCount / dispatchBefore * 1000.0 << "/s, after "
+            << elementCount / dispatchAfter * 1000.0 << "/s ("
+            << dispatchBefore / dispatchAfter << "x)." << std::endl;
+
+    double checksumBefore, checksumAfter;
+    double decodeBefore = timeDecodeBefore(checksumBefore);
+    double decodeAfter = timeDecodeAfter(checksumAfter);
+
+    double attributeCount = static_cast<double>(numberOfAttributes)
+            * iterations;
+    std::cout << "Attributes decoded: before "
+            << attributeCount / decodeBefore * 1000.0 << "/s, after "
+            << attributeCount / decodeAfter * 1000.0 << "/s ("
+            << decodeBefore / decodeAfter << "x)." << std::endl;
+
+    if (foundBefore != foundAfter || checksumBefore != checksumAfter) {
+        std::cout << "Warning: the two paths do not agree." << std::endl;
+    }
+
+    return true;
+}
+
+}
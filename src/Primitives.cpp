@@ -5,7 +5,10 @@
  */
 
 #include <Primitives.hpp>
+#include <GeometryCache.hpp>
+#include <GLState.hpp>
 
+#include <algorithm>
 #include <cmath>
 
 namespace ge {
@@ -13,58 +16,15 @@ namespace Primitives {
 
 const std::string ShaderFolder = "shaders/";
 
-/* Copy from GLUT
- * Compute lookup table of cos and sin values forming a circle
- *
- * Notes:
- *    It is the responsibility of the caller to free these tables
- *    The size of the table is (n+1) to form a connected loop
- *    The last entry is exactly the same as the first
- *    The sign of n can be flipped to get the reverse loop
- */
-
-/* Primitive super class */
-void PrimitiveInterface::fghCircleTable(double **sint, double **cost,
-        const int n) {
-    int i;
-
-    /* Table size, the sign of n flips the circle direction */
-
-    const int size = abs(n);
-
-    /* Determine the angle between samples */
-
-    const double angle = 2 * M_PI / (double) ((n == 0) ? 1 : n);
-
-    /* Allocate memory for n samples, plus duplicate of first entry at the end */
-
-    *sint = (double *) calloc(sizeof(double), size + 1);
-    *cost = (double *) calloc(sizeof(double), size + 1);
-
-    /* Bail out if memory allocation fails */
+/* Fewest slices (and loops) a coarser level may have */
+const int MinLevelSlices = 4;
 
-    if (!(*sint) || !(*cost)) {
-        free(*sint);
-        free(*cost);
-        throw Exception("Failed to allocate memory in fghCircleTable.", true);
-    }
-
-    /* Compute cos and sin around the circle */
-
-    (*sint)[0] = 0.0;
-    (*cost)[0] = 1.0;
-
-    for (i = 1; i < size; i++) {
-        (*sint)[i] = sin(angle * i);
-        (*cost)[i] = cos(angle * i);
-    }
-
-    /* Last sample is duplicate of the first */
-
-    (*sint)[size] = (*sint)[0];
-    (*cost)[size] = (*cost)[0];
+/* Largest gap between a circle and a polygon of segments sides inscribed in it */
+static GLdouble chordError(GLdouble radius, int segments) {
+    return radius * (1.0 - cos(M_PI / segments));
 }
 
+/* Primitive super class */
 void PrimitiveInterface::calculateNormal(GLdouble v[3][3], GLdouble out[3]) // Calculates Normal For A Quad Using 3 Points
         {
     GLdouble v1[3], v2[3];                // Vector 1 (x,y,z) & Vector 2 (x,y,z)
@@ -108,6 +68,37 @@ void PrimitiveInterface::NormalizeVector(GLdouble vector[3]) {
     vector[2] /= length;
 }
 
+bool PrimitiveInterface::hasShader() {
+    return false;
+}
+
+bool PrimitiveInterface::isStatic() {
+    return true;
+}
+
+Mesh* PrimitiveInterface::getMesh(GLdouble&, GLdouble&) {
+    return nullptr;
+}
+
+std::size_t PrimitiveInterface::getNumberOfTriangles() {
+    GLdouble s = 1.0, t = 1.0;
+    Mesh* mesh = getMesh(s, t);
+    return mesh != nullptr ? mesh->getNumberOfTriangles() : 0;
+}
+
+unsigned int PrimitiveInterface::getNumberOfLevels() {
+    return 1;
+}
+
+Mesh* PrimitiveInterface::getLevelMesh(unsigned int) {
+    GLdouble s = 1.0, t = 1.0;
+    return getMesh(s, t);
+}
+
+GLdouble PrimitiveInterface::getLevelError(unsigned int) {
+    return 0.0;
+}
+
 PrimitiveInterface::~PrimitiveInterface() {
 }
 
@@ -125,7 +116,7 @@ Rectangle::Rectangle(xyPointDouble pt1, xyPointDouble pt2) {
     x2 = pt2.x;
     y2 = pt2.y;
 
-    /* end */
+    shareMesh();
 }
 
 Rectangle::Rectangle(GLdouble inX0, GLdouble inY0, GLdouble inX1,
@@ -142,42 +133,56 @@ Rectangle::Rectangle(GLdouble inX0, GLdouble inY0, GLdouble inX1,
     x2 = inX1;
     y2 = inY1;
 
-    /* end */
+    shareMesh();
 }
 
 Rectangle::~Rectangle() {
 
 }
 
-void Rectangle::draw(GLdouble s, GLdouble t) {
-    glEnable(GL_TEXTURE_2D);
-    glPushMatrix();
-    glBegin(GL_POLYGON);
+void Rectangle::shareMesh() {
+    this->mesh = GeometryCache::getMesh(GeometryCache::TypeRectangle, { x1,
+            y1, x2, y2 }, [this](Mesh& out) {
+        buildMesh(out);
+    });
+}
+
+/* Texture coordinates for texture lengths of 1, draw scales them */
+void Rectangle::buildMesh(Mesh& out) {
+    GLuint corners[4];
+
     if ((this->y2 < this->y1) && (this->x2 < this->x1)) {
-        glNormal3d(0.0, 0.0, -1.0);
-        glTexCoord2f(0.0, 0.0);
-        glVertex3d(this->x2, this->y2, 0.0);
-        glTexCoord2d((this->x1 - this->x2) / s, 0.0);
-        glVertex3d(this->x1, this->y2, 0.0);
-        glTexCoord2d((this->x2 - this->x1) / s, (this->y2 - this->y1) / t);
-        glVertex3d(this->x1, this->y1, 0.0);
-        glTexCoord2d(0.0, (this->y2 - this->y1) / t);
-        glVertex3d(this->x2, this->y1, 0.0);
+        corners[0] = out.addVertex(x2, y2, 0, 0, 0, -1, 0, 0);
+        corners[1] = out.addVertex(x1, y2, 0, 0, 0, -1, x1 - x2, 0);
+        corners[2] = out.addVertex(x1, y1, 0, 0, 0, -1, x2 - x1, y2 - y1);
+        corners[3] = out.addVertex(x2, y1, 0, 0, 0, -1, 0, y2 - y1);
     } else {
-        glNormal3d(0.0, 0.0, 1.0);
-        glTexCoord2d(0.0, 0.0);
-        glVertex3d(this->x1, this->y1, 0.0);
-        glTexCoord2d((this->x2 - this->x1) / s, 0.0);
-        glVertex3d(this->x2, this->y1, 0.0);
-        glTexCoord2d((this->x2 - this->x1) / s, (this->y2 - this->y1) / t);
-        glVertex3d(this->x2, this->y2, 0.0);
-        glTexCoord2d(0.0, (this->y2 - this->y1) / t);
-        glVertex3d(this->x1, this->y2, 0.0);
-    }
-
-    glEnd();
-    glPopMatrix();
-    glDisable(GL_TEXTURE_2D);
+        corners[0] = out.addVertex(x1, y1, 0, 0, 0, 1, 0, 0);
+        corners[1] = out.addVertex(x2, y1, 0, 0, 0, 1, x2 - x1, 0);
+        corners[2] = out.addVertex(x2, y2, 0, 0, 0, 1, x2 - x1, y2 - y1);
+        corners[3] = out.addVertex(x1, y2, 0, 0, 0, 1, 0, y2 - y1);
+    }
+
+    /* Split along 0-2, like the polygon was */
+    out.addIndex(corners[1]);
+    out.addIndex(corners[2]);
+    out.addIndex(corners[0]);
+    out.addIndex(corners[3]);
+}
+
+/* Texturing is left to the appearance, an untextured one has it disabled */
+void Rectangle::draw(GLdouble s, GLdouble t) {
+    mesh->draw(s, t);
+}
+
+Mesh* Rectangle::getMesh(GLdouble&, GLdouble&) {
+    return mesh.get();
+}
+
+void Rectangle::getBounds(BoundingBox& out) {
+    out.setEmpty();
+    out.merge(this->x1, this->y1, 0.0);
+    out.merge(this->x2, this->y2, 0.0);
 }
 
 /* Triangle primitive */
@@ -195,6 +200,8 @@ Triangle::Triangle(GLdouble inX1, GLdouble inY1, GLdouble inZ1, GLdouble inX2,
     this->point3[0] = inX3;
     this->point3[1] = inY3;
     this->point3[2] = inZ3;
+
+    shareMesh();
 }
 
 Triangle::Triangle(xyzPointDouble pt1, xyzPointDouble pt2, xyzPointDouble pt3) {
@@ -215,47 +222,100 @@ Triangle::Triangle(xyzPointDouble pt1, xyzPointDouble pt2, xyzPointDouble pt3) {
             this->point2[2] }, { this->point3[0], this->point3[1],
             this->point3[2] } };
     calculateNormal(pontos, normal);
+
+    shareMesh();
 }
 
 Triangle::~Triangle() {
 
 }
 
+/* The normal follows from the points */
+void Triangle::shareMesh() {
+    this->mesh = GeometryCache::getMesh(GeometryCache::TypeTriangle, {
+            point1[0], point1[1], point1[2], point2[0], point2[1], point2[2],
+            point3[0], point3[1], point3[2] }, [this](Mesh& out) {
+        buildMesh(out);
+    });
+}
+
+/* Texture coordinates for texture lengths of 1, draw scales them */
+void Triangle::buildMesh(Mesh& out) {
+    GLdouble s2 = std::abs(
+            (point2[0] - point1[0]) * normal[2]
+                    + (point2[0] - point1[0]) * normal[1]
+                    + (point2[2] - point1[2]) * normal[0]);
+    GLdouble s3 = std::abs(
+            (point3[0] - point1[0]) * normal[2]
+                    + (point3[0] - point1[0]) * normal[1]
+                    + (point3[2] - point1[2]) * normal[0]);
+    GLdouble t3 = std::abs(
+            (point3[1] - point1[1]) * normal[2]
+                    + (point3[0] - point1[0]) * normal[1]
+                    + (point3[1] - point1[1]) * normal[0]);
+
+    out.addIndex(
+            out.addVertex(point1[0], point1[1], point1[2], normal[0],
+                    normal[1], normal[2], 0, 0));
+    out.addIndex(
+            out.addVertex(point2[0], point2[1], point2[2], normal[0],
+                    normal[1], normal[2], s2, 0));
+    out.addIndex(
+            out.addVertex(point3[0], point3[1], point3[2], normal[0],
+                    normal[1], normal[2], s3, t3));
+}
+
 void Triangle::draw(GLdouble s, GLdouble t) {
-    glEnable(GL_TEXTURE_2D);
-    glPushMatrix();
-    glBegin(GL_TRIANGLES);
-    glNormal3d(normal[0], normal[1], normal[2]);
-    glTexCoord2d(0.0, 0.0);
-    glVertex3d(this->point1[0], this->point1[1], this->point1[2]);
-
-    glTexCoord2d(
-            abs(
-                    (this->point2[0] - this->point1[0]) / s * normal[2]
-                            + (this->point2[0] - this->point1[0]) / s
-                                    * normal[1]
-                            + (this->point2[2] - this->point1[2]) / s
-                                    * normal[0]), 0.0);
-    glVertex3d(this->point2[0], this->point2[1], this->point2[2]);
-
-    glTexCoord2d(
-            abs(
-                    (this->point3[0] - this->point1[0]) / s * normal[2]
-                            + (this->point3[0] - this->point1[0]) / s
-                                    * normal[1]
-                            + (this->point3[2] - this->point1[2]) / s
-                                    * normal[0]),
-            abs(
-                    (this->point3[1] - this->point1[1]) / t * normal[2]
-                            + (this->point3[0] - this->point1[0]) / t
-                                    * normal[1]
-                            + (this->point3[1] - this->point1[1]) / t
-                                    * normal[0]));
-    glVertex3d(this->point3[0], this->point3[1], this->point3[2]);
-
-    glEnd();
-    glPopMatrix();
-    glDisable(GL_TEXTURE_2D);
+    mesh->draw(s, t);
+}
+
+Mesh* Triangle::getMesh(GLdouble&, GLdouble&) {
+    return mesh.get();
+}
+
+void Triangle::getBounds(BoundingBox& out) {
+    out.setEmpty();
+    out.merge(this->point1[0], this->point1[1], this->point1[2]);
+    out.merge(this->point2[0], this->point2[1], this->point2[2]);
+    out.merge(this->point3[0], this->point3[1], this->point3[2]);
+}
+
+/* Tessellated primitives */
+TessellatedPrimitive::TessellatedPrimitive() {
+    this->numberOfLevels = 0;
+}
+
+TessellatedPrimitive::~TessellatedPrimitive() {
+
+}
+
+void TessellatedPrimitive::addLevel(std::shared_ptr<Mesh> mesh,
+        GLdouble error) {
+    levels[numberOfLevels] = mesh;
+    errors[numberOfLevels] = error;
+    numberOfLevels++;
+}
+
+void TessellatedPrimitive::draw(GLdouble, GLdouble) {
+    levels[0]->draw();
+}
+
+Mesh* TessellatedPrimitive::getMesh(GLdouble& s, GLdouble& t) {
+    s = 1.0;
+    t = 1.0;
+    return levels[0].get();
+}
+
+unsigned int TessellatedPrimitive::getNumberOfLevels() {
+    return this->numberOfLevels;
+}
+
+Mesh* TessellatedPrimitive::getLevelMesh(unsigned int level) {
+    return levels[level].get();
+}
+
+GLdouble TessellatedPrimitive::getLevelError(unsigned int level) {
+    return errors[level];
 }
 
 /* Cylinder primitive */
@@ -267,154 +327,109 @@ Cylinder::Cylinder(GLdouble iBase, GLdouble iTop, GLdouble iHeight,
     this->slices = iSlices;
     this->stacks = iStacks;
 
-    this->angleStep = 2 * M_PI / slices;
-
-    /* Precalc */
-
-    /* Allocs */
-    sinCache = (double *) calloc(sizeof(double), slices + 1);
-    cosCache = (double *) calloc(sizeof(double), slices + 1);
-    sinCache2 = (double *) calloc(sizeof(double), slices + 1);
-    cosCache2 = (double *) calloc(sizeof(double), slices + 1);
-    sinCache3 = (double *) calloc(sizeof(double), slices + 1);
-    cosCache3 = (double *) calloc(sizeof(double), slices + 1);
-
-    GLdouble angle;
-    GLdouble length;
-
-    GLdouble xyNormalRatio;
-
     if (slices < 2 || stacks < 1 || baseRadius < 0.0 || topRadius < 0.0
             || height < 0.0) {
         throw Exception("Invalid values fed to geCylinder.", true);
     }
 
-    /* Compute length (needed for normal calculations) */
-    deltaRadius = baseRadius - topRadius;
-    length = sqrt(deltaRadius * deltaRadius + height * height);
-
-    if (length == 0.0) {
+    /* Needed for the normals */
+    GLdouble deltaRadius = baseRadius - topRadius;
+    if (deltaRadius == 0.0 && height == 0.0) {
         throw Exception("Invalid values fed to geCylinder", true);
     }
 
-    zNormal = deltaRadius / length;
-    xyNormalRatio = height / length;
-
-    for (int i = 0; i < slices; i++) {
-        angle = 2 * M_PI * i / slices;
-
-        sinCache[i] = sin(angle);
-        cosCache[i] = cos(angle);
-
-        sinCache2[i] = xyNormalRatio * sin(angle);
-        cosCache2[i] = xyNormalRatio * cos(angle);
+    /* The sides are straight, only the slices bend */
+    GLdouble radius = std::max(baseRadius, topRadius);
+    for (unsigned int level = 0; level < MaxLevels; level++) {
+        int levelSlices = slices >> level;
+        int levelStacks = std::max(stacks >> level, 1);
+        if (level > 0 && levelSlices < MinLevelSlices) {
+            break;
+        }
 
-        sinCache3[i] = xyNormalRatio * sin(angle);
-        cosCache3[i] = xyNormalRatio * cos(angle);
+        addLevel(
+                GeometryCache::getMesh(GeometryCache::TypeCylinder, {
+                        baseRadius, topRadius, height, (double) levelSlices,
+                        (double) levelStacks },
+                        [this, levelSlices, levelStacks](Mesh& out) {
+                            buildMesh(out, levelSlices, levelStacks);
+                        }, level > 0), chordError(radius, levelSlices));
     }
-
-    sinCache[slices] = sinCache[0];
-    cosCache[slices] = cosCache[0];
-    sinCache2[slices] = sinCache2[0];
-    cosCache2[slices] = cosCache2[0];
-    sinCache3[slices] = sinCache3[0];
-    cosCache3[slices] = cosCache3[0];
-
-    this->deltaAngle = 2.0 * M_PI / (this->slices);
 }
 
-void Cylinder::draw(GLdouble, GLdouble) {
-    glPushMatrix();
+/* Caps first, then one strip per stack */
+void Cylinder::buildMesh(Mesh& out, int levelSlices, int levelStacks) {
+    const GeometryCache::CircleTable& circle = GeometryCache::getCircleTable(
+            levelSlices);
 
-    GLdouble radiusLow, radiusHigh;
-    GLdouble zLow, zHigh;
+    GLdouble deltaRadius = baseRadius - topRadius;
+    GLdouble length = sqrt(deltaRadius * deltaRadius + height * height);
+    GLdouble zNormal = deltaRadius / length;
+    GLdouble xyNormalRatio = height / length;
 
-    /* Cover the base and top */
     if (baseRadius > 0.0) {
-        drawCircle(this->baseRadius);
+        addCap(out, circle, levelSlices, this->baseRadius, 0.0, -1.0);
     }
 
-    /* Top needs a translation */
     if (topRadius > 0.0) {
-        glPushMatrix();
-        glTranslated(0, 0, this->height);
-        drawCircle(this->topRadius);
-        glPopMatrix();
-    }
-
-    for (int j = 0; j < stacks; j++) {
-        zLow = j * height / stacks;
-        zHigh = (j + 1) * height / stacks;
-        radiusLow = baseRadius - deltaRadius * ((float) j / (float) stacks);
-        radiusHigh = baseRadius
-                - deltaRadius * ((float) (j + 1) / (float) stacks);
-
-        glBegin(GL_QUAD_STRIP);
-        for (int i = 0; i <= slices; i++) {
-            glNormal3d(sinCache2[i], cosCache2[i], zNormal);
-
-            glTexCoord2d(1 - (GLdouble) i / slices,
-                    (GLdouble) j / (GLdouble) stacks);
-            glVertex3d(radiusLow * sinCache[i], radiusLow * cosCache[i], zLow);
-            glTexCoord2d(1 - (GLdouble) i / slices,
-                    (GLdouble) (j + 1) / (GLdouble) stacks);
-            glVertex3d(radiusHigh * sinCache[i], radiusHigh * cosCache[i],
-                    zHigh);
+        addCap(out, circle, levelSlices, this->topRadius, this->height, 1.0);
+    }
+
+    /* Rows of slices + 1 vertices, the last one repeats the first with s = 0 */
+    GLuint firstRow = static_cast<GLuint>(out.getNumberOfVertices());
+    for (int j = 0; j <= levelStacks; j++) {
+        GLdouble z = j * height / levelStacks;
+        GLdouble radius = baseRadius
+                - deltaRadius * ((float) j / (float) levelStacks);
+
+        for (int i = 0; i <= levelSlices; i++) {
+            out.addVertex(radius * circle.sin[i], radius * circle.cos[i], z,
+                    xyNormalRatio * circle.sin[i],
+                    xyNormalRatio * circle.cos[i], zNormal,
+                    1 - (GLdouble) i / levelSlices,
+                    (GLdouble) j / (GLdouble) levelStacks);
         }
     }
-    glEnd();
 
-    glPopMatrix();
+    for (int j = 0; j < levelStacks; j++) {
+        GLuint low = firstRow + j * (levelSlices + 1);
+        GLuint high = low + levelSlices + 1;
 
+        out.beginStrip();
+        for (int i = 0; i <= levelSlices; i++) {
+            out.addIndex(low + i);
+            out.addIndex(high + i);
+        }
+    }
 }
 
-/* Needs optimizations */
-void Cylinder::drawCircle(GLdouble radius) {
-    GLdouble vertex[4];
-    GLdouble texcoord[2];
-
-    glBegin(GL_TRIANGLE_FAN);
+/* Along z, from the base (z = 0) to the top */
+void Cylinder::getBounds(BoundingBox& out) {
+    GLdouble radius = std::max(this->baseRadius, this->topRadius);
 
-    /* draw the vertex at the center of the circle */
-    texcoord[0] = 0.5;
-    texcoord[1] = 0.5;
-    glTexCoord2dv(texcoord);
-
-    vertex[0] = vertex[1] = vertex[2] = 0.0;
-    vertex[3] = 1.0;
-    glVertex4dv(vertex);
+    out.setEmpty();
+    out.merge(-radius, -radius, 0.0);
+    out.merge(radius, radius, this->height);
+}
 
-    for (int i = 0; i < this->slices; i++) {
-        texcoord[0] = (cosCache[i] + 1.0) * 0.5;
-        texcoord[1] = (sinCache[i] + 1.0) * 0.5;
-        glTexCoord2dv(texcoord);
+void Cylinder::addCap(Mesh& out, const GeometryCache::CircleTable& circle,
+        int levelSlices, GLdouble radius, GLdouble z, GLdouble normalZ) {
+    GLuint center = out.addVertex(0, 0, z, 0, 0, normalZ, 0.5, 0.5);
 
-        vertex[0] = cosCache[i] * radius;
-        vertex[1] = sinCache[i] * radius;
-        vertex[2] = 0.0;
-        vertex[3] = 1.0;
-        glVertex4dv(vertex);
+    std::vector<GLuint> rim;
+    for (int i = 0; i < levelSlices; i++) {
+        rim.push_back(
+                out.addVertex(circle.cos[i] * radius, circle.sin[i] * radius,
+                        z, 0, 0, normalZ, (circle.cos[i] + 1.0) * 0.5,
+                        (circle.sin[i] + 1.0) * 0.5));
     }
+    rim.push_back(rim.front());
 
-    texcoord[0] = (1.0 + 1.0) * 0.5;
-    texcoord[1] = (0.0 + 1.0) * 0.5;
-    glTexCoord2dv(texcoord);
-
-    vertex[0] = 1.0 * radius;
-    vertex[1] = 0.0 * radius;
-    vertex[2] = 0.0;
-    vertex[3] = 1.0;
-    glVertex4dv(vertex);
-    glEnd();
+    out.addFan(center, rim);
 }
 
 Cylinder::~Cylinder() {
-    free(sinCache);
-    free(cosCache);
-    free(sinCache2);
-    free(cosCache2);
-    free(sinCache3);
-    free(cosCache3);
+
 }
 
 /* Sphere primitive */
@@ -423,96 +438,86 @@ Sphere::Sphere(GLdouble iRadius, int iSlices, int iStacks) {
     this->slices = iSlices;
     this->stacks = iStacks;
 
-    fghCircleTable(&sint1, &cost1, -this->slices);
-    fghCircleTable(&sint2, &cost2, this->stacks * 2);
-}
-
-void Sphere::draw(GLdouble, GLdouble) {
-    glPushMatrix();
-
-    int i, j;
-
-    /* Adjust z and radius as stacks are drawn. */
-
-    double z0, z1;
-    double r0, r1;
-
-    z0 = 1.0;
-    z1 = cost2[(stacks > 0) ? 1 : 0];
-    r0 = 0.0;
-    r1 = sint2[(stacks > 0) ? 1 : 0];
-
-    glBegin(GL_TRIANGLE_FAN);
-
-    glNormal3d(0, 0, 1);
-    glVertex3d(0, 0, radius);
+    /* Stacks go half way around, slices all the way */
+    for (unsigned int level = 0; level < MaxLevels; level++) {
+        int levelSlices = slices >> level;
+        int levelStacks = std::max(stacks >> level, std::min(stacks, 2));
+        if (level > 0 && levelSlices < MinLevelSlices) {
+            break;
+        }
 
-    for (j = slices; j >= 0; j--) {
-        glNormal3d(cost1[j] * r1, sint1[j] * r1, z1);
-        glTexCoord3d(cost1[j] * r1 * radius, sint1[j] * r1 * radius,
-                z1 * radius);
-        glVertex3d(cost1[j] * r1 * radius, sint1[j] * r1 * radius, z1 * radius);
+        addLevel(
+                GeometryCache::getMesh(GeometryCache::TypeSphere, { radius,
+                        (double) levelSlices, (double) levelStacks },
+                        [this, levelSlices, levelStacks](Mesh& out) {
+                            buildMesh(out, levelSlices, levelStacks);
+                        }, level > 0),
+                std::max(chordError(radius, levelSlices),
+                        chordError(radius, levelStacks * 2)));
     }
+}
 
-    glEnd();
-
-    /* Cover each stack with a quad strip, except the top and bottom stacks */
-
-    for (i = 1; i < stacks - 1; i++) {
-        z0 = z1;
-        z1 = cost2[i + 1];
-        r0 = r1;
-        r1 = sint2[i + 1];
-
-        glBegin(GL_QUAD_STRIP);
-
-        for (j = 0; j <= slices; j++) {
+/* Fans at the poles, a strip per stack in between */
+void Sphere::buildMesh(Mesh& out, int levelSlices, int levelStacks) {
+    /* Around (backwards) and from pole to pole */
+    const GeometryCache::CircleTable& around = GeometryCache::getCircleTable(
+            -levelSlices);
+    const GeometryCache::CircleTable& along = GeometryCache::getCircleTable(
+            levelStacks * 2);
 
-            glNormal3d(cost1[j] * r1, sint1[j] * r1, z1);
-            glTexCoord3d(cost1[j] * r1 * radius, sint1[j] * r1 * radius,
-                    z1 * radius);
+    /* Rings the fans and strips use, texture coordinates are x and y */
+    int firstRing = (levelStacks > 0) ? 1 : 0;
+    int lastRing = (levelStacks > 1) ? levelStacks - 1 : firstRing;
 
-            glVertex3d(cost1[j] * r1 * radius, sint1[j] * r1 * radius,
-                    z1 * radius);
-            glNormal3d(cost1[j] * r0, sint1[j] * r0, z0);
+    GLuint rings = static_cast<GLuint>(out.getNumberOfVertices());
+    for (int i = firstRing; i <= lastRing; i++) {
+        for (int j = 0; j <= levelSlices; j++) {
+            GLdouble x = around.cos[j] * along.sin[i];
+            GLdouble y = around.sin[j] * along.sin[i];
+            GLdouble z = along.cos[i];
 
-            glTexCoord3d(cost1[j] * r0 * radius, sint1[j] * r0 * radius,
-                    z0 * radius);
-            glVertex3d(cost1[j] * r0 * radius, sint1[j] * r0 * radius,
-                    z0 * radius);
+            out.addVertex(x * radius, y * radius, z * radius, x, y, z,
+                    x * radius, y * radius);
         }
-
-        glEnd();
     }
 
-    /* The bottom stack is covered with a triangle fan */
-
-    z0 = z1;
-    r0 = r1;
+    std::vector<GLuint> rim;
 
-    glBegin(GL_TRIANGLE_FAN);
+    GLuint top = out.addVertex(0, 0, radius, 0, 0, 1, 0, 0);
+    GLuint ring = rings;
+    for (int j = levelSlices; j >= 0; j--) {
+        rim.push_back(ring + j);
+    }
+    out.addFan(top, rim);
 
-    glNormal3d(0, 0, -1);
-    glVertex3d(0, 0, -radius);
+    for (int i = 1; i < levelStacks - 1; i++) {
+        GLuint upper = rings + (i - firstRing) * (levelSlices + 1);
+        GLuint lower = upper + levelSlices + 1;
 
-    for (j = 0; j <= slices; j++) {
-        glNormal3d(cost1[j] * r0, sint1[j] * r0, z0);
-        glTexCoord3d(cost1[j] * r0 * radius, sint1[j] * r0 * radius,
-                z0 * radius);
-        glVertex3d(cost1[j] * r0 * radius, sint1[j] * r0 * radius, z0 * radius);
+        out.beginStrip();
+        for (int j = 0; j <= levelSlices; j++) {
+            out.addIndex(lower + j);
+            out.addIndex(upper + j);
+        }
     }
 
-    glEnd();
+    GLuint bottom = out.addVertex(0, 0, -radius, 0, 0, -1, 0, 0);
+    ring = rings + (lastRing - firstRing) * (levelSlices + 1);
+    rim.clear();
+    for (int j = 0; j <= levelSlices; j++) {
+        rim.push_back(ring + j);
+    }
+    out.addFan(bottom, rim);
+}
 
-    glPopMatrix();
+void Sphere::getBounds(BoundingBox& out) {
+    out.setEmpty();
+    out.merge(-this->radius, -this->radius, -this->radius);
+    out.merge(this->radius, this->radius, this->radius);
 }
 
 Sphere::~Sphere() {
-    /* Release sin and cos tables */
-    free(sint1);
-    free(cost1);
-    free(sint2);
-    free(cost2);
+
 }
 
 /* Torus primitive */
@@ -535,68 +540,72 @@ Torus::Torus(GLdouble iInner, GLdouble iOuter, int iSlices, int iLoops) {
     slices++;
     loops++;
 
-    /* Allocate the vertices array */
-    vertex = (double *) calloc(sizeof(double), 3 * slices * loops);
-    normal = (double *) calloc(sizeof(double), 3 * slices * loops);
-
-    /* Precalc */
-    double dpsi, dphi;
-    double spsi, cpsi, sphi, cphi;
-    double phi, psi;
-
-    dpsi = 2.0 * M_PI / (double) (loops - 1);
-    dphi = -2.0 * M_PI / (double) (slices - 1);
-
-    psi = 0.0;
-
-    for (int j = 0; j < loops; j++) {
-        cpsi = cos(psi);
-        spsi = sin(psi);
-        phi = 0.0;
-
-        for (int i = 0; i < slices; i++) {
-            int offset = 3 * (j * slices + i);
-            cphi = cos(phi);
-            sphi = sin(phi);
-            *(vertex + offset + 0) = cpsi * (outer + cphi * inner);
-            *(vertex + offset + 1) = spsi * (outer + cphi * inner);
-            *(vertex + offset + 2) = sphi * inner;
-            *(normal + offset + 0) = cpsi * cphi;
-            *(normal + offset + 1) = spsi * cphi;
-            *(normal + offset + 2) = sphi;
-            phi += dphi;
+    /* The tube and the ring around it both bend */
+    for (unsigned int level = 0; level < MaxLevels; level++) {
+        int levelSlices = ((slices - 1) >> level) + 1;
+        int levelLoops = ((loops - 1) >> level) + 1;
+        if (level > 0
+                && std::min(levelSlices, levelLoops) - 1 < MinLevelSlices) {
+            break;
         }
 
-        psi += dpsi;
+        addLevel(
+                GeometryCache::getMesh(GeometryCache::TypeTorus, { inner,
+                        outer, (double) levelSlices, (double) levelLoops },
+                        [this, levelSlices, levelLoops](Mesh& out) {
+                            buildMesh(out, levelSlices, levelLoops);
+                        }, level > 0),
+                chordError(inner, levelSlices - 1)
+                        + chordError(outer + inner, levelLoops - 1));
     }
-    /* End precalcs */
 }
 
 Torus::~Torus() {
-    free(vertex);
-    free(normal);
+
 }
 
-void Torus::draw(GLdouble, GLdouble) {
-    glPushMatrix();
+/* A strip along the loops for each slice */
+void Torus::buildMesh(Mesh& out, int levelSlices, int levelLoops) {
+    double dpsi = 2.0 * M_PI / (double) (levelLoops - 1);
+    double dphi = -2.0 * M_PI / (double) (levelSlices - 1);
+
+    double psi = 0.0;
+
+    for (int j = 0; j < levelLoops; j++) {
+        double cpsi = cos(psi);
+        double spsi = sin(psi);
+        double phi = 0.0;
 
-    glBegin(GL_QUADS);
-    for (int i = 0; i < slices - 1; i++) {
-        for (int j = 0; j < loops - 1; j++) {
-            int offset = 3 * (j * slices + i);
-            glNormal3dv(normal + offset);
-            glVertex3dv(vertex + offset);
-            glNormal3dv(normal + offset + 3);
-            glVertex3dv(vertex + offset + 3);
-            glNormal3dv(normal + offset + 3 * slices + 3);
-            glVertex3dv(vertex + offset + 3 * slices + 3);
-            glNormal3dv(normal + offset + 3 * slices);
-            glVertex3dv(vertex + offset + 3 * slices);
+        for (int i = 0; i < levelSlices; i++) {
+            double cphi = cos(phi);
+            double sphi = sin(phi);
+
+            out.addVertex(cpsi * (outer + cphi * inner),
+                    spsi * (outer + cphi * inner), sphi * inner, cpsi * cphi,
+                    spsi * cphi, sphi, (GLdouble) i / (levelSlices - 1),
+                    (GLdouble) j / (levelLoops - 1));
+            phi += dphi;
         }
+
+        psi += dpsi;
     }
-    glEnd();
 
-    glPopMatrix();
+    for (int i = 0; i < levelSlices - 1; i++) {
+        out.beginStrip();
+        for (int j = 0; j < levelLoops; j++) {
+            out.addIndex(j * levelSlices + i);
+            out.addIndex(j * levelSlices + i + 1);
+        }
+    }
+}
+
+/* Ring around z */
+void Torus::getBounds(BoundingBox& out) {
+    GLdouble radius = this->outer + this->inner;
+
+    out.setEmpty();
+    out.merge(-radius, -radius, -this->inner);
+    out.merge(radius, radius, this->inner);
 }
 
 /* Plane primitive */
@@ -607,6 +616,10 @@ GLdouble Plane::planeGrid[4][4][3] = { { { -0.5, 0.0, -0.5 }, { -0.125, 0.0,
         0.0, 0.125 }, { 0.5, 0.0, 0.125 } }, { { -0.5, 0.0, 0.5 }, { -0.125,
         0.0, 0.5 }, { 0.125, 0.0, 0.5 }, { 0.5, 0.0, 0.5 } } };
 
+/* Same mapping as the patch */
+GLdouble Plane::texturePoints[4][2] = { { 0.0, 0.0 }, { 0.0, 1.0 },
+        { 1.0, 0.0 }, { 1.0, 1.0 } };
+
 Plane::Plane(unsigned int parts) {
     this->partsPerAxis = parts;
     this->evaluatorOrder = 4;
@@ -617,15 +630,33 @@ Plane::~Plane() {
 
 }
 
+/* Normals and texture coordinates are evaluated too, never left to the previous primitive */
 void Plane::draw(GLdouble, GLdouble) {
-    glEnable(GL_MAP2_VERTEX_3);
+    GLState::enable(GL_MAP2_VERTEX_3);
+    GLState::enable(GL_MAP2_TEXTURE_COORD_2);
+    GLState::enable(GL_AUTO_NORMAL);
     glMapGrid2f(this->partsPerAxis, 0.0, 1.0, this->partsPerAxis, 0.0, 1.0);
     glColor3f(1.0, 1.0, 1.0);
     glMap2d(GL_MAP2_VERTEX_3, 0, 1, 3, evaluatorOrder, 0, 1, evaluatorOrder * 3,
             evaluatorOrder, grid);
+    glMap2d(GL_MAP2_TEXTURE_COORD_2, 0.0, 1.0, 2, 2, 0.0, 1.0, 4, 2,
+            &texturePoints[0][0]);
     glEvalMesh2(GL_FILL, 0, this->partsPerAxis, 0, this->partsPerAxis);
 }
 
+/* Two per grid cell */
+std::size_t Plane::getNumberOfTriangles() {
+    return static_cast<std::size_t>(partsPerAxis) * partsPerAxis * 2;
+}
+
+/* A bezier surface stays inside its control points */
+void Plane::getBounds(BoundingBox& out) {
+    out.setEmpty();
+    for (int i = 0; i < evaluatorOrder * evaluatorOrder; i++) {
+        out.merge(grid[i * 3], grid[i * 3 + 1], grid[i * 3 + 2]);
+    }
+}
+
 /* Patch primitive */
 /* Texture points for the evaluators */
 GLdouble Patch::texturePoints[4][2] = { { 0.0, 0.0 }, { 0.0, 1.0 },
@@ -695,8 +726,9 @@ void Patch::insertPoint(xyzPointDouble i) {
 }
 
 void Patch::draw(GLdouble, GLdouble) {
-    glEnable(GL_MAP2_VERTEX_3);
-    glEnable(GL_MAP2_TEXTURE_COORD_2);
+    GLState::enable(GL_MAP2_VERTEX_3);
+    GLState::enable(GL_MAP2_TEXTURE_COORD_2);
+    GLState::enable(GL_AUTO_NORMAL);
 
     glMapGrid2f(this->partsU, 0.0, 1.0, this->partsV, 0.0, 1.0);
 
@@ -724,8 +756,22 @@ void Patch::draw(GLdouble, GLdouble) {
             glEvalMesh2(GL_FILL, 0, this->partsU, 0, this->partsV);
             break;
     }
+}
 
-    glEnable(GL_AUTO_NORMAL);
+/* Points and lines draw none */
+std::size_t Patch::getNumberOfTriangles() {
+    if (this->compute == '0' || this->compute == '1') {
+        return 0;
+    }
+    return static_cast<std::size_t>(partsU) * partsV * 2;
+}
+
+/* Control points, same as the plane */
+void Patch::getBounds(BoundingBox& out) {
+    out.setEmpty();
+    for (auto& point : points) {
+        out.merge(point.x, point.y, point.z);
+    }
 }
 
 /* Vehicle primitive */
@@ -829,10 +875,20 @@ void Vehicle::tiltRight() {
     tilt = tilt + tiltFactor;
 }
 
+/* Driven around with the keyboard, the graph never knows where it is */
+void Vehicle::getBounds(BoundingBox& out) {
+    out.setUnbounded();
+}
+
+bool Vehicle::isStatic() {
+    return false;
+}
+
 Vehicle::~Vehicle() {
     delete (topHub);
     delete (topBody);
     delete (bottomBody);
+    delete (evaluatorDemo);
 }
 
 /* Water Line primitive */
@@ -863,16 +919,37 @@ WaterLine::WaterLine(std::string& hmap, std::string& tmap, std::string& fshader,
 }
 
 WaterLine::~WaterLine() {
+    delete (plane);
+    delete (heightmapTexture);
+    delete (texture);
 
+    if (waterShader != nullptr) {
+        delete (waterShader);
+    }
+}
+
+/* CPU only, called while the scene is being loaded */
+void WaterLine::decodeTextures() {
+    this->heightmapTexture->decodeTexture();
+    this->texture->decodeTexture();
+}
+
+/* GL realization, called by the scene init */
+void WaterLine::init() {
+    if (waterShader != nullptr) {
+        return;
+    }
+
+    /* Create the actual shader object */
+    this->waterShader = new Shader(vertexshader.c_str(),
+            fragmentshader.c_str());
+    this->heightmapTexture->loadTexture();
+    this->texture->loadTexture();
 }
 
 void WaterLine::draw(GLdouble s, GLdouble t) {
     if (waterShader == nullptr) {
-        /* Create the actual shader object */
-        this->waterShader = new Shader(vertexshader.c_str(),
-                fragmentshader.c_str());
-        this->heightmapTexture->loadTexture();
-        this->texture->loadTexture();
+        init();
 
     } else {
 
@@ -892,10 +969,10 @@ void WaterLine::draw(GLdouble s, GLdouble t) {
         glUniform1i(heightImageLoc, 1);
 
         /* Activating textures */
-        glActiveTexture(GL_TEXTURE1);
+        GLState::activeTexture(GL_TEXTURE1);
         heightmapTexture->apply();
 
-        glActiveTexture(GL_TEXTURE0);
+        GLState::activeTexture(GL_TEXTURE0);
         texture->apply();
 
         /* Draw the plane */
@@ -906,6 +983,21 @@ void WaterLine::draw(GLdouble s, GLdouble t) {
     }
 }
 
+/* The shader lifts the plane by up to 1 (and 0.1 along z) */
+void WaterLine::getBounds(BoundingBox& out) {
+    this->plane->getBounds(out);
+    out.max[1] += 1.0;
+    out.max[2] += 0.1;
+}
+
+bool WaterLine::isStatic() {
+    return false;
+}
+
+bool WaterLine::hasShader() {
+    return true;
+}
+
 void WaterLine::update(unsigned long/* timePassed */) {
     if (waterShader != nullptr) {
 
@@ -0,0 +1,100 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Render queue methods.
+ */
+
+#include <RenderQueue.hpp>
+
+#include <cstring>
+
+namespace ge {
+
+const unsigned int DepthBits = 22;
+const unsigned int AppearanceBits = 16;
+const unsigned int TextureBits = 16;
+const unsigned int ShaderBits = 8;
+
+RenderQueue::RenderQueue() {
+
+}
+
+RenderQueue::~RenderQueue() {
+
+}
+
+uint64_t RenderQueue::makeStateKey(Pass pass, unsigned int shader,
+        unsigned int texture, unsigned int appearance) {
+    uint64_t key = pass;
+    key = (key << ShaderBits) | (shader & ((1u << ShaderBits) - 1));
+    key = (key << TextureBits) | (texture & ((1u << TextureBits) - 1));
+    key = (key << AppearanceBits)
+            | (appearance & ((1u << AppearanceBits) - 1));
+    return key << DepthBits;
+}
+
+/* Float bits flipped so they sort as unsigned integers, the top bits are kept */
+uint64_t RenderQueue::makeDepthKey(double depth) {
+    float value = static_cast<float>(depth);
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    return bits >> (32 - DepthBits);
+}
+
+void RenderQueue::clear() {
+    items.clear();
+}
+
+void RenderQueue::push(uint64_t key, unsigned int entry) {
+    Item item;
+    item.key = key;
+    item.entry = entry;
+    items.push_back(item);
+}
+
+void RenderQueue::sort() {
+    const std::size_t size = items.size();
+    if (size < 2) {
+        return;
+    }
+
+    /* Every histogram in one read of the keys */
+    std::size_t counts[8][256];
+    std::memset(counts, 0, sizeof(counts));
+    for (auto& item : items) {
+        for (unsigned int digit = 0; digit < 8; digit++) {
+            counts[digit][(item.key >> (digit * 8)) & 0xff]++;
+        }
+    }
+
+    sorted.resize(size);
+
+    for (unsigned int digit = 0; digit < 8; digit++) {
+        std::size_t* count = counts[digit];
+
+        /* Every key has the same byte here */
+        if (count[(items[0].key >> (digit * 8)) & 0xff] == size) {
+            continue;
+        }
+
+        std::size_t offset = 0;
+        for (unsigned int i = 0; i < 256; i++) {
+            std::size_t bucket = count[i];
+            count[i] = offset;
+            offset += bucket;
+        }
+
+        for (auto& item : items) {
+            sorted[count[(item.key >> (digit * 8)) & 0xff]++] = item;
+        }
+        items.swap(sorted);
+    }
+}
+
+const std::vector<RenderQueue::Item>& RenderQueue::getItems() {
+    return this->items;
+}
+
+}
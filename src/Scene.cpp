@@ -5,18 +5,195 @@
  */
 
 #include <Scene.hpp>
+#include <DisplayListManager.hpp>
+#include <GeometryCache.hpp>
+#include <GLState.hpp>
 
 namespace ge {
-Scene::Scene(std::string& fileName) {
+
+/* Compiled scene (yafb) record helpers */
+static void binaryStoreColor(float* out, const color& in) {
+    out[0] = in.r;
+    out[1] = in.g;
+    out[2] = in.b;
+    out[3] = in.a;
+}
+
+static color binaryLoadColor(const float* in) {
+    color out;
+    out.r = in[0];
+    out.g = in[1];
+    out.b = in[2];
+    out.a = in[3];
+    return out;
+}
+
+static void binaryStoreLightColors(Binary::LightRecord& record,
+        const xyzPointFloat& location, const color& ambient,
+        const color& diffuse, const color& specular) {
+    record.location[0] = location.x;
+    record.location[1] = location.y;
+    record.location[2] = location.z;
+    binaryStoreColor(record.ambient, ambient);
+    binaryStoreColor(record.diffuse, diffuse);
+    binaryStoreColor(record.specular, specular);
+}
+
+static Binary::TransformRecord binaryTransformRecord(uint32_t type, int axis,
+        double x, double y, double z) {
+    Binary::TransformRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.axis = axis;
+    record.values[0] = x;
+    record.values[1] = y;
+    record.values[2] = z;
+    return record;
+}
+
+static Binary::PrimitiveRecord binaryPrimitiveRecord(uint32_t type) {
+    Binary::PrimitiveRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    for (unsigned int i = 0; i < 4; i++) {
+        record.strings[i] = Binary::NoString;
+    }
+    return record;
+}
+
+/* CPU phase only, nothing here needs a GL context (that is left to init) */
+Scene::Scene(std::string& fileName, bool useCache) {
     currentCameraPointer = nullptr;
+    graph = nullptr;
+    firstFrameDrawn = false;
+    imageWriter = nullptr;
+    binaryFileWritten = false;
+    externalGuiCamera = nullptr;
+    xmlCurrentNode = nullptr;
+    xmlCurrentPatch = nullptr;
+
+    /* The destructor does not run for a throwing constructor */
+    try {
+        if (useCache) {
+            loadScene(fileName, Binary::getCacheFileName(fileName), false);
+        } else {
+            /* Always parse the source, the compiled image is not read or written */
+            loadScene(fileName, std::string(), true);
+        }
 
-    parseAndLoadXml(fileName);
+        /* Set current camera pointer to the initial camera defined in the XML */
+        setInitialCamera();
+
+        /* Scene textures are decoded when first drawn, water lines now */
+        decodeTextures();
 
-    /* Set current camera pointer to the initial camera defined in the XML */
-    setInitialCamera();
+        /* Draw list and static batches, the first frame only uploads them */
+        graph->updateWorldMatrices();
+    } catch (...) {
+        release();
+        throw;
+    }
 
     /* Create an camera that can be used to override the scene cameras */
     externalGuiCamera = new PerspectiveCamera();
+
+    sourceFileName = fileName;
+    readSourceModificationTime();
+}
+
+Scene::Scene(std::string& fileName, const std::string& binaryFileName,
+        LoadMode mode) {
+    currentCameraPointer = nullptr;
+    graph = nullptr;
+    firstFrameDrawn = false;
+    imageWriter = nullptr;
+    binaryFileWritten = false;
+    externalGuiCamera = nullptr;
+    xmlCurrentNode = nullptr;
+    xmlCurrentPatch = nullptr;
+
+    /* A reload only happens when the source changed, the compiled image is always rebuilt */
+    try {
+        loadScene(fileName, binaryFileName, true);
+
+        if (mode == LoadReload) {
+            setInitialCamera();
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+bool Scene::compileBinary(std::string& fileName,
+        const std::string& binaryFileName) {
+    Scene compiledScene(fileName, binaryFileName, LoadCompile);
+
+    /* Decoding builds the texb caches, so the first run does not decode either */
+    WorkerPool pool;
+    for (auto texture : compiledScene.textureVector) {
+        pool.submit([texture] {
+            texture->decodeTexture();
+        });
+    }
+    pool.wait();
+    compiledScene.decodeTextures();
+
+    return compiledScene.binaryFileWritten;
+}
+
+void Scene::loadScene(std::string& fileName, const std::string& binaryFileName,
+        bool forceCompile) {
+    /* A yafb file can be loaded directly, there is no source to check against */
+    if (Binary::isCompiledSceneFileName(fileName)) {
+        Binary::SceneImage image;
+        if (!image.open(fileName, 0, 0, false)) {
+            throw Exception("Invalid or outdated compiled scene file.", true);
+        }
+        binaryLoad(image);
+        return;
+    }
+
+    int64_t sourceModificationTime = 0;
+    uint64_t sourceSize = 0;
+    bool sourceExists = getFileModificationTime(fileName,
+            sourceModificationTime, sourceSize);
+
+    /* Use the compiled image if it was compiled from the current yaf file */
+    if (sourceExists && !forceCompile) {
+        Binary::SceneImage image;
+        if (image.open(binaryFileName, sourceModificationTime, sourceSize,
+                true)) {
+#ifdef ENGINE_VERBOSE
+            std::cout << "Loading compiled scene [" << binaryFileName << "]"
+                    << std::endl;
+#endif
+            binaryLoad(image);
+            return;
+        }
+    }
+
+    /* Fall back to the xml, recording everything needed for the compiled image */
+    Binary::SceneImageWriter writer;
+    imageWriter = &writer;
+    parseAndLoadXml(fileName);
+    imageWriter = nullptr;
+
+    if (binaryFileName.empty()) {
+        return;
+    }
+
+    if (sourceExists) {
+        binaryFileWritten = writer.write(binaryFileName, sourceModificationTime,
+                sourceSize);
+    }
+
+#ifdef ENGINE_VERBOSE
+    if (!binaryFileWritten) {
+        std::cout << "Could not write compiled scene [" << binaryFileName
+                << "]" << std::endl;
+    }
+#endif
 }
 
 void Scene::parseAndLoadXml(std::string& fileName) {
@@ -28,1173 +205,1719 @@ void Scene::parseAndLoadXml(std::string& fileName) {
     xmlGraphLoaded = false;
     xmlAnimationsLoaded = false;
 
-    xmlLoadFile(fileName);
+    xmlRootFound = false;
+    xmlStateStack.clear();
+    xmlCurrentNode = nullptr;
+    xmlCurrentAnimation = nullptr;
+    xmlCurrentPatch = nullptr;
+
+    /* Every section is loaded while the file is being read */
+    {
+        LoadProfiler::Scope profile(LoadProfiler::PhaseParse);
+        YafReader reader;
+        if (!reader.parse(fileName, *this)) {
+            throw Exception("Error while loading scene xml file.");
+        }
+    }
+
+    if (!xmlRootFound) {
+        throw Exception("No correct root element found!", true);
+    }
+
+    if (!(xmlGlobalsLoaded && xmlCamerasLoaded && xmlLightsLoaded
+            && xmlTexturesLoaded && xmlAppearancesLoaded && xmlGraphLoaded)) {
+        throw Exception("Something went wrong with the XML parsing.", true);
+    }
+}
+
+/* Builds the scene from a compiled image, mirroring what the xml loaders do */
+void Scene::binaryLoad(Binary::SceneImage& image) {
+    LoadProfiler::Scope profile(LoadProfiler::PhaseBinaryLoad);
+    uint32_t count;
+
+    /* Globals */
+    const Binary::GlobalsRecord* globals = image.getGlobals();
+    setBackgroundColor(binaryLoadColor(globals->background));
+
+    std::string drawModeIn = image.getString(globals->drawMode);
+    setDrawMode(drawModeIn);
+    std::string shadingModeIn = image.getString(globals->shadingMode);
+    setShadingMode(shadingModeIn);
+    std::string cullFaceIn = image.getString(globals->cullFace);
+    setCullFace(cullFaceIn);
+    std::string cullOrderIn = image.getString(globals->cullOrder);
+    setCullOrder(cullOrderIn);
+    xmlGlobalsLoaded = true;
+
+    /* Cameras */
+    this->initialCamera = image.getString(globals->initialCamera);
 
-    xmlCheckDocumentType();
+    const Binary::CameraRecord* cameras = image.getCameras(count);
+    for (uint32_t i = 0; i < count; i++) {
+        std::string cameraId = image.getString(cameras[i].id);
 
-    xmlLoadMainElements();
-    xmlCheckMainElements();
+        if (cameras[i].type == Binary::CameraPerspective) {
+            xyzPointDouble pos, target;
+            pos.x = cameras[i].position[0];
+            pos.y = cameras[i].position[1];
+            pos.z = cameras[i].position[2];
+            target.x = cameras[i].target[0];
+            target.y = cameras[i].target[1];
+            target.z = cameras[i].target[2];
 
-    xmlLoadGlobals();
-    xmlLoadCameras();
-    xmlLoadLighting();
-    xmlLoadTextures();
-    xmlLoadAppearances();
+            cameraVector.push_back(
+                    new PerspectiveCamera(cameraId, cameras[i].nearPlane,
+                            cameras[i].farPlane, cameras[i].angle, pos,
+                            target));
+        } else {
+            cameraVector.push_back(
+                    new OrthoCamera(cameraId, cameras[i].nearPlane,
+                            cameras[i].farPlane, cameras[i].left,
+                            cameras[i].right, cameras[i].top,
+                            cameras[i].bottom));
+        }
+    }
 
-    /* Before attempting to load animations check if the section exists */
-    if (xmlAnimationsElement != nullptr) {
-        xmlLoadAnimations();
+    this->numberOfCameras = count;
+    if (numberOfCameras < 1) {
+        throw Exception("Compiled scene: No camera found.", true);
     }
+    xmlCamerasLoaded = true;
+
+    /* Lighting */
+    lightingDoubleSided = globals->lightingDoubleSided != 0;
+    lightingLocal = globals->lightingLocal != 0;
+    lightingEnable = globals->lightingEnabled != 0;
+    setAmbientLightColor(binaryLoadColor(globals->ambient));
+
+    const Binary::LightRecord* lights = image.getLights(count);
+    this->numberOfLights = 0;
+    for (uint32_t i = 0; i < count && numberOfLights < MAX_LIGHTS; i++) {
+        std::string lightId = image.getString(lights[i].id);
+        xyzPointFloat location;
+        location.x = lights[i].location[0];
+        location.y = lights[i].location[1];
+        location.z = lights[i].location[2];
+
+        if (lights[i].type == Binary::LightSpot) {
+            xyzPointFloat direction;
+            direction.x = lights[i].direction[0];
+            direction.y = lights[i].direction[1];
+            direction.z = lights[i].direction[2];
 
-    /* Graph is loaded last, since it will get references for the rest */
-    xmlLoadGraph();
+            lightVector.push_back(
+                    new SpotLight(lightId, numberOfLights,
+                            lights[i].enabled != 0, location,
+                            binaryLoadColor(lights[i].ambient),
+                            binaryLoadColor(lights[i].diffuse),
+                            binaryLoadColor(lights[i].specular),
+                            lights[i].angle, lights[i].exponent, direction));
+        } else {
+            lightVector.push_back(
+                    new OmniLight(lightId, numberOfLights,
+                            lights[i].enabled != 0, location,
+                            binaryLoadColor(lights[i].ambient),
+                            binaryLoadColor(lights[i].diffuse),
+                            binaryLoadColor(lights[i].specular)));
+        }
 
-    if (doc != nullptr) {
-        delete (doc);
+        this->numberOfLights++;
     }
 
-    delete[] xmlFileName;
+    if (numberOfLights < 1) {
+        throw Exception("Compiled scene: No lights found!", true);
+    }
+    xmlLightsLoaded = true;
 
-    if (!(xmlGlobalsLoaded && xmlCamerasLoaded && xmlLightsLoaded
-            && xmlTexturesLoaded && xmlAppearancesLoaded && xmlGraphLoaded)) {
-        throw Exception("Something went wrong with the XML parsing.", true);
+    /* Textures */
+    const Binary::TextureRecord* textures = image.getTextures(count);
+    for (uint32_t i = 0; i < count; i++) {
+        std::string textureId = image.getString(textures[i].id);
+        std::string textureFileName = image.getString(textures[i].file);
+        addTexture(new Texture(textureId, textureFileName));
     }
-}
+    xmlTexturesLoaded = true;
 
-void Scene::xmlLoadFile(const std::string& filename) {
-    doc = new TiXmlDocument(filename);
-    bool loadOkay = doc->LoadFile();
+    /* Appearances */
+    const Binary::AppearanceRecord* appearances = image.getAppearances(count);
+    for (uint32_t i = 0; i < count; i++) {
+        std::string appearanceId = image.getString(appearances[i].id);
+
+        if (appearances[i].textureRef != Binary::NoString) {
+            std::string textureId = image.getString(appearances[i].textureRef);
+            addAppearance(
+                    new Appearance(appearanceId,
+                            binaryLoadColor(appearances[i].emissive),
+                            binaryLoadColor(appearances[i].ambient),
+                            binaryLoadColor(appearances[i].diffuse),
+                            binaryLoadColor(appearances[i].specular),
+                            appearances[i].shininess, textureId,
+                            appearances[i].texlengthS,
+                            appearances[i].texlengthT));
+        } else {
+            addAppearance(
+                    new Appearance(appearanceId,
+                            binaryLoadColor(appearances[i].emissive),
+                            binaryLoadColor(appearances[i].ambient),
+                            binaryLoadColor(appearances[i].diffuse),
+                            binaryLoadColor(appearances[i].specular),
+                            appearances[i].shininess));
+        }
+    }
 
-    if (!loadOkay) {
-        throw Exception("Error while loading scene xml file.");
+    if (appearanceVector.empty()) {
+        throw Exception("Compiled scene: No appearances found!", true);
     }
+    xmlAppearancesLoaded = true;
+
+    /* Animations */
+    uint32_t numberOfPoints;
+    const Binary::PointRecord* points = image.getPoints(numberOfPoints);
+
+    const Binary::AnimationRecord* animations = image.getAnimations(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Animation* temporaryAnimation = new Animation(
+                image.getString(animations[i].id), animations[i].span,
+                animations[i].type);
+
+        for (uint32_t p = 0; p < animations[i].pointCount; p++) {
+            const Binary::PointRecord& point = points[animations[i].firstPoint
+                    + p];
+            temporaryAnimation->insertPoint(point.x, point.y, point.z);
+        }
+
+        addAnimation(temporaryAnimation);
+    }
+    xmlAnimationsLoaded = true;
+
+    /* Graph */
+    std::string rootId = image.getString(globals->rootId);
+    graph = new SceneGraph(rootId);
+
+    uint32_t numberOfTransforms, numberOfPrimitives, numberOfChildren;
+    const Binary::TransformRecord* transforms = image.getTransforms(
+            numberOfTransforms);
+    const Binary::PrimitiveRecord* primitives = image.getPrimitives(
+            numberOfPrimitives);
+    const uint32_t* children = image.getChildren(numberOfChildren);
+
+    /* Nodes are kept in unprocessedNodes as soon as they exist, so a failed load can free them */
+    const Binary::NodeRecord* nodes = image.getNodes(count);
+    std::vector<Node*>& loadedNodes = unprocessedNodes;
+    loadedNodes.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const Binary::NodeRecord& record = nodes[i];
+        std::string nodeId = image.getString(record.id);
+        Node::ListMode displayList = Node::ListOff;
+        if ((record.flags & Binary::NodeDisplayList) != 0) {
+            displayList = Node::ListOn;
+        } else if ((record.flags & Binary::NodeDisplayListAuto) != 0) {
+            displayList = Node::ListAuto;
+        }
+
+        Node* temporaryNode = new Node(nodeId, displayList,
+                (record.flags & Binary::NodeStaticBatch) != 0);
+        loadedNodes.push_back(temporaryNode);
+
+        for (uint32_t t = 0; t < record.transformCount; t++) {
+            const Binary::TransformRecord& transform =
+                    transforms[record.firstTransform + t];
+            int transformNumber = static_cast<int>(t);
+
+            if (transform.type == Binary::TransformTypeScale) {
+                temporaryNode->addTransform(
+                        new TransformScale(transform.values[0],
+                                transform.values[1], transform.values[2],
+                                transformNumber));
+            } else if (transform.type == Binary::TransformTypeRotate) {
+                temporaryNode->addTransform(
+                        new TransformRotate(transform.axis,
+                                transform.values[0], transformNumber));
+            } else {
+                temporaryNode->addTransform(
+                        new TransformTranslate(transform.values[0],
+                                transform.values[1], transform.values[2],
+                                transformNumber));
+            }
+        }
+
+        if (record.appearanceRef != Binary::NoString) {
+            std::string appearanceId = image.getString(record.appearanceRef);
+            temporaryNode->setAppearanceReference(appearanceId);
+            temporaryNode->setAppearance(getAppearanceByString(appearanceId));
+        }
+
+        if (record.animationRef != Binary::NoString) {
+            std::string animationId = image.getString(record.animationRef);
+            temporaryNode->setAnimationReference(animationId);
+            temporaryNode->setAnimation(getAnimationByString(animationId));
+        }
+
+        temporaryNode->setPrimitivesHash(
+                Binary::hashPrimitives(primitives + record.firstPrimitive,
+                        record.primitiveCount, points, image.getStrings()));
+
+        for (uint32_t p = 0; p < record.primitiveCount; p++) {
+            const Binary::PrimitiveRecord& primitive =
+                    primitives[record.firstPrimitive + p];
+            const double* v = primitive.values;
+            const uint32_t* n = primitive.integers;
+
+            switch (primitive.type) {
+            case Binary::PrimitiveRectangle:
+                temporaryNode->addPrimitive(
+                        new Primitives::Rectangle(v[0], v[1], v[2], v[3]));
+                break;
+            case Binary::PrimitiveTriangle:
+                temporaryNode->addPrimitive(
+                        new Primitives::Triangle(v[0], v[1], v[2], v[3], v[4],
+                                v[5], v[6], v[7], v[8]));
+                break;
+            case Binary::PrimitiveCylinder:
+                temporaryNode->addPrimitive(
+                        new Primitives::Cylinder(v[0], v[1], v[2], n[0], n[1]));
+                break;
+            case Binary::PrimitiveSphere:
+                temporaryNode->addPrimitive(
+                        new Primitives::Sphere(v[0], static_cast<int>(n[0]),
+                                static_cast<int>(n[1])));
+                break;
+            case Binary::PrimitiveTorus:
+                temporaryNode->addPrimitive(
+                        new Primitives::Torus(v[0], v[1],
+                                static_cast<int>(n[0]),
+                                static_cast<int>(n[1])));
+                break;
+            case Binary::PrimitivePlane:
+                temporaryNode->addPrimitive(new Primitives::Plane(n[0]));
+                break;
+            case Binary::PrimitivePatch: {
+                Primitives::Patch* primitiveTempP = new Primitives::Patch(n[0],
+                        n[1], n[2], n[3]);
+
+                if (primitive.pointCount
+                        != primitiveTempP->getNumberOfPoints()) {
+                    delete (primitiveTempP);
+                    throw Exception(
+                            "Compiled scene: Number of patch points is invalid.",
+                            true);
+                }
+
+                for (uint32_t c = 0; c < primitive.pointCount; c++) {
+                    const Binary::PointRecord& point = points[primitive.firstPoint
+                            + c];
+                    primitiveTempP->insertPoint(point.x, point.y, point.z);
+                }
+
+                temporaryNode->addPrimitive(primitiveTempP);
+                break;
+            }
+            case Binary::PrimitiveVehicle: {
+                Primitives::Vehicle* primitiveTempV = new Primitives::Vehicle();
+                sceneVehicles.push_back(primitiveTempV);
+                temporaryNode->addPrimitive(primitiveTempV);
+                break;
+            }
+            case Binary::PrimitiveWaterLine: {
+                std::string hmap = image.getString(primitive.strings[0]);
+                std::string tmap = image.getString(primitive.strings[1]);
+                std::string fshader = image.getString(primitive.strings[2]);
+                std::string vshader = image.getString(primitive.strings[3]);
+
+                Primitives::WaterLine* primitiveTempWL =
+                        new Primitives::WaterLine(hmap, tmap, fshader, vshader);
+                temporaryNode->addPrimitive(primitiveTempWL);
+                waterLineVector.push_back(primitiveTempWL);
+                break;
+            }
+            default:
+                throw Exception("Compiled scene: Invalid primitive type.", true);
+            }
+        }
+    }
+
+    /* Children are already resolved to node indexes, the root is never linked as a child */
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t c = 0; c < nodes[i].childCount; c++) {
+            Node* child = loadedNodes[children[nodes[i].firstChild + c]];
+            std::string childId = child->getNodeID();
+
+            loadedNodes[i]->addChildrenID(childId);
+            if (childId != rootId) {
+                loadedNodes[i]->getChildrenVector().push_back(child);
+            }
+        }
+    }
+
+    graph->importLinkedNodes(loadedNodes);
+    xmlGraphLoaded = true;
 }
 
-void Scene::xmlCheckDocumentType() {
-    xmlRootElement = doc->FirstChildElement(Xml::DocumentType);
+/* Called by the reader for every opening tag, dispatches on the enclosing element */
+void Scene::startElement(const YafElement& element) {
+    XmlState parent = xmlStateStack.empty() ? XmlDocument : xmlStateStack.back();
+    XmlState state = XmlIgnored;
+    Xml::Names::Name name = element.getToken();
 
-    if (xmlRootElement == nullptr) {
-        throw Exception("No correct root element found!", true);
+    switch (parent) {
+        case XmlDocument:
+            if (name != Xml::DocumentType || xmlRootFound) {
+                throw Exception("No correct root element found!", true,
+                        element.getRow());
+            }
+            xmlRootFound = true;
+            state = XmlYaf;
+            break;
+
+        case XmlYaf:
+            if (name == Xml::Nodes::Globals::RootNode) {
+                xmlLoadGlobals(element);
+            } else if (name == Xml::Nodes::Cameras::RootNode) {
+                LoadProfiler::begin(LoadProfiler::PhaseCameras);
+                xmlLoadCameras(element);
+                state = XmlCameras;
+            } else if (name == Xml::Nodes::Lights::RootNode) {
+                LoadProfiler::begin(LoadProfiler::PhaseLighting);
+                xmlLoadLighting(element);
+                state = XmlLighting;
+            } else if (name == Xml::Nodes::Textures::RootNode) {
+                if (xmlTexturesLoaded) {
+                    throw Exception("Textures have already been loaded!", true);
+                }
+                LoadProfiler::begin(LoadProfiler::PhaseTextures);
+                state = XmlTextures;
+            } else if (name == Xml::Nodes::Appearances::RootNode) {
+                if (xmlAppearancesLoaded) {
+                    throw Exception("Appearances have already been loaded!", true);
+                }
+                LoadProfiler::begin(LoadProfiler::PhaseAppearances);
+                state = XmlAppearances;
+            } else if (name == Xml::Nodes::Animations::RootNode) {
+                if (xmlAnimationsLoaded) {
+                    throw Exception("Animations have already been loaded!", true);
+                }
+                LoadProfiler::begin(LoadProfiler::PhaseAnimations);
+                state = XmlAnimations;
+            } else if (name == Xml::Blocks::Graph) {
+                LoadProfiler::begin(LoadProfiler::PhaseGraph);
+                xmlLoadGraph(element);
+                state = XmlGraph;
+            }
+            break;
+
+        case XmlCameras:
+            xmlLoadCamera(element);
+            break;
+
+        case XmlLighting:
+            xmlLoadLight(element);
+            break;
+
+        case XmlTextures:
+            xmlLoadTexture(element);
+            break;
+
+        case XmlAppearances:
+            xmlLoadAppearance(element);
+            break;
+
+        case XmlAnimations:
+            xmlLoadAnimation(element);
+            state = XmlAnimation;
+            break;
+
+        case XmlAnimation:
+            xmlLoadAnimationPoint(element);
+            break;
+
+        case XmlGraph:
+            xmlLoadNode(element);
+            state = XmlNode;
+            break;
+
+        case XmlNode:
+            state = xmlLoadNodeBlock(element);
+            break;
+
+        case XmlTransforms:
+            xmlLoadTransform(element);
+            break;
+
+        case XmlChildren:
+            state = xmlLoadNodeChild(element);
+            break;
+
+        case XmlPatch:
+            xmlLoadPatchPoint(element);
+            break;
+
+        case XmlIgnored:
+            break;
     }
+
+    xmlStateStack.push_back(state);
 }
 
-void Scene::xmlLoadMainElements() {
-    xmlGlobalsElement = xmlRootElement->FirstChildElement(Xml::Nodes::Globals::RootNode);
-    xmlCamerasElement = xmlRootElement->FirstChildElement(Xml::Nodes::Cameras::RootNode);
-    xmlLightingElement = xmlRootElement->FirstChildElement(Xml::Nodes::Lights::RootNode);
-    xmlTexturesElement = xmlRootElement->FirstChildElement(Xml::Nodes::Textures::RootNode);
-    xmlAppearancesElement = xmlRootElement->FirstChildElement(Xml::Nodes::Appearances::RootNode);
-    xmlGraphElement = xmlRootElement->FirstChildElement(Xml::Blocks::Graph);
-    xmlAnimationsElement = xmlRootElement->FirstChildElement(Xml::Nodes::Animations::RootNode);
+/* Called by the reader for every closing tag, finishes the element being closed */
+void Scene::endElement(const YafElement& element) {
+    XmlState state = xmlStateStack.back();
+    xmlStateStack.pop_back();
+
+    switch (state) {
+        case XmlYaf:
+            xmlCheckMainElements();
+            xmlLinkGraph();
+            break;
+
+        case XmlCameras:
+            /* Check if we got at least one camera */
+            numberOfCameras = static_cast<unsigned int>(cameraVector.size());
+
+            if (numberOfCameras < 1) {
+                throw Exception("XML: Cameras: No camera found.", true);
+            }
+
+            if (imageWriter != nullptr) {
+                imageWriter->getGlobals().initialCamera = imageWriter->addString(
+                        initialCamera);
+            }
+
+            xmlCamerasLoaded = true;
+            LoadProfiler::end(LoadProfiler::PhaseCameras);
+            break;
+
+        case XmlLighting:
+            if (numberOfLights < 1) {
+                throw Exception("XML: Lighting: No lights found!", true);
+            }
+
+            xmlLightsLoaded = true;
+            LoadProfiler::end(LoadProfiler::PhaseLighting);
+            break;
+
+        case XmlTextures:
+            xmlTexturesLoaded = true;
+            LoadProfiler::end(LoadProfiler::PhaseTextures);
+            break;
+
+        case XmlAppearances:
+            if (appearanceVector.empty()) {
+                throw Exception("No appearances found!", true);
+            }
+
+            xmlAppearancesLoaded = true;
+            LoadProfiler::end(LoadProfiler::PhaseAppearances);
+            break;
+
+        case XmlAnimation:
+            xmlCurrentAnimation = nullptr;
+            break;
+
+        case XmlAnimations:
+            xmlAnimationsLoaded = true;
+            LoadProfiler::end(LoadProfiler::PhaseAnimations);
+            break;
+
+        case XmlNode:
+            xmlEndNode(element);
+            break;
+
+        case XmlPatch:
+            xmlEndPatch();
+            break;
+
+        case XmlGraph:
+            if (unprocessedNodes.empty()) {
+                throw Exception("Node: No nodes found.", true, element.getRow());
+            }
+
+            /* Nodes are linked once the whole file has been read */
+            xmlGraphLoaded = true;
+            LoadProfiler::end(LoadProfiler::PhaseGraph);
+            break;
+
+        default:
+            break;
+    }
 }
 
 void Scene::xmlCheckMainElements() {
     /* Check if all required nodes exist */
 
-    if (xmlGlobalsElement == nullptr) {
+    if (!xmlGlobalsLoaded) {
         throw Exception("Globals element not found.");
     }
 
-    if (xmlCamerasElement == nullptr) {
+    if (!xmlCamerasLoaded) {
         throw Exception("Cameras element not found.");
     }
 
-    if (xmlLightingElement == nullptr) {
+    if (!xmlLightsLoaded) {
         throw Exception("Lighting element not found.");
     }
 
-    if (xmlTexturesElement == nullptr) {
+    if (!xmlTexturesLoaded) {
         throw Exception("Textures element not found.");
     }
 
-    if (xmlAppearancesElement == nullptr) {
+    if (!xmlAppearancesLoaded) {
         throw Exception("Appearances element not found.");
     }
 
-    if (xmlGraphElement == nullptr) {
+    if (!xmlGraphLoaded) {
         throw Exception("Graph element not found.");
     }
 }
 
 /* Load and set globals from XML */
-void Scene::xmlLoadGlobals() {
+void Scene::xmlLoadGlobals(const YafElement& element) {
+    LoadProfiler::Scope profile(LoadProfiler::PhaseGlobals);
+
     if (xmlGlobalsLoaded) {
         throw Exception(Xml::Nodes::Globals::Errors::AlreadyLoaded, true);
     }
 
-    color bgColor = getColorFromElementAttribute(xmlGlobalsElement,
+    color bgColor = getColorFromElementAttribute(element,
             Xml::Nodes::Globals::Attributes::Background, Xml::Nodes::Globals::Errors::InvalidBackgrond);
     setBackgroundColor(bgColor);
 
-    std::string drawMode = getStringFromElementAttribute(xmlGlobalsElement,
+    std::string drawMode = getStringFromElementAttribute(element,
             Xml::Nodes::Globals::Attributes::DrawMode, Xml::Nodes::Globals::Errors::InvalidDrawMode);
     setDrawMode(drawMode);
 
-    std::string shadingMode = getStringFromElementAttribute(xmlGlobalsElement,
+    std::string shadingMode = getStringFromElementAttribute(element,
             Xml::Nodes::Globals::Attributes::Shading, Xml::Nodes::Globals::Errors::InvalidShading);
     setShadingMode(shadingMode);
 
-    std::string cullFace = getStringFromElementAttribute(xmlGlobalsElement,
+    std::string cullFace = getStringFromElementAttribute(element,
             Xml::Nodes::Globals::Attributes::CullFace, Xml::Nodes::Globals::Errors::InvalidCullFace);
     setCullFace(cullFace);
 
-    std::string cullOrder = getStringFromElementAttribute(xmlGlobalsElement,
+    std::string cullOrder = getStringFromElementAttribute(element,
             Xml::Nodes::Globals::Attributes::CullOrder, Xml::Nodes::Globals::Errors::InvalidCullOrder);
     setCullOrder(cullOrder);
 
+    if (imageWriter != nullptr) {
+        Binary::GlobalsRecord& globals = imageWriter->getGlobals();
+        globals.background[0] = bgColor.r;
+        globals.background[1] = bgColor.g;
+        globals.background[2] = bgColor.b;
+        globals.background[3] = bgColor.a;
+        globals.drawMode = imageWriter->addString(drawMode);
+        globals.shadingMode = imageWriter->addString(shadingMode);
+        globals.cullFace = imageWriter->addString(cullFace);
+        globals.cullOrder = imageWriter->addString(cullOrder);
+    }
+
     xmlGlobalsLoaded = true;
 }
 
-/* Load and set cameras from XML */
-void Scene::xmlLoadCameras() {
+/* Load the cameras block attributes from XML, the cameras come as children */
+void Scene::xmlLoadCameras(const YafElement& element) {
     if (xmlCamerasLoaded) {
         throw Exception("XML: Cameras have already been loaded!", true);
     }
 
-    int numberOfPerspectiveCameras = 0, numberOfOrthoCameras = 0;
-
     this->numberOfCameras = 0;
-    this->initialCamera = getStringFromElementAttribute(xmlCamerasElement,
+    this->initialCamera = getStringFromElementAttribute(element,
             Xml::Nodes::Cameras::Attributes::InitialCamera,
             Xml::Nodes::Cameras::Errors::InvalidInitialCamera);
+}
 
-    /* Get camera first child */
-    TiXmlElement* xmlCameraElement = xmlCamerasElement->FirstChildElement();
-
-    bool camerasLastRun = false;
-    while (xmlCameraElement != nullptr && !camerasLastRun) {
-        /* Checks if we are loading the last child, if so this will be the last run. */
-        if (xmlCameraElement == xmlCamerasElement->LastChild()) {
-            camerasLastRun = true;
-        }
-
-        /* Camera is perspective */
-        if (Xml::Nodes::Cameras::Perspective == xmlCameraElement->Value()) {
-            std::string cameraId;
-            float nearIn, farIn, angle;
-            xyzPointDouble pos, target;
-
-            cameraId = getStringFromElementAttribute(xmlCameraElement,
-                    Xml::GenericAttributes::ID,
-                    Xml::Nodes::Cameras::Errors::InvalidCameraID);
-            nearIn = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Near,
-                    Xml::Nodes::Cameras::Errors::InvalidNear);
-            farIn = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Far,
-                    Xml::Nodes::Cameras::Errors::InvalidFar);
-            angle = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Angle,
-                    Xml::Nodes::Cameras::Errors::InvalidAngle);
-            pos = getDoublePointFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Position,
-                    Xml::Nodes::Cameras::Errors::InvalidPosition);
-            target = getDoublePointFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Target,
-                    Xml::Nodes::Cameras::Errors::InvalidTarget);
-
-            cameraVector.push_back(
-                    new PerspectiveCamera(cameraId, nearIn, farIn, angle, pos,
-                            target));
-
-            numberOfPerspectiveCameras++;
-        }
-
-        /* Camera is ortho */
-        if (Xml::Nodes::Cameras::Ortho == xmlCameraElement->Value()) {
-            std::string cameraId;
-            float nearIn, farIn, left, right, top, bottom;
-
-            cameraId = getStringFromElementAttribute(xmlCameraElement,
-                    Xml::GenericAttributes::ID,
-                    Xml::Nodes::Cameras::Errors::InvalidCameraID);
-            nearIn = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Near,
-                    Xml::Nodes::Cameras::Errors::InvalidNear);
-            farIn = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Far,
-                    Xml::Nodes::Cameras::Errors::InvalidFar);
-            left = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Left,
-                    Xml::Nodes::Cameras::Errors::InvalidLeft);
-            right = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Right,
-                    Xml::Nodes::Cameras::Errors::InvalidRight);
-            top = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Top,
-                    Xml::Nodes::Cameras::Errors::InvalidTop);
-            bottom = getFloatFromElementAttribute(xmlCameraElement,
-                    Xml::Nodes::Cameras::Attributes::Bottom,
-                    Xml::Nodes::Cameras::Errors::InvalidBottom);
+/* Load and set a camera from XML */
+void Scene::xmlLoadCamera(const YafElement& element) {
+    /* Camera is perspective */
+    if (Xml::Nodes::Cameras::Perspective == element.getToken()) {
+        std::string cameraId;
+        float nearIn, farIn, angle;
+        xyzPointDouble pos, target;
 
-            cameraVector.push_back(
-                    new OrthoCamera(cameraId, nearIn, farIn, left, right, top,
-                            bottom));
-            numberOfOrthoCameras++;
+        cameraId = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::ID,
+                Xml::Nodes::Cameras::Errors::InvalidCameraID);
+        nearIn = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Near,
+                Xml::Nodes::Cameras::Errors::InvalidNear);
+        farIn = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Far,
+                Xml::Nodes::Cameras::Errors::InvalidFar);
+        angle = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Angle,
+                Xml::Nodes::Cameras::Errors::InvalidAngle);
+        pos = getDoublePointFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Position,
+                Xml::Nodes::Cameras::Errors::InvalidPosition);
+        target = getDoublePointFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Target,
+                Xml::Nodes::Cameras::Errors::InvalidTarget);
+
+        cameraVector.push_back(
+                new PerspectiveCamera(cameraId, nearIn, farIn, angle, pos,
+                        target));
+
+        if (imageWriter != nullptr) {
+            Binary::CameraRecord record;
+            memset(&record, 0, sizeof(record));
+            record.id = imageWriter->addString(cameraId);
+            record.type = Binary::CameraPerspective;
+            record.nearPlane = nearIn;
+            record.farPlane = farIn;
+            record.angle = angle;
+            record.position[0] = pos.x;
+            record.position[1] = pos.y;
+            record.position[2] = pos.z;
+            record.target[0] = target.x;
+            record.target[1] = target.y;
+            record.target[2] = target.z;
+            imageWriter->addCamera(record);
         }
-
-        xmlCameraElement = xmlCameraElement->NextSiblingElement();
     }
 
-    /* Check if we got at least one camera */
-    numberOfCameras = numberOfOrthoCameras + numberOfPerspectiveCameras;
+    /* Camera is ortho */
+    if (Xml::Nodes::Cameras::Ortho == element.getToken()) {
+        std::string cameraId;
+        float nearIn, farIn, left, right, top, bottom;
 
-    if (numberOfCameras < 1) {
-        throw Exception("XML: Cameras: No camera found.", true);
+        cameraId = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::ID,
+                Xml::Nodes::Cameras::Errors::InvalidCameraID);
+        nearIn = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Near,
+                Xml::Nodes::Cameras::Errors::InvalidNear);
+        farIn = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Far,
+                Xml::Nodes::Cameras::Errors::InvalidFar);
+        left = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Left,
+                Xml::Nodes::Cameras::Errors::InvalidLeft);
+        right = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Right,
+                Xml::Nodes::Cameras::Errors::InvalidRight);
+        top = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Top,
+                Xml::Nodes::Cameras::Errors::InvalidTop);
+        bottom = getFloatFromElementAttribute(element,
+                Xml::Nodes::Cameras::Attributes::Bottom,
+                Xml::Nodes::Cameras::Errors::InvalidBottom);
+
+        cameraVector.push_back(
+                new OrthoCamera(cameraId, nearIn, farIn, left, right, top,
+                        bottom));
+
+        if (imageWriter != nullptr) {
+            Binary::CameraRecord record;
+            memset(&record, 0, sizeof(record));
+            record.id = imageWriter->addString(cameraId);
+            record.type = Binary::CameraOrtho;
+            record.nearPlane = nearIn;
+            record.farPlane = farIn;
+            record.left = left;
+            record.right = right;
+            record.top = top;
+            record.bottom = bottom;
+            imageWriter->addCamera(record);
+        }
     }
-
-    xmlCamerasLoaded = true;
 }
 
-/* Load and set lighting from XML */
-void Scene::xmlLoadLighting() {
+/* Load and set the lighting block attributes from XML, the lights come as children */
+void Scene::xmlLoadLighting(const YafElement& element) {
     if (xmlLightsLoaded) {
         throw Exception("Lights have already been loaded!", true);
     }
 
-    unsigned int numberOfOmniLights = 0, numberOfSpotLights = 0;
     this->numberOfLights = 0;
 
-    std::string lightingDS = getStringFromElementAttribute(xmlLightingElement,
+    std::string lightingDS = getStringFromElementAttribute(element,
             Xml::Nodes::Lights::Attributes::DoubleSided,
             Xml::Errors::ATTRIBUTE_LIGHTING_DOUBLESIDED);
     lightingDoubleSided = validateBoolean(lightingDS);
 
-    std::string lightingL = getStringFromElementAttribute(xmlLightingElement,
+    std::string lightingL = getStringFromElementAttribute(element,
             Xml::Nodes::Lights::Attributes::Local, Xml::Errors::ATTRIBUTE_LIGHTING_LOCAL);
     lightingLocal = validateBoolean(lightingL);
 
-    std::string lightingE = getStringFromElementAttribute(xmlLightingElement,
+    std::string lightingE = getStringFromElementAttribute(element,
             Xml::GenericAttributes::Enabled, Xml::Errors::ATTRIBUTE_LIGHTING_ENABLED);
     lightingEnable = validateBoolean(lightingE);
 
-    color ambientC = getColorFromElementAttribute(xmlLightingElement,
+    color ambientC = getColorFromElementAttribute(element,
             Xml::Nodes::Lights::Attributes::Ambient,
             Xml::Errors::ATTRIBUTE_LIGHTING_G_AMBIENT);
     setAmbientLightColor(ambientC);
 
-    /* Get lighting first child */
-    TiXmlElement* xmlLightElement = xmlLightingElement->FirstChildElement();
-
-    bool lightingLastRun = false;
-    while (xmlLightElement != nullptr && !lightingLastRun) {
-        /* Checks if we are loading the last child, if so this will be the last run. */
-        if (xmlLightElement == xmlLightingElement->LastChild()) {
-            lightingLastRun = true;
-        }
-
-        /* Omni light */
-        if (Xml::Nodes::Lights::Omni == xmlLightElement->Value()) {
-            std::string lightId;
-            bool lightEnable;
-            xyzPointFloat location;
-            color ambient, diffuse, specular;
-
-            lightId = getStringFromElementAttribute(xmlLightElement,
-                    Xml::GenericAttributes::ID, Xml::Errors::SECTION_LIGHTING_ID);
-
-            std::string enabled = getStringFromElementAttribute(xmlLightElement,
-                    Xml::GenericAttributes::Enabled,
-                    Xml::Errors::SECTION_LIGHTING_ENABLED);
-            lightEnable = validateBoolean(enabled);
-
-            location = getFloatPointFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Location,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_LOCATION);
-            ambient = getColorFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Ambient,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_AMBIENT);
-            diffuse = getColorFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Diffuse,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_DIFFUSE);
-            specular = getColorFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Specular,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_SPECULAR);
-
-            lightVector.push_back(
-                    new OmniLight(lightId, numberOfLights, lightEnable,
-                            location, ambient, diffuse, specular));
-            numberOfOmniLights++;
+    if (imageWriter != nullptr) {
+        Binary::GlobalsRecord& globals = imageWriter->getGlobals();
+        globals.lightingDoubleSided = lightingDoubleSided ? 1 : 0;
+        globals.lightingLocal = lightingLocal ? 1 : 0;
+        globals.lightingEnabled = lightingEnable ? 1 : 0;
+        globals.ambient[0] = ambientC.r;
+        globals.ambient[1] = ambientC.g;
+        globals.ambient[2] = ambientC.b;
+        globals.ambient[3] = ambientC.a;
+    }
+}
+
+/* Load a light from XML */
+void Scene::xmlLoadLight(const YafElement& element) {
+    /* Lights after the limit are ignored */
+    if (this->numberOfLights == MAX_LIGHTS) {
+        return;
+    }
+
+    /* Omni light */
+    if (Xml::Nodes::Lights::Omni == element.getToken()) {
+        std::string lightId;
+        bool lightEnable;
+        xyzPointFloat location;
+        color ambient, diffuse, specular;
+
+        lightId = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::ID, Xml::Errors::SECTION_LIGHTING_ID);
+
+        std::string enabled = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::Enabled,
+                Xml::Errors::SECTION_LIGHTING_ENABLED);
+        lightEnable = validateBoolean(enabled);
+
+        location = getFloatPointFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Location,
+                Xml::Errors::ATTRIBUTE_LIGHTING_LOCATION);
+        ambient = getColorFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Ambient,
+                Xml::Errors::ATTRIBUTE_LIGHTING_AMBIENT);
+        diffuse = getColorFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Diffuse,
+                Xml::Errors::ATTRIBUTE_LIGHTING_DIFFUSE);
+        specular = getColorFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Specular,
+                Xml::Errors::ATTRIBUTE_LIGHTING_SPECULAR);
+
+        lightVector.push_back(
+                new OmniLight(lightId, numberOfLights, lightEnable,
+                        location, ambient, diffuse, specular));
+
+        if (imageWriter != nullptr) {
+            Binary::LightRecord record;
+            memset(&record, 0, sizeof(record));
+            record.id = imageWriter->addString(lightId);
+            record.type = Binary::LightOmni;
+            record.enabled = lightEnable ? 1 : 0;
+            binaryStoreLightColors(record, location, ambient, diffuse,
+                    specular);
+            imageWriter->addLight(record);
         }
 
-        /* Spot light */
-        if (Xml::Nodes::Lights::Spot == xmlLightElement->Value()) {
-            std::string lightId;
-            bool lightEnable;
-            GLfloat angle, exponent;
-            xyzPointFloat location;
-            xyzPointFloat direction;
-            color ambient, diffuse, specular;
-
-            lightId = getStringFromElementAttribute(xmlLightElement,
-                    Xml::GenericAttributes::ID, Xml::Errors::SECTION_LIGHTING_ID);
-
-            std::string enabled = getStringFromElementAttribute(xmlLightElement,
-                    Xml::GenericAttributes::Enabled,
-                    Xml::Errors::SECTION_LIGHTING_ENABLED);
-            lightEnable = validateBoolean(enabled);
-
-            location = getFloatPointFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Location,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_LOCATION);
-            ambient = getColorFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Ambient,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_AMBIENT);
-            diffuse = getColorFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Diffuse,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_DIFFUSE);
-            specular = getColorFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Specular,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_SPECULAR);
-            angle = getFloatFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Angle, Xml::Errors::SECTION_LIGHTING_ANGLE);
-            exponent = getFloatFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Exponent,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_EXPONENT);
-            direction = getFloatPointFromElementAttribute(xmlLightElement,
-                    Xml::Nodes::Lights::Attributes::Direction,
-                    Xml::Errors::ATTRIBUTE_LIGHTING_DIRECTION);
-
-            lightVector.push_back(
-                    new SpotLight(lightId, numberOfLights, lightEnable,
-                            location, ambient, diffuse, specular, angle,
-                            exponent, direction));
-
-            numberOfSpotLights++;
+        this->numberOfLights++;
+    }
+
+    /* Spot light */
+    if (Xml::Nodes::Lights::Spot == element.getToken()) {
+        std::string lightId;
+        bool lightEnable;
+        GLfloat angle, exponent;
+        xyzPointFloat location;
+        xyzPointFloat direction;
+        color ambient, diffuse, specular;
+
+        lightId = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::ID, Xml::Errors::SECTION_LIGHTING_ID);
+
+        std::string enabled = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::Enabled,
+                Xml::Errors::SECTION_LIGHTING_ENABLED);
+        lightEnable = validateBoolean(enabled);
+
+        location = getFloatPointFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Location,
+                Xml::Errors::ATTRIBUTE_LIGHTING_LOCATION);
+        ambient = getColorFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Ambient,
+                Xml::Errors::ATTRIBUTE_LIGHTING_AMBIENT);
+        diffuse = getColorFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Diffuse,
+                Xml::Errors::ATTRIBUTE_LIGHTING_DIFFUSE);
+        specular = getColorFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Specular,
+                Xml::Errors::ATTRIBUTE_LIGHTING_SPECULAR);
+        angle = getFloatFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Angle, Xml::Errors::SECTION_LIGHTING_ANGLE);
+        exponent = getFloatFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Exponent,
+                Xml::Errors::ATTRIBUTE_LIGHTING_EXPONENT);
+        direction = getFloatPointFromElementAttribute(element,
+                Xml::Nodes::Lights::Attributes::Direction,
+                Xml::Errors::ATTRIBUTE_LIGHTING_DIRECTION);
+
+        lightVector.push_back(
+                new SpotLight(lightId, numberOfLights, lightEnable,
+                        location, ambient, diffuse, specular, angle,
+                        exponent, direction));
+
+        if (imageWriter != nullptr) {
+            Binary::LightRecord record;
+            memset(&record, 0, sizeof(record));
+            record.id = imageWriter->addString(lightId);
+            record.type = Binary::LightSpot;
+            record.enabled = lightEnable ? 1 : 0;
+            binaryStoreLightColors(record, location, ambient, diffuse,
+                    specular);
+            record.angle = angle;
+            record.exponent = exponent;
+            record.direction[0] = direction.x;
+            record.direction[1] = direction.y;
+            record.direction[2] = direction.z;
+            imageWriter->addLight(record);
         }
-        this->numberOfLights = numberOfOmniLights + numberOfSpotLights;
-        xmlLightElement = xmlLightElement->NextSiblingElement();
 
-        if (this->numberOfLights == MAX_LIGHTS) {
-            std::cout << "XML: Lighting: Light limit reached, ignoring lights."
-                    << std::endl;
-            break;
+        this->numberOfLights++;
+    }
+
+    if (this->numberOfLights == MAX_LIGHTS) {
+        std::cout << "XML: Lighting: Light limit reached, ignoring lights."
+                << std::endl;
+    }
+}
+
+/* Load texture information from XML */
+void Scene::xmlLoadTexture(const YafElement& element) {
+    std::string textureId, textureFileName;
+    textureId = getStringFromElementAttribute(element,
+            Xml::GenericAttributes::ID,
+            Xml::Nodes::Textures::Errors::InvalidTextureID);
+    textureFileName = getStringFromElementAttribute(element,
+            Xml::GenericAttributes::File,
+            Xml::Nodes::Textures::Errors::InvalidFileName);
+
+    /* Create texture object here. */
+    addTexture(new Texture(textureId, textureFileName));
+
+    if (imageWriter != nullptr) {
+        imageWriter->addTexture(textureId, textureFileName);
+    }
+}
+
+/* Load an appearance from XML */
+void Scene::xmlLoadAppearance(const YafElement& element) {
+    std::string appearanceId, textureId;
+    float shininess, texlength_s, texlength_t;
+    color emissive, ambient, diffuse, specular;
+    bool hasTexture;
+
+    appearanceId = getStringFromElementAttribute(element,
+            Xml::GenericAttributes::ID,
+            Xml::Nodes::Appearances::Errors::InvalidAppearanceID);
+    emissive = getColorFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::Emissive,
+            Xml::Nodes::Appearances::Errors::InvalidEmissive);
+    ambient = getColorFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::Ambient,
+            Xml::Nodes::Appearances::Errors::InvalidAmbient);
+    diffuse = getColorFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::Diffuse,
+            Xml::Nodes::Appearances::Errors::InvalidDiffuse);
+    specular = getColorFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::Specular,
+            Xml::Nodes::Appearances::Errors::InvalidSpecular);
+    shininess = getFloatFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::Shininess,
+            Xml::Nodes::Appearances::Errors::InvalidShininess);
+    hasTexture = getAttributeExistence(element,
+            Xml::Nodes::Textures::Attributes::ID);
+
+    if (imageWriter != nullptr) {
+        Binary::AppearanceRecord record;
+        memset(&record, 0, sizeof(record));
+        record.id = imageWriter->addString(appearanceId);
+        record.textureRef = Binary::NoString;
+        binaryStoreColor(record.emissive, emissive);
+        binaryStoreColor(record.ambient, ambient);
+        binaryStoreColor(record.diffuse, diffuse);
+        binaryStoreColor(record.specular, specular);
+        record.shininess = shininess;
+        imageWriter->addAppearance(record);
+    }
+
+    if (hasTexture) {
+        textureId = getStringFromElementAttribute(element,
+                Xml::Nodes::Textures::Attributes::ID,
+                Xml::Nodes::Appearances::Errors::InvalidTextureID);
+        texlength_s = getFloatFromElementAttribute(element,
+                Xml::Nodes::Textures::Attributes::LenghtS,
+                Xml::Nodes::Appearances::Errors::InvalidTextureLenghtS);
+        texlength_t = getFloatFromElementAttribute(element,
+                Xml::Nodes::Textures::Attributes::LenghtT,
+                Xml::Nodes::Appearances::Errors::InvalidTextureLenghtT);
+
+        if (imageWriter != nullptr) {
+            imageWriter->setLastAppearanceTexture(textureId, texlength_s,
+                    texlength_t);
         }
-    }
 
-    if (numberOfLights < 1) {
-        throw Exception("XML: Lighting: No lights found!", true);
+        Appearance* temporaryAppearance = new Appearance(appearanceId,
+                emissive, ambient, diffuse, specular, shininess, textureId,
+                texlength_s, texlength_t);
+        addAppearance(temporaryAppearance);
+        temporaryAppearance = nullptr;
+    } else {
+        Appearance* temporaryAppearance = new Appearance(appearanceId,
+                emissive, ambient, diffuse, specular, shininess);
+        addAppearance(temporaryAppearance);
+        temporaryAppearance = nullptr;
     }
-
-    xmlLightsLoaded = true;
 }
 
-/* Load textures information from XML */
-void Scene::xmlLoadTextures() {
-    if (xmlTexturesLoaded) {
-        throw Exception("Textures have already been loaded!", true);
+/* Load the graph block from XML, the nodes come as children */
+void Scene::xmlLoadGraph(const YafElement& element) {
+    if (xmlGraphLoaded) {
+        throw Exception("Graph has already been loaded!", true);
     }
 
-    /* Get textures first child */
-    TiXmlElement* xmlTextureElement = xmlTexturesElement->FirstChildElement();
-
-    bool texturesLastRun = false;
-    while (xmlTextureElement != nullptr && !texturesLastRun) {
-        /* Checks if we are loading the last child, if so this will be the last run. */
-        if (xmlTextureElement == xmlTextureElement->LastChild()) {
-            texturesLastRun = true;
-        }
-
-        std::string textureId, textureFileName;
-        textureId = getStringFromElementAttribute(xmlTextureElement,
-                Xml::GenericAttributes::ID,
-                Xml::Nodes::Textures::Errors::InvalidTextureID);
-        textureFileName = getStringFromElementAttribute(xmlTextureElement,
-                Xml::GenericAttributes::File,
-                Xml::Nodes::Textures::Errors::InvalidFileName);
+    /* Root ID */
+    std::string rootId;
+    rootId = getStringFromElementAttribute(element,
+            Xml::Nodes::RootNodeID, Xml::Errors::ATTRIBUTE_GRAPH_ROOTID);
 
-        /* Create texture object here. */
-        textureVector.push_back(new Texture(textureId, textureFileName));
+    /* Create geGraph object */
+    graph = new SceneGraph(rootId);
 
-        xmlTextureElement = xmlTextureElement->NextSiblingElement();
+    if (imageWriter != nullptr) {
+        imageWriter->getGlobals().rootId = imageWriter->addString(rootId);
     }
-
-    xmlTexturesLoaded = true;
 }
 
-/* Load appearances from XML */
-void Scene::xmlLoadAppearances() {
-    if (xmlAppearancesLoaded) {
-        throw Exception("Appearances have already been loaded!", true);
-    }
-
-    int numberOfAppearances = 0;
-
-    /* Get apperances first child */
-    TiXmlElement* xmlAppearanceElement =
-            xmlAppearancesElement->FirstChildElement();
-    bool appearanceLastRun = false;
-    while (xmlAppearanceElement != nullptr && !appearanceLastRun) {
-        /* Checks if we are loading the last child, if so this will be the last run. */
-        if (xmlAppearanceElement == xmlAppearancesElement->LastChild()) {
-            appearanceLastRun = true;
-        }
+/* Load a node from XML, its blocks come as children */
+void Scene::xmlLoadNode(const YafElement& element) {
+    std::string nodeId;
 
-        std::string appearanceId, textureId;
-        float shininess, texlength_s, texlength_t;
-        color emissive, ambient, diffuse, specular;
-        bool hasTexture;
+    /* Id */
+    nodeId = getStringFromElementAttribute(element,
+            Xml::GenericAttributes::ID, Xml::Errors::SECTION_GRAPH_ID);
 
-        appearanceId = getStringFromElementAttribute(xmlAppearanceElement,
-                Xml::GenericAttributes::ID,
-                Xml::Nodes::Appearances::Errors::InvalidAppearanceID);
-        emissive = getColorFromElementAttribute(xmlAppearanceElement,
-                Xml::Nodes::Appearances::Attributes::Emissive,
-                Xml::Nodes::Appearances::Errors::InvalidEmissive);
-        ambient = getColorFromElementAttribute(xmlAppearanceElement,
-                Xml::Nodes::Appearances::Attributes::Ambient,
-                Xml::Nodes::Appearances::Errors::InvalidAmbient);
-        diffuse = getColorFromElementAttribute(xmlAppearanceElement,
-                Xml::Nodes::Appearances::Attributes::Diffuse,
-                Xml::Nodes::Appearances::Errors::InvalidDiffuse);
-        specular = getColorFromElementAttribute(xmlAppearanceElement,
-                Xml::Nodes::Appearances::Attributes::Specular,
-                Xml::Nodes::Appearances::Errors::InvalidSpecular);
-        shininess = getFloatFromElementAttribute(xmlAppearanceElement,
-                Xml::Nodes::Appearances::Attributes::Shininess,
-                Xml::Nodes::Appearances::Errors::InvalidShininess);
-        hasTexture = getAttributeExistence(xmlAppearanceElement,
-                Xml::Nodes::Textures::Attributes::ID);
-
-        if (hasTexture) {
-            textureId = getStringFromElementAttribute(xmlAppearanceElement,
-                    Xml::Nodes::Textures::Attributes::ID,
-                    Xml::Nodes::Appearances::Errors::InvalidTextureID);
-            texlength_s = getFloatFromElementAttribute(xmlAppearanceElement,
-                    Xml::Nodes::Textures::Attributes::LenghtS,
-                    Xml::Nodes::Appearances::Errors::InvalidTextureLenghtS);
-            texlength_t = getFloatFromElementAttribute(xmlAppearanceElement,
-                    Xml::Nodes::Textures::Attributes::LenghtT,
-                    Xml::Nodes::Appearances::Errors::InvalidTextureLenghtT);
-
-            Appearance* temporaryAppearance = new Appearance(appearanceId,
-                    emissive, ambient, diffuse, specular, shininess, textureId,
-                    texlength_s, texlength_t);
-            appearanceVector.push_back(temporaryAppearance);
-            temporaryAppearance = nullptr;
-        } else {
-            Appearance* temporaryAppearance = new Appearance(appearanceId,
-                    emissive, ambient, diffuse, specular, shininess);
-            appearanceVector.push_back(temporaryAppearance);
-            temporaryAppearance = nullptr;
-        }
+    /* Display list, left to the engine when the attribute is missing */
+    Node::ListMode displayList;
+    bool displayListAttribute = getAttributeExistence(element,
+            Xml::Nodes::DisplayLists::RootNode);
 
-        numberOfAppearances++;
-        xmlAppearanceElement = xmlAppearanceElement->NextSiblingElement();
+    if (displayListAttribute) {
+        std::string displayListTemp;
+        displayListTemp = getStringFromElementAttribute(element,
+                Xml::Nodes::DisplayLists::RootNode,
+                Xml::Errors::ATTRIBUTE_NODE_DISPLAYLIST);
+        displayList =
+                validateBoolean(displayListTemp) ?
+                        Node::ListOn : Node::ListOff;
+    } else {
+        displayList = Node::ListAuto;
     }
 
-    if (numberOfAppearances < 1) {
-        throw Exception("No appearances found!", true);
+    /* Static batch */
+    bool staticBatch = false;
+    if (getAttributeExistence(element, Xml::Nodes::StaticBatches::RootNode)) {
+        std::string staticBatchTemp = getStringFromElementAttribute(element,
+                Xml::Nodes::StaticBatches::RootNode,
+                Xml::Errors::ATTRIBUTE_NODE_STATICBATCH);
+        staticBatch = validateBoolean(staticBatchTemp);
     }
 
-    xmlAppearancesLoaded = true;
-}
+    xmlCurrentNode = new Node(nodeId, displayList, staticBatch);
+    xmlNodeTransformsFound = false;
+    xmlNodeAppearanceFound = false;
+    xmlNodeAnimationFound = false;
+    xmlNodeChildrenFound = false;
+    xmlNodeTransformCount = 0;
 
-/* Load the scene graph from XML */
-void Scene::xmlLoadGraph() {
-    if (xmlGraphLoaded) {
-        throw Exception("Graph has already been loaded!", true);
+    if (imageWriter != nullptr) {
+        imageWriter->beginNode(nodeId, displayList == Node::ListOn,
+                displayList == Node::ListAuto, staticBatch);
     }
+}
 
-    /* Root ID */
-    std::string rootId;
-    rootId = getStringFromElementAttribute(xmlGraphElement,
-            Xml::Nodes::RootNodeID, Xml::Errors::ATTRIBUTE_GRAPH_ROOTID);
-
-    /* Create geGraph object */
-    graph = new SceneGraph(rootId);
-
-    /* Get graph first child (node) */
-    int numberOfGraphNodes = 0;
-    TiXmlElement* xmlNodeElement = xmlGraphElement->FirstChildElement();
+/* Node blocks, only the first block of each kind is used */
+Scene::XmlState Scene::xmlLoadNodeBlock(const YafElement& element) {
+    Xml::Names::Name name = element.getToken();
 
-    if (xmlGraphElement == nullptr) {
-        throw Exception("Graph: Error while reading graph node.", true);
+    /*************************************** Begin transforms ***************************************/
+    if (Xml::Nodes::Transforms::RootNode == name && !xmlNodeTransformsFound) {
+        xmlNodeTransformsFound = true;
+        return XmlTransforms;
     }
 
-    bool nodeLastRun = false;
-    while (xmlNodeElement != nullptr && !nodeLastRun) {
-        /* Checks if we are loading the last child, if so this will be the last run. */
-        if (xmlNodeElement == xmlGraphElement->LastChild()) {
-            nodeLastRun = true;
-        }
-
-        std::string nodeId;
-
+    /*************************************** Begin appearanceref ***************************************/
+    if (Xml::Nodes::Appearances::NodeReference == name
+            && !xmlNodeAppearanceFound) {
+        std::string appearanceId;
         /* Id */
-        nodeId = getStringFromElementAttribute(xmlNodeElement,
-                Xml::GenericAttributes::ID, Xml::Errors::SECTION_GRAPH_ID);
-
-        /* Display list */
-        bool displayList;
-        bool displayListAttribute = getAttributeExistence(xmlNodeElement,
-                Xml::Nodes::DisplayLists::RootNode);
-
-        if (displayListAttribute) {
-            std::string displayListTemp;
-            displayListTemp = getStringFromElementAttribute(xmlNodeElement,
-                    Xml::Nodes::DisplayLists::RootNode,
-                    Xml::Errors::ATTRIBUTE_NODE_DISPLAYLIST);
-            displayList = validateBoolean(displayListTemp);
-        } else {
-            displayList = false;
-        }
+        appearanceId = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::ID,
+                Xml::Errors::SECTION_GRAPH_APPEARANCE_ID);
 
-        Node* temporaryNode;
-        temporaryNode = new Node(nodeId, displayList);
+        /* Resolved once every appearance is known */
+        xmlCurrentNode->setAppearanceReference(appearanceId);
+        xmlNodeAppearanceFound = true;
 
-        /*************************************** Begin transforms ***************************************/
-        /* Get node first child (transforms) */
-        unsigned numberOfTransforms = 0;
-        TiXmlElement* xmlTransformsElement = xmlNodeElement->FirstChildElement(
-                Xml::Nodes::Transforms::RootNode);
-        if (xmlTransformsElement == nullptr) {
-            throw Exception("Node: No transform block found.", true,
-                    xmlNodeElement->Row());
+        if (imageWriter != nullptr) {
+            imageWriter->setNodeAppearance(appearanceId);
         }
+    }
 
-        TiXmlElement* xmlTransformElement =
-                xmlTransformsElement->FirstChildElement();
-
-        bool transformsLastRun = false;
-        while (xmlTransformElement != nullptr && !transformsLastRun) {
-            /* Checks if we are loading the last child, if so this will be the last run. */
-            if (xmlTransformElement == xmlNodeElement->LastChild()) {
-                transformsLastRun = true;
-            }
+    /*************************************** Begin animationref ***************************************/
+    if (Xml::Nodes::Animations::NodeReference == name
+            && !xmlNodeAnimationFound) {
+        /* Id */
+        std::string animationId;
+        animationId = getStringFromElementAttribute(element,
+                Xml::GenericAttributes::ID,
+                Xml::Errors::SECTION_GRAPH_ANIMATION_ID);
 
-            if (Xml::Nodes::Transforms::Scale == xmlTransformElement->Value()) {
-                /* Factor */
-                xyzPointDouble scaleFactor;
-                scaleFactor = getDoublePointFromElementAttribute(
-                        xmlTransformElement, Xml::Nodes::Transforms::Attributes::Factor,
-                        Xml::Errors::ATTRIBUTE_TRANSFORM_FACTOR);
+        /* Resolved once every animation is known */
+        xmlCurrentNode->setAnimationReference(animationId);
+        xmlNodeAnimationFound = true;
 
-                temporaryNode->addTransform(
-                        new TransformScale(scaleFactor, numberOfTransforms));
-                numberOfTransforms++;
-            }
+        if (imageWriter != nullptr) {
+            imageWriter->setNodeAnimation(animationId);
+        }
+    }
 
-            if (Xml::Nodes::Transforms::Rotate == xmlTransformElement->Value()) {
-                std::string axis;
-                int axisInt;
-                float angle;
-
-                /* Axis */
-                axis = getStringFromElementAttribute(xmlTransformElement,
-                        Xml::Nodes::Transforms::Attributes::Axis,
-                        Xml::Errors::ATTRIBUTE_TRANSFORM_AXIS);
-
-                if (axis == "x") {
-                    axisInt = 0;
-                } else if (axis == "y") {
-                    axisInt = 1;
-                } else if (axis == "z") {
-                    axisInt = 2;
-                } else {
-                    throw Exception(
-                            "Transform: Invalid string in transform axis.",
-                            true, xmlTransformElement->Row());
-                }
+    /*************************************** Begin children ***************************************/
+    if (Xml::Blocks::Children == name && !xmlNodeChildrenFound) {
+        xmlNodeChildrenFound = true;
+        return XmlChildren;
+    }
 
-                /* Angle */
-                angle = getFloatFromElementAttribute(xmlTransformElement,
-                        Xml::Nodes::Appearances::Attributes::Angle, Xml::Errors::ATTRIBUTE_ANGLE);
+    return XmlIgnored;
+}
 
-                temporaryNode->addTransform(
-                        new TransformRotate(axisInt, angle,
-                                numberOfTransforms));
-                numberOfTransforms++;
-            }
+/* Load a node transform from XML */
+void Scene::xmlLoadTransform(const YafElement& element) {
+    switch (element.getToken()) {
+        case Xml::Nodes::Transforms::Scale: {
+            /* Factor */
+            xyzPointDouble scaleFactor;
+            scaleFactor = getDoublePointFromElementAttribute(element,
+                    Xml::Nodes::Transforms::Attributes::Factor,
+                    Xml::Errors::ATTRIBUTE_TRANSFORM_FACTOR);
 
-            /* Translate */
-            if (Xml::Nodes::Transforms::Translate == xmlTransformElement->Value()) {
-                xyzPointDouble translate;
-                translate = getDoublePointFromElementAttribute(
-                        xmlTransformElement, Xml::Nodes::Transforms::Attributes::To,
-                        Xml::Errors::ATTRIBUTE_TRANSFORM_TO);
+            xmlCurrentNode->addTransform(
+                    new TransformScale(scaleFactor, xmlNodeTransformCount));
+            xmlNodeTransformCount++;
 
-                temporaryNode->addTransform(
-                        new TransformTranslate(translate,
-                                numberOfTransforms));
-                numberOfTransforms++;
+            if (imageWriter != nullptr) {
+                imageWriter->addNodeTransform(
+                        binaryTransformRecord(Binary::TransformTypeScale, 0,
+                                scaleFactor.x, scaleFactor.y, scaleFactor.z));
             }
-
-            xmlTransformElement = xmlTransformElement->NextSiblingElement();
+            break;
         }
 
-        /* End transforms */
-
-        /*************************************** Begin appearanceref ***************************************/
-        TiXmlElement* xmlAppearancerefElement =
-                xmlNodeElement->FirstChildElement(Xml::Nodes::Appearances::NodeReference);
-        if (xmlAppearancerefElement == nullptr) {
+        case Xml::Nodes::Transforms::Rotate: {
+            int axisInt;
+            float angle;
 
-        } else {
-            std::string appearanceId;
-            /* Id */
-            appearanceId = getStringFromElementAttribute(
-                    xmlAppearancerefElement, Xml::GenericAttributes::ID,
-                    Xml::Errors::SECTION_GRAPH_APPEARANCE_ID);
-
-            temporaryNode->setAppearance(getAppearanceByString(appearanceId));
-        }
-        /* End appearanceref */
+            /* Axis */
+            const std::string_view* axisPointer = element.getAttribute(
+                    Xml::Nodes::Transforms::Attributes::Axis);
+            if (axisPointer == nullptr) {
+                throw Exception(Xml::Errors::ATTRIBUTE_TRANSFORM_AXIS, true,
+                        element.getRow());
+            }
+            std::string_view axis = *axisPointer;
+
+            if (axis == "x") {
+                axisInt = 0;
+            } else if (axis == "y") {
+                axisInt = 1;
+            } else if (axis == "z") {
+                axisInt = 2;
+            } else {
+                throw Exception("Transform: Invalid string in transform axis.",
+                        true, element.getRow());
+            }
 
-        /*************************************** Begin animationref ***************************************/
-        TiXmlElement* xmlAnimationrefElement =
-                xmlNodeElement->FirstChildElement(Xml::Nodes::Animations::NodeReference);
-        if (xmlAnimationrefElement == nullptr) {
+            /* Angle */
+            angle = getFloatFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Angle, Xml::Errors::ATTRIBUTE_ANGLE);
 
-        } else {
-            /* Id */
-            std::string animationId;
-            animationId = getStringFromElementAttribute(xmlAnimationrefElement,
-                    Xml::GenericAttributes::ID, Xml::Errors::SECTION_GRAPH_ANIMATION_ID);
+            xmlCurrentNode->addTransform(
+                    new TransformRotate(axisInt, angle, xmlNodeTransformCount));
+            xmlNodeTransformCount++;
 
-            temporaryNode->setAnimation(getAnimationByString(animationId));
+            if (imageWriter != nullptr) {
+                imageWriter->addNodeTransform(
+                        binaryTransformRecord(Binary::TransformTypeRotate,
+                                axisInt, angle, 0.0, 0.0));
+            }
+            break;
         }
-        /* End animationref */
 
-        /*************************************** Begin children ***************************************/
-        /* Get node first child (children) */
-        unsigned numberOfChildren = 0;
-        TiXmlElement* xmlChildrensElement = xmlNodeElement->FirstChildElement(
-                Xml::Blocks::Children);
-        if (xmlChildrensElement == nullptr) {
-            throw Exception("Node: No children block found.", true,
-                    xmlNodeElement->Row());
+        /* Translate */
+        case Xml::Nodes::Transforms::Translate: {
+            xyzPointDouble translate;
+            translate = getDoublePointFromElementAttribute(element,
+                    Xml::Nodes::Transforms::Attributes::To,
+                    Xml::Errors::ATTRIBUTE_TRANSFORM_TO);
+
+            xmlCurrentNode->addTransform(
+                    new TransformTranslate(translate, xmlNodeTransformCount));
+            xmlNodeTransformCount++;
+
+            if (imageWriter != nullptr) {
+                imageWriter->addNodeTransform(
+                        binaryTransformRecord(Binary::TransformTypeTranslate, 0,
+                                translate.x, translate.y, translate.z));
+            }
+            break;
         }
 
-        TiXmlElement* xmlChildrenElement =
-                xmlChildrensElement->FirstChildElement();
-
-        bool childrensLastRun = false;
-        while (xmlChildrenElement != nullptr && !childrensLastRun) {
-            /* Checks if we are loading the last child, if so this will be the last run. */
-            if (xmlChildrenElement == xmlChildrensElement->LastChild()) {
-                childrensLastRun = true;
-            }
+        default:
+            break;
+    }
+}
 
-            /*Rectangle*/
-            if (Xml::Nodes::Appearances::Rectangle == xmlChildrenElement->Value()) {
-                xyPointDouble pt1, pt2;
+/* Load a primitive or node reference from XML */
+Scene::XmlState Scene::xmlLoadNodeChild(const YafElement& element) {
+    switch (element.getToken()) {
+        /*Rectangle*/
+        case Xml::Nodes::Appearances::Rectangle: {
+            xyPointDouble pt1, pt2;
 
-                /* XY1 */
-                pt1 = get2DdPointFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::xy1,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_XY1);
+            /* XY1 */
+            pt1 = get2DdPointFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::xy1,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_XY1);
 
-                /* XY2 */
-                pt2 = get2DdPointFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::xy2,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_XY2);
+            /* XY2 */
+            pt2 = get2DdPointFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::xy2,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_XY2);
 
-                /* Create rectangle and store pointer in graph */
-                Primitives::PrimitiveInterface* primitiveTemp =
-                        new Primitives::Rectangle(pt1, pt2);
-                temporaryNode->addPrimitive(primitiveTemp);
-                primitiveTemp = nullptr;
+            /* Create rectangle and store pointer in graph */
+            xmlCurrentNode->addPrimitive(new Primitives::Rectangle(pt1, pt2));
 
-                numberOfChildren++;
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitiveRectangle);
+                record.values[0] = pt1.x;
+                record.values[1] = pt1.y;
+                record.values[2] = pt2.x;
+                record.values[3] = pt2.y;
+                imageWriter->addNodePrimitive(record);
             }
+            break;
+        }
 
-            /*Triangle*/
-            if (Xml::Nodes::Appearances::Triangle == xmlChildrenElement->Value()) {
-                xyzPointDouble point1, point2, point3;
-                point1 = getDoublePointFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::xyz1,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_XYZ1);
-                point2 = getDoublePointFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::xyz2,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_XYZ2);
-                point3 = getDoublePointFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::xyz3,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_XYZ3);
-
-                /* Create triangle and store pointer in graph */
-                Primitives::PrimitiveInterface* primitiveTemp =
-                        new Primitives::Triangle(point1, point2, point3);
-                temporaryNode->addPrimitive(primitiveTemp);
-                primitiveTemp = nullptr;
-
-                numberOfChildren++;
+        /*Triangle*/
+        case Xml::Nodes::Appearances::Triangle: {
+            xyzPointDouble point1, point2, point3;
+            point1 = getDoublePointFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::xyz1,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_XYZ1);
+            point2 = getDoublePointFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::xyz2,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_XYZ2);
+            point3 = getDoublePointFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::xyz3,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_XYZ3);
+
+            /* Create triangle and store pointer in graph */
+            xmlCurrentNode->addPrimitive(
+                    new Primitives::Triangle(point1, point2, point3));
+
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitiveTriangle);
+                record.values[0] = point1.x;
+                record.values[1] = point1.y;
+                record.values[2] = point1.z;
+                record.values[3] = point2.x;
+                record.values[4] = point2.y;
+                record.values[5] = point2.z;
+                record.values[6] = point3.x;
+                record.values[7] = point3.y;
+                record.values[8] = point3.z;
+                imageWriter->addNodePrimitive(record);
             }
+            break;
+        }
 
-            /*Cylinder*/
-            if (Xml::Nodes::Appearances::Cylinder == xmlChildrenElement->Value()) {
-                float base, top, height;
-                unsigned int slices, stacks;
-
-                base = getFloatFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Base,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_BASE);
-                top = getFloatFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Top,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_TOP);
-                height = getFloatFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Height,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_HEIGHT);
-                slices = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Slices,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_SLICES);
-                stacks = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Stacks,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_STACKS);
-
-                /* Create cylinder and store pointer in graph */
-                Primitives::PrimitiveInterface* primitiveTemp =
-                        new Primitives::Cylinder(base, top, height, slices,
-                                stacks);
-                temporaryNode->addPrimitive(primitiveTemp);
-                primitiveTemp = nullptr;
-
-                numberOfChildren++;
+        /*Cylinder*/
+        case Xml::Nodes::Appearances::Cylinder: {
+            float base, top, height;
+            unsigned int slices, stacks;
+
+            base = getFloatFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Base,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_BASE);
+            top = getFloatFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Top,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_TOP);
+            height = getFloatFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Height,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_HEIGHT);
+            slices = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Slices,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_SLICES);
+            stacks = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Stacks,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_CYL_STACKS);
+
+            /* Create cylinder and store pointer in graph */
+            xmlCurrentNode->addPrimitive(
+                    new Primitives::Cylinder(base, top, height, slices, stacks));
+
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitiveCylinder);
+                record.values[0] = base;
+                record.values[1] = top;
+                record.values[2] = height;
+                record.integers[0] = slices;
+                record.integers[1] = stacks;
+                imageWriter->addNodePrimitive(record);
             }
+            break;
+        }
 
-            /*Sphere*/
-            if (Xml::Nodes::Appearances::Sphere == xmlChildrenElement->Value()) {
-                float radius;
-                unsigned int slices, stacks;
-
-                radius = getFloatFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Radius,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_SPHERE_RADIUS);
-                slices = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Slices,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_SPHERE_SLICES);
-                stacks = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Stacks,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_SPHERE_STACKS);
-
-                /* Create sphere and store pointer in graph */
-                Primitives::PrimitiveInterface* primitiveTemp =
-                        new Primitives::Sphere(radius, slices, stacks);
-                temporaryNode->addPrimitive(primitiveTemp);
-                primitiveTemp = nullptr;
-
-                numberOfChildren++;
+        /*Sphere*/
+        case Xml::Nodes::Appearances::Sphere: {
+            float radius;
+            unsigned int slices, stacks;
+
+            radius = getFloatFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Radius,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_SPHERE_RADIUS);
+            slices = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Slices,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_SPHERE_SLICES);
+            stacks = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Stacks,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_SPHERE_STACKS);
+
+            /* Create sphere and store pointer in graph */
+            xmlCurrentNode->addPrimitive(
+                    new Primitives::Sphere(radius, slices, stacks));
+
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitiveSphere);
+                record.values[0] = radius;
+                record.integers[0] = slices;
+                record.integers[1] = stacks;
+                imageWriter->addNodePrimitive(record);
             }
+            break;
+        }
 
-            /*Torus*/
-            if (Xml::Nodes::Appearances::Torus == xmlChildrenElement->Value()) {
-                float inner, outer;
-                unsigned int slices, loops;
-
-                inner = getFloatFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Inner,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_INNER);
-                outer = getFloatFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Outer,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_OUTER);
-                slices = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Slices,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_SLICES);
-                loops = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Loops,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_LOOPS);
-
-                /* Create torus and store pointer in graph */
-                Primitives::PrimitiveInterface* primitiveTemp =
-                        new Primitives::Torus(inner, outer, slices, loops);
-                temporaryNode->addPrimitive(primitiveTemp);
-                primitiveTemp = nullptr;
-
-                numberOfChildren++;
+        /*Torus*/
+        case Xml::Nodes::Appearances::Torus: {
+            float inner, outer;
+            unsigned int slices, loops;
+
+            inner = getFloatFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Inner,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_INNER);
+            outer = getFloatFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Outer,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_OUTER);
+            slices = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Slices,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_SLICES);
+            loops = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Loops,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_TORUS_LOOPS);
+
+            /* Create torus and store pointer in graph */
+            xmlCurrentNode->addPrimitive(
+                    new Primitives::Torus(inner, outer, slices, loops));
+
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitiveTorus);
+                record.values[0] = inner;
+                record.values[1] = outer;
+                record.integers[0] = slices;
+                record.integers[1] = loops;
+                imageWriter->addNodePrimitive(record);
             }
+            break;
+        }
 
-            /* Plane */
-            if (Xml::Nodes::Appearances::Plane == xmlChildrenElement->Value()) {
-                unsigned int parts;
+        /* Plane */
+        case Xml::Nodes::Appearances::Plane: {
+            unsigned int parts;
 
-                parts = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Parts,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_PLANE_PARTS);
+            parts = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Parts,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_PLANE_PARTS);
 
-                /* Create plane and store pointer in graph */
-                Primitives::PrimitiveInterface* primitiveTemp =
-                        new Primitives::Plane(parts);
-                temporaryNode->addPrimitive(primitiveTemp);
-                primitiveTemp = nullptr;
+            /* Create plane and store pointer in graph */
+            xmlCurrentNode->addPrimitive(new Primitives::Plane(parts));
 
-                numberOfChildren++;
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitivePlane);
+                record.integers[0] = parts;
+                imageWriter->addNodePrimitive(record);
             }
+            break;
+        }
 
-            /* Patch */
-            if (Xml::Nodes::Appearances::Patch == xmlChildrenElement->Value()) {
-                unsigned int order, partsU, partsV, compute;
-
-                order = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Order,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_ORDER);
-                partsU = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::PartsU,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_PARTSU);
-                partsV = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::PartsV,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_PARTSV);
-                compute = getUnsignedIntFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::Compute,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_COMPUTE);
-
-                Primitives::Patch* primitiveTempP = new Primitives::Patch(order,
-                        partsU, partsV, compute);
-
-                /* Get number of points to be read */
-                unsigned int numberOfPoints =
-                        primitiveTempP->getNumberOfPoints();
-
-                TiXmlElement* xmlPatchPointElement =
-                        xmlChildrenElement->FirstChildElement();
-
-                bool pointsLastRun = false;
-                unsigned int readPoints = 0;
-
-                while (xmlPatchPointElement != nullptr && !pointsLastRun) {
-                    /* Checks if we are loading the last child, if so this will be the last run. */
-                    if (xmlPatchPointElement
-                            == xmlPatchPointElement->LastChild()) {
-                        pointsLastRun = true;
-                    }
-
-                    /* Point */
-                    if (Xml::Nodes::Appearances::ControlPoint == xmlPatchPointElement->Value()) {
-                        xyzPointDouble point;
-                        point.x = getFloatFromElementAttribute(
-                                xmlPatchPointElement,
-                                Xml::Nodes::Appearances::Attributes::x,
-                                Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_X);
-                        point.y = getFloatFromElementAttribute(
-                                xmlPatchPointElement,
-                                Xml::Nodes::Appearances::Attributes::y,
-                                Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_Y);
-                        point.z = getFloatFromElementAttribute(
-                                xmlPatchPointElement,
-                                Xml::Nodes::Appearances::Attributes::z,
-                                Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_Z);
-
-                        primitiveTempP->insertPoint(point);
-                        readPoints++;
-
-                        xmlPatchPointElement =
-                                xmlPatchPointElement->NextSiblingElement();
-                    } else {
-                        throw Exception("Patch: Invalid child found.", true);
-                    }
-                }
-
-                if (readPoints == numberOfPoints) {
-
-                } else {
-                    throw Exception(
-                            "Patch: Number of read points is invalid.", true);
-                }
-
-                /* Store gePatch pointer in graph */
-                temporaryNode->addPrimitive(primitiveTempP);
-                primitiveTempP = nullptr;
-
-                numberOfChildren++;
+        /* Patch, the control points come as children */
+        case Xml::Nodes::Appearances::Patch: {
+            unsigned int order, partsU, partsV, compute;
+
+            order = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Order,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_ORDER);
+            partsU = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::PartsU,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_PARTSU);
+            partsV = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::PartsV,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_PARTSV);
+            compute = getUnsignedIntFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::Compute,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_COMPUTE);
+
+            xmlCurrentPatch = new Primitives::Patch(order, partsU, partsV, compute);
+            xmlPatchReadPoints = 0;
+
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitivePatch);
+                record.integers[0] = order;
+                record.integers[1] = partsU;
+                record.integers[2] = partsV;
+                record.integers[3] = compute;
+                imageWriter->addNodePrimitive(record);
             }
 
-            /* Vehicle */
-            if (Xml::Nodes::Appearances::Vehicle == xmlChildrenElement->Value()) {
-
-                /* Create vehicle */
-                Primitives::Vehicle* primitiveTempV = new Primitives::Vehicle();
+            return XmlPatch;
+        }
 
-                /* Store the geVehicle pointer in the scene too, so that we can move it */
-                sceneVehicles.push_back(primitiveTempV);
+        /* Vehicle */
+        case Xml::Nodes::Appearances::Vehicle: {
 
-                /* Store geVehicle pointer in graph */
-                temporaryNode->addPrimitive(primitiveTempV);
-                primitiveTempV = nullptr;
-
-                numberOfChildren++;
-            }
+            /* Create vehicle */
+            Primitives::Vehicle* primitiveTempV = new Primitives::Vehicle();
 
-            /* Water line */
-            if (Xml::Nodes::Appearances::WaterLine == xmlChildrenElement->Value()) {
-                std::string hmap, tmap, fshader, vshader;
-
-                hmap = getStringFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::HeightMap,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_HEIGHTMAP);
-                tmap = getStringFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::TextureMap,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_TEXTUREMAP);
-                fshader = getStringFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::FragmentShader,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_FRAGMENTSHADER);
-                vshader = getStringFromElementAttribute(xmlChildrenElement,
-                        Xml::Nodes::Appearances::Attributes::VertexShader,
-                        Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_VERTEXSHADER_ERRROR);
-
-                /* Create waterline */
-                Primitives::WaterLine* primitiveTempWL =
-                        new Primitives::WaterLine(hmap, tmap, fshader, vshader);
+            /* Store the geVehicle pointer in the scene too, so that we can move it */
+            sceneVehicles.push_back(primitiveTempV);
 
-                /* Store geVehicle pointer in graph */
-                temporaryNode->addPrimitive(primitiveTempWL);
-                waterLineVector.push_back(primitiveTempWL);
+            /* Store geVehicle pointer in graph */
+            xmlCurrentNode->addPrimitive(primitiveTempV);
 
-                primitiveTempWL = nullptr;
+            if (imageWriter != nullptr) {
+                imageWriter->addNodePrimitive(
+                        binaryPrimitiveRecord(Binary::PrimitiveVehicle));
+            }
+            break;
+        }
 
-                numberOfChildren++;
+        /* Water line */
+        case Xml::Nodes::Appearances::WaterLine: {
+            std::string hmap, tmap, fshader, vshader;
+
+            hmap = getStringFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::HeightMap,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_HEIGHTMAP);
+            tmap = getStringFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::TextureMap,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_TEXTUREMAP);
+            fshader = getStringFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::FragmentShader,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_FRAGMENTSHADER);
+            vshader = getStringFromElementAttribute(element,
+                    Xml::Nodes::Appearances::Attributes::VertexShader,
+                    Xml::Errors::ATTRIBUTE_PRIMITIVE_WL_VERTEXSHADER_ERRROR);
+
+            /* Create waterline */
+            Primitives::WaterLine* primitiveTempWL = new Primitives::WaterLine(
+                    hmap, tmap, fshader, vshader);
+
+            /* Store geVehicle pointer in graph */
+            xmlCurrentNode->addPrimitive(primitiveTempWL);
+            waterLineVector.push_back(primitiveTempWL);
+
+            if (imageWriter != nullptr) {
+                Binary::PrimitiveRecord record = binaryPrimitiveRecord(
+                        Binary::PrimitiveWaterLine);
+                record.strings[0] = imageWriter->addString(hmap);
+                record.strings[1] = imageWriter->addString(tmap);
+                record.strings[2] = imageWriter->addString(fshader);
+                record.strings[3] = imageWriter->addString(vshader);
+                imageWriter->addNodePrimitive(record);
             }
+            break;
+        }
 
-            /* Noderef */
-            if (Xml::Blocks::NodeReference == xmlChildrenElement->Value()) {
-                std::string nodeReferenceId;
-                nodeReferenceId = getStringFromElementAttribute(
-                        xmlChildrenElement, Xml::GenericAttributes::ID,
-                        Xml::Blocks::Errors::InvalidNodeRefID);
+        /* Noderef */
+        case Xml::Blocks::NodeReference: {
+            std::string nodeReferenceId;
+            nodeReferenceId = getStringFromElementAttribute(element,
+                    Xml::GenericAttributes::ID,
+                    Xml::Blocks::Errors::InvalidNodeRefID);
 
-                /* Set reference id */
-                temporaryNode->addChildrenID(nodeReferenceId);
+            /* Set reference id */
+            xmlCurrentNode->addChildrenID(nodeReferenceId);
 
-                numberOfChildren++;
+            if (imageWriter != nullptr) {
+                imageWriter->addNodeChild(nodeReferenceId);
             }
-
-            xmlChildrenElement = xmlChildrenElement->NextSiblingElement();
+            break;
         }
 
-        /* End children */
+        default:
+            break;
+    }
 
-        unprocessedNodes.push_back(temporaryNode);
+    return XmlIgnored;
+}
 
-        numberOfGraphNodes++;
-        xmlNodeElement = xmlNodeElement->NextSiblingElement();
+/* Load a patch control point from XML */
+void Scene::xmlLoadPatchPoint(const YafElement& element) {
+    if (Xml::Nodes::Appearances::ControlPoint != element.getToken()) {
+        throw Exception("Patch: Invalid child found.", true, element.getRow());
     }
 
-    if (numberOfGraphNodes < 1) {
-        throw Exception("Node: No nodes found.", true, xmlNodeElement->Row());
-    }
+    xyzPointDouble point;
+    point.x = getFloatFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::x,
+            Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_X);
+    point.y = getFloatFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::y,
+            Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_Y);
+    point.z = getFloatFromElementAttribute(element,
+            Xml::Nodes::Appearances::Attributes::z,
+            Xml::Errors::ATTRIBUTE_PRIMITIVE_PATCH_Z);
 
-    graph->importNodesPointerVector(unprocessedNodes);
+    xmlCurrentPatch->insertPoint(point);
+    xmlPatchReadPoints++;
 
-    xmlGraphLoaded = true;
+    if (imageWriter != nullptr) {
+        imageWriter->addPrimitivePoint(point.x, point.y, point.z);
+    }
 }
 
-/* Load animations from XML */
-void Scene::xmlLoadAnimations() {
-    if (xmlAnimationsLoaded) {
-        throw Exception("Animations have already been loaded!", true);
+void Scene::xmlEndPatch() {
+    if (xmlPatchReadPoints != xmlCurrentPatch->getNumberOfPoints()) {
+        throw Exception("Patch: Number of read points is invalid.", true);
     }
 
-    int numberOfAnimations = 0;
-
-    /* Get animations first child */
-    TiXmlElement* xmlAnimationElement =
-            xmlAnimationsElement->FirstChildElement();
+    /* Store gePatch pointer in graph */
+    xmlCurrentNode->addPrimitive(xmlCurrentPatch);
+    xmlCurrentPatch = nullptr;
+}
 
-    bool animationsLastRun = false;
-    while (xmlAnimationElement != nullptr && !animationsLastRun) {
-        /* Checks if we are loading the last child, if so this will be the last run. */
-        if (xmlAnimationElement == xmlAnimationElement->LastChild()) {
-            animationsLastRun = true;
-        }
+void Scene::xmlEndNode(const YafElement& element) {
+    if (!xmlNodeTransformsFound) {
+        throw Exception("Node: No transform block found.", true,
+                element.getRow());
+    }
 
-        std::string animationId, animationType;
-        float animationSpan;
-        unsigned int animationTypeNumber;
+    if (!xmlNodeChildrenFound) {
+        throw Exception("Node: No children block found.", true,
+                element.getRow());
+    }
 
-        animationId = getStringFromElementAttribute(xmlAnimationElement,
-                Xml::GenericAttributes::ID, Xml::Nodes::Animations::Errors::InvalidID);
-        animationSpan = getFloatFromElementAttribute(xmlAnimationElement,
-                Xml::Nodes::Animations::Attributes::Span,
-                Xml::Nodes::Animations::Errors::InvalidSpan);
-        animationType = getStringFromElementAttribute(xmlAnimationElement,
-                Xml::Nodes::Animations::Attributes::Type,
-                Xml::Nodes::Animations::Errors::InvalidType);
+    if (imageWriter != nullptr) {
+        xmlCurrentNode->setPrimitivesHash(imageWriter->getNodePrimitivesHash());
+        imageWriter->endNode();
+    }
 
-        /* Check the animation type string */
-        if (animationType == Xml::Nodes::Animations::Values::Linear) {
-            animationTypeNumber = 1;
-        } else {
-            throw Exception("Animations: Invalid animation type string.",
-                    true, xmlAnimationElement->Row());
-        }
+    unprocessedNodes.push_back(xmlCurrentNode);
+    xmlCurrentNode = nullptr;
+}
 
-        /* Create animation object here. (So that we can add control points later) */
-        Animation* temporaryAnimation;
-        temporaryAnimation = new Animation(animationId, animationSpan,
-                animationTypeNumber);
+/* Load an animation from XML, the control points come as children */
+void Scene::xmlLoadAnimation(const YafElement& element) {
+    std::string animationId, animationType;
+    float animationSpan;
+    unsigned int animationTypeNumber;
 
-        animationsVector.push_back(temporaryAnimation);
+    animationId = getStringFromElementAttribute(element,
+            Xml::GenericAttributes::ID, Xml::Nodes::Animations::Errors::InvalidID);
+    animationSpan = getFloatFromElementAttribute(element,
+            Xml::Nodes::Animations::Attributes::Span,
+            Xml::Nodes::Animations::Errors::InvalidSpan);
+    animationType = getStringFromElementAttribute(element,
+            Xml::Nodes::Animations::Attributes::Type,
+            Xml::Nodes::Animations::Errors::InvalidType);
 
-        /* Control Points */
-        TiXmlElement* xmlAnimationPointElement =
-                xmlAnimationElement->FirstChildElement();
+    /* Check the animation type string */
+    if (animationType == Xml::Nodes::Animations::Values::Linear) {
+        animationTypeNumber = 1;
+    } else {
+        throw Exception("Animations: Invalid animation type string.", true,
+                element.getRow());
+    }
 
-        bool pointsLastRun = false;
-        unsigned int readPoints = 0;
+    /* Create animation object here. (So that we can add control points later) */
+    xmlCurrentAnimation = new Animation(animationId, animationSpan,
+            animationTypeNumber);
 
-        while (xmlAnimationPointElement != nullptr && !pointsLastRun) {
-            /* Checks if we are loading the last child, if so this will be the last run. */
-            if (xmlAnimationPointElement
-                    == xmlAnimationPointElement->LastChild()) {
-                pointsLastRun = true;
-            }
+    addAnimation(xmlCurrentAnimation);
 
-            /* Point */
-            if (Xml::Nodes::Appearances::ControlPoint == xmlAnimationPointElement->Value()) {
-                xyzPointDouble point;
+    if (imageWriter != nullptr) {
+        imageWriter->beginAnimation(animationId, animationSpan,
+                animationTypeNumber);
+    }
+}
 
-                point.x = getFloatFromElementAttribute(xmlAnimationPointElement,
-                        Xml::Nodes::Animations::Attributes::x,
-                        Xml::Nodes::Animations::Errors::InvalidX);
-                point.y = getFloatFromElementAttribute(xmlAnimationPointElement,
-                        Xml::Nodes::Animations::Attributes::y,
-                        Xml::Nodes::Animations::Errors::InvalidY);
-                point.z = getFloatFromElementAttribute(xmlAnimationPointElement,
-                        Xml::Nodes::Animations::Attributes::z,
-                        Xml::Nodes::Animations::Errors::InvalidZ);
+/* Load an animation control point from XML */
+void Scene::xmlLoadAnimationPoint(const YafElement& element) {
+    if (Xml::Nodes::Appearances::ControlPoint != element.getToken()) {
+        throw Exception("Animation: Invalid child found.", true,
+                element.getRow());
+    }
 
-                temporaryAnimation->insertPoint(point);
+    xyzPointDouble point;
 
-                readPoints++;
+    point.x = getFloatFromElementAttribute(element,
+            Xml::Nodes::Animations::Attributes::x,
+            Xml::Nodes::Animations::Errors::InvalidX);
+    point.y = getFloatFromElementAttribute(element,
+            Xml::Nodes::Animations::Attributes::y,
+            Xml::Nodes::Animations::Errors::InvalidY);
+    point.z = getFloatFromElementAttribute(element,
+            Xml::Nodes::Animations::Attributes::z,
+            Xml::Nodes::Animations::Errors::InvalidZ);
 
-                xmlAnimationPointElement =
-                        xmlAnimationPointElement->NextSiblingElement();
-            } else {
-                throw Exception("Animation: Invalid child found.", true);
-            }
-        }
+    xmlCurrentAnimation->insertPoint(point);
 
-        numberOfAnimations++;
-        xmlAnimationElement = xmlAnimationElement->NextSiblingElement();
+    if (imageWriter != nullptr) {
+        imageWriter->addAnimationPoint(point.x, point.y, point.z);
     }
-
-    xmlAnimationsLoaded = true;
 }
 
-TiXmlElement *Scene::findChildByAttribute(TiXmlElement *parent,
-        const char * attr, const char *val) {
-    TiXmlElement *child = parent->FirstChildElement();
-    bool found = false;
+/* Sections can come in any order, so node references are only resolved at the end */
+void Scene::xmlLinkGraph() {
+    LoadProfiler::Scope profile(LoadProfiler::PhaseGraphImport);
 
-    while (child && !found) {
-        if (child->Attribute(attr)
-                && strcmp(child->Attribute(attr), val) == 0) {
-            found = true;
-        } else {
-            child = child->NextSiblingElement();
+    for (auto node : unprocessedNodes) {
+        std::string appearanceId = node->getAppearanceReference();
+        if (!appearanceId.empty()) {
+            node->setAppearance(getAppearanceByString(appearanceId));
+        }
+
+        std::string animationId = node->getAnimationReference();
+        if (!animationId.empty()) {
+            node->setAnimation(getAnimationByString(animationId));
         }
     }
 
-    return child;
+    graph->importNodesPointerVector(unprocessedNodes);
 }
 
-std::string Scene::getStringFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
+std::string Scene::getStringFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
 
-    const std::string* valString = iElement->Attribute(iAttribute);
+    const std::string_view* valString = iElement.getAttribute(iAttribute);
 
     if (valString) {
         return std::string(*valString);
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
-xyzPointDouble Scene::getDoublePointFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
-    xyzPointDouble output;
-    const std::string* valString = iElement->Attribute(iAttribute);
+xyzPointDouble Scene::getDoublePointFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
+    double values[3];
 
-    if (valString
-            && sscanf(valString->c_str(), "%lf %lf %lf", &output.x, &output.y, &output.z)
-                    == 3) {
+    if (iElement.getNumbers(iAttribute, values, 3)) {
+        xyzPointDouble output;
+        output.x = values[0];
+        output.y = values[1];
+        output.z = values[2];
         return output;
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
-xyzPointFloat Scene::getFloatPointFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
-    xyzPointFloat output;
-    const std::string*  valString = iElement->Attribute(iAttribute);
+xyzPointFloat Scene::getFloatPointFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
+    float values[3];
 
-    if (valString
-            && sscanf(valString->c_str(), "%f %f %f", &output.x, &output.y, &output.z)
-                    == 3) {
+    if (iElement.getNumbers(iAttribute, values, 3)) {
+        xyzPointFloat output;
+        output.x = values[0];
+        output.y = values[1];
+        output.z = values[2];
         return output;
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
-color Scene::getColorFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
-    color output;
-    const std::string* valString = iElement->Attribute(iAttribute);
+color Scene::getColorFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
+    float values[4];
 
-    if (valString && sscanf(valString->c_str(), "%f %f %f %f", &output.r, &output.g, &output.b, &output.a) == 4) {
+    if (iElement.getNumbers(iAttribute, values, 4)) {
+        color output;
+        output.r = values[0];
+        output.g = values[1];
+        output.b = values[2];
+        output.a = values[3];
         return output;
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
-double Scene::getDoubleFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
+double Scene::getDoubleFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
     double output;
-    const std::string* valString = iElement->Attribute(iAttribute);
 
-    if (valString && sscanf(valString->c_str(), "%lf", &output) == 1) {
+    if (iElement.getNumbers(iAttribute, &output, 1)) {
         return output;
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
-float Scene::getFloatFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
+float Scene::getFloatFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
     float output;
-    const std::string* valString = iElement->Attribute(iAttribute);
 
-    if (valString && sscanf(valString->c_str(), "%f", &output) == 1) {
+    if (iElement.getNumbers(iAttribute, &output, 1)) {
         return output;
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
-unsigned int Scene::getUnsignedIntFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
+unsigned int Scene::getUnsignedIntFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
     unsigned int output;
-    const std::string* valString = iElement->Attribute(iAttribute);
 
-    if (valString && sscanf(valString->c_str(), "%u", &output) == 1) {
+    if (iElement.getNumbers(iAttribute, &output, 1)) {
         return output;
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
-bool Scene::getAttributeExistence(TiXmlElement* iElement,
-        const std::string& iAttribute) {
-    const std::string* valString = iElement->Attribute(iAttribute);
-
-    if (valString) {
-        return true;
-    } else {
-        return false;
-    }
+bool Scene::getAttributeExistence(const YafElement& iElement,
+        Xml::Names::Name iAttribute) {
+    return iElement.getAttribute(iAttribute) != nullptr;
 }
 
-xyPointDouble Scene::get2DdPointFromElementAttribute(TiXmlElement* iElement,
-        const std::string& iAttribute, const std::string& Error) {
-    xyPointDouble output;
-    const std::string* valString = iElement->Attribute(iAttribute);
+xyPointDouble Scene::get2DdPointFromElementAttribute(const YafElement& iElement,
+        Xml::Names::Name iAttribute, const std::string& Error) {
+    double values[2];
 
-    if (valString && sscanf(valString->c_str(), "%lf %lf", &output.x, &output.y) == 2) {
+    if (iElement.getNumbers(iAttribute, values, 2)) {
+        xyPointDouble output;
+        output.x = values[0];
+        output.y = values[1];
         return output;
     }
 
-    throw Exception(Error, true, iElement->Row());
+    throw Exception(Error, true, iElement.getRow());
 }
 
 /* End XML functions */
@@ -1309,23 +2032,24 @@ void Scene::applyGlobals() {
     /* Cull face [OK] */
     if (this->cullFace == Xml::Nodes::Globals::Values::CullFaceNone) {
         glCullFace(GL_NONE);
+        GLState::disable(GL_CULL_FACE);
     }
 
     if (this->cullFace == Xml::Nodes::Globals::Values::CullFaceBack) {
         glCullFace(GL_BACK);
-        glEnable(GL_CULL_FACE);
+        GLState::enable(GL_CULL_FACE);
     }
 
     if (this->cullFace == Xml::Nodes::Globals::Values::CullFaceFront) {
         glCullFace(GL_FRONT);
-        glEnable(GL_CULL_FACE);
+        GLState::enable(GL_CULL_FACE);
     }
 
     /* Cull order [OK] */
     if (this->cullFace == Xml::Nodes::Globals::Values::CullFaceBoth) {
         glCullFace(GL_BACK);
         glCullFace(GL_FRONT);
-        glEnable(GL_CULL_FACE);
+        GLState::enable(GL_CULL_FACE);
     }
 
     /* Draw mode */
@@ -1348,13 +2072,14 @@ void Scene::applyGlobals() {
     }
 
     /* Enable depth comparisons */
-    glEnable(GL_DEPTH_TEST);
+    GLState::enable(GL_DEPTH_TEST);
 }
 
 GLboolean Scene::getLightingEnableStatus() {
     return this->lightingEnable;
 }
 
+/* GL realization of the loaded scene, needs the GL context */
 void Scene::init() {
 #ifdef ENGINE_VERBOSE
     std::cout << "Setting up globals" << std::endl;
@@ -1375,19 +2100,34 @@ void Scene::init() {
 #endif
     initAppearanceTextures();
 
+#ifdef ENGINE_VERBOSE
+    std::cout << "Setting up shaders" << std::endl;
+#endif
+    initShaders();
+
+#ifdef ENGINE_VERBOSE
+    std::cout << "Compiling display lists" << std::endl;
+#endif
+    initDisplayLists();
 }
 
 void Scene::initLights() {
     /* General lighting parameters setup */
     /* Local is missing */
     if (lightingEnable) {
-        glEnable(GL_LIGHTING);
+        GLState::enable(GL_LIGHTING);
+    } else {
+        GLState::disable(GL_LIGHTING);
     }
 
     glLightModelfv(GL_LIGHT_MODEL_AMBIENT, this->ambientLightColour);
     glLightModelf(GL_LIGHT_MODEL_TWO_SIDE, this->lightingDoubleSided);
     /* End general lighting */
 
+    for (auto light : lightVector) {
+        light->init();
+    }
+
 #ifdef ENGINE_VERBOSE
     if (!this->lightVector.empty ()) {
         for (std::vector<Light*>::iterator it = lightVector.begin (); it != this->lightVector.end (); it++) {
@@ -1399,12 +2139,52 @@ void Scene::initLights() {
 #endif
 }
 
-/* Initialize textures (throws a fatal geException if texture file doesn't exist) */
+/*
+ * Water line images are decoded now (CPU only, so spread over the pool). Scene
+ * textures are left to the residency, only their files are checked so a
+ * missing image still fails the load.
+ */
+void Scene::decodeTextures() {
+    for (auto texture : textureVector) {
+        if (!texture->fileExists()) {
+            throw Exception(
+                    "The texture could not be loaded: ["
+                            + texture->getFileName() + "]", true);
+        }
+    }
+
+    LoadProfiler::Scope profile(LoadProfiler::PhaseTextureDecode);
+    WorkerPool pool;
+
+    for (auto waterLine : waterLineVector) {
+        pool.submit([waterLine] {
+            waterLine->decodeTextures();
+        });
+    }
+
+    pool.wait();
+}
+
+/* Only names and placeholders, the images are loaded when first drawn */
 void Scene::initTextures() {
-    for (std::vector<Texture*>::iterator jt = textureVector.begin();
-            jt != this->textureVector.end(); jt++) {
-        (*jt)->loadTexture();
+#ifdef ENGINE_VERBOSE
+    auto start = std::chrono::steady_clock::now();
+#endif
+
+    /* OpenGL calls must stay on this thread */
+    {
+        LoadProfiler::Scope profile(LoadProfiler::PhaseTextureUpload);
+        for (auto texture : textureVector) {
+            textureResidency.add(texture);
+        }
     }
+
+#ifdef ENGINE_VERBOSE
+    double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    std::cout << "Textures: " << textureVector.size()
+            << " placeholders created in " << elapsed << " ms" << std::endl;
+#endif
 }
 
 /* Assign textures to appearances */
@@ -1413,22 +2193,27 @@ void Scene::initAppearanceTextures() {
             && this->xmlTexturesLoaded) {
         for (std::vector<Appearance*>::iterator it = appearanceVector.begin();
                 it != this->appearanceVector.end(); it++) {
+            Texture* texture = textureRegistry.find(
+                    (*it)->getTextureReference());
 
-            std::string apperanceRef = (*it)->getTextureReference();
-
-            for (std::vector<Texture*>::iterator jt = textureVector.begin();
-                    jt != this->textureVector.end(); jt++) {
-                if ((*jt)->getXmlId() == apperanceRef) {
-                    (*it)->setTexture(*jt);
-
-                    break;
-                }
+            if (texture != nullptr) {
+                (*it)->setTexture(texture);
             }
-
         }
     }
 }
 
+/* Shaders can only be compiled once there is a GL context */
+void Scene::initShaders() {
+    for (auto waterLine : waterLineVector) {
+        waterLine->init();
+    }
+}
+
+void Scene::initDisplayLists() {
+    graph->compileDisplayLists();
+}
+
 /* Search initial camera and set current camera pointer to it */
 void Scene::setInitialCamera() {
     if (cameraVector.empty()) {
@@ -1484,9 +2269,33 @@ void Scene::display() {
     glLoadIdentity();
     applyCameraView();
 
+    /* The modelview stays the identity, the camera matrix is all the frustum needs */
+    GLdouble viewProjection[16];
+    this->currentCameraPointer->getViewProjection(this->aspectRatio,
+            viewProjection);
+    Frustum frustum;
+    frustum.setMatrix(viewProjection);
+    frustum.setViewportHeight(windowSizeY);
+
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
-    graph->draw();
+
+    /* GLUI drew in between, nothing the cache knows still holds */
+    GLState::beginFrame();
+
+    /* Textures decoded since the last frame */
+    textureResidency.beginFrame();
+    /* Lists refused last frame may fit now */
+    DisplayListManager::beginFrame();
+
+    /* The first frame still uploads meshes and builds the instancing shaders */
+    if (!firstFrameDrawn) {
+        LoadProfiler::Scope profile(LoadProfiler::PhaseFirstDraw);
+        graph->draw(frustum);
+        firstFrameDrawn = true;
+    } else {
+        graph->draw(frustum);
+    }
 
     displayLights();
 
@@ -1539,16 +2348,44 @@ void Scene::setCurrentWindowSize(int windowX, int windowY) {
     this->aspectRatio = (double) windowX / (double) windowY;
 }
 
+void Scene::addTexture(Texture* in) {
+    if (!textureRegistry.add(in->getXmlId(), in)) {
+        std::string error = "Duplicated texture id [" + in->getXmlId() + "].";
+        delete (in);
+        throw Exception(error, true);
+    }
+
+    textureVector.push_back(in);
+}
+
+void Scene::addAppearance(Appearance* in) {
+    if (!appearanceRegistry.add(in->getAppearanceID(), in)) {
+        std::string error = "Duplicated appearance id ["
+                + in->getAppearanceID() + "].";
+        delete (in);
+        throw Exception(error, true);
+    }
+
+    appearanceVector.push_back(in);
+}
+
+void Scene::addAnimation(Animation* in) {
+    if (!animationRegistry.add(in->getID(), in)) {
+        std::string error = "Duplicated animation id [" + in->getID() + "].";
+        delete (in);
+        throw Exception(error, true);
+    }
+
+    animationsVector.push_back(in);
+}
+
 Appearance* Scene::getAppearanceByString(std::string& in) {
     if (this->xmlAppearancesLoaded) {
 
         if (!this->appearanceVector.empty()) {
-            for (std::vector<Appearance*>::iterator it =
-                    this->appearanceVector.begin();
-                    it != this->appearanceVector.end(); ++it) {
-                if ((*it)->getAppearanceID() == in) {
-                    return *it;
-                }
+            Appearance* appearance = appearanceRegistry.find(in);
+            if (appearance != nullptr) {
+                return appearance;
             }
 
             throw Exception(
@@ -1571,12 +2408,9 @@ Animation* Scene::getAnimationByString(std::string& in) {
     if (this->xmlAnimationsLoaded) {
 
         if (!this->animationsVector.empty()) {
-            for (std::vector<Animation*>::iterator it =
-                    this->animationsVector.begin();
-                    it != this->animationsVector.end(); ++it) {
-                if ((*it)->getID() == in) {
-                    return *it;
-                }
+            Animation* animation = animationRegistry.find(in);
+            if (animation != nullptr) {
+                return animation;
             }
 
             throw Exception(
@@ -1646,16 +2480,24 @@ void Scene::reSetPolygonMode(int in) {
     }
 }
 
+/* The panel is not rebuilt after a reload, so the light may be gone */
 bool Scene::getLightStatus(unsigned int number) {
+    if (number >= lightVector.size()) {
+        return false;
+    }
     return lightVector[number]->getLightEnableStatus();
 }
 
 void Scene::disableLight(unsigned int number) {
-    lightVector[number]->disable();
+    if (number < lightVector.size()) {
+        lightVector[number]->disable();
+    }
 }
 
 void Scene::enableLight(unsigned int number) {
-    lightVector[number]->enable();
+    if (number < lightVector.size()) {
+        lightVector[number]->enable();
+    }
 }
 
 std::string Scene::getLightID(unsigned int number) {
@@ -1675,7 +2517,9 @@ std::string Scene::getCameraID(unsigned int number) {
 }
 
 void Scene::setCamera(unsigned int number) {
-    currentCameraPointer = cameraVector[number];
+    if (number < cameraVector.size()) {
+        currentCameraPointer = cameraVector[number];
+    }
 }
 
 unsigned int Scene::getCurrentCamera() {
@@ -1760,13 +2604,509 @@ void Scene::tiltVehicleRight() {
     }
 }
 
+/******************** RELOAD ********************/
+void Scene::readSourceModificationTime() {
+    if (!getFileModificationTime(sourceFileName, sourceModificationTime,
+            sourceSize)) {
+        sourceModificationTime = 0;
+        sourceSize = 0;
+    }
+    lastReloadCheck = std::chrono::steady_clock::now();
+}
+
+bool Scene::reloadIfModified() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastReloadCheck < std::chrono::milliseconds(500)) {
+        return false;
+    }
+    lastReloadCheck = now;
+
+    int64_t modificationTime;
+    uint64_t size;
+    if (!getFileModificationTime(sourceFileName, modificationTime, size)
+            || (modificationTime == sourceModificationTime
+                    && size == sourceSize)) {
+        return false;
+    }
+
+    return reload();
+}
+
+bool Scene::reload() {
+    auto start = std::chrono::steady_clock::now();
+    readSourceModificationTime();
+
+    /* Load errors are not fatal here, the live scene is kept */
+    Scene* fresh = nullptr;
+    try {
+        Exception::Recoverable recoverable;
+        fresh = new Scene(sourceFileName,
+                Binary::getCacheFileName(sourceFileName), LoadReload);
+    } catch (Exception& e) {
+        std::cerr << "Could not reload [" << sourceFileName << "]."
+                << std::endl;
+        e.printerErrorMessage();
+        return false;
+    }
+
+    /* Textures are decoded before anything is touched, so a missing image can still cancel the reload */
+    std::vector<Texture*> changedTextures;
+    std::unordered_set<std::string> changedTextureIds;
+    if (!reloadTextures(*fresh, changedTextures, changedTextureIds)) {
+        delete (fresh);
+        return false;
+    }
+
+    std::unordered_set<Appearance*> changedAppearances;
+    std::unordered_set<Animation*> changedAnimations;
+
+    reloadGlobals(*fresh);
+    reloadAppearances(*fresh, changedTextureIds, changedAppearances);
+    reloadAnimations(*fresh, changedAnimations);
+    unsigned int patchedNodes = reloadGraph(*fresh, changedAppearances,
+            changedAnimations);
+
+    /* Fresh now owns everything that was replaced */
+    delete (fresh);
+
+    /* GL realization of what changed */
+    applyGlobals();
+    initLights();
+    for (auto texture : changedTextures) {
+        textureResidency.add(texture);
+    }
+    initAppearanceTextures();
+    initShaders();
+    initDisplayLists();
+
+    double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    std::cout << "Reloaded [" << sourceFileName << "] in " << elapsed
+            << " ms: " << patchedNodes << " nodes, "
+            << changedTextures.size() << " textures, "
+            << changedAppearances.size() << " appearances and "
+            << changedAnimations.size() << " animations changed." << std::endl;
+
+    return true;
+}
+
+/* Textures are kept if their file did not change, the others are decoded now */
+bool Scene::reloadTextures(Scene& fresh, std::vector<Texture*>& changedTextures,
+        std::unordered_set<std::string>& changedTextureIds) {
+    std::vector<Texture*> merged, discarded;
+    std::unordered_set<Texture*> kept;
+
+    for (auto texture : fresh.textureVector) {
+        Texture* live = textureRegistry.find(texture->getXmlId());
+
+        if (live != nullptr && live->getFileName() == texture->getFileName()) {
+            merged.push_back(live);
+            kept.insert(live);
+            discarded.push_back(texture);
+        } else {
+            merged.push_back(texture);
+            changedTextures.push_back(texture);
+            changedTextureIds.insert(texture->getXmlId());
+        }
+    }
+
+    {
+        LoadProfiler::Scope profile(LoadProfiler::PhaseTextureDecode);
+        WorkerPool pool;
+        for (auto texture : changedTextures) {
+            pool.submit([texture] {
+                texture->decodeTexture();
+            });
+        }
+        pool.wait();
+    }
+
+    for (auto texture : changedTextures) {
+        if (!texture->isDecoded()) {
+            std::cerr << "Could not reload [" << sourceFileName
+                    << "]: the texture could not be loaded: ["
+                    << texture->getFileName() << "]" << std::endl;
+            return false;
+        }
+    }
+
+    for (auto live : textureVector) {
+        if (kept.count(live) == 0) {
+            textureResidency.remove(live);
+            discarded.push_back(live);
+            changedTextureIds.insert(live->getXmlId());
+        }
+    }
+
+    textureVector.swap(merged);
+    fresh.textureVector.swap(discarded);
+
+    textureRegistry.clear();
+    for (auto texture : textureVector) {
+        textureRegistry.add(texture->getXmlId(), texture);
+    }
+
+    return true;
+}
+
+/* Globals, cameras and lights are small, they are always replaced */
+void Scene::reloadGlobals(Scene& fresh) {
+    std::copy(fresh.backgroundColour, fresh.backgroundColour + 4,
+            backgroundColour);
+    drawMode = fresh.drawMode;
+    shadingMode = fresh.shadingMode;
+    cullFace = fresh.cullFace;
+    cullOrder = fresh.cullOrder;
+
+    lightingDoubleSided = fresh.lightingDoubleSided;
+    lightingLocal = fresh.lightingLocal;
+    lightingEnable = fresh.lightingEnable;
+    std::copy(fresh.ambientLightColour, fresh.ambientLightColour + 4,
+            ambientLightColour);
+
+    /* The camera in use is kept if it still exists */
+    bool externalCamera = currentCameraPointer == externalGuiCamera;
+    std::string currentCameraId;
+    if (currentCameraPointer != nullptr) {
+        currentCameraId = currentCameraPointer->getID();
+    }
+
+    cameraVector.swap(fresh.cameraVector);
+    numberOfCameras = fresh.numberOfCameras;
+    initialCamera = fresh.initialCamera;
+
+    if (!externalCamera) {
+        currentCameraPointer = nullptr;
+        for (auto camera : cameraVector) {
+            if (camera->getID() == currentCameraId) {
+                currentCameraPointer = camera;
+                break;
+            }
+        }
+
+        if (currentCameraPointer == nullptr) {
+            setInitialCamera();
+        }
+    }
+
+    for (auto light : lightVector) {
+        light->disable();
+    }
+
+    lightVector.swap(fresh.lightVector);
+    numberOfLights = fresh.numberOfLights;
+}
+
+/* Changed appearances are updated in place, so the nodes keep their pointers */
+void Scene::reloadAppearances(Scene& fresh,
+        const std::unordered_set<std::string>& changedTextureIds,
+        std::unordered_set<Appearance*>& changedAppearances) {
+    std::vector<Appearance*> merged, discarded;
+    std::unordered_set<Appearance*> kept;
+
+    for (auto appearance : fresh.appearanceVector) {
+        Appearance* live = appearanceRegistry.find(
+                appearance->getAppearanceID());
+
+        /* New, nothing is drawn with it yet */
+        if (live == nullptr) {
+            merged.push_back(appearance);
+            continue;
+        }
+
+        if (!live->hasSameValues(*appearance)) {
+            *live = *appearance;
+            changedAppearances.insert(live);
+        } else if (changedTextureIds.count(live->getTextureReference()) > 0) {
+            live->clearTexture();
+            changedAppearances.insert(live);
+        }
+
+        merged.push_back(live);
+        kept.insert(live);
+        discarded.push_back(appearance);
+    }
+
+    for (auto live : appearanceVector) {
+        if (kept.count(live) == 0) {
+            discarded.push_back(live);
+        }
+    }
+
+    appearanceVector.swap(merged);
+    fresh.appearanceVector.swap(discarded);
+
+    appearanceRegistry.clear();
+    for (auto appearance : appearanceVector) {
+        appearanceRegistry.add(appearance->getAppearanceID(), appearance);
+    }
+}
+
+/* Same as the appearances, a changed animation starts over */
+void Scene::reloadAnimations(Scene& fresh,
+        std::unordered_set<Animation*>& changedAnimations) {
+    std::vector<Animation*> merged, discarded;
+    std::unordered_set<Animation*> kept;
+
+    for (auto animation : fresh.animationsVector) {
+        Animation* live = animationRegistry.find(animation->getID());
+
+        if (live == nullptr) {
+            merged.push_back(animation);
+            continue;
+        }
+
+        if (!live->hasSameDefinition(*animation)) {
+            *live = *animation;
+            changedAnimations.insert(live);
+        }
+
+        merged.push_back(live);
+        kept.insert(live);
+        discarded.push_back(animation);
+    }
+
+    for (auto live : animationsVector) {
+        if (kept.count(live) == 0) {
+            discarded.push_back(live);
+        }
+    }
+
+    animationsVector.swap(merged);
+    fresh.animationsVector.swap(discarded);
+
+    animationRegistry.clear();
+    for (auto animation : animationsVector) {
+        animationRegistry.add(animation->getID(), animation);
+    }
+}
+
+/* Returns the number of nodes that were patched or added */
+unsigned int Scene::reloadGraph(Scene& fresh,
+        const std::unordered_set<Appearance*>& changedAppearances,
+        const std::unordered_set<Animation*>& changedAnimations) {
+    std::vector<Node*> patched;
+    std::unordered_set<Primitives::PrimitiveInterface*> discarded;
+
+    graph->applyReload(*fresh.graph, patched, discarded);
+
+    /* Patched nodes may point to appearances and animations of fresh */
+    for (auto node : patched) {
+        if (node->getAppearance() != nullptr) {
+            Appearance* live = appearanceRegistry.find(
+                    node->getAppearance()->getAppearanceID());
+            if (live != nullptr) {
+                node->setAppearance(live);
+            }
+        }
+
+        if (node->getAnimation() != nullptr) {
+            Animation* live = animationRegistry.find(
+                    node->getAnimation()->getID());
+            if (live != nullptr) {
+                node->setAnimation(live);
+            }
+        }
+    }
+
+    /* Vehicles and water lines of the patched nodes */
+    auto isDiscarded = [&discarded](Primitives::PrimitiveInterface* primitive) {
+        return discarded.count(primitive) > 0;
+    };
+    sceneVehicles.erase(
+            std::remove_if(sceneVehicles.begin(), sceneVehicles.end(),
+                    isDiscarded), sceneVehicles.end());
+    waterLineVector.erase(
+            std::remove_if(waterLineVector.begin(), waterLineVector.end(),
+                    isDiscarded), waterLineVector.end());
+
+    for (auto node : patched) {
+        for (auto primitive : node->getPrimitiveVector()) {
+            auto vehicle = dynamic_cast<Primitives::Vehicle*>(primitive);
+            if (vehicle != nullptr
+                    && std::find(sceneVehicles.begin(), sceneVehicles.end(),
+                            vehicle) == sceneVehicles.end()) {
+                sceneVehicles.push_back(vehicle);
+            }
+
+            auto waterLine = dynamic_cast<Primitives::WaterLine*>(primitive);
+            if (waterLine != nullptr
+                    && std::find(waterLineVector.begin(), waterLineVector.end(),
+                            waterLine) == waterLineVector.end()) {
+                waterLineVector.push_back(waterLine);
+            }
+        }
+    }
+
+    std::unordered_set<Node*> changedNodes(patched.begin(), patched.end());
+    graph->invalidateDisplayLists(changedNodes, changedAppearances,
+            changedAnimations);
+
+    return static_cast<unsigned int>(patched.size());
+}
+/******************** RELOAD (END) ********************/
+
+void Scene::printTextureStatistics(std::ostream& out) {
+    textureResidency.printStatistics(out);
+}
+
+void Scene::printDrawStatistics(std::ostream& out) {
+    out << "Culling " << (graph->getCulling() ? "on" : "off") << ": "
+            << graph->getVisitedInstances() << " instances visited, "
+            << graph->getCulledInstances() << " subtrees culled, "
+            << graph->getCulledBatches() << " static batches culled, "
+            << graph->getDrawnEntries() << " entries drawn." << std::endl;
+
+    out << "Traversal: " << graph->getTraversalJobs() << " jobs on "
+            << graph->getTraversalJobThreads() << " threads, "
+            << graph->getTraversalSeconds() * 1000.0 << " ms." << std::endl;
+
+    graph->printOcclusionStatistics(out);
+
+    out << "Sorting " << (graph->getSorting() ? "on" : "off") << ": "
+            << graph->getAppearanceChanges() << " appearances applied, "
+            << graph->getTextureChanges() << " textures bound (draw list order: "
+            << graph->getListOrderAppearanceChanges() << " and "
+            << graph->getListOrderTextureChanges() << ")." << std::endl;
+
+    out << "Instancing " << (graph->getInstancing() ? "on" : "off") << ": "
+            << graph->getInstancedEntries() << " entries drawn with "
+            << graph->getInstancedCalls() << " instanced calls, "
+            << graph->getUploadedInstances() << " instance matrices written."
+            << std::endl;
+
+    out << "Level of detail " << (graph->getLevelOfDetail() ? "on" : "off")
+            << " (bias " << SceneGraph::getLodBias() << "): "
+            << graph->getSubmittedTriangles() << " triangles submitted, "
+            << graph->getCoarseEntries()
+            << " entries drawn coarser than their full mesh." << std::endl;
+
+    out << "GL state: " << GLState::getIssuedCalls() << " calls issued, "
+            << GLState::getElidedCalls() << " elided." << std::endl;
+
+    DisplayListManager::printStatistics(out);
+}
+
+bool Scene::toggleCulling() {
+    graph->setCulling(!graph->getCulling());
+    return graph->getCulling();
+}
+
+bool Scene::toggleOcclusionCulling() {
+    graph->setOcclusionCulling(!graph->getOcclusionCulling());
+    return graph->getOcclusionCulling();
+}
+
+bool Scene::toggleSorting() {
+    graph->setSorting(!graph->getSorting());
+    return graph->getSorting();
+}
+
+bool Scene::toggleInstancing() {
+    graph->setInstancing(!graph->getInstancing());
+    return graph->getInstancing();
+}
+
+bool Scene::toggleLevelOfDetail() {
+    graph->setLevelOfDetail(!graph->getLevelOfDetail());
+    return graph->getLevelOfDetail();
+}
+
+double Scene::changeLodBias(double delta) {
+    SceneGraph::setLodBias(SceneGraph::getLodBias() + delta);
+    return SceneGraph::getLodBias();
+}
+
+void Scene::getNodeWorldMatrices(const std::string& nodeId,
+        std::vector<const GLdouble*>& out) {
+    Node* node = graph != nullptr ? graph->getNodeByID(nodeId) : nullptr;
+    if (node != nullptr) {
+        graph->getWorldMatrices(node, out);
+    }
+}
+
+void Scene::printSummary(std::ostream& out) {
+    out << "Cameras: " << cameraVector.size() << ", lights: "
+            << lightVector.size() << ", textures: " << textureVector.size()
+            << ", appearances: " << appearanceVector.size() << ", animations: "
+            << animationsVector.size() << ", nodes: "
+            << (graph != nullptr ? graph->getNumberOfNodes() : 0)
+            << " (drawn as "
+            << (graph != nullptr ? graph->getNumberOfInstances() : 0)
+            << " instances, "
+            << (graph != nullptr ? graph->getNumberOfSharedNodes() : 0)
+            << " shared)." << std::endl;
+    GeometryCache::printStatistics(out);
+
+    if (graph != nullptr && graph->getNumberOfStaticBatches() > 0) {
+        out << "Static batches: " << graph->getNumberOfStaticBatches()
+                << " hold " << graph->getNumberOfBatchedPrimitives()
+                << " primitives." << std::endl;
+    }
+
+    if (graph != nullptr && graph->getNumberOfInstanceGroups() > 0) {
+        out << "Instance groups: " << graph->getNumberOfInstanceGroups()
+                << " hold " << graph->getNumberOfGroupedEntries()
+                << " draw list entries." << std::endl;
+    }
+
+    if (graph != nullptr && graph->getMeasuredLists() > 0) {
+        out << "Automatic display lists: " << graph->getChosenLists()
+                << " of " << graph->getMeasuredLists()
+                << " measured subtrees." << std::endl;
+    }
+}
+
 Scene::~Scene() {
+    release();
+}
+
+void Scene::release() {
+    /* Nodes the graph does not own yet (only left by a failed load) */
+    for (auto node : unprocessedNodes) {
+        if (graph == nullptr || graph->getNodeByID(node->getNodeID()) != node) {
+            delete (node);
+        }
+    }
+    unprocessedNodes.clear();
+
+    if (xmlCurrentNode != nullptr) {
+        delete (xmlCurrentNode);
+    }
+
+    if (xmlCurrentPatch != nullptr) {
+        delete (xmlCurrentPatch);
+    }
+
     if (graph != nullptr) {
         delete (graph);
     }
 
-    if (doc != nullptr) {
-        delete (doc);
+    for (auto camera : cameraVector) {
+        delete (camera);
+    }
+
+    if (externalGuiCamera != nullptr) {
+        delete (externalGuiCamera);
+    }
+
+    for (auto light : lightVector) {
+        delete (light);
+    }
+
+    /* Decodes still running must finish before their textures go */
+    textureResidency.clear();
+
+    for (auto texture : textureVector) {
+        delete (texture);
+    }
+
+    for (auto appearance : appearanceVector) {
+        delete (appearance);
+    }
+
+    for (auto animation : animationsVector) {
+        delete (animation);
     }
 }
 
@@ -0,0 +1,549 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Synthetic stress scene generator methods.
+ */
+
+#include <SceneGenerator.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace ge {
+
+/* Every level is a stack frame while writing */
+const unsigned int MaxDepth = 256;
+
+/* Half the size of the scene, each level gets half the room of its parent */
+const double SceneExtent = 50.0;
+
+/* Control points of the patches, order 3 (4 x 4 points) */
+const unsigned int PatchOrder = 3;
+
+static const char* primitiveNames[SceneGenerator::NumberOfPrimitiveTypes] = {
+        "cylinder", "sphere", "torus", "patch", "rectangle", "triangle", "plane" };
+
+/* Splits "a,b,c", empty fields are kept so they can be reported */
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> fields;
+    std::string::size_type start = 0;
+
+    while (true) {
+        std::string::size_type end = list.find(',', start);
+        fields.push_back(list.substr(start, end - start));
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    return fields;
+}
+
+SceneGenerator::Settings::Settings() {
+    this->nodes = 1000;
+    this->depth = 0;
+    this->fanOut = 8;
+    this->seed = 1;
+
+    for (unsigned int i = 0; i < NumberOfPrimitiveTypes; i++) {
+        this->primitiveWeights[i] = 0;
+    }
+    this->primitiveWeights[Cylinder] = 1;
+    this->primitiveWeights[Sphere] = 1;
+    this->primitiveWeights[Torus] = 1;
+    this->primitiveWeights[Patch] = 1;
+    this->primitiveWeights[Rectangle] = 1;
+    this->primitiveWeights[Triangle] = 1;
+
+    this->slices = 16;
+    this->stacks = 8;
+    this->shapes = 0;
+
+    this->appearances = 16;
+    this->textures = 4;
+    this->animations = 8;
+    this->animatedNodes = 10;
+
+    this->textureFiles.push_back("fire.jpg");
+    this->textureFiles.push_back("firemap.jpg");
+}
+
+bool SceneGenerator::Settings::setPrimitiveMix(const std::string& mix) {
+    unsigned int weights[NumberOfPrimitiveTypes] = { 0 };
+
+    for (const std::string& field : splitList(mix)) {
+        std::string name = field.substr(0, field.find(':'));
+        unsigned long weight = 1;
+
+        if (name.size() != field.size()) {
+            const char* value = field.c_str() + name.size() + 1;
+            char* end;
+            weight = std::strtoul(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || weight > 1000000) {
+                std::cerr << "Invalid primitive weight: [" << field << "]."
+                        << std::endl;
+                return false;
+            }
+        }
+
+        unsigned int type = 0;
+        while (type < NumberOfPrimitiveTypes && name != primitiveNames[type]) {
+            type++;
+        }
+
+        if (type == NumberOfPrimitiveTypes) {
+            std::cerr << "Unknown primitive: [" << name << "]." << std::endl;
+            return false;
+        }
+
+        weights[type] += static_cast<unsigned int>(weight);
+    }
+
+    for (unsigned int i = 0; i < NumberOfPrimitiveTypes; i++) {
+        this->primitiveWeights[i] = weights[i];
+    }
+
+    return true;
+}
+
+bool SceneGenerator::Settings::setTextureFiles(const std::string& files) {
+    std::vector<std::string> fields = splitList(files);
+
+    for (const std::string& field : fields) {
+        if (field.empty()) {
+            std::cerr << "Empty texture file name in [" << files << "]."
+                    << std::endl;
+            return false;
+        }
+    }
+
+    this->textureFiles = fields;
+    return true;
+}
+
+SceneGenerator::SceneGenerator(const Settings& settings) :
+        settings(settings), engine(settings.seed) {
+    this->out = nullptr;
+
+    this->depth = 0;
+    this->weightTotal = 0;
+
+    this->leaves = 0;
+    this->animated = 0;
+    this->reachedDepth = 0;
+    for (unsigned int i = 0; i < NumberOfPrimitiveTypes; i++) {
+        this->primitives[i] = 0;
+    }
+}
+
+SceneGenerator::~SceneGenerator() {
+
+}
+
+uint32_t SceneGenerator::nextInteger(uint32_t range) {
+    return static_cast<uint32_t>(engine() % range);
+}
+
+double SceneGenerator::nextReal(double minimum, double maximum) {
+    return minimum + (maximum - minimum) * (engine() / 4294967296.0);
+}
+
+uint64_t SceneGenerator::getCapacity(unsigned int height) {
+    const uint64_t maximum = std::numeric_limits<uint64_t>::max();
+    uint64_t capacity = 1, levelNodes = 1;
+
+    for (unsigned int i = 0; i < height; i++) {
+        if (levelNodes > maximum / settings.fanOut) {
+            return maximum;
+        }
+        levelNodes *= settings.fanOut;
+
+        if (capacity > maximum - levelNodes) {
+            return maximum;
+        }
+        capacity += levelNodes;
+    }
+
+    return capacity;
+}
+
+/*
+ * The smallest branching that fills the levels below (so the subtree reaches
+ * the height), raised until the nodes fit the capacity of the child subtrees.
+ */
+unsigned int SceneGenerator::getNumberOfChildren(uint64_t nodes,
+        unsigned int height) {
+    uint64_t below = nodes - 1;
+    uint64_t children = 1;
+
+    while (children < settings.fanOut && children < below) {
+        uint64_t reach = 0, levelNodes = 1;
+        for (unsigned int i = 0; i < height && reach < below; i++) {
+            levelNodes *= children;
+            reach += levelNodes;
+        }
+
+        if (reach >= below) {
+            break;
+        }
+        children++;
+    }
+
+    uint64_t childCapacity = getCapacity(height - 1);
+    while (children < settings.fanOut
+            && (below + children - 1) / children > childCapacity) {
+        children++;
+    }
+
+    return static_cast<unsigned int>(children);
+}
+
+void SceneGenerator::writeHeader() {
+    fprintf(out, "<?xml version=\"1.0\"?>\n");
+    fprintf(out, "<!-- geEngine --generate: %llu nodes, depth %u, fan-out %u, "
+            "seed %u -->\n", static_cast<unsigned long long>(settings.nodes),
+            depth, settings.fanOut, settings.seed);
+    fprintf(out, "<yaf>\n");
+
+    fprintf(out, "  <globals background=\"0 0 0 1\" drawmode=\"fill\" "
+            "shading=\"gouraud\" cullface=\"none\" cullorder=\"CCW\"/>\n");
+
+    double distance = SceneExtent * 2.0;
+    fprintf(out, "  <cameras initial=\"cam1\">\n");
+    fprintf(out, "    <perspective id=\"cam1\" near=\"0.1\" far=\"%.1f\" "
+            "angle=\"60\" pos=\"%.1f %.1f %.1f\" target=\"0 0 0\"/>\n",
+            distance * 10.0, distance, distance, distance);
+    fprintf(out, "  </cameras>\n");
+
+    fprintf(out, "  <lighting doublesided=\"false\" local=\"false\" "
+            "enabled=\"true\" ambient=\"0.2 0.2 0.2 1.0\">\n");
+    fprintf(out, "    <omni id=\"light1\" enabled=\"true\" "
+            "location=\"%.1f %.1f %.1f\" ambient=\"0.2 0.2 0.2 1\" "
+            "diffuse=\"0.8 0.8 0.8 1\" specular=\"0.3 0.3 0.3 1\"/>\n",
+            SceneExtent, SceneExtent * 2.0, SceneExtent);
+    fprintf(out, "  </lighting>\n");
+
+    fprintf(out, "  <textures>\n");
+    for (unsigned int i = 0; i < settings.textures; i++) {
+        fprintf(out, "    <texture id=\"tex%u\" file=\"%s\"/>\n", i,
+                settings.textureFiles[i % settings.textureFiles.size()].c_str());
+    }
+    fprintf(out, "  </textures>\n");
+
+    /* Every fourth appearance is untextured, so texture state changes as well */
+    fprintf(out, "  <appearances>\n");
+    unsigned int textured = 0;
+    for (unsigned int i = 0; i < settings.appearances; i++) {
+        double r = nextReal(0.2, 1.0);
+        double g = nextReal(0.2, 1.0);
+        double b = nextReal(0.2, 1.0);
+        unsigned int shininess = 1 + nextInteger(128);
+
+        fprintf(out, "    <appearance id=\"app%u\" emissive=\"0 0 0 0\" "
+                "ambient=\"%.3f %.3f %.3f 1\" diffuse=\"%.3f %.3f %.3f 1\" "
+                "specular=\"0.2 0.2 0.2 1\" shininess=\"%u\"", i, r * 0.5,
+                g * 0.5, b * 0.5, r, g, b, shininess);
+
+        if (settings.textures > 0 && i % 4 != 3) {
+            fprintf(out, " textureref=\"tex%u\" texlength_s=\"1\" "
+                    "texlength_t=\"1\"", textured % settings.textures);
+            textured++;
+        }
+        fprintf(out, "/>\n");
+    }
+    fprintf(out, "  </appearances>\n");
+
+    fprintf(out, "  <animations>\n");
+    for (unsigned int i = 0; i < settings.animations; i++) {
+        fprintf(out, "    <animation id=\"anim%u\" span=\"%.1f\" "
+                "type=\"linear\">\n", i, nextReal(2.0, 20.0));
+
+        unsigned int points = 2 + nextInteger(4);
+        for (unsigned int j = 0; j < points; j++) {
+            double x = nextReal(-2.0, 2.0);
+            double y = nextReal(-2.0, 2.0);
+            double z = nextReal(-2.0, 2.0);
+            fprintf(out, "      <controlpoint xx=\"%.3f\" yy=\"%.3f\" "
+                    "zz=\"%.3f\"/>\n", x, y, z);
+        }
+        fprintf(out, "    </animation>\n");
+    }
+    fprintf(out, "  </animations>\n");
+}
+
+void SceneGenerator::writeTransforms(unsigned int level, double extent,
+        bool leaf) {
+    fprintf(out, "      <transforms>\n");
+
+    if (level > 0) {
+        double x = nextReal(-extent, extent);
+        double y = nextReal(-extent, extent);
+        double z = nextReal(-extent, extent);
+        fprintf(out, "        <translate to=\"%.3f %.3f %.3f\"/>\n", x, y, z);
+        fprintf(out, "        <rotate axis=\"y\" angle=\"%.1f\"/>\n",
+                nextReal(0.0, 360.0));
+    }
+
+    if (leaf) {
+        double factor = nextReal(0.5, 1.5);
+        fprintf(out, "        <scale factor=\"%.3f %.3f %.3f\"/>\n", factor,
+                factor, factor);
+    }
+
+    fprintf(out, "      </transforms>\n");
+}
+
+void SceneGenerator::writePrimitive() {
+    uint32_t pick = nextInteger(weightTotal);
+    unsigned int type = 0;
+    while (pick >= settings.primitiveWeights[type]) {
+        pick -= settings.primitiveWeights[type];
+        type++;
+    }
+
+    primitives[type]++;
+
+    /* A shape's parameters come from an engine seeded by the shape */
+    bool shape = settings.shapes > 0;
+    std::mt19937 shapeEngine;
+    if (shape) {
+        uint32_t index = type * settings.shapes + nextInteger(settings.shapes);
+        shapeEngine.seed(settings.seed ^ (0x9e3779b9u * (index + 1)));
+        std::swap(engine, shapeEngine);
+    }
+
+    switch (type) {
+        case Cylinder: {
+            double base = nextReal(0.2, 1.0);
+            double top = nextReal(0.0, 1.0);
+            double height = nextReal(0.5, 2.0);
+            fprintf(out, "        <cylinder base=\"%.3f\" top=\"%.3f\" "
+                    "height=\"%.3f\" slices=\"%u\" stacks=\"%u\"/>\n", base,
+                    top, height, settings.slices, settings.stacks);
+            break;
+        }
+
+        case Sphere:
+            fprintf(out, "        <sphere radius=\"%.3f\" slices=\"%u\" "
+                    "stacks=\"%u\"/>\n", nextReal(0.2, 1.0), settings.slices,
+                    settings.stacks);
+            break;
+
+        case Torus: {
+            double inner = nextReal(0.1, 0.3);
+            double outer = inner + nextReal(0.2, 0.8);
+            fprintf(out, "        <torus inner=\"%.3f\" outer=\"%.3f\" "
+                    "slices=\"%u\" loops=\"%u\"/>\n", inner, outer,
+                    settings.slices, settings.stacks);
+            break;
+        }
+
+        case Patch:
+            fprintf(out, "        <patch order=\"%u\" partsU=\"%u\" "
+                    "partsV=\"%u\" compute=\"2\">\n", PatchOrder,
+                    settings.slices, settings.stacks);
+            for (unsigned int u = 0; u <= PatchOrder; u++) {
+                for (unsigned int v = 0; v <= PatchOrder; v++) {
+                    fprintf(out, "          <controlpoint x=\"%.3f\" "
+                            "y=\"%.3f\" z=\"%.3f\"/>\n",
+                            u / static_cast<double>(PatchOrder) - 0.5,
+                            nextReal(-0.3, 0.3),
+                            v / static_cast<double>(PatchOrder) - 0.5);
+                }
+            }
+            fprintf(out, "        </patch>\n");
+            break;
+
+        case Rectangle: {
+            double x1 = nextReal(-1.0, -0.2);
+            double y1 = nextReal(-1.0, -0.2);
+            double x2 = nextReal(0.2, 1.0);
+            double y2 = nextReal(0.2, 1.0);
+            fprintf(out, "        <rectangle xy1=\"%.3f %.3f\" "
+                    "xy2=\"%.3f %.3f\"/>\n", x1, y1, x2, y2);
+            break;
+        }
+
+        case Triangle: {
+            double x2 = nextReal(0.5, 1.5);
+            double x3 = nextReal(0.0, 1.0);
+            double y3 = nextReal(0.5, 1.5);
+            double z3 = nextReal(-0.5, 0.5);
+            fprintf(out, "        <triangle xyz1=\"0 0 0\" xyz2=\"%.3f 0 0\" "
+                    "xyz3=\"%.3f %.3f %.3f\"/>\n", x2, x3, y3, z3);
+            break;
+        }
+
+        case Plane:
+            fprintf(out, "        <plane parts=\"%u\"/>\n", settings.slices);
+            break;
+
+        default:
+            break;
+    }
+
+    if (shape) {
+        std::swap(engine, shapeEngine);
+    }
+}
+
+/* Node ids are given in preorder, so the ids of the children follow from the subtree sizes */
+void SceneGenerator::writeNode(uint64_t id, uint64_t nodes, unsigned int level,
+        double extent) {
+    bool leaf = nodes == 1;
+    unsigned int children = leaf ? 0 : getNumberOfChildren(nodes, depth - level);
+
+    reachedDepth = level > reachedDepth ? level : reachedDepth;
+
+    fprintf(out, "    <node id=\"n%llu\">\n", static_cast<unsigned long long>(id));
+    writeTransforms(level, extent, leaf);
+
+    /* The root gives an appearance to anything that does not pick its own */
+    if (settings.appearances > 0 && (leaf || level == 0)) {
+        fprintf(out, "      <appearanceref id=\"app%u\"/>\n",
+                level == 0 ? 0 : nextInteger(settings.appearances));
+    }
+
+    if (!leaf && level > 0 && settings.animations > 0
+            && nextInteger(100) < settings.animatedNodes) {
+        fprintf(out, "      <animationref id=\"anim%u\"/>\n",
+                nextInteger(settings.animations));
+        animated++;
+    }
+
+    fprintf(out, "      <children>\n");
+
+    if (leaf) {
+        writePrimitive();
+        leaves++;
+    } else {
+        uint64_t below = nodes - 1;
+        uint64_t childId = id + 1;
+        for (unsigned int i = 0; i < children; i++) {
+            uint64_t childNodes = below / children + (i < below % children);
+            fprintf(out, "        <noderef id=\"n%llu\"/>\n",
+                    static_cast<unsigned long long>(childId));
+            childId += childNodes;
+        }
+    }
+
+    fprintf(out, "      </children>\n");
+    fprintf(out, "    </node>\n");
+
+    if (leaf) {
+        return;
+    }
+
+    uint64_t below = nodes - 1;
+    uint64_t childId = id + 1;
+    for (unsigned int i = 0; i < children; i++) {
+        uint64_t childNodes = below / children + (i < below % children);
+        writeNode(childId, childNodes, level + 1, extent * 0.5);
+        childId += childNodes;
+    }
+}
+
+bool SceneGenerator::write(const std::string& fileName) {
+    if (settings.nodes < 1 || settings.fanOut < 1) {
+        std::cerr << "The scene needs at least one node and a fan-out of one."
+                << std::endl;
+        return false;
+    }
+
+    weightTotal = 0;
+    for (unsigned int i = 0; i < NumberOfPrimitiveTypes; i++) {
+        weightTotal += settings.primitiveWeights[i];
+    }
+    if (weightTotal == 0) {
+        std::cerr << "The primitive mix is empty." << std::endl;
+        return false;
+    }
+
+    /* The loader rejects cylinders below these */
+    if (settings.slices < 2 || settings.stacks < 1) {
+        std::cerr << "The primitives need at least two slices and one stack."
+                << std::endl;
+        return false;
+    }
+
+    /* The loader rejects a scene without appearances */
+    if (settings.appearances < 1) {
+        std::cerr << "The scene needs at least one appearance." << std::endl;
+        return false;
+    }
+
+    if (settings.textures > 0 && settings.textureFiles.empty()) {
+        std::cerr << "No texture files to use." << std::endl;
+        return false;
+    }
+
+    depth = settings.depth;
+    if (depth == 0) {
+        while (depth < MaxDepth && getCapacity(depth) < settings.nodes) {
+            depth++;
+        }
+    }
+
+    if (depth > MaxDepth || getCapacity(depth) < settings.nodes) {
+        std::cerr << "A tree of depth " << depth << " and fan-out "
+                << settings.fanOut << " can not hold " << settings.nodes
+                << " nodes (at most depth " << MaxDepth << ")." << std::endl;
+        return false;
+    }
+
+    /* Same as the yafb, never leave a half written scene behind */
+    std::string temporaryFileName = fileName + ".tmp";
+    out = fopen(temporaryFileName.c_str(), "wb");
+    if (out == nullptr) {
+        std::cerr << "Could not open [" << temporaryFileName << "]."
+                << std::endl;
+        return false;
+    }
+    setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+    engine.seed(settings.seed);
+    leaves = 0;
+    animated = 0;
+    reachedDepth = 0;
+    for (unsigned int i = 0; i < NumberOfPrimitiveTypes; i++) {
+        primitives[i] = 0;
+    }
+
+    writeHeader();
+
+    fprintf(out, "  <graph rootid=\"n0\">\n");
+    writeNode(0, settings.nodes, 0, SceneExtent);
+    fprintf(out, "  </graph>\n");
+    fprintf(out, "</yaf>\n");
+
+    long size = ftell(out);
+    bool writeOk = !ferror(out);
+    writeOk = (fclose(out) == 0) && writeOk;
+    out = nullptr;
+
+    if (!writeOk
+            || std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+        std::remove(temporaryFileName.c_str());
+        std::cerr << "Could not write [" << fileName << "]." << std::endl;
+        return false;
+    }
+
+    std::cout << "Wrote [" << fileName << "]: " << settings.nodes
+            << " nodes (" << leaves << " leaves, depth " << reachedDepth
+            << ", " << animated << " animated), " << size << " bytes."
+            << std::endl;
+    std::cout << "Primitives:";
+    for (unsigned int i = 0; i < NumberOfPrimitiveTypes; i++) {
+        if (primitives[i] > 0) {
+            std::cout << " " << primitiveNames[i] << " " << primitives[i];
+        }
+    }
+    std::cout << "." << std::endl;
+
+    return true;
+}
+
+}
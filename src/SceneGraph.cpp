@@ -5,21 +5,130 @@
  */
 
 #include <SceneGraph.hpp>
+#include <GLState.hpp>
+#include <LoadProfiler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
 
 namespace ge {
 
-const unsigned int MAX_DISPLAY_LISTS = 64;
+/* Beyond this the draw list would take more memory than it saves time */
+const uint64_t MaxDrawListInstances = 1 << 22;
+
+/* Static batches are split until they fit, unless a single mesh is larger */
+const std::size_t MaxBatchVertices = 1 << 11;
+
+/* Fewer draws of a mesh with an appearance are not worth a group */
+const std::size_t MinInstanceGroup = 16;
+
+/* Subtrees with fewer draw entries cost less to draw than to query */
+const unsigned int MinOcclusionEntries = 4;
+
+/* Graphs with fewer instances are walked on the drawing thread alone */
+const std::size_t MinParallelInstances = 1 << 13;
+/* Jobs per thread, subtrees differ in size and in what culling leaves */
+const unsigned int TraversalJobsPerThread = 4;
+const unsigned int MinJobInstances = 1 << 10;
+
+/* Subtrees measured for an automatic display list, in draw entries */
+const unsigned int MinAutoListEntries = 4;
+const unsigned int MaxAutoListEntries = 256;
+/* Load time spent measuring, what is left keeps no list until a reload */
+const double MaxAutoListSeconds = 0.1;
+const unsigned int AutoListRuns = 3;
+/* A list is kept if its call takes at most this much of the direct draw */
+const double AutoListGain = 0.8;
+
+/* Screen space error allowed at bias 0, in pixels */
+const GLdouble LodPixelError = 1.0;
+
+/* A coarser level is taken once its error is this far under the tolerance */
+const GLdouble LodHysteresis = 0.75;
+
+double SceneGraph::lodBias = 0.0;
+unsigned int SceneGraph::traversalThreads = 0;
+
+/* out = left * right, column major (what glMultMatrixd does to left) */
+static void multiplyMatrices(const GLdouble* left, const GLdouble* right,
+        GLdouble* out) {
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            out[column * 4 + row] = left[row] * right[column * 4]
+                    + left[4 + row] * right[column * 4 + 1]
+                    + left[8 + row] * right[column * 4 + 2]
+                    + left[12 + row] * right[column * 4 + 3];
+        }
+    }
+}
+
+/* out = matrix * point, point with w = 1 */
+static void transformPoint(const GLdouble* matrix, const GLdouble* point,
+        GLdouble* out) {
+    for (int row = 0; row < 3; row++) {
+        out[row] = matrix[row] * point[0] + matrix[4 + row] * point[1]
+                + matrix[8 + row] * point[2] + matrix[12 + row];
+    }
+}
+
+static void getCenter(const BoundingBox& box, GLdouble* out) {
+    for (int axis = 0; axis < 3; axis++) {
+        out[axis] = (box.min[axis] + box.max[axis]) * 0.5;
+    }
+}
+
+/* Longest column of the upper 3x3, how much the matrix grows a length at most */
+static GLdouble getScale(const GLdouble* matrix) {
+    GLdouble scale = 0.0;
+    for (int column = 0; column < 3; column++) {
+        const GLdouble* m = matrix + column * 4;
+        scale = std::max(scale, m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+    }
+    return sqrt(scale);
+}
+
+/* Distance from the origin to the farthest point of the box */
+static GLdouble getReach(const BoundingBox& box) {
+    GLdouble reach = 0.0;
+    for (int axis = 0; axis < 3; axis++) {
+        GLdouble farthest = std::max(std::fabs(box.min[axis]),
+                std::fabs(box.max[axis]));
+        reach += farthest * farthest;
+    }
+    return sqrt(reach);
+}
+
+/* Id of key, the next free one the first time it is seen */
+template<typename Key>
+static unsigned int getDenseId(std::unordered_map<Key, unsigned int>& ids,
+        Key key) {
+    auto found = ids.find(key);
+    if (found != ids.end()) {
+        return found->second;
+    }
+
+    unsigned int id = static_cast<unsigned int>(ids.size());
+    ids[key] = id;
+    return id;
+}
 
 // Static members
 std::stack<Appearance*> Node::appearanceStack;
 bool Node::creatingDisplayList = false;
-GLint Node::displayListCount = 1;
 
-Node::Node(std::string& in, bool displayList) {
+Node::Node(std::string& in, ListMode displayList, bool staticBatch) {
     this->ID = in;
     this->precalcDone = false;
     this->nodeAppearance = nullptr;
-    this->useDisplayList = displayList;
+    this->displayListMode = displayList;
+    this->autoDisplayList = false;
+    this->autoDisplayListMeasured = false;
+    this->useStaticBatch = staticBatch;
+    this->staticSubtree = false;
+    this->firstInstance = 0;
+    this->primitiveBoundsDone = false;
 
     /* Copy paste is cheap */
     transformationsMatrix[0] = 1;
@@ -42,10 +151,10 @@ Node::Node(std::string& in, bool displayList) {
     transformationsMatrix[14] = 0;
     transformationsMatrix[15] = 1;
 
-    this->displayListID = -1;
-    this->displayListCreated = false;
-
     this->nodeAnimation = nullptr;
+
+    this->contentHash[PartPrimitives] = 0;
+    this->contentHashed = false;
 }
 
 void Node::addTransform(Transform* in) {
@@ -54,6 +163,7 @@ void Node::addTransform(Transform* in) {
 
 void Node::addPrimitive(Primitives::PrimitiveInterface* in) {
     this->primitiveVector.push_back(in);
+    this->primitiveBoundsDone = false;
 }
 
 void Node::addChildrenID(std::string& in) {
@@ -64,6 +174,22 @@ void Node::setAnimation(Animation* in) {
     this->nodeAnimation = in;
 }
 
+void Node::setAppearanceReference(const std::string& in) {
+    this->appearanceReference = in;
+}
+
+void Node::setAnimationReference(const std::string& in) {
+    this->animationReference = in;
+}
+
+const std::string& Node::getAppearanceReference() {
+    return this->appearanceReference;
+}
+
+const std::string& Node::getAnimationReference() {
+    return this->animationReference;
+}
+
 std::vector<std::string>& Node::getChildrenIDVector() {
     return this->childrenIdVector;
 }
@@ -80,10 +206,171 @@ Appearance* Node::getAppearance() {
     return this->nodeAppearance;
 }
 
+Animation* Node::getAnimation() {
+    return this->nodeAnimation;
+}
+
+std::vector<Primitives::PrimitiveInterface*>& Node::getPrimitiveVector() {
+    return this->primitiveVector;
+}
+
+void Node::setPrimitivesHash(std::uint64_t in) {
+    this->contentHash[PartPrimitives] = in;
+}
+
+void Node::hashContent() {
+    ContentHash links;
+    links.add(this->ID);
+    links.addValue(this->displayListMode);
+    links.addValue(this->useStaticBatch);
+    links.add(this->appearanceReference);
+    links.add(this->animationReference);
+    for (auto& childId : childrenIdVector) {
+        links.add(childId);
+    }
+
+    ContentHash transforms;
+    for (auto transform : transformList) {
+        transforms.add(transform->getTransformationMatrix(),
+                16 * sizeof(GLdouble));
+    }
+
+    this->contentHash[PartLinks] = links.get();
+    this->contentHash[PartTransforms] = transforms.get();
+    this->contentHashed = true;
+}
+
+std::uint64_t Node::getHash(Part part) {
+    if (!contentHashed) {
+        hashContent();
+    }
+    return this->contentHash[part];
+}
+
+void Node::replacePart(Part part, Node& other) {
+    if (!contentHashed) {
+        hashContent();
+    }
+    if (!other.contentHashed) {
+        other.hashContent();
+    }
+
+    switch (part) {
+        case PartLinks:
+            std::swap(displayListMode, other.displayListMode);
+            /* The subtree may be a different one, measured again */
+            autoDisplayList = false;
+            autoDisplayListMeasured = false;
+            std::swap(useStaticBatch, other.useStaticBatch);
+            std::swap(nodeAppearance, other.nodeAppearance);
+            std::swap(nodeAnimation, other.nodeAnimation);
+            appearanceReference.swap(other.appearanceReference);
+            animationReference.swap(other.animationReference);
+            childrenIdVector.swap(other.childrenIdVector);
+            childrenVector.clear();
+            break;
+
+        case PartTransforms:
+            transformList.swap(other.transformList);
+            std::swap_ranges(transformationsMatrix, transformationsMatrix + 16,
+                    other.transformationsMatrix);
+            std::swap(precalcDone, other.precalcDone);
+            break;
+
+        case PartPrimitives:
+            primitiveVector.swap(other.primitiveVector);
+            primitiveBoundsDone = false;
+            other.primitiveBoundsDone = false;
+            break;
+
+        default:
+            return;
+    }
+
+    std::swap(contentHash[part], other.contentHash[part]);
+    invalidateDisplayList();
+}
+
+void Node::invalidateDisplayList() {
+    for (auto& list : displayLists) {
+        DisplayListManager::release(list.list);
+    }
+}
+
+Node::DisplayList& Node::getDisplayList(Appearance* inheritedAppearance) {
+    for (auto& list : displayLists) {
+        if (list.inheritedAppearance == inheritedAppearance) {
+            return list;
+        }
+    }
+
+    displayLists.emplace_back();
+    displayLists.back().inheritedAppearance = inheritedAppearance;
+    return displayLists.back();
+}
+
 std::string Node::getNodeID() {
     return this->ID;
 }
 
+bool Node::hasDisplayList() {
+    return this->displayListMode == ListOn
+            || (this->displayListMode == ListAuto && this->autoDisplayList);
+}
+
+Node::ListMode Node::getDisplayListMode() {
+    return this->displayListMode;
+}
+
+bool Node::isAutoDisplayListMeasured() {
+    return this->autoDisplayListMeasured;
+}
+
+void Node::setAutoDisplayList(bool in) {
+    this->autoDisplayList = in;
+    this->autoDisplayListMeasured = true;
+}
+
+bool Node::hasStaticBatch() {
+    return this->useStaticBatch;
+}
+
+bool Node::isStaticSubtree() {
+    return this->staticSubtree;
+}
+
+void Node::setStaticSubtree(bool in) {
+    this->staticSubtree = in;
+}
+
+GLdouble* Node::getNodeMatrix() {
+    return this->transformationsMatrix;
+}
+
+void Node::setFirstInstance(unsigned int in) {
+    this->firstInstance = in;
+}
+
+unsigned int Node::getFirstInstance() {
+    return this->firstInstance;
+}
+
+const BoundingBox& Node::getPrimitiveBounds() {
+    if (!primitiveBoundsDone) {
+        primitiveBounds.setEmpty();
+
+        BoundingBox bounds;
+        for (auto primitive : primitiveVector) {
+            primitive->getBounds(bounds);
+            primitiveBounds.merge(bounds);
+        }
+
+        primitiveBoundsDone = true;
+    }
+
+    return this->primitiveBounds;
+}
+
 void Node::calculateNodeMatrix() {
     if (precalcDone) {
         return;
@@ -95,9 +382,10 @@ void Node::calculateNodeMatrix() {
     }
 
     for (auto transform : transformList) {
-        setTransformationMatrix(
-                multiplyMatrix(transform->getTransformationMatrix(),
-                        transformationsMatrix));
+        GLdouble* product = multiplyMatrix(transform->getTransformationMatrix(),
+                transformationsMatrix);
+        setTransformationMatrix(product);
+        delete[] product;
     }
 
     this->precalcDone = true;
@@ -130,37 +418,112 @@ GLdouble* Node::multiplyMatrix(GLdouble* left, GLdouble* right) {
 }
 
 /**** geNode: runtime ****/
-void Node::draw() {
-    /* Display List limits NOT respected */
+/* Size of a list per triangle (three vertices) and per primitive drawn */
+const std::size_t ListBytesPerTriangle = 3 * sizeof(Mesh::Vertex);
+const std::size_t ListBytesPerPrimitive = 64;
 
+void Node::draw() {
     /*
-     * Check if we need to create a display list
-     * The node needs to have the display list flag defined to true
-     * We must not be currently creating a display list
-     * And we must not already have an display list created
+     * Nodes without a list, and every node inside a list being compiled
+     * (a list below another list is part of it)
      */
+    if (!hasDisplayList() || this->creatingDisplayList) {
+        drawHelper();
+        return;
+    }
 
-    if (this->useDisplayList && !(this->creatingDisplayList)
-            && (!this->displayListCreated)) {
-        this->creatingDisplayList = true;
+    /* The same list serves every parent with the same appearance */
+    Appearance* inheritedAppearance =
+            appearanceStack.empty() ? nullptr : appearanceStack.top();
 
-        this->displayListID = this->displayListCount;
+    glPushMatrix();
 
-        glNewList(this->displayListCount, GL_COMPILE_AND_EXECUTE);
-        drawHelper();
-        glEndList();
+    /* Animations stay out of the list, they would be frozen in it */
+    if (this->nodeAnimation != nullptr) {
+        this->nodeAnimation->applyAnimation();
+    }
+    glMultMatrixd(transformationsMatrix);
 
-        this->displayListCreated = true;
-        this->creatingDisplayList = false;
-        this->displayListCount++;
+    callDisplayList(inheritedAppearance);
 
-    } else {
-        if (this->displayListCreated) {
-            glCallList(this->displayListID);
-        } else {
-            drawHelper();
+    if (!this->staticSubtree) {
+        if (this->nodeAppearance != nullptr) {
+            appearanceStack.push(nodeAppearance);
+        }
+        drawContents(ContentsMoving);
+        if (this->nodeAppearance != nullptr) {
+            appearanceStack.pop();
         }
     }
+
+    glPopMatrix();
+}
+
+std::size_t Node::callDisplayList(Appearance* inheritedAppearance) {
+    DisplayList& list = getDisplayList(
+            this->nodeAppearance != nullptr ? nullptr : inheritedAppearance);
+
+    if (list.list.id == 0 && !compileDisplayList(list, inheritedAppearance)) {
+        DisplayListManager::countDirectDraw();
+        drawDisplayListContents(inheritedAppearance);
+
+        std::size_t triangles = 0;
+        estimateBytes(ContentsStatic, triangles);
+        return triangles;
+    }
+
+    return DisplayListManager::call(list.list);
+}
+
+bool Node::compileDisplayList(Appearance* inheritedAppearance) {
+    DisplayList& list = getDisplayList(
+            this->nodeAppearance != nullptr ? nullptr : inheritedAppearance);
+
+    return list.list.id != 0 || compileDisplayList(list, inheritedAppearance);
+}
+
+bool Node::compileDisplayList(DisplayList& list,
+        Appearance* inheritedAppearance) {
+    std::size_t triangles = 0;
+    std::size_t bytes = estimateBytes(ContentsStatic, triangles);
+    if (!DisplayListManager::reserve(list.list, bytes, triangles)) {
+        return false;
+    }
+
+    this->creatingDisplayList = true;
+    std::vector<Texture*>* outerRecording = TextureResidency::startRecording(
+            &list.list.textures);
+
+    GLState::startRecording();
+    glNewList(list.list.id, GL_COMPILE);
+    drawDisplayListContents(inheritedAppearance);
+    glEndList();
+    GLState::stopRecording();
+
+    TextureResidency::stopRecording(outerRecording);
+    this->creatingDisplayList = false;
+
+    /* Recorded, not executed, the cache followed state that was never set */
+    GLState::invalidate();
+    return true;
+}
+
+void Node::drawDisplayListContents(Appearance* inheritedAppearance) {
+    if (inheritedAppearance != nullptr) {
+        appearanceStack.push(inheritedAppearance);
+    }
+    if (this->nodeAppearance != nullptr) {
+        appearanceStack.push(nodeAppearance);
+    }
+
+    drawContents(ContentsStatic);
+
+    if (this->nodeAppearance != nullptr) {
+        appearanceStack.pop();
+    }
+    if (inheritedAppearance != nullptr) {
+        appearanceStack.pop();
+    }
 }
 
 void Node::drawHelper() {
@@ -179,25 +542,67 @@ void Node::drawHelper() {
     /* Apply node transform matrix */
     glMultMatrixd(transformationsMatrix);
 
-    /* Apply apperance */
-    appearanceStack.top()->apply();
+    drawContents(ContentsAll);
+
+    /* Done, pop the stacks */
+    if (this->nodeAppearance != nullptr) {
+        appearanceStack.pop();
+    }
+    glPopMatrix();
+}
+
+/* The appearance on top of the stack is the node's */
+void Node::drawContents(Contents contents) {
+    bool applied = false;
 
     /* Draw primitives */
     for (auto primitive : this->primitiveVector) {
+        if (contents != ContentsAll
+                && primitive->isStatic() != (contents == ContentsStatic)) {
+            continue;
+        }
+
+        /* Apply apperance */
+        if (!applied) {
+            appearanceStack.top()->apply();
+            applied = true;
+        }
+
         primitive->draw(appearanceStack.top()->getTextureSWrap(),
                 appearanceStack.top()->getTextureTWrap());
     }
 
     /* Check if we have to go deeper */
     for (auto child : this->childrenVector) {
-        child->draw();
+        if (contents == ContentsAll
+                || child->isStaticSubtree() == (contents == ContentsStatic)) {
+            child->draw();
+        }
     }
+}
 
-    /* Done, pop the stacks */
-    if (this->nodeAppearance != nullptr) {
-        appearanceStack.pop();
+/* A shared node counts once per reference, like the list records it */
+std::size_t Node::estimateBytes(Contents contents, std::size_t& triangles) {
+    std::size_t bytes = 0;
+
+    for (auto primitive : this->primitiveVector) {
+        if (contents == ContentsAll
+                || primitive->isStatic() == (contents == ContentsStatic)) {
+            std::size_t primitiveTriangles = primitive->getNumberOfTriangles();
+            bytes += ListBytesPerPrimitive
+                    + primitiveTriangles * ListBytesPerTriangle;
+            triangles += primitiveTriangles;
+        }
     }
-    glPopMatrix();
+
+    for (auto child : this->childrenVector) {
+        if (contents == ContentsAll
+                || child->isStaticSubtree() == (contents == ContentsStatic)) {
+            bytes += child->estimateBytes(ContentsAll, triangles);
+        }
+    }
+
+    return bytes;
 }
 /**** geNode: runtime (end) ****/
 
@@ -220,8 +625,17 @@ void Node::printMatrix16x1(GLdouble* in) {
     std::cout.unsetf(std::ios::fixed);
 }
 
+/* Transforms and primitives belong to the node, everything else to the scene */
 Node::~Node() {
+    for (auto transform : transformList) {
+        delete (transform);
+    }
+
+    for (auto primitive : primitiveVector) {
+        delete (primitive);
+    }
 
+    invalidateDisplayList();
 }
 
 /******************** GRAPH ********************/
@@ -271,11 +685,56 @@ SceneGraph::SceneGraph(std::string& root) {
     this->defaultRootAppearance = new Appearance(internalAppearanceName,
             emissive, ambient, diffuse, specular, shininess);
 
-    this->firstRun = true;
+    this->numberOfInstances = 0;
+    this->numberOfSharedNodes = 0;
+
+    this->drawListValid = false;
+    this->useDrawList = false;
+
+    this->culling = true;
+    this->visitedInstances = 0;
+    this->culledInstances = 0;
+    this->drawnEntries = 0;
+    this->culledBatches = 0;
+
+    this->occlusion = true;
+    this->occlusionFrame = false;
+
+    this->numberOfTraversalJobs = 0;
+    this->traversalJobsRun = 0;
+    this->traversalJobThreads = 0;
+    this->traversalSeconds = 0.0;
+
+    this->batchedPrimitives = 0;
+
+    this->sorting = true;
+    this->appearanceChanges = 0;
+    this->textureChanges = 0;
+    this->listOrderAppearanceChanges = 0;
+    this->listOrderTextureChanges = 0;
+
+    this->instancing = true;
+    this->instancedFrame = false;
+    this->groupedEntries = 0;
+    this->instancedCalls = 0;
+    this->instancedEntries = 0;
+    this->uploadedInstances = 0;
+
+    this->levelOfDetail = true;
+    this->lodTolerance = LodPixelError;
+    this->submittedTriangles = 0;
+    this->coarseEntries = 0;
+
+    this->measuredLists = 0;
+    this->chosenLists = 0;
 }
 
 SceneGraph::~SceneGraph() {
+    for (auto& node : nodeRegistry) {
+        delete (node.second);
+    }
 
+    delete (defaultRootAppearance);
 }
 
 void SceneGraph::setRootNode(Node* root) {
@@ -288,74 +747,1825 @@ void SceneGraph::setRootNode(Node* root) {
     }
 }
 
+/* Check if root node has apperance */
+void SceneGraph::setRootDefaultAppearance() {
+    if (rootNode->getAppearance() == nullptr) {
+        rootNode->setAppearance(defaultRootAppearance);
+    }
+}
+
+void SceneGraph::registerNodes(std::vector<Node*>& inputNodes) {
+    if (inputNodes.empty()) {
+        throw Exception("No nodes to process received.", true);
+    }
+
+    nodeRegistry.reserve(inputNodes.size());
+
+    for (auto node : inputNodes) {
+        if (!nodeRegistry.add(node->getNodeID(), node)) {
+            throw Exception("Duplicated node id [" + node->getNodeID() + "].",
+                    true);
+        }
+    }
+
+    /* Check if we got a rootNode */
+    Node* root = nodeRegistry.find(this->rootID);
+    if (root == nullptr) {
+        throw Exception("Root node not found!", true);
+    }
+
+    setRootNode(root);
+    setRootDefaultAppearance();
+}
+
 void SceneGraph::importNodesPointerVector(std::vector<Node*>& inputNodes) {
-    if (!inputNodes.empty()) {
-
-        /* Find root node and then remove the pointer from the inputNodes vector */
-        for (std::vector<Node*>::iterator k = inputNodes.begin();
-                k != inputNodes.end();) {
-            if (this->rootID == (*k)->getNodeID()) {
-                setRootNode((*k));
-                k = inputNodes.erase(k);
-            } else {
-                ++k;
+    registerNodes(inputNodes);
+
+    /* Every node is linked once, each reference is a single lookup */
+    for (auto node : inputNodes) {
+        for (auto& childId : node->getChildrenIDVector()) {
+            Node* child = nodeRegistry.find(childId);
+
+            if (child == nullptr) {
+                throw Exception(
+                        "Node [" + node->getNodeID()
+                                + "]: Reference to a non existing node ["
+                                + childId + "].", true);
             }
-        }
 
-        /* Check if we got a rootNode, if so start a recursive search for children */
-        if (rootNode == nullptr) {
-            throw Exception("Root node not found!", true);
+            /* The root node can not be used as a child */
+            if (child != rootNode) {
+                node->getChildrenVector().push_back(child);
+            }
         }
+    }
 
-        /* Check if root node has apperance */
-        if (rootNode->getAppearance() == nullptr) {
-            rootNode->setAppearance(defaultRootAppearance);
-        }
+    checkGraph();
 
-        importNodesPointerVectorHelper(inputNodes, rootNode);
+    LoadProfiler::Scope profile(LoadProfiler::PhaseNodeMatrices);
+    for (auto node : inputNodes) {
+        node->calculateNodeMatrix();
+    }
 
-        /* Clean unprocessed Nodes Vector */
-        inputNodes.clear();
+    /* Clean unprocessed Nodes Vector */
+    inputNodes.clear();
+}
 
-    } else {
-        throw Exception("No nodes to process received.", true);
+void SceneGraph::importLinkedNodes(std::vector<Node*>& linkedNodes) {
+    registerNodes(linkedNodes);
+    checkGraph();
+
+    LoadProfiler::Scope profile(LoadProfiler::PhaseNodeMatrices);
+    for (auto node : linkedNodes) {
+        node->calculateNodeMatrix();
     }
+
+    linkedNodes.clear();
 }
 
-void SceneGraph::importNodesPointerVectorHelper(std::vector<Node*>& inputNodes,
-        Node* parent) {
-    parent->calculateNodeMatrix();
+Node* SceneGraph::getNodeByID(const std::string& id) {
+    return nodeRegistry.find(id);
+}
 
-    /* Current node has no children so bail out */
-    if (parent->getChildrenIDVector().empty()) {
-        return;
-    }
+unsigned int SceneGraph::getNumberOfNodes() {
+    return static_cast<unsigned int>(nodeRegistry.size());
+}
+
+uint64_t SceneGraph::getNumberOfInstances() {
+    return this->numberOfInstances;
+}
+
+unsigned int SceneGraph::getNumberOfSharedNodes() {
+    return this->numberOfSharedNodes;
+}
+
+/* Iterative depth first search, scenes can be deeper than the call stack */
+void SceneGraph::checkGraph() {
+    enum VisitState {
+        NotVisited = 0, OnPath, Done
+    };
+
+    struct NodeInfo {
+        VisitState state = NotVisited;
+        unsigned int parents = 0;
+        uint64_t instances = 0;
+    };
 
-    if (!inputNodes.empty()) {
-        /* Find children by ID then add pointer to vector */
-        for (auto si : parent->getChildrenIDVector()) {
-            for (auto inputNode : inputNodes) {
-                if (inputNode->getNodeID() == si) {
-                    parent->getChildrenVector().push_back(inputNode);
+    struct PathEntry {
+        Node* node;
+        std::size_t nextChild;
+    };
+
+    std::unordered_map<Node*, NodeInfo> info;
+    info.reserve(nodeRegistry.size());
+
+    std::vector<PathEntry> path;
+
+    for (auto& entry : nodeRegistry) {
+        if (info[entry.second].state != NotVisited) {
+            continue;
+        }
+
+        info[entry.second].state = OnPath;
+        path.push_back( { entry.second, 0 });
+
+        while (!path.empty()) {
+            Node* node = path.back().node;
+            std::vector<Node*>& children = node->getChildrenVector();
+
+            if (path.back().nextChild < children.size()) {
+                Node* child = children[path.back().nextChild++];
+                NodeInfo& childInfo = info[child];
+
+                if (childInfo.state == OnPath) {
+                    throw Exception(
+                            "Node [" + node->getNodeID() + "]: Reference to ["
+                                    + child->getNodeID()
+                                    + "], which is one of its ancestors (cycle).",
+                            true);
                 }
+
+                if (childInfo.state == NotVisited) {
+                    childInfo.state = OnPath;
+                    path.push_back( { child, 0 });
+                }
+                continue;
+            }
+
+            /* Saturates, a few levels of sharing can reach absurd counts */
+            uint64_t count = 1;
+            for (auto child : children) {
+                NodeInfo& childInfo = info[child];
+                count = childInfo.instances > UINT64_MAX - count ?
+                        UINT64_MAX : count + childInfo.instances;
+                childInfo.parents++;
             }
+
+            NodeInfo& nodeInfo = info[node];
+            nodeInfo.instances = count;
+            nodeInfo.state = Done;
+            path.pop_back();
         }
+    }
 
-        /* Recursive search */
-        for (auto child : parent->getChildrenVector()) {
-            importNodesPointerVectorHelper(inputNodes, child);
+    this->numberOfInstances = info[rootNode].instances;
+    this->numberOfSharedNodes = 0;
+    for (auto& entry : info) {
+        if (entry.second.parents > 1) {
+            this->numberOfSharedNodes++;
         }
     }
+
+    LoadProfiler::count(LoadProfiler::CounterNodeInstances,
+            this->numberOfInstances);
+    LoadProfiler::count(LoadProfiler::CounterSharedNodes,
+            this->numberOfSharedNodes);
 }
 
-void SceneGraph::draw() {
-    if (this->firstRun) {
-        glGenLists(MAX_DISPLAY_LISTS);
-        this->firstRun = false;
+bool SceneGraph::applyReload(SceneGraph& fresh, std::vector<Node*>& patched,
+        std::unordered_set<Primitives::PrimitiveInterface*>& discarded) {
+    bool rootChanged = fresh.rootID != this->rootID;
+
+    /* Nodes whose children vector has to be filled again */
+    std::vector<Node*> relink;
+    std::vector<Node*> added;
+    std::vector<Node*> removed;
+
+    /* Nodes that only moved keep their place in the draw list */
+    std::vector<Node*> moved;
+    bool graphChanged = rootChanged;
+
+    for (auto& entry : fresh.nodeRegistry) {
+        Node* freshNode = entry.second;
+        Node* liveNode = nodeRegistry.find(entry.first);
+
+        if (liveNode == nullptr) {
+            added.push_back(freshNode);
+            continue;
+        }
+
+        bool changed = false;
+        for (int part = 0; part < Node::NumberOfParts; part++) {
+            Node::Part nodePart = static_cast<Node::Part>(part);
+            if (liveNode->getHash(nodePart) == freshNode->getHash(nodePart)) {
+                continue;
+            }
+
+            if (nodePart == Node::PartPrimitives) {
+                discarded.insert(liveNode->getPrimitiveVector().begin(),
+                        liveNode->getPrimitiveVector().end());
+            }
+
+            liveNode->replacePart(nodePart, *freshNode);
+            changed = true;
+
+            if (nodePart == Node::PartLinks) {
+                relink.push_back(liveNode);
+            }
+
+            if (nodePart == Node::PartTransforms) {
+                moved.push_back(liveNode);
+            } else {
+                graphChanged = true;
+            }
+        }
+
+        if (changed) {
+            patched.push_back(liveNode);
+        }
     }
 
-    glPushMatrix();
-    this->rootNode->draw();
-    glPopMatrix();
+    for (auto& entry : nodeRegistry) {
+        if (fresh.nodeRegistry.find(entry.first) == nullptr) {
+            removed.push_back(entry.second);
+        }
+    }
+
+    /* Removed nodes are handed over to fresh, which deletes them */
+    for (auto node : removed) {
+        discarded.insert(node->getPrimitiveVector().begin(),
+                node->getPrimitiveVector().end());
+        nodeRegistry.remove(node->getNodeID());
+        fresh.nodeRegistry.add(node->getNodeID(), node);
+    }
+
+    for (auto node : added) {
+        fresh.nodeRegistry.remove(node->getNodeID());
+        nodeRegistry.add(node->getNodeID(), node);
+        patched.push_back(node);
+        relink.push_back(node);
+    }
+
+    /* The old root may have the internal appearance, the new one needs it */
+    if (rootChanged) {
+        if (rootNode->getAppearance() == defaultRootAppearance) {
+            rootNode->setAppearance(nullptr);
+        }
+
+        this->rootID = fresh.rootID;
+        this->rootNode = nodeRegistry.find(rootID);
+
+        /* Every node may be (or have been) linked to the root, and drawn below it */
+        relink.clear();
+        for (auto& entry : nodeRegistry) {
+            relink.push_back(entry.second);
+            entry.second->invalidateDisplayList();
+        }
+    }
+
+    if (rootNode->getAppearance() == fresh.defaultRootAppearance
+            || rootNode->getAppearance() == nullptr) {
+        rootNode->setAppearance(defaultRootAppearance);
+    }
+
+    for (auto node : relink) {
+        node->getChildrenVector().clear();
+
+        for (auto& childId : node->getChildrenIDVector()) {
+            Node* child = nodeRegistry.find(childId);
+
+            if (child != nullptr && child != rootNode) {
+                node->getChildrenVector().push_back(child);
+            }
+        }
+    }
+
+    /* Fresh passed the same check, this only updates the counts */
+    checkGraph();
+
+    /* Appearances and animations are patched in place, only the graph itself matters */
+    /* A batch has the transforms of the nodes below its own baked in */
+    for (auto node : moved) {
+        if (batchedNodes.count(node) > 0) {
+            graphChanged = true;
+        }
+    }
+
+    if (graphChanged || !added.empty() || !removed.empty()) {
+        drawListValid = false;
+    } else {
+        for (auto node : moved) {
+            invalidateWorldMatrices(node);
+        }
+    }
+
+    return rootChanged;
+}
+
+void SceneGraph::invalidateDisplayLists(const std::unordered_set<Node*>& nodes,
+        const std::unordered_set<Appearance*>& appearances,
+        const std::unordered_set<Animation*>& animations) {
+    ReloadChanges changes;
+    changes.nodes = &nodes;
+    changes.appearances = &appearances;
+    changes.animations = &animations;
+
+    invalidateHelper(rootNode, false, changes);
+
+    /* Texture lengths are baked into the batches */
+    for (auto& batch : staticBatches) {
+        if (appearances.count(batch.appearance) > 0) {
+            drawListValid = false;
+        }
+    }
+}
+
+/* Returns true if something drawn by the node changed */
+bool SceneGraph::invalidateHelper(Node* node, bool inherited,
+        ReloadChanges& changes) {
+    auto visited = changes.visited[inherited].find(node);
+    if (visited != changes.visited[inherited].end()) {
+        return visited->second;
+    }
+
+    /*
+     * Appearances and animations also change whatever is drawn below the
+     * node, and so does a patched node (its appearance may be the one its
+     * children inherit, which picks their display list)
+     */
+    bool drawnWithChanges = inherited || changes.nodes->count(node) > 0
+            || changes.appearances->count(node->getAppearance()) > 0
+            || changes.animations->count(node->getAnimation()) > 0;
+    bool changed = drawnWithChanges;
+
+    for (auto child : node->getChildrenVector()) {
+        changed = invalidateHelper(child, drawnWithChanges, changes) || changed;
+    }
+
+    if (changed) {
+        node->invalidateDisplayList();
+    }
+
+    changes.visited[inherited][node] = changed;
+    return changed;
+}
+
+void SceneGraph::compileDisplayLists() {
+    LoadProfiler::Scope profile(LoadProfiler::PhaseDisplayLists);
+    updateWorldMatrices();
+
+    if (!useDrawList) {
+        std::set<std::pair<Node*, Appearance*> > visited;
+        compileDisplayListsHelper(rootNode, nullptr, visited);
+        return;
+    }
+
+    chooseDisplayLists();
+
+    for (auto& entry : drawEntries) {
+        if (entry.displayListNode != nullptr
+                && !entry.displayListNode->compileDisplayList(
+                        entry.appearance)) {
+            /* The rest are compiled when drawn, if something is evicted */
+            break;
+        }
+    }
+}
+
+void SceneGraph::compileDisplayListsHelper(Node* node,
+        Appearance* inheritedAppearance,
+        std::set<std::pair<Node*, Appearance*> >& visited) {
+    if (!visited.insert(std::make_pair(node, inheritedAppearance)).second) {
+        return;
+    }
+
+    bool listed = node->hasDisplayList();
+    if (listed && !node->compileDisplayList(inheritedAppearance)) {
+        return;
+    }
+
+    Appearance* appearance =
+            node->getAppearance() != nullptr ?
+                    node->getAppearance() : inheritedAppearance;
+    for (auto child : node->getChildrenVector()) {
+        if (!listed || !child->isStaticSubtree()) {
+            compileDisplayListsHelper(child, appearance, visited);
+        }
+    }
+}
+
+/* Topmost candidates only, a shared node is measured at its first instance */
+void SceneGraph::chooseDisplayLists() {
+    std::vector<unsigned int> candidates;
+
+    unsigned int index = 1;
+    while (index < nodeInstances.size()) {
+        NodeInstance& instance = nodeInstances[index];
+
+        if (instance.entriesEnd - instance.firstEntry < MinAutoListEntries) {
+            index = instance.end;
+        } else if (isListCandidate(index)) {
+            candidates.push_back(index);
+            index = instance.end;
+        } else {
+            index++;
+        }
+    }
+
+    if (candidates.empty()) {
+        return;
+    }
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+
+    auto start = std::chrono::steady_clock::now();
+    bool chosen = false;
+    for (auto candidate : candidates) {
+        Node* node = nodeInstances[candidate].node;
+        if (node->isAutoDisplayListMeasured()) {
+            continue;
+        }
+
+        double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        if (elapsed > MaxAutoListSeconds || !measureDisplayList(candidate)) {
+            break;
+        }
+
+        measuredLists++;
+        if (node->hasDisplayList()) {
+            chosenLists++;
+            chosen = true;
+        }
+    }
+
+    glPopMatrix();
+
+    /* Chosen nodes become single entries */
+    if (chosen) {
+        drawListValid = false;
+        updateWorldMatrices();
+    }
+}
+
+bool SceneGraph::isListCandidate(unsigned int index) {
+    NodeInstance& instance = nodeInstances[index];
+    Node* node = instance.node;
+
+    if (node->getDisplayListMode() != Node::ListAuto
+            || node->isAutoDisplayListMeasured() || !node->isStaticSubtree()
+            || batchedNodes.count(node) > 0
+            || instance.entriesEnd - instance.firstEntry > MaxAutoListEntries) {
+        return false;
+    }
+
+    for (unsigned int i = instance.firstEntry; i < instance.entriesEnd; i++) {
+        DrawEntry& entry = drawEntries[i];
+        if (entry.primitive == nullptr || entry.group != nullptr
+                || entry.levels > 1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Appearance* SceneGraph::getInheritedAppearance(unsigned int index) {
+    for (unsigned int i = nodeInstances[index].parent; i != 0;
+            i = nodeInstances[i].parent) {
+        if (nodeInstances[i].node->getAppearance() != nullptr) {
+            return nodeInstances[i].node->getAppearance();
+        }
+    }
+
+    return nullptr;
+}
+
+/*
+ * Best of a few runs each way, after a draw that uploads whatever the
+ * subtree needs. glFinish makes the time the GL's, not only the calls'.
+ */
+bool SceneGraph::measureDisplayList(unsigned int index) {
+    Node* node = nodeInstances[index].node;
+    Appearance* inheritedAppearance = getInheritedAppearance(index);
+    glLoadMatrixd(nodeInstances[index].world);
+
+    node->drawDisplayListContents(inheritedAppearance);
+    glFinish();
+
+    double direct = 0.0;
+    for (unsigned int run = 0; run < AutoListRuns; run++) {
+        auto start = std::chrono::steady_clock::now();
+        node->drawDisplayListContents(inheritedAppearance);
+        glFinish();
+        double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        direct = (run == 0 || elapsed < direct) ? elapsed : direct;
+    }
+    GLState::invalidate();
+
+    if (!node->compileDisplayList(inheritedAppearance)) {
+        return false;
+    }
+
+    double listed = 0.0;
+    for (unsigned int run = 0; run < AutoListRuns; run++) {
+        auto start = std::chrono::steady_clock::now();
+        node->callDisplayList(inheritedAppearance);
+        glFinish();
+        double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        listed = (run == 0 || elapsed < listed) ? elapsed : listed;
+    }
+
+    bool keep = listed <= direct * AutoListGain;
+    if (!keep) {
+        node->invalidateDisplayList();
+    }
+    node->setAutoDisplayList(keep);
+
+#ifdef ENGINE_VERBOSE
+    std::cout << "Display list for [" << node->getNodeID() << "]: "
+            << listed * 1000.0 << " ms called, " << direct * 1000.0
+            << " ms drawn directly, " << (keep ? "kept" : "dropped")
+            << std::endl;
+#endif
+
+    return true;
+}
+
+unsigned int SceneGraph::getMeasuredLists() {
+    return this->measuredLists;
+}
+
+unsigned int SceneGraph::getChosenLists() {
+    return this->chosenLists;
+}
+
+void SceneGraph::buildDrawList() {
+    drawEntries.clear();
+    nodeInstances.clear();
+    animatedInstances.clear();
+    changedInstances.clear();
+    staticBatches.clear();
+    batchRanges.clear();
+    batchedNodes.clear();
+    batchedPrimitives = 0;
+    instanceGroups.clear();
+    groupedEntries = 0;
+    occlusionCulling.clear();
+    drawListValid = true;
+
+    /* Lists hold what never moves, recursive draws need to know it too */
+    for (auto& entry : nodeRegistry) {
+        entry.second->setFirstInstance(0);
+        entry.second->setStaticSubtree(isStaticSubtree(entry.second));
+    }
+
+    useDrawList = numberOfInstances < MaxDrawListInstances;
+    if (!useDrawList) {
+        staticSubtrees.clear();
+        return;
+    }
+
+    /* Instance 0 is the scene itself, it never moves */
+    NodeInstance scene;
+    scene.node = nullptr;
+    scene.parent = 0;
+    scene.end = 0;
+    scene.nextInstance = 0;
+    scene.firstEntry = 0;
+    scene.ownEntriesEnd = 0;
+    scene.occlusionUnit = 0;
+    std::copy(identityMatrix, identityMatrix + 16, scene.world);
+    scene.scale = 1.0;
+
+    nodeInstances.reserve(static_cast<std::size_t>(numberOfInstances) + 1);
+    nodeInstances.push_back(scene);
+
+    buildDrawListHelper(rootNode, 0, nullptr, true, false);
+    staticSubtrees.clear();
+    nodeInstances[0].end = static_cast<unsigned int>(nodeInstances.size());
+    nodeInstances[0].entriesEnd = static_cast<unsigned int>(drawEntries.size());
+
+    drawEntries.shrink_to_fit();
+    animatedInstances.shrink_to_fit();
+    buildInstanceGroups();
+    setStateKeys();
+
+    for (unsigned int i = 1; i < nodeInstances.size(); i++) {
+        updateWorldMatrix(i);
+    }
+    updateGroupMatrices(0, static_cast<unsigned int>(drawEntries.size()));
+
+    /* Children come after their parents */
+    for (unsigned int i = static_cast<unsigned int>(nodeInstances.size());
+            i-- > 0;) {
+        updateBounds(i);
+    }
+
+    addOcclusionUnits();
+}
+
+/* Bounds that can be anywhere (a vehicle below) would never be occluded */
+void SceneGraph::addOcclusionUnits() {
+    for (unsigned int i = 1; i < nodeInstances.size(); i++) {
+        NodeInstance& instance = nodeInstances[i];
+        if (instance.entriesEnd - instance.firstEntry >= MinOcclusionEntries
+                && !instance.bounds.unbounded && !instance.bounds.isEmpty()) {
+            instance.occlusionUnit = occlusionCulling.addUnit(i);
+        }
+    }
+}
+
+/*
+ * Same order as Node::drawHelper, static nodes below a display list only get
+ * instances and nodes below a static batch only get entries for what the
+ * batch could not take (a display list wins over a batch, a batch wins over
+ * the display lists below it)
+ */
+void SceneGraph::buildDrawListHelper(Node* node, unsigned int parent,
+        Appearance* inheritedAppearance, bool drawn, bool batched) {
+    unsigned int index = static_cast<unsigned int>(nodeInstances.size());
+
+    NodeInstance instance;
+    instance.node = node;
+    instance.parent = parent;
+    instance.end = 0;
+    instance.nextInstance = node->getFirstInstance();
+    instance.firstEntry = static_cast<unsigned int>(drawEntries.size());
+    instance.occlusionUnit = 0;
+    node->setFirstInstance(index);
+    nodeInstances.push_back(instance);
+
+    if (node->getAnimation() != nullptr) {
+        AnimatedInstance animated;
+        animated.instance = index;
+        animated.animation = node->getAnimation();
+        animated.version = node->getAnimation()->getVersion();
+        animatedInstances.push_back(animated);
+    }
+
+    if (batched) {
+        batchedNodes.insert(node);
+    }
+
+    bool listed = drawn && !batched && node->hasDisplayList();
+    if (listed) {
+        DrawEntry entry;
+        entry.instance = index;
+        entry.appearance = inheritedAppearance;
+        entry.primitive = nullptr;
+        entry.displayListNode = node;
+        entry.batch = nullptr;
+        entry.group = nullptr;
+        entry.member = 0;
+        entry.levels = 1;
+        entry.level = 0;
+        entry.reach = 0.0;
+        entry.applyAppearance = false;
+        drawEntries.push_back(entry);
+    }
+
+    if (drawn && !batched && !listed && node->hasStaticBatch()
+            && isStaticSubtree(node)) {
+        addStaticBatchEntries(node, index, inheritedAppearance);
+        batched = true;
+    }
+
+    Appearance* appearance =
+            node->getAppearance() != nullptr ?
+                    node->getAppearance() : inheritedAppearance;
+
+    bool first = true;
+    for (auto primitive : node->getPrimitiveVector()) {
+        if (!drawn) {
+            break;
+        }
+
+        GLdouble s = 1.0, t = 1.0;
+        if (batched && primitive->getMesh(s, t) != nullptr) {
+            continue;
+        }
+        if (listed && primitive->isStatic()) {
+            continue;
+        }
+
+        DrawEntry entry;
+        entry.instance = index;
+        entry.appearance = appearance;
+        entry.primitive = primitive;
+        entry.displayListNode = nullptr;
+        entry.batch = nullptr;
+        entry.group = nullptr;
+        entry.member = 0;
+        entry.levels = primitive->getNumberOfLevels();
+        entry.level = 0;
+        entry.reach = 0.0;
+        if (entry.levels > 1) {
+            BoundingBox bounds;
+            primitive->getBounds(bounds);
+            entry.reach = getReach(bounds);
+        }
+        entry.applyAppearance = first;
+        drawEntries.push_back(entry);
+        first = false;
+    }
+
+    nodeInstances[index].ownEntriesEnd =
+            static_cast<unsigned int>(drawEntries.size());
+
+    for (auto child : node->getChildrenVector()) {
+        buildDrawListHelper(child, index, appearance,
+                drawn && !(listed && isStaticSubtree(child)), batched);
+    }
+
+    nodeInstances[index].end = static_cast<unsigned int>(nodeInstances.size());
+    nodeInstances[index].entriesEnd =
+            static_cast<unsigned int>(drawEntries.size());
+}
+
+bool SceneGraph::isStaticSubtree(Node* node) {
+    auto found = staticSubtrees.find(node);
+    if (found != staticSubtrees.end()) {
+        return found->second;
+    }
+
+    bool isStatic = node->getAnimation() == nullptr;
+    for (auto primitive : node->getPrimitiveVector()) {
+        isStatic = isStatic && primitive->isStatic();
+    }
+    for (auto child : node->getChildrenVector()) {
+        isStatic = isStaticSubtree(child) && isStatic;
+    }
+
+    staticSubtrees[node] = isStatic;
+    return isStatic;
+}
+
+/* Every path below the node, a shared node goes in once per reference */
+void SceneGraph::collectBatchPieces(Node* node, const GLdouble* matrix,
+        Appearance* appearance, std::vector<BatchPiece>& out) {
+    for (auto primitive : node->getPrimitiveVector()) {
+        BatchPiece piece;
+        piece.appearance = appearance;
+        piece.s = appearance->getTextureSWrap();
+        piece.t = appearance->getTextureTWrap();
+        piece.mesh = primitive->getMesh(piece.s, piece.t);
+        if (piece.mesh == nullptr || piece.mesh->getNumberOfIndices() == 0) {
+            continue;
+        }
+
+        std::copy(matrix, matrix + 16, piece.matrix);
+        BoundingBox bounds;
+        primitive->getBounds(bounds);
+        bounds.transform(matrix, piece.bounds);
+        out.push_back(piece);
+    }
+
+    for (auto child : node->getChildrenVector()) {
+        GLdouble childMatrix[16];
+        multiplyMatrices(matrix, child->getNodeMatrix(), childMatrix);
+        Appearance* childAppearance =
+                child->getAppearance() != nullptr ?
+                        child->getAppearance() : appearance;
+        collectBatchPieces(child, childMatrix, childAppearance, out);
+    }
+}
+
+void SceneGraph::splitStaticBatch(std::vector<BatchPiece>::iterator first,
+        std::vector<BatchPiece>::iterator last) {
+    std::size_t vertices = 0;
+    BoundingBox centers;
+    for (auto piece = first; piece != last; ++piece) {
+        GLdouble center[3];
+        getCenter(piece->bounds, center);
+        centers.merge(center[0], center[1], center[2]);
+        vertices += piece->mesh->getNumberOfVertices();
+    }
+
+    if (vertices > MaxBatchVertices && last - first > 1) {
+        int axis = 0;
+        for (int i = 1; i < 3; i++) {
+            if (centers.max[i] - centers.min[i]
+                    > centers.max[axis] - centers.min[axis]) {
+                axis = i;
+            }
+        }
+
+        auto middle = first + (last - first) / 2;
+        std::nth_element(first, middle, last,
+                [axis](const BatchPiece& left, const BatchPiece& right) {
+                    return left.bounds.min[axis] + left.bounds.max[axis]
+                            < right.bounds.min[axis] + right.bounds.max[axis];
+                });
+
+        splitStaticBatch(first, middle);
+        splitStaticBatch(middle, last);
+        return;
+    }
+
+    staticBatches.emplace_back();
+    StaticBatch& batch = staticBatches.back();
+    batch.appearance = first->appearance;
+
+    for (auto piece = first; piece != last; ++piece) {
+        batch.mesh.append(*piece->mesh, piece->matrix, piece->s, piece->t);
+        batch.bounds.merge(piece->bounds);
+    }
+    getCenter(batch.bounds, batch.center);
+
+    batchedPrimitives += static_cast<unsigned int>(last - first);
+    LoadProfiler::count(LoadProfiler::CounterStaticBatches);
+    LoadProfiler::count(LoadProfiler::CounterBatchedPrimitives, last - first);
+}
+
+/* Built the first time, like display lists one set per inherited appearance */
+void SceneGraph::addStaticBatchEntries(Node* node, unsigned int instance,
+        Appearance* inheritedAppearance) {
+    Appearance* appearance =
+            node->getAppearance() != nullptr ?
+                    node->getAppearance() : inheritedAppearance;
+    std::pair<Node*, Appearance*> key(node,
+            node->getAppearance() != nullptr ? nullptr : inheritedAppearance);
+
+    auto found = batchRanges.find(key);
+    if (found == batchRanges.end()) {
+        LoadProfiler::Scope profile(LoadProfiler::PhaseStaticBatches);
+
+        std::vector<BatchPiece> pieces;
+        collectBatchPieces(node, identityMatrix, appearance, pieces);
+
+        /* One group per appearance, in draw order */
+        std::unordered_map<Appearance*, unsigned int> groupIds;
+        std::vector<std::vector<BatchPiece> > groups;
+        for (auto& piece : pieces) {
+            unsigned int group = getDenseId(groupIds, piece.appearance);
+            if (group == groups.size()) {
+                groups.emplace_back();
+            }
+            groups[group].push_back(piece);
+        }
+
+        std::pair<unsigned int, unsigned int> range;
+        range.first = static_cast<unsigned int>(staticBatches.size());
+        for (auto& group : groups) {
+            splitStaticBatch(group.begin(), group.end());
+        }
+        range.second = static_cast<unsigned int>(staticBatches.size());
+
+        found = batchRanges.insert(std::make_pair(key, range)).first;
+    }
+
+    for (unsigned int i = found->second.first; i < found->second.second; i++) {
+        DrawEntry entry;
+        entry.instance = instance;
+        entry.appearance = staticBatches[i].appearance;
+        entry.primitive = nullptr;
+        entry.displayListNode = nullptr;
+        entry.batch = &staticBatches[i];
+        entry.group = nullptr;
+        entry.member = 0;
+        entry.levels = 1;
+        entry.level = 0;
+        entry.reach = 0.0;
+        entry.applyAppearance = true;
+        drawEntries.push_back(entry);
+    }
+}
+
+/*
+ * Entries are grouped in list order, so each group's members are in preorder
+ * and a frustum culled walk finds its visible ones in increasing order
+ */
+void SceneGraph::buildInstanceGroups() {
+    std::map<std::pair<Mesh*, Appearance*>, std::vector<unsigned int> >
+            candidates;
+
+    for (unsigned int i = 0; i < drawEntries.size(); i++) {
+        DrawEntry& entry = drawEntries[i];
+        GLdouble s = 1.0, t = 1.0;
+        Mesh* mesh = nullptr;
+
+        if (entry.batch != nullptr) {
+            mesh = &entry.batch->mesh;
+        } else if (entry.primitive != nullptr
+                && !entry.primitive->hasShader()) {
+            s = entry.appearance->getTextureSWrap();
+            t = entry.appearance->getTextureTWrap();
+            mesh = entry.primitive->getMesh(s, t);
+        }
+
+        if (mesh != nullptr && mesh->getNumberOfIndices() > 0) {
+            candidates[std::make_pair(mesh, entry.appearance)].push_back(i);
+        }
+    }
+
+    for (auto& candidate : candidates) {
+        if (candidate.second.size() < MinInstanceGroup) {
+            continue;
+        }
+
+        instanceGroups.emplace_back(candidate.first.first);
+        InstanceGroup& group = instanceGroups.back();
+
+        /* Same mesh, same parameters, the same levels */
+        DrawEntry& first = drawEntries[candidate.second.front()];
+        for (unsigned int level = 1; level < first.levels; level++) {
+            group.addLevel(first.primitive->getLevelMesh(level));
+        }
+
+        for (auto i : candidate.second) {
+            drawEntries[i].group = &group;
+            drawEntries[i].member = group.addMember();
+        }
+        groupedEntries += static_cast<unsigned int>(candidate.second.size());
+    }
+}
+
+void SceneGraph::updateGroupMatrices(unsigned int first, unsigned int end) {
+    if (instanceGroups.empty()) {
+        return;
+    }
+
+    for (unsigned int i = first; i < end; i++) {
+        DrawEntry& entry = drawEntries[i];
+        if (entry.group != nullptr) {
+            entry.group->setMatrix(entry.member,
+                    nodeInstances[entry.instance].world);
+        }
+    }
+}
+
+/* Parent world * animation * node transforms, the parent must be up to date */
+void SceneGraph::updateWorldMatrix(unsigned int index) {
+    NodeInstance& instance = nodeInstances[index];
+    const GLdouble* parentWorld = nodeInstances[instance.parent].world;
+    Animation* animation = instance.node->getAnimation();
+
+    if (animation == nullptr) {
+        multiplyMatrices(parentWorld, instance.node->getNodeMatrix(),
+                instance.world);
+    } else {
+        GLdouble animationMatrix[16], animated[16];
+        animation->getAnimationMatrix(animationMatrix);
+        multiplyMatrices(parentWorld, animationMatrix, animated);
+        multiplyMatrices(animated, instance.node->getNodeMatrix(),
+                instance.world);
+    }
+
+    instance.scale = getScale(instance.world);
+}
+
+/* The scene (instance 0) has no node, only children */
+void SceneGraph::updateBounds(unsigned int index) {
+    NodeInstance& instance = nodeInstances[index];
+
+    if (instance.node != nullptr) {
+        instance.node->getPrimitiveBounds().transform(instance.world,
+                instance.bounds);
+    } else {
+        instance.bounds.setEmpty();
+    }
+
+    for (unsigned int child = index + 1; child < instance.end;
+            child = nodeInstances[child].end) {
+        instance.bounds.merge(nodeInstances[child].bounds);
+    }
+}
+
+void SceneGraph::updateWorldMatrices() {
+    if (!drawListValid) {
+        buildDrawList();
+        return;
+    }
+
+    for (auto& animated : animatedInstances) {
+        unsigned long version = animated.animation->getVersion();
+        if (version != animated.version) {
+            animated.version = version;
+            changedInstances.push_back(animated.instance);
+        }
+    }
+
+    if (changedInstances.empty()) {
+        return;
+    }
+
+    /* Preorder, so a subtree is done once even if several of its nodes moved */
+    std::sort(changedInstances.begin(), changedInstances.end());
+
+    /* Ancestors of the moved subtrees, their bounds are merged again */
+    std::vector<unsigned int> ancestors;
+    /* Moved subtrees, none inside another */
+    std::vector<unsigned int> moved;
+    unsigned int movedInstances = 0;
+
+    unsigned int done = 0;
+    for (auto first : changedInstances) {
+        if (first < done) {
+            continue;
+        }
+
+        done = nodeInstances[first].end;
+        moved.push_back(first);
+        movedInstances += done - first;
+
+        for (unsigned int i = nodeInstances[first].parent; i != 0;
+                i = nodeInstances[i].parent) {
+            ancestors.push_back(i);
+        }
+    }
+
+    changedInstances.clear();
+
+    WorkerPool* pool = nullptr;
+    if (movedInstances >= MinParallelInstances) {
+        pool = getTraversalPool();
+    }
+    if (pool != nullptr) {
+        updateSubtrees(moved, movedInstances, *pool);
+    } else {
+        for (auto first : moved) {
+            updateSubtree(first);
+        }
+    }
+
+    /* Groups are shared between subtrees, members are marked on this thread */
+    if (!instanceGroups.empty()) {
+        for (auto first : moved) {
+            for (unsigned int i = nodeInstances[first].firstEntry;
+                    i < nodeInstances[first].entriesEnd; i++) {
+                DrawEntry& entry = drawEntries[i];
+                if (entry.group != nullptr) {
+                    entry.group->markChanged(entry.member);
+                }
+            }
+        }
+    }
+
+    /* Deepest first, a parent always has a smaller index than its children */
+    std::sort(ancestors.begin(), ancestors.end());
+    ancestors.erase(std::unique(ancestors.begin(), ancestors.end()),
+            ancestors.end());
+    for (auto i = ancestors.rbegin(); i != ancestors.rend(); ++i) {
+        updateBounds(*i);
+    }
+}
+
+/*
+ * World matrices, group member matrices and bounds of the subtree. Runs in
+ * jobs: it only writes the subtree's own instances and group members (the
+ * nodes' primitive bounds were all worked out when the draw list was built).
+ */
+void SceneGraph::updateSubtree(unsigned int first) {
+    NodeInstance& instance = nodeInstances[first];
+
+    for (unsigned int i = first; i < instance.end; i++) {
+        updateWorldMatrix(i);
+    }
+    writeGroupMatrices(instance.firstEntry, instance.entriesEnd);
+    for (unsigned int i = instance.end; i-- > first;) {
+        updateBounds(i);
+    }
+}
+
+/*
+ * Subtrees too large for a job have their root done here and their
+ * children split again, small ones are packed in jobs of about the same
+ * number of instances
+ */
+void SceneGraph::updateSubtrees(const std::vector<unsigned int>& moved,
+        unsigned int movedInstances, WorkerPool& pool) {
+    unsigned int jobInstances = std::max(MinJobInstances,
+            movedInstances / (pool.getNumberOfThreads()
+                    * TraversalJobsPerThread));
+
+    std::vector<unsigned int> subtrees;
+    /* Done here, their bounds once the jobs are done */
+    std::vector<unsigned int> roots;
+
+    std::vector<unsigned int> stack(moved.rbegin(), moved.rend());
+    while (!stack.empty()) {
+        unsigned int index = stack.back();
+        stack.pop_back();
+        NodeInstance& instance = nodeInstances[index];
+
+        if (instance.end - index <= jobInstances) {
+            subtrees.push_back(index);
+            continue;
+        }
+
+        updateWorldMatrix(index);
+        writeGroupMatrices(instance.firstEntry, instance.ownEntriesEnd);
+        roots.push_back(index);
+
+        std::size_t children = stack.size();
+        for (unsigned int child = index + 1; child < instance.end;
+                child = nodeInstances[child].end) {
+            stack.push_back(child);
+        }
+        std::reverse(stack.begin() + children, stack.end());
+    }
+
+    std::size_t first = 0;
+    while (first < subtrees.size()) {
+        std::size_t last = first;
+        unsigned int instances = 0;
+        while (last < subtrees.size() && instances < jobInstances) {
+            instances += nodeInstances[subtrees[last]].end - subtrees[last];
+            last++;
+        }
+
+        pool.submit([this, &subtrees, first, last] {
+            for (std::size_t i = first; i < last; i++) {
+                updateSubtree(subtrees[i]);
+            }
+        });
+        first = last;
+    }
+    pool.wait();
+
+    /* Preorder, children before their parents */
+    for (auto i = roots.rbegin(); i != roots.rend(); ++i) {
+        updateBounds(*i);
+    }
+}
+
+void SceneGraph::writeGroupMatrices(unsigned int first, unsigned int end) {
+    if (instanceGroups.empty()) {
+        return;
+    }
+
+    for (unsigned int i = first; i < end; i++) {
+        DrawEntry& entry = drawEntries[i];
+        if (entry.group != nullptr) {
+            entry.group->writeMatrix(entry.member,
+                    nodeInstances[entry.instance].world);
+        }
+    }
+}
+
+/* nullptr when graphs this size are walked on the drawing thread alone */
+WorkerPool* SceneGraph::getTraversalPool() {
+    if (nodeInstances.size() < MinParallelInstances || traversalThreads == 1) {
+        return nullptr;
+    }
+
+    if (traversalPool == nullptr) {
+        traversalPool.reset(new WorkerPool(traversalThreads));
+    }
+    return traversalPool->getNumberOfThreads() > 1 ?
+            traversalPool.get() : nullptr;
+}
+
+void SceneGraph::invalidateWorldMatrices(Node* node) {
+    if (!drawListValid) {
+        return;
+    }
+
+    for (unsigned int i = node->getFirstInstance(); i != 0;
+            i = nodeInstances[i].nextInstance) {
+        changedInstances.push_back(i);
+    }
+}
+
+void SceneGraph::getWorldMatrices(Node* node,
+        std::vector<const GLdouble*>& out) {
+    updateWorldMatrices();
+
+    for (unsigned int i = node->getFirstInstance(); i != 0;
+            i = nodeInstances[i].nextInstance) {
+        out.push_back(nodeInstances[i].world);
+    }
+}
+
+void SceneGraph::draw(const Frustum& frustum) {
+    updateWorldMatrices();
+
+    visitedInstances = 0;
+    culledInstances = 0;
+    drawnEntries = 0;
+    culledBatches = 0;
+    instancedCalls = 0;
+    instancedEntries = 0;
+    uploadedInstances = 0;
+    submittedTriangles = 0;
+    coarseEntries = 0;
+    appearanceChanges = 0;
+    textureChanges = 0;
+    listOrderAppearanceChanges = 0;
+    listOrderTextureChanges = 0;
+
+    glPushMatrix();
+
+    if (!useDrawList) {
+        this->rootNode->draw();
+        glPopMatrix();
+        return;
+    }
+
+    renderQueue.clear();
+
+    lodTolerance = LodPixelError * pow(2.0, lodBias);
+
+    instancedFrame = instancing && !instanceGroups.empty()
+            && InstanceGroup::isSupported();
+    if (instancedFrame) {
+        InstanceGroup::beginFrame();
+    }
+
+    /* Results of queries issued while it was on are still read */
+    occlusionCulling.beginFrame();
+    occlusionFrame = culling && occlusion
+            && occlusionCulling.getNumberOfUnits() > 0
+            && OcclusionCulling::isSupported();
+
+    queueVisibleEntries(frustum);
+
+    if (sorting) {
+        renderQueue.sort();
+    }
+    submitQueue();
+
+    if (occlusionFrame) {
+        drawRevealedSubtrees(frustum);
+    }
+
+    glPopMatrix();
+}
+
+/*
+ * The queries of the subtrees skipped as occluded are tested against what
+ * was just drawn. The ones that pass are drawn now, the units below them
+ * are taken as visible (they were not tested) until their next query.
+ */
+void SceneGraph::drawRevealedSubtrees(const Frustum& frustum) {
+    glLoadMatrixd(identityMatrix);
+    occlusionCulling.issueQueries();
+
+    std::vector<unsigned int> revealed;
+    occlusionCulling.collectResults(revealed);
+    if (revealed.empty()) {
+        return;
+    }
+
+    renderQueue.clear();
+
+    /* Walk order, groups take their members in order */
+    std::sort(revealed.begin(), revealed.end());
+
+    numberOfTraversalJobs = 0;
+    for (auto index : revealed) {
+        for (unsigned int i = index + 1; i < nodeInstances[index].end; i++) {
+            if (nodeInstances[i].occlusionUnit != 0) {
+                occlusionCulling.reveal(nodeInstances[i].occlusionUnit);
+            }
+        }
+
+        addTraversalJob(false, index, nodeInstances[index].end);
+    }
+
+    runTraversalJobs(frustum, false);
+    mergeTraversalJobs();
+
+    if (sorting) {
+        renderQueue.sort();
+    }
+    submitQueue();
+}
+
+/* The item vectors of a job are cleared, not freed */
+SceneGraph::TraversalJob& SceneGraph::addTraversalJob(bool entries,
+        unsigned int first, unsigned int end) {
+    if (numberOfTraversalJobs == traversalJobs.size()) {
+        traversalJobs.emplace_back();
+    }
+
+    TraversalJob& job = traversalJobs[numberOfTraversalJobs++];
+    job.entries = entries;
+    job.first = first;
+    job.end = end;
+    job.items.clear();
+    job.visitedInstances = 0;
+    job.culledInstances = 0;
+    job.drawnEntries = 0;
+    job.culledBatches = 0;
+    job.coarseEntries = 0;
+    job.listOrderAppearanceChanges = 0;
+    job.listOrderTextureChanges = 0;
+    return job;
+}
+
+void SceneGraph::queueVisibleEntries(const Frustum& frustum) {
+    auto start = std::chrono::steady_clock::now();
+
+    unsigned int instances = static_cast<unsigned int>(nodeInstances.size());
+    unsigned int entries = static_cast<unsigned int>(drawEntries.size());
+
+    numberOfTraversalJobs = 0;
+
+    WorkerPool* pool = getTraversalPool();
+    if (pool == nullptr) {
+        if (culling) {
+            addTraversalJob(false, 1, instances);
+        } else {
+            addTraversalJob(true, 0, entries);
+        }
+    } else {
+        unsigned int jobs = pool->getNumberOfThreads() * TraversalJobsPerThread;
+
+        if (culling) {
+            splitTraversal(std::max(MinJobInstances, instances / jobs),
+                    frustum, occlusionFrame);
+        } else {
+            unsigned int size = entries / jobs + 1;
+            for (unsigned int first = 0; first < entries; first += size) {
+                addTraversalJob(true, first, std::min(first + size, entries));
+            }
+        }
+    }
+
+    traversalJobThreads = runTraversalJobs(frustum, occlusionFrame);
+    traversalJobsRun = numberOfTraversalJobs;
+    mergeTraversalJobs();
+
+    traversalSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Same walk as a job, but a subtree small enough becomes a job of its own
+ * and so do the entries of the larger nodes above
+ */
+void SceneGraph::splitTraversal(unsigned int jobInstances,
+        const Frustum& frustum, bool occlusionTests) {
+    addTraversalJob(true, 0, 0);
+
+    unsigned int index = 1;
+    while (index < nodeInstances.size()) {
+        NodeInstance& instance = nodeInstances[index];
+
+        if (instance.firstEntry == instance.entriesEnd) {
+            index = instance.end;
+            continue;
+        }
+
+        if (instance.end - index <= jobInstances) {
+            addTraversalJob(false, index, instance.end);
+            index = instance.end;
+            continue;
+        }
+
+        /* Jobs are added as the walk goes, the vector may grow */
+        TraversalJob& top = traversalJobs[0];
+        top.visitedInstances++;
+
+        if (frustum.classify(instance.bounds) == Frustum::Outside) {
+            top.culledInstances++;
+            index = instance.end;
+            continue;
+        }
+
+        if (occlusionTests && instance.occlusionUnit != 0
+                && !occlusionCulling.visit(instance.occlusionUnit,
+                        instance.bounds, frustum, top.occlusionRequests)) {
+            index = instance.end;
+            continue;
+        }
+
+        if (instance.firstEntry < instance.ownEntriesEnd) {
+            addTraversalJob(true, instance.firstEntry, instance.ownEntriesEnd);
+        }
+        index++;
+    }
+}
+
+unsigned int SceneGraph::runTraversalJobs(const Frustum& frustum,
+        bool occlusionTests) {
+    auto run = [this, &frustum, occlusionTests](TraversalJob& job) {
+        if (job.entries) {
+            queueEntryRange(job.first, job.end, frustum, job);
+        } else {
+            queueVisibleEntries(job.first, job.end, frustum, occlusionTests,
+                    job);
+        }
+    };
+
+    WorkerPool* pool = getTraversalPool();
+    if (numberOfTraversalJobs < 2 || pool == nullptr) {
+        for (unsigned int i = 0; i < numberOfTraversalJobs; i++) {
+            run(traversalJobs[i]);
+        }
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < numberOfTraversalJobs; i++) {
+        TraversalJob* job = &traversalJobs[i];
+        pool->submit([run, job] {
+            run(*job);
+        });
+    }
+    pool->wait();
+
+    return std::min(numberOfTraversalJobs, pool->getNumberOfThreads());
+}
+
+void SceneGraph::mergeTraversalJobs() {
+    for (unsigned int i = 0; i < numberOfTraversalJobs; i++) {
+        TraversalJob& job = traversalJobs[i];
+
+        visitedInstances += job.visitedInstances;
+        culledInstances += job.culledInstances;
+        drawnEntries += job.drawnEntries;
+        culledBatches += job.culledBatches;
+        coarseEntries += job.coarseEntries;
+        listOrderAppearanceChanges += job.listOrderAppearanceChanges;
+        listOrderTextureChanges += job.listOrderTextureChanges;
+
+        occlusionCulling.addRequests(job.occlusionRequests);
+
+        for (auto& item : job.items) {
+            DrawEntry& entry = drawEntries[item.entry];
+
+            /* The rest of the group is drawn with its first visible member */
+            if (instancedFrame && entry.group != nullptr
+                    && !entry.group->addVisible(entry.member, entry.level)) {
+                continue;
+            }
+
+            renderQueue.push(item.key, item.entry);
+        }
+    }
+}
+
+/* Runs in a job, everything it counts or asks for goes to the job */
+void SceneGraph::queueVisibleEntries(unsigned int first, unsigned int end,
+        const Frustum& frustum, bool occlusionTests, TraversalJob& job) {
+    /* Preorder, skipping a subtree is jumping to its end */
+    unsigned int index = first;
+    while (index < end) {
+        NodeInstance& instance = nodeInstances[index];
+
+        /* Nothing left to draw below (leaves and nodes inside a display list) */
+        if (instance.firstEntry == instance.entriesEnd) {
+            index = instance.end;
+            continue;
+        }
+
+        job.visitedInstances++;
+
+        Frustum::Result result = frustum.classify(instance.bounds);
+        if (result == Frustum::Outside) {
+            job.culledInstances++;
+            index = instance.end;
+            continue;
+        }
+
+        if (occlusionTests && instance.occlusionUnit != 0
+                && !occlusionCulling.visit(instance.occlusionUnit,
+                        instance.bounds, frustum, job.occlusionRequests)) {
+            index = instance.end;
+            continue;
+        }
+
+        /* Inside the frustum, but the units below still have to be tested */
+        bool unitsBelow = occlusionTests
+                && instance.entriesEnd - instance.ownEntriesEnd
+                        >= MinOcclusionEntries;
+
+        if (result == Frustum::Inside && !unitsBelow) {
+            queueEntryRange(instance.firstEntry, instance.entriesEnd, frustum,
+                    job);
+            index = instance.end;
+        } else {
+            queueEntryRange(instance.firstEntry, instance.ownEntriesEnd,
+                    frustum, job);
+            index = instance.ownEntriesEnd == instance.entriesEnd ?
+                    instance.end : index + 1;
+        }
+    }
+}
+
+/* Dense ids, so the most used ones fit their key fields */
+void SceneGraph::setStateKeys() {
+    std::unordered_map<Appearance*, unsigned int> appearanceIds;
+    std::unordered_map<Texture*, unsigned int> textureIds;
+    std::unordered_map<Primitives::PrimitiveInterface*, unsigned int> shaderIds;
+
+    /* 0 stands for no texture and no shader */
+    textureIds[nullptr] = 0;
+    shaderIds[nullptr] = 0;
+
+    for (auto& entry : drawEntries) {
+        unsigned int appearance = getDenseId(appearanceIds, entry.appearance);
+
+        if (entry.displayListNode != nullptr) {
+            entry.stateKey = RenderQueue::makeStateKey(
+                    RenderQueue::PassDisplayList, 0, 0, appearance);
+            continue;
+        }
+
+        if (entry.primitive != nullptr && entry.primitive->hasShader()) {
+            unsigned int shader = getDenseId(shaderIds, entry.primitive);
+            entry.stateKey = RenderQueue::makeStateKey(RenderQueue::PassShader,
+                    shader, 0, appearance);
+            continue;
+        }
+
+        unsigned int texture = getDenseId(textureIds,
+                entry.appearance->getTexture());
+        entry.stateKey = RenderQueue::makeStateKey(
+                RenderQueue::PassFixedFunction, 0, texture, appearance);
+    }
+}
+
+/*
+ * Depth of the node's origin (a batch's center), good enough to draw each
+ * state run front to back. Batches are culled one by one, they can be much
+ * smaller than their node's subtree.
+ */
+void SceneGraph::queueEntryRange(unsigned int first, unsigned int end,
+        const Frustum& frustum, TraversalJob& job) {
+    for (unsigned int i = first; i < end; i++) {
+        DrawEntry& entry = drawEntries[i];
+        const GLdouble* world = nodeInstances[entry.instance].world;
+        GLdouble center[3];
+
+        if (entry.batch != nullptr) {
+            if (culling) {
+                BoundingBox bounds;
+                entry.batch->bounds.transform(world, bounds);
+                if (frustum.classify(bounds) == Frustum::Outside) {
+                    job.culledBatches++;
+                    continue;
+                }
+            }
+
+            transformPoint(world, entry.batch->center, center);
+        } else {
+            std::copy(world + 12, world + 15, center);
+        }
+
+        job.drawnEntries++;
+
+        if (entry.applyAppearance) {
+            job.listOrderAppearanceChanges++;
+            if (entry.appearance->getTexture() != nullptr) {
+                job.listOrderTextureChanges++;
+            }
+        }
+
+        if (entry.levels > 1) {
+            if (levelOfDetail) {
+                selectLevel(entry, frustum);
+            } else {
+                entry.level = 0;
+            }
+
+            if (entry.level > 0) {
+                job.coarseEntries++;
+            }
+        }
+
+        /* Groups are shared between jobs, members are added when merged */
+        RenderQueue::Item item;
+        item.key = entry.stateKey
+                | RenderQueue::makeDepthKey(frustum.getDepth(center));
+        item.entry = i;
+        job.items.push_back(item);
+    }
+}
+
+/*
+ * Errors are measured at the node's origin moved toward the camera by the
+ * primitive's reach, so a large primitive is judged by its nearest part
+ */
+void SceneGraph::selectLevel(DrawEntry& entry, const Frustum& frustum) {
+    NodeInstance& instance = nodeInstances[entry.instance];
+    GLdouble pixels = instance.scale
+            * frustum.getPixelsPerUnit(instance.world + 12,
+                    entry.reach * instance.scale);
+
+    unsigned int level = entry.level;
+    while (level > 0
+            && entry.primitive->getLevelError(level) * pixels > lodTolerance) {
+        level--;
+    }
+    while (level + 1 < entry.levels
+            && entry.primitive->getLevelError(level + 1) * pixels
+                    <= lodTolerance * LodHysteresis) {
+        level++;
+    }
+
+    entry.level = level;
+}
+
+void SceneGraph::submitQueue() {
+    /* What the GL state was last set to, nullptr once something else changed it */
+    Appearance* applied = nullptr;
+
+    for (auto& item : renderQueue.getItems()) {
+        DrawEntry& entry = drawEntries[item.entry];
+        bool grouped = instancedFrame && entry.group != nullptr;
+
+        /* Members carry their own world matrices */
+        glLoadMatrixd(
+                grouped ? identityMatrix : nodeInstances[entry.instance].world);
+
+        if (entry.displayListNode != nullptr) {
+            submittedTriangles += entry.displayListNode->callDisplayList(
+                    entry.appearance);
+            applied = nullptr;
+            continue;
+        }
+
+        /*
+         * Unsorted, every node applies its own. Grouped members are drawn
+         * early, so the node's first queued entry may not be the one that
+         * applies it, whatever differs from the last one applied is applied.
+         */
+        bool apply = entry.appearance != applied
+                || (!sorting && entry.applyAppearance);
+        if (apply) {
+            entry.appearance->apply();
+            applied = entry.appearance;
+
+            appearanceChanges++;
+            if (entry.appearance->getTexture() != nullptr) {
+                textureChanges++;
+            }
+        }
+
+        /* Read every frame, a reload may change the appearance */
+        if (grouped) {
+            GLdouble s = 1.0, t = 1.0;
+            if (entry.batch == nullptr) {
+                s = entry.appearance->getTextureSWrap();
+                t = entry.appearance->getTextureTWrap();
+                entry.primitive->getMesh(s, t);
+            }
+
+            uploadedInstances += entry.group->upload();
+            submittedTriangles += entry.group->getVisibleTriangles();
+            instancedEntries += static_cast<unsigned int>(
+                    entry.group->getNumberOfVisible());
+            instancedCalls += entry.group->draw(s, t,
+                    entry.appearance->getTexture() != nullptr);
+            continue;
+        }
+
+        /* Texture lengths are baked into the batch */
+        if (entry.batch != nullptr) {
+            entry.batch->mesh.draw();
+            submittedTriangles += entry.batch->mesh.getNumberOfTriangles();
+            continue;
+        }
+
+        /* Levels of detail ignore texture lengths */
+        if (entry.level > 0) {
+            Mesh* mesh = entry.primitive->getLevelMesh(entry.level);
+            mesh->draw();
+            submittedTriangles += mesh->getNumberOfTriangles();
+            continue;
+        }
+
+        entry.primitive->draw(entry.appearance->getTextureSWrap(),
+                entry.appearance->getTextureTWrap());
+        submittedTriangles += entry.primitive->getNumberOfTriangles();
+
+        if (entry.primitive->hasShader()) {
+            applied = nullptr;
+        }
+    }
+}
+
+void SceneGraph::setCulling(bool enabled) {
+    this->culling = enabled;
+}
+
+bool SceneGraph::getCulling() {
+    return this->culling;
+}
+
+unsigned int SceneGraph::getVisitedInstances() {
+    return this->visitedInstances;
+}
+
+unsigned int SceneGraph::getCulledInstances() {
+    return this->culledInstances;
+}
+
+unsigned int SceneGraph::getDrawnEntries() {
+    return this->drawnEntries;
+}
+
+unsigned int SceneGraph::getCulledBatches() {
+    return this->culledBatches;
+}
+
+unsigned int SceneGraph::getNumberOfStaticBatches() {
+    return static_cast<unsigned int>(staticBatches.size());
+}
+
+unsigned int SceneGraph::getNumberOfBatchedPrimitives() {
+    return this->batchedPrimitives;
+}
+
+void SceneGraph::setOcclusionCulling(bool enabled) {
+    this->occlusion = enabled;
+}
+
+bool SceneGraph::getOcclusionCulling() {
+    return this->occlusion;
+}
+
+void SceneGraph::printOcclusionStatistics(std::ostream& out) {
+    out << "Occlusion culling " << (occlusion ? "on" : "off") << " ("
+            << occlusionCulling.getNumberOfUnits() << " subtrees tested): ";
+    occlusionCulling.printStatistics(out);
+}
+
+void SceneGraph::setTraversalThreads(unsigned int threads) {
+    traversalThreads = threads;
+}
+
+unsigned int SceneGraph::getTraversalJobs() {
+    return this->traversalJobsRun;
+}
+
+unsigned int SceneGraph::getTraversalJobThreads() {
+    return this->traversalJobThreads;
+}
+
+double SceneGraph::getTraversalSeconds() {
+    return this->traversalSeconds;
+}
+
+void SceneGraph::setSorting(bool enabled) {
+    this->sorting = enabled;
+}
+
+bool SceneGraph::getSorting() {
+    return this->sorting;
+}
+
+void SceneGraph::setInstancing(bool enabled) {
+    this->instancing = enabled;
+}
+
+bool SceneGraph::getInstancing() {
+    return this->instancing;
+}
+
+unsigned int SceneGraph::getNumberOfInstanceGroups() {
+    return static_cast<unsigned int>(instanceGroups.size());
+}
+
+unsigned int SceneGraph::getNumberOfGroupedEntries() {
+    return this->groupedEntries;
+}
+
+unsigned int SceneGraph::getInstancedCalls() {
+    return this->instancedCalls;
+}
+
+unsigned int SceneGraph::getInstancedEntries() {
+    return this->instancedEntries;
+}
+
+unsigned int SceneGraph::getUploadedInstances() {
+    return this->uploadedInstances;
+}
+
+void SceneGraph::setLevelOfDetail(bool enabled) {
+    this->levelOfDetail = enabled;
+}
+
+bool SceneGraph::getLevelOfDetail() {
+    return this->levelOfDetail;
+}
+
+void SceneGraph::setLodBias(double bias) {
+    lodBias = bias;
+}
+
+double SceneGraph::getLodBias() {
+    return lodBias;
+}
+
+uint64_t SceneGraph::getSubmittedTriangles() {
+    return this->submittedTriangles;
+}
+
+unsigned int SceneGraph::getCoarseEntries() {
+    return this->coarseEntries;
+}
+
+unsigned int SceneGraph::getAppearanceChanges() {
+    return this->appearanceChanges;
+}
+
+unsigned int SceneGraph::getTextureChanges() {
+    return this->textureChanges;
+}
+
+unsigned int SceneGraph::getListOrderAppearanceChanges() {
+    return this->listOrderAppearanceChanges;
+}
+
+unsigned int SceneGraph::getListOrderTextureChanges() {
+    return this->listOrderTextureChanges;
 }
 }
@@ -5,6 +5,8 @@
  */
 
 #include <Shader.hpp>
+#include <GLState.hpp>
+#include <LoadProfiler.hpp>
 #include "includes.hpp"
 
 namespace ge {
@@ -70,10 +72,16 @@ static void validateProgram(GLuint program) {
     }
 }
 
-Shader::Shader(const char *vsFile, const char *fsFile) {
-    vertexShaderPointer = glCreateShader(GL_VERTEX_SHADER);
-    fragmentShaderPointer = glCreateShader(GL_FRAGMENT_SHADER);
+Shader::Shader() {
+    this->ID = 0;
+    this->vertexShaderPointer = 0;
+    this->fragmentShaderPointer = 0;
+    this->timeloc = -1;
+    this->totalTimePassed = 0;
+}
 
+Shader::Shader(const char *vsFile, const char *fsFile) :
+        Shader() {
     const char* vsText = textFileRead(vsFile);
     const char* fsText = textFileRead(fsFile);
 
@@ -89,22 +97,39 @@ Shader::Shader(const char *vsFile, const char *fsFile) {
         return;
     }
 
+    build(vsText, fsText, vsFile, fsFile);
+}
+
+Shader* Shader::fromSource(const char* vsText, const char* fsText) {
+    Shader* shader = new Shader();
+    shader->build(vsText, fsText, "built in", "built in");
+    return shader;
+}
+
+void Shader::build(const char* vsText, const char* fsText, const char* vsName,
+        const char* fsName) {
+    LoadProfiler::Scope profile(LoadProfiler::PhaseShaders);
+
+    vertexShaderPointer = glCreateShader(GL_VERTEX_SHADER);
+    fragmentShaderPointer = glCreateShader(GL_FRAGMENT_SHADER);
+    LoadProfiler::count(LoadProfiler::CounterGLObjects, 2);
+
     glShaderSource(vertexShaderPointer, 1, &vsText, 0);
     glShaderSource(fragmentShaderPointer, 1, &fsText, 0);
 
     glCompileShader(vertexShaderPointer);
-    validateShader(vertexShaderPointer, vsFile);
+    validateShader(vertexShaderPointer, vsName);
     glCompileShader(fragmentShaderPointer);
-    validateShader(fragmentShaderPointer, fsFile);
+    validateShader(fragmentShaderPointer, fsName);
 
     ID = glCreateProgram();
+    LoadProfiler::count(LoadProfiler::CounterGLObjects);
     glAttachShader(ID, fragmentShaderPointer);
     glAttachShader(ID, vertexShaderPointer);
     glLinkProgram(ID);
     validateProgram(ID);
 
     timeloc = glGetUniformLocation(ID, "time");
-    this->totalTimePassed = 0;
 }
 
 Shader::~Shader() {
@@ -120,12 +145,22 @@ unsigned int Shader::getId() {
     return ID;
 }
 
+bool Shader::isLinked() {
+    if (ID == 0) {
+        return false;
+    }
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(ID, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
 void Shader::bind() {
-    glUseProgram(ID);
+    GLState::useProgram(ID);
 }
 
 void Shader::unbind() {
-    glUseProgram(0);
+    GLState::useProgram(0);
 }
 
 void Shader::update(float time) {
@@ -5,6 +5,10 @@
  */
 
 #include <Texture.hpp>
+#include <GLState.hpp>
+#include <LoadProfiler.hpp>
+#include <MappedFile.hpp>
+#include <TextureResidency.hpp>
 
 namespace ge {
 
@@ -14,6 +18,14 @@ Texture::Texture(std::string& xmlIdIn, std::string& input) {
     this->loaded = false;
     this->xmlId = xmlIdIn;
     this->fileName = input;
+    this->decodedImage = nullptr;
+    this->imageSize = 0;
+    this->uploadedLevels = 0;
+    this->decodeTime = 0.0;
+    this->uploadTime = 0.0;
+    this->residencyState = NotResident;
+    this->lastUsedFrame = 0;
+    this->residency = nullptr;
 }
 
 GLuint Texture::getIdOpenGL() {
@@ -29,44 +41,160 @@ int Texture::getHeight() {
 }
 
 void Texture::loadTexture() {
+    decodeTexture();
+    uploadTexture();
+}
+
+void Texture::decodeTexture() {
+    if (this->fileName.empty() || this->decodedImage != nullptr) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::string pathFileName = TextureFolder + this->fileName;
+    int64_t sourceModificationTime;
+    uint64_t sourceSize;
+    if (!getFileModificationTime(pathFileName, sourceModificationTime,
+            sourceSize)) {
+        return;
+    }
 
-    if (!this->fileName.empty()) {
+    /* Only a missing or outdated cache costs a decode */
+    std::string cacheFileName = TextureCache::getCacheFileName(pathFileName);
+    TextureCache::Image* image = new TextureCache::Image();
 
-        if (!this->loaded) {
-            glGenTextures(1, &idOpenGL);
-            this->loaded = true;
+    if (!image->open(cacheFileName, sourceModificationTime, sourceSize)) {
+        if (!image->build(pathFileName, cacheFileName, sourceModificationTime,
+                sourceSize)) {
+            delete (image);
+            return;
         }
+        LoadProfiler::count(LoadProfiler::CounterTexturesDecoded);
+    }
+
+    uint32_t levelWidth, levelHeight;
+    image->getLevel(0, levelWidth, levelHeight);
+    this->width = static_cast<int>(levelWidth);
+    this->height = static_cast<int>(levelHeight);
+    this->decodedImage = image;
+
+    this->decodeTime = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+bool Texture::isDecoded() {
+    return this->fileName.empty() || this->decodedImage != nullptr;
+}
 
-        std::string pathFileName = TextureFolder + this->fileName;
+bool Texture::fileExists() {
+    int64_t modificationTime;
+    uint64_t size;
+    return this->fileName.empty()
+            || getFileModificationTime(TextureFolder + this->fileName,
+                    modificationTime, size);
+}
+
+void Texture::uploadTexture() {
+    if (this->fileName.empty()) {
+        return;
+    }
 
-        unsigned char *data = loadRGBImage(pathFileName.c_str(), &this->width,
-                &this->height);
+    if (this->decodedImage == nullptr) {
+        throw Exception(
+                "The texture could not be loaded: [" + this->fileName + "]",
+                true);
+    }
 
-        if (data) {
+    auto start = std::chrono::steady_clock::now();
 
-            glPixelStorei(GL_UNPACK_ROW_LENGTH, this->width);
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (!this->loaded) {
+        glGenTextures(1, &idOpenGL);
+        LoadProfiler::count(LoadProfiler::CounterGLObjects);
+        this->loaded = true;
+    }
 
-            glBindTexture(GL_TEXTURE_2D, this->idOpenGL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    /* RGBA rows are always 4 byte aligned */
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, this->width, this->height, 0,
-            GL_RGB, GL_UNSIGNED_BYTE, data);
+    GLState::bindTexture(this->idOpenGL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+            GL_LINEAR_MIPMAP_LINEAR);
 
-            free(data);
+    GLint levels = static_cast<GLint>(this->decodedImage->getNumberOfLevels());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
 
-        } else {
-            throw Exception(
-                    "The texture could not be loaded: [" + this->fileName + "]",
-                    true);
-        }
+    for (GLint level = 0; level < levels; level++) {
+        uint32_t levelWidth, levelHeight;
+        const unsigned char* pixels = this->decodedImage->getLevel(level,
+                levelWidth, levelHeight);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, levelWidth, levelHeight,
+                0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    /* Smaller than before, what is left of the old chain goes */
+    for (GLint level = levels; level < this->uploadedLevels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    this->imageSize = this->decodedImage->getPixelSize();
+    this->uploadedLevels = levels;
+
+    delete (this->decodedImage);
+    this->decodedImage = nullptr;
+
+    this->uploadTime = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+void Texture::uploadPlaceholder() {
+    static const unsigned char grey[3] = { 128, 128, 128 };
+
+    if (!this->loaded) {
+        glGenTextures(1, &idOpenGL);
+        LoadProfiler::count(LoadProfiler::CounterGLObjects);
+        this->loaded = true;
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLState::bindTexture(this->idOpenGL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE,
+            grey);
+
+    /* Empty levels free the rest of an evicted mip chain */
+    for (GLint level = 1; level < this->uploadedLevels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, nullptr);
     }
+
+    this->imageSize = 0;
+    this->uploadedLevels = 1;
+}
+
+std::size_t Texture::getImageSize() {
+    return this->imageSize;
 }
 
 void Texture::apply() {
+    touch();
+
     if (this->loaded) {
-        glBindTexture(GL_TEXTURE_2D, idOpenGL);
+        GLState::bindTexture(idOpenGL);
+    }
+}
+
+void Texture::touch() {
+    if (this->residency != nullptr) {
+        this->residency->touch(this);
     }
 }
 
@@ -74,8 +202,28 @@ std::string Texture::getXmlId() {
     return this->xmlId;
 }
 
+std::string Texture::getFileName() {
+    return this->fileName;
+}
+
+double Texture::getDecodeTime() {
+    return this->decodeTime;
+}
+
+double Texture::getUploadTime() {
+    return this->uploadTime;
+}
+
 Texture::~Texture() {
+    if (this->decodedImage != nullptr) {
+        delete (this->decodedImage);
+    }
 
+    /* Only uploaded textures touch OpenGL, so headless loads can delete theirs */
+    if (this->loaded) {
+        GLState::forgetTexture(idOpenGL);
+        glDeleteTextures(1, &idOpenGL);
+    }
 }
 
 }
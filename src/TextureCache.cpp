@@ -0,0 +1,241 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Preprocessed texture cache methods.
+ */
+
+#include <TextureCache.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#define getpid _getpid
+#endif
+
+#include <imagetools.hpp>
+
+namespace ge {
+namespace TextureCache {
+
+const uint64_t LevelAlignment = 16;
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + LevelAlignment - 1) & ~(LevelAlignment - 1);
+}
+
+/*
+ * Textures sharing an image may decode at the same time, on the pool or in
+ * another process, each writes its own file and the last rename wins
+ */
+static std::string getTemporaryFileName(const std::string& cacheFileName) {
+    static std::atomic<unsigned long> written(0);
+    return cacheFileName + "." + std::to_string(getpid()) + "."
+            + std::to_string(written++) + ".tmp";
+}
+
+/* Each pixel is the average of the (up to) four pixels it covers */
+static void downsample(const unsigned char* source, uint32_t sourceWidth,
+        uint32_t sourceHeight, unsigned char* destination, uint32_t width,
+        uint32_t height) {
+    for (uint32_t y = 0; y < height; y++) {
+        uint32_t y0 = y * 2;
+        uint32_t y1 = std::min(y0 + 1, sourceHeight - 1);
+
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t x0 = x * 2;
+            uint32_t x1 = std::min(x0 + 1, sourceWidth - 1);
+
+            const unsigned char* p00 = source + (y0 * sourceWidth + x0) * 4;
+            const unsigned char* p01 = source + (y0 * sourceWidth + x1) * 4;
+            const unsigned char* p10 = source + (y1 * sourceWidth + x0) * 4;
+            const unsigned char* p11 = source + (y1 * sourceWidth + x1) * 4;
+
+            unsigned char* out = destination + (y * width + x) * 4;
+            for (unsigned int c = 0; c < 4; c++) {
+                out[c] = static_cast<unsigned char>(
+                        (p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+            }
+        }
+    }
+}
+
+Image::Image() {
+    this->data = nullptr;
+}
+
+Image::~Image() {
+
+}
+
+bool Image::validate(const unsigned char* candidate,
+        std::size_t candidateSize) {
+    if (candidateSize < sizeof(Header)) {
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(candidate);
+
+    if (header->magic != Magic || header->version != Version
+            || header->byteOrder != ByteOrderMark
+            || header->headerSize != sizeof(Header) || header->levelCount < 1
+            || header->levelCount > MaxLevels) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->levelCount; i++) {
+        const LevelEntry& level = header->levels[i];
+        uint64_t end = level.offset
+                + static_cast<uint64_t>(level.width) * level.height * 4;
+
+        if (level.width == 0 || level.height == 0
+                || level.offset % LevelAlignment != 0 || end > candidateSize
+                || end < level.offset) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Image::open(const std::string& fileName, int64_t sourceModificationTime,
+        uint64_t sourceSize) {
+    this->data = nullptr;
+
+    if (!file.open(fileName) || !validate(file.getData(), file.getSize())) {
+        file.close();
+        return false;
+    }
+
+    /* Rebuilt if the image changed since */
+    const Header* header = reinterpret_cast<const Header*>(file.getData());
+    if (header->sourceModificationTime != sourceModificationTime
+            || header->sourceSize != sourceSize) {
+        file.close();
+        return false;
+    }
+
+    this->data = file.getData();
+    return true;
+}
+
+bool Image::build(const std::string& imageFileName,
+        const std::string& cacheFileName, int64_t sourceModificationTime,
+        uint64_t sourceSize) {
+    this->data = nullptr;
+
+    /* RGB, already flipped so the bottom row comes first */
+    int imageWidth, imageHeight;
+    unsigned char* rgb = loadRGBImage(imageFileName, &imageWidth,
+            &imageHeight);
+    if (rgb == nullptr) {
+        return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = Magic;
+    header.version = Version;
+    header.byteOrder = ByteOrderMark;
+    header.headerSize = sizeof(Header);
+    header.sourceModificationTime = sourceModificationTime;
+    header.sourceSize = sourceSize;
+
+    /* Lay out the chain, down to 1x1 */
+    uint64_t offset = alignOffset(sizeof(Header));
+    uint32_t width = static_cast<uint32_t>(imageWidth);
+    uint32_t height = static_cast<uint32_t>(imageHeight);
+
+    while (header.levelCount < MaxLevels) {
+        LevelEntry& level = header.levels[header.levelCount++];
+        level.offset = offset;
+        level.width = width;
+        level.height = height;
+        offset = alignOffset(offset + static_cast<uint64_t>(width) * height * 4);
+
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    buffer.assign(static_cast<std::size_t>(offset), 0);
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+
+    unsigned char* base = buffer.data() + header.levels[0].offset;
+    std::size_t pixelCount = static_cast<std::size_t>(imageWidth) * imageHeight;
+    for (std::size_t i = 0; i < pixelCount; i++) {
+        base[i * 4] = rgb[i * 3];
+        base[i * 4 + 1] = rgb[i * 3 + 1];
+        base[i * 4 + 2] = rgb[i * 3 + 2];
+        base[i * 4 + 3] = 255;
+    }
+    free(rgb);
+
+    for (uint32_t i = 1; i < header.levelCount; i++) {
+        const LevelEntry& source = header.levels[i - 1];
+        const LevelEntry& level = header.levels[i];
+        downsample(buffer.data() + source.offset, source.width, source.height,
+                buffer.data() + level.offset, level.width, level.height);
+    }
+
+    this->data = buffer.data();
+
+    /* Same as the yafb, never leave a half written cache behind */
+    std::string temporaryFileName = getTemporaryFileName(cacheFileName);
+    FILE* cacheFile = fopen(temporaryFileName.c_str(), "wb");
+    if (cacheFile == nullptr) {
+        return true;
+    }
+
+    bool writeOk = fwrite(buffer.data(), 1, buffer.size(), cacheFile)
+            == buffer.size();
+    writeOk = (fclose(cacheFile) == 0) && writeOk;
+
+    if (!writeOk
+            || std::rename(temporaryFileName.c_str(), cacheFileName.c_str())
+                    != 0) {
+        std::remove(temporaryFileName.c_str());
+    }
+
+    return true;
+}
+
+uint32_t Image::getNumberOfLevels() {
+    if (data == nullptr) {
+        return 0;
+    }
+    return reinterpret_cast<const Header*>(data)->levelCount;
+}
+
+const unsigned char* Image::getLevel(uint32_t level, uint32_t& width,
+        uint32_t& height) {
+    const LevelEntry& entry = reinterpret_cast<const Header*>(data)->levels[level];
+    width = entry.width;
+    height = entry.height;
+    return data + entry.offset;
+}
+
+std::size_t Image::getPixelSize() {
+    std::size_t pixelSize = 0;
+    for (uint32_t i = 0; i < getNumberOfLevels(); i++) {
+        const LevelEntry& entry =
+                reinterpret_cast<const Header*>(data)->levels[i];
+        pixelSize += static_cast<std::size_t>(entry.width) * entry.height * 4;
+    }
+    return pixelSize;
+}
+
+std::string getCacheFileName(const std::string& imageFileName) {
+    return imageFileName + FileExtension;
+}
+
+}
+}
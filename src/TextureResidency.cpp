@@ -0,0 +1,239 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Texture residency methods.
+ */
+
+#include <TextureResidency.hpp>
+#include <LoadProfiler.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace ge {
+
+std::vector<Texture*>* TextureResidency::recording = nullptr;
+
+std::size_t TextureResidency::defaultBudget = 256 * 1024 * 1024;
+
+TextureResidency::TextureResidency() {
+    this->frame = 1;
+    this->budget = defaultBudget;
+    this->evictAfterFrames = 120;
+
+    this->residentBytes = 0;
+    this->peakResidentBytes = 0;
+    this->uploads = 0;
+    this->evictions = 0;
+    this->stalls = 0;
+    this->failures = 0;
+}
+
+void TextureResidency::add(Texture* texture) {
+    texture->residency = this;
+    texture->lastUsedFrame = 0;
+    textures.push_back(texture);
+
+    /* Nothing to load */
+    if (texture->fileName.empty()) {
+        texture->residencyState = Texture::Resident;
+        return;
+    }
+
+    texture->uploadPlaceholder();
+
+    /* Already decoded (reloaded textures are checked first), uploaded next frame */
+    if (texture->decodedImage != nullptr) {
+        texture->residencyState = Texture::Decoded;
+        decoding.push_back(texture);
+    } else {
+        texture->residencyState = Texture::NotResident;
+    }
+}
+
+void TextureResidency::remove(Texture* texture) {
+    if (texture->residencyState == Texture::Decoding) {
+        pool->wait();
+    }
+
+    if (texture->residencyState == Texture::Resident) {
+        residentBytes -= texture->fileName.empty() ? 0 : texture->getImageSize();
+    }
+
+    textures.erase(std::remove(textures.begin(), textures.end(), texture),
+            textures.end());
+    decoding.erase(std::remove(decoding.begin(), decoding.end(), texture),
+            decoding.end());
+
+    texture->residency = nullptr;
+    texture->residencyState = Texture::NotResident;
+}
+
+void TextureResidency::clear() {
+    if (pool != nullptr) {
+        pool->wait();
+    }
+
+    for (auto texture : textures) {
+        texture->residency = nullptr;
+        texture->residencyState = Texture::NotResident;
+    }
+
+    textures.clear();
+    decoding.clear();
+    residentBytes = 0;
+}
+
+/* Only flags the texture, GL work waits for beginFrame (this may run inside glNewList) */
+void TextureResidency::touch(Texture* texture) {
+    if (recording != nullptr
+            && std::find(recording->begin(), recording->end(), texture)
+                    == recording->end()) {
+        recording->push_back(texture);
+    }
+
+    if (texture->lastUsedFrame == frame) {
+        return;
+    }
+    texture->lastUsedFrame = frame;
+
+    int state = texture->residencyState.load(std::memory_order_acquire);
+    if (state == Texture::Resident || state == Texture::DecodeFailed) {
+        return;
+    }
+
+    /* Drawn with the placeholder this frame */
+    stalls++;
+
+    if (state == Texture::NotResident) {
+        if (pool == nullptr) {
+            pool.reset(new WorkerPool());
+        }
+
+        texture->residencyState = Texture::Decoding;
+        decoding.push_back(texture);
+
+        pool->submit([texture] {
+            texture->decodeTexture();
+            texture->residencyState.store(
+                    texture->decodedImage != nullptr ?
+                            Texture::Decoded : Texture::DecodeFailed,
+                    std::memory_order_release);
+        });
+    }
+}
+
+void TextureResidency::beginFrame() {
+    frame++;
+
+    for (std::size_t i = 0; i < decoding.size();) {
+        Texture* texture = decoding[i];
+        int state = texture->residencyState.load(std::memory_order_acquire);
+
+        if (state == Texture::Decoding) {
+            i++;
+            continue;
+        }
+
+        if (state == Texture::Decoded) {
+            LoadProfiler::Scope profile(LoadProfiler::PhaseTextureUpload);
+            texture->uploadTexture();
+            texture->residencyState = Texture::Resident;
+
+            residentBytes += texture->getImageSize();
+            peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+            uploads++;
+        } else {
+            /* Keeps the placeholder, a broken image is not worth stopping the scene */
+            failures++;
+            std::cerr << "The texture could not be loaded: ["
+                    << texture->fileName << "]" << std::endl;
+        }
+
+        decoding[i] = decoding.back();
+        decoding.pop_back();
+    }
+
+    evict();
+}
+
+/* Least recently used first, textures drawn recently are kept even over the budget */
+void TextureResidency::evict() {
+    if (residentBytes <= budget) {
+        return;
+    }
+
+    std::vector<Texture*> candidates;
+    for (auto texture : textures) {
+        if (texture->residencyState == Texture::Resident
+                && !texture->fileName.empty()
+                && frame - texture->lastUsedFrame > evictAfterFrames) {
+            candidates.push_back(texture);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+            [](Texture* a, Texture* b) {
+                return a->lastUsedFrame < b->lastUsedFrame;
+            });
+
+    for (auto texture : candidates) {
+        if (residentBytes <= budget) {
+            break;
+        }
+
+        residentBytes -= texture->getImageSize();
+        texture->uploadPlaceholder();
+        texture->residencyState = Texture::NotResident;
+        evictions++;
+    }
+}
+
+void TextureResidency::setBudget(std::size_t bytes) {
+    this->budget = bytes;
+}
+
+void TextureResidency::setEvictAfterFrames(unsigned int frames) {
+    this->evictAfterFrames = frames;
+}
+
+std::vector<Texture*>* TextureResidency::startRecording(
+        std::vector<Texture*>* in) {
+    std::vector<Texture*>* previous = recording;
+    recording = in;
+    return previous;
+}
+
+void TextureResidency::stopRecording(std::vector<Texture*>* previous) {
+    recording = previous;
+}
+
+void TextureResidency::setDefaultBudget(std::size_t bytes) {
+    defaultBudget = bytes;
+}
+
+void TextureResidency::printStatistics(std::ostream& out) {
+    unsigned int resident = 0;
+    for (auto texture : textures) {
+        if (texture->residencyState == Texture::Resident
+                && !texture->fileName.empty()) {
+            resident++;
+        }
+    }
+
+    const double megabyte = 1024.0 * 1024.0;
+    out << "Textures: " << resident << " of " << textures.size()
+            << " resident, " << residentBytes / megabyte << " MB (peak "
+            << peakResidentBytes / megabyte << " MB, budget "
+            << budget / megabyte << " MB), " << uploads << " uploads, "
+            << evictions << " evictions, " << stalls << " stalls, "
+            << failures << " failed." << std::endl;
+}
+
+TextureResidency::~TextureResidency() {
+    if (pool != nullptr) {
+        pool->wait();
+    }
+}
+
+}
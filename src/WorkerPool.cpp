@@ -0,0 +1,93 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Thread pool methods.
+ */
+
+#include <WorkerPool.hpp>
+
+namespace ge {
+
+WorkerPool::WorkerPool(unsigned int numberOfThreads) {
+    this->pendingJobs = 0;
+    this->stopping = false;
+
+    if (numberOfThreads == 0) {
+        numberOfThreads = std::thread::hardware_concurrency();
+    }
+
+    /* hardware_concurrency may not be able to tell */
+    if (numberOfThreads == 0) {
+        numberOfThreads = 2;
+    }
+
+    for (unsigned int i = 0; i < numberOfThreads; i++) {
+        workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+void WorkerPool::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobAvailable.wait(lock, [this] {
+                return this->stopping || !this->jobs.empty();
+            });
+
+            if (jobs.empty()) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            this->pendingJobs--;
+            if (this->pendingJobs == 0) {
+                jobsFinished.notify_all();
+            }
+        }
+    }
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        jobs.push(std::move(job));
+        this->pendingJobs++;
+    }
+
+    jobAvailable.notify_one();
+}
+
+void WorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    jobsFinished.wait(lock, [this] {
+        return this->pendingJobs == 0;
+    });
+}
+
+unsigned int WorkerPool::getNumberOfThreads() {
+    return static_cast<unsigned int>(workers.size());
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        this->stopping = true;
+    }
+
+    jobAvailable.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+}
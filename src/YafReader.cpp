@@ -0,0 +1,530 @@
+/*
+ * Eduardo Fernandes
+ *
+ * Streaming yaf (xml) reader methods.
+ */
+
+#include <YafReader.hpp>
+#include <LoadProfiler.hpp>
+#include "includes.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+namespace ge {
+
+static bool isXmlSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* Reads count numbers, the separators are the ones sscanf("%f %f") accepts */
+template<typename T>
+static bool parseNumberList(std::string_view in, T* out, unsigned count) {
+    const char* p = in.data();
+    const char* e = p + in.size();
+
+    for (unsigned i = 0; i < count; i++) {
+        while (p < e && isXmlSpace(*p)) {
+            p++;
+        }
+
+        /* from_chars does not take the leading plus sign */
+        if (p < e && *p == '+') {
+            p++;
+        }
+
+        std::from_chars_result result = std::from_chars(p, e, out[i]);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        p = result.ptr;
+
+        if (i + 1 < count && p < e && !isXmlSpace(*p)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/******************** ELEMENT ********************/
+YafElement::YafElement() {
+    this->token = Xml::Names::Unknown;
+    this->attributeCount = 0;
+    this->row = 0;
+}
+
+std::string_view YafElement::getName() const {
+    return this->name;
+}
+
+Xml::Names::Name YafElement::getToken() const {
+    return this->token;
+}
+
+int YafElement::getRow() const {
+    return this->row;
+}
+
+const std::string_view* YafElement::getAttribute(
+        Xml::Names::Name attribute) const {
+    if (attribute == Xml::Names::Unknown) {
+        return nullptr;
+    }
+
+    for (std::size_t i = 0; i < this->attributeCount; i++) {
+        if (attributes[i].name == attribute) {
+            return &attributes[i].value;
+        }
+    }
+
+    return nullptr;
+}
+
+std::size_t YafElement::getNumberOfAttributes() const {
+    return this->attributeCount;
+}
+
+Xml::Names::Name YafElement::getAttributeToken(std::size_t i) const {
+    return attributes[i].name;
+}
+
+std::string_view YafElement::getAttributeValue(std::size_t i) const {
+    return attributes[i].value;
+}
+
+bool YafElement::getNumbers(Xml::Names::Name attribute, double* out,
+        unsigned count) const {
+    const std::string_view* value = getAttribute(attribute);
+    return value != nullptr && YafReader::parseNumbers(*value, out, count);
+}
+
+bool YafElement::getNumbers(Xml::Names::Name attribute, float* out,
+        unsigned count) const {
+    const std::string_view* value = getAttribute(attribute);
+    return value != nullptr && YafReader::parseNumbers(*value, out, count);
+}
+
+bool YafElement::getNumbers(Xml::Names::Name attribute, unsigned* out,
+        unsigned count) const {
+    const std::string_view* value = getAttribute(attribute);
+    return value != nullptr && YafReader::parseNumbers(*value, out, count);
+}
+
+/******************** READER ********************/
+YafReader::YafReader() {
+    this->file = nullptr;
+    this->begin = 0;
+    this->end = 0;
+    this->endOfFile = false;
+    this->row = 1;
+    this->depth = 0;
+}
+
+bool YafReader::parse(const std::string& fileName, YafHandler& handler) {
+    file = fopen(fileName.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    buffer.resize(ChunkSize);
+    this->begin = 0;
+    this->end = 0;
+    this->endOfFile = false;
+    this->row = 1;
+    this->depth = 0;
+
+    fillBuffer();
+
+    /* Skip the UTF-8 byte order mark */
+    if (end - begin >= 3 && memcmp(&buffer[begin], "\xEF\xBB\xBF", 3) == 0) {
+        this->begin += 3;
+    }
+
+    for (;;) {
+        if (begin == end && !fillBuffer()) {
+            break;
+        }
+
+        /* Text between elements is not used by yaf, skip it */
+        const char* start = &buffer[begin];
+        const char* markup = static_cast<const char*>(memchr(start, '<',
+                end - begin));
+
+        if (markup == nullptr) {
+            consume(end - begin);
+            continue;
+        }
+
+        consume(static_cast<std::size_t>(markup - start));
+
+        bool complete;
+        std::size_t markupEnd = findMarkupEnd(begin, complete);
+
+        while (!complete) {
+            if (endOfFile) {
+                throw Exception("XML: Unexpected end of file.", true, row);
+            }
+
+            if (end - begin >= MaxMarkupSize) {
+                throw Exception("XML: Element is too large.", true, row);
+            }
+
+            fillBuffer();
+            markupEnd = findMarkupEnd(begin, complete);
+        }
+
+        const char* tag = &buffer[begin];
+        std::size_t length = markupEnd - begin;
+        int tagRow = this->row;
+
+        if (tag[1] == '/') {
+            /* End tag */
+            std::size_t nameStart = 2, nameEnd = length - 1;
+            while (nameEnd > nameStart && isXmlSpace(tag[nameEnd - 1])) {
+                nameEnd--;
+            }
+
+            element.name = std::string_view(tag + nameStart,
+                    nameEnd - nameStart);
+            element.token = Xml::Names::find(element.name);
+            element.attributeCount = 0;
+            element.row = tagRow;
+
+            if (depth == 0 || openElements[depth - 1] != element.name) {
+                throw Exception(
+                        "XML: Unexpected end tag [" + std::string(element.name)
+                                + "].", true, tagRow);
+            }
+
+            depth--;
+            handler.endElement(element);
+            consume(length);
+        } else if (tag[1] == '?' || tag[1] == '!') {
+            /* Declarations, comments, doctype and CDATA are ignored */
+            consume(length);
+        } else {
+            parseTag(tag + 1, length - 2, tagRow, handler);
+            consume(length);
+        }
+    }
+
+    fclose(file);
+    file = nullptr;
+
+    if (depth > 0) {
+        throw Exception(
+                "XML: Unexpected end of file, element ["
+                        + openElements[depth - 1] + "] is not closed.", true,
+                row);
+    }
+
+    return true;
+}
+
+/* Moves the unparsed bytes to the front and reads the next chunk */
+bool YafReader::fillBuffer() {
+    if (begin > 0) {
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        this->end -= this->begin;
+        this->begin = 0;
+    }
+
+    /* Only grows while a single tag does not fit */
+    if (buffer.size() - end < ChunkSize) {
+        buffer.resize(end + ChunkSize);
+    }
+
+    std::size_t readBytes = fread(buffer.data() + end, 1, ChunkSize, file);
+    if (readBytes == 0) {
+        this->endOfFile = true;
+        return false;
+    }
+
+    this->end += readBytes;
+    LoadProfiler::count(LoadProfiler::CounterBytesRead, readBytes);
+    return true;
+}
+
+void YafReader::consume(std::size_t length) {
+    const char* data = &buffer[begin];
+    for (std::size_t i = 0; i < length; i++) {
+        if (data[i] == '\n') {
+            this->row++;
+        }
+    }
+
+    this->begin += length;
+}
+
+/* Returns the position after the markup starting at start (a '<') */
+std::size_t YafReader::findMarkupEnd(std::size_t start, bool& complete) {
+    const char* data = buffer.data();
+    std::size_t available = end - start;
+    complete = false;
+
+    /* Long enough to tell the markup types apart */
+    if (available < 9 && !endOfFile) {
+        return 0;
+    }
+
+    const char* terminator = ">";
+    std::size_t position = start + 1;
+
+    if (available >= 4 && memcmp(data + start, "<!--", 4) == 0) {
+        terminator = "-->";
+        position = start + 4;
+    } else if (available >= 9 && memcmp(data + start, "<![CDATA[", 9) == 0) {
+        terminator = "]]>";
+        position = start + 9;
+    } else if (available >= 2 && data[start + 1] == '?') {
+        terminator = "?>";
+        position = start + 2;
+    }
+
+    std::size_t terminatorLength = strlen(terminator);
+
+    if (terminatorLength > 1) {
+        for (; position + terminatorLength <= end; position++) {
+            if (memcmp(data + position, terminator, terminatorLength) == 0) {
+                complete = true;
+                return position + terminatorLength;
+            }
+        }
+
+        return 0;
+    }
+
+    /* Tags and doctype, '>' may show up inside quotes or an internal subset */
+    char quote = 0;
+    int bracketDepth = 0;
+    for (; position < end; position++) {
+        char c = data[position];
+
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '[') {
+            bracketDepth++;
+        } else if (c == ']' && bracketDepth > 0) {
+            bracketDepth--;
+        } else if (c == '>' && bracketDepth == 0) {
+            complete = true;
+            return position + 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Parses the inside of a start tag (without '<' and '>') */
+void YafReader::parseTag(const char* tag, std::size_t length, int tagRow,
+        YafHandler& handler) {
+    const char* p = tag;
+    const char* e = tag + length;
+
+    bool emptyElement = length > 0 && e[-1] == '/';
+    if (emptyElement) {
+        e--;
+    }
+
+    const char* nameStart = p;
+    while (p < e && !isXmlSpace(*p)) {
+        p++;
+    }
+
+    if (p == nameStart) {
+        throw Exception("XML: Invalid element.", true, tagRow);
+    }
+
+    element.name = std::string_view(nameStart,
+            static_cast<std::size_t>(p - nameStart));
+    element.token = Xml::Names::find(element.name);
+    element.attributeCount = 0;
+    element.row = tagRow;
+    LoadProfiler::count(LoadProfiler::CounterElementsParsed);
+
+    for (;;) {
+        while (p < e && isXmlSpace(*p)) {
+            p++;
+        }
+
+        if (p == e) {
+            break;
+        }
+
+        const char* attributeStart = p;
+        while (p < e && *p != '=' && !isXmlSpace(*p)) {
+            p++;
+        }
+        const char* attributeEnd = p;
+
+        while (p < e && isXmlSpace(*p)) {
+            p++;
+        }
+
+        if (p == e || *p != '=' || attributeStart == attributeEnd) {
+            throw Exception(
+                    "XML: Invalid attribute in element ["
+                            + std::string(element.name) + "].",
+                    true, tagRow);
+        }
+        p++;
+
+        while (p < e && isXmlSpace(*p)) {
+            p++;
+        }
+
+        if (p == e || (*p != '"' && *p != '\'')) {
+            throw Exception(
+                    "XML: Attribute values must be quoted in element ["
+                            + std::string(element.name) + "].", true, tagRow);
+        }
+
+        char quote = *p++;
+        const char* valueStart = p;
+        while (p < e && *p != quote) {
+            p++;
+        }
+
+        if (p == e) {
+            throw Exception(
+                    "XML: Unterminated attribute value in element ["
+                            + std::string(element.name) + "].", true, tagRow);
+        }
+
+        if (element.attributeCount == element.attributes.size()) {
+            element.attributes.emplace_back();
+            element.decodedValues.emplace_back();
+        }
+
+        YafElement::Attribute& attribute =
+                element.attributes[element.attributeCount];
+        std::size_t valueLength = static_cast<std::size_t>(p - valueStart);
+
+        attribute.name = Xml::Names::find(
+                std::string_view(attributeStart,
+                        static_cast<std::size_t>(attributeEnd
+                                - attributeStart)));
+        attribute.value = std::string_view(valueStart, valueLength);
+        attribute.decoded = decodeValue(valueStart, valueLength,
+                element.decodedValues[element.attributeCount], tagRow);
+        element.attributeCount++;
+
+        p++;
+    }
+
+    /* The decoded strings do not move anymore, point the values to them */
+    for (std::size_t i = 0; i < element.attributeCount; i++) {
+        if (element.attributes[i].decoded) {
+            element.attributes[i].value = element.decodedValues[i];
+        }
+    }
+
+    if (!emptyElement) {
+        if (depth == openElements.size()) {
+            openElements.emplace_back();
+        }
+        openElements[depth].assign(element.name.data(), element.name.size());
+        depth++;
+    }
+
+    handler.startElement(element);
+
+    if (emptyElement) {
+        element.attributeCount = 0;
+        handler.endElement(element);
+    }
+}
+
+/* Replaces the xml entities, returns false (out is not used) if there are none */
+bool YafReader::decodeValue(const char* in, std::size_t length,
+        std::string& out, int tagRow) {
+    const char* ampersand = static_cast<const char*>(memchr(in, '&', length));
+    if (ampersand == nullptr) {
+        return false;
+    }
+
+    out.clear();
+    const char* e = in + length;
+
+    for (const char* p = in; p < e; p++) {
+        if (*p != '&') {
+            out.push_back(*p);
+            continue;
+        }
+
+        const char* semicolon = static_cast<const char*>(memchr(p, ';',
+                static_cast<std::size_t>(e - p)));
+        if (semicolon == nullptr) {
+            throw Exception("XML: Invalid entity in attribute value.", true,
+                    tagRow);
+        }
+
+        std::string entity(p + 1, semicolon);
+        if (entity == "lt") {
+            out.push_back('<');
+        } else if (entity == "gt") {
+            out.push_back('>');
+        } else if (entity == "amp") {
+            out.push_back('&');
+        } else if (entity == "quot") {
+            out.push_back('"');
+        } else if (entity == "apos") {
+            out.push_back('\'');
+        } else if (entity.size() > 1 && entity[0] == '#') {
+            unsigned long code;
+            if (entity[1] == 'x') {
+                code = strtoul(entity.c_str() + 2, nullptr, 16);
+            } else {
+                code = strtoul(entity.c_str() + 1, nullptr, 10);
+            }
+
+            /* Yaf files are plain ASCII, anything else is stored as UTF-8 */
+            if (code < 0x80) {
+                out.push_back(static_cast<char>(code));
+            } else if (code < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            } else {
+                out.push_back(static_cast<char>(0xE0 | ((code >> 12) & 0x0F)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+        } else {
+            throw Exception("XML: Unknown entity [" + entity + "].", true,
+                    tagRow);
+        }
+
+        p = semicolon;
+    }
+
+    return true;
+}
+
+bool YafReader::parseNumbers(std::string_view in, double* out,
+        unsigned count) {
+    return parseNumberList(in, out, count);
+}
+
+bool YafReader::parseNumbers(std::string_view in, float* out,
+        unsigned count) {
+    return parseNumberList(in, out, count);
+}
+
+bool YafReader::parseNumbers(std::string_view in, unsigned* out,
+        unsigned count) {
+    return parseNumberList(in, out, count);
+}
+
+YafReader::~YafReader() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+}